@@ -0,0 +1,139 @@
+/* ----------------------------------------------------------------------------
+ * Copyright 2017, Massachusetts Institute of Technology,
+ * Cambridge, MA 02139
+ * All Rights Reserved
+ * Authors: Luca Carlone, et al. (see THANKS for the full author list)
+ * See LICENSE for the license information
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @file   BenchmarkPlaneFactors.cpp
+ * @brief  Times the error and Jacobian evaluation of the plane factors, with
+ * dynamic and with fixed-size Jacobians, and their linearization.
+ * @author Antoni Rosinol
+ */
+
+#include <cmath>
+#include <string>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include <gtsam/geometry/OrientedPlane3.h>
+#include <gtsam/geometry/Point3.h>
+#include <gtsam/nonlinear/Values.h>
+
+#include "kimera-vio/factors/ParallelPlaneRegularFactor.h"
+#include "kimera-vio/factors/PointPlaneFactor.h"
+#include "kimera-vio/utils/Timer.h"
+
+DEFINE_int32(nr_evaluations, 100000, "Nr of evaluations per timing.");
+
+namespace VIO {
+
+/* -------------------------------------------------------------------------- */
+// First entry of the error of a factor, scalar or vector.
+inline double firstEntry(const double& error) { return error; }
+template <int Dim>
+inline double firstEntry(const Eigen::Matrix<double, Dim, 1>& error) {
+  return error(0);
+}
+
+/* -------------------------------------------------------------------------- */
+// Times evaluateError, evaluateErrorFixed and linearize of a binary factor.
+// The accumulated error is returned, so that the loops are not optimized out.
+template <typename Factor, typename FixedJacobian, typename Value1,
+          typename Value2>
+double timeFactor(const std::string& name,
+                  const Factor& factor,
+                  const Value1& value_1,
+                  const Value2& value_2) {
+  const size_t nr_evaluations = static_cast<size_t>(FLAGS_nr_evaluations);
+  double accumulated_error = 0.0;
+
+  auto tic = utils::Timer::tic();
+  for (size_t i = 0u; i < nr_evaluations; ++i) {
+    gtsam::Matrix H1, H2;
+    accumulated_error += factor.evaluateError(value_1, value_2, H1, H2)(0);
+  }
+  const auto dynamic_us = utils::Timer::toc<std::chrono::microseconds>(tic);
+
+  FixedJacobian H1_fixed, H2_fixed;
+  tic = utils::Timer::tic();
+  for (size_t i = 0u; i < nr_evaluations; ++i) {
+    accumulated_error -= firstEntry(
+        factor.evaluateErrorFixed(value_1, value_2, H1_fixed, H2_fixed));
+  }
+  const auto fixed_us = utils::Timer::toc<std::chrono::microseconds>(tic);
+
+  gtsam::Values values;
+  values.insert(factor.key1(), value_1);
+  values.insert(factor.key2(), value_2);
+  tic = utils::Timer::tic();
+  for (size_t i = 0u; i < nr_evaluations; ++i) {
+    CHECK(factor.linearize(values));
+  }
+  const auto linearize_us = utils::Timer::toc<std::chrono::microseconds>(tic);
+
+  LOG(INFO) << name << " timing for " << nr_evaluations
+            << " evaluations [us]:\n"
+            << " - dynamic Jacobians: " << dynamic_us.count() << '\n'
+            << " - fixed-size Jacobians: " << fixed_us.count() << '\n'
+            << " - linearize: " << linearize_us.count();
+  return accumulated_error;
+}
+
+}  // namespace VIO
+
+int main(int argc, char* argv[]) {
+  // Initialize Google's flags library.
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  // Initialize Google's logging library.
+  google::InitGoogleLogging(argv[0]);
+  CHECK_GT(FLAGS_nr_evaluations, 0);
+
+  const gtsam::Point3 point(4.3, -3.2, 1.9);
+  const gtsam::OrientedPlane3 plane_1(gtsam::Unit3(2.4, 1.2, 1.9), 2.3);
+  const gtsam::OrientedPlane3 plane_2(0.1, 0.1, 0.9, 0.1);
+
+  double accumulated_error = 0.0;
+  accumulated_error +=
+      VIO::timeFactor<gtsam::PointPlaneFactor, gtsam::Matrix13>(
+      "PointPlaneFactor",
+      gtsam::PointPlaneFactor(
+          1, 2, gtsam::noiseModel::Isotropic::Sigma(1, 0.1)),
+      point,
+      plane_1);
+  accumulated_error += VIO::timeFactor<
+      gtsam::ParallelPlaneRegularTangentSpaceFactor, gtsam::Matrix23>(
+      "ParallelPlaneRegularTangentSpaceFactor",
+      gtsam::ParallelPlaneRegularTangentSpaceFactor(
+          1, 2, gtsam::noiseModel::Isotropic::Sigma(2, 0.1)),
+      plane_1,
+      plane_2);
+  accumulated_error += VIO::timeFactor<
+      gtsam::GeneralParallelPlaneRegularTangentSpaceFactor, gtsam::Matrix33>(
+      "GeneralParallelPlaneRegularTangentSpaceFactor",
+      gtsam::GeneralParallelPlaneRegularTangentSpaceFactor(
+          1, 2, gtsam::noiseModel::Isotropic::Sigma(3, 0.1), 1.0),
+      plane_1,
+      plane_2);
+  accumulated_error += VIO::timeFactor<gtsam::ParallelPlaneRegularBasicFactor,
+                                       gtsam::Matrix33>(
+      "ParallelPlaneRegularBasicFactor",
+      gtsam::ParallelPlaneRegularBasicFactor(
+          1, 2, gtsam::noiseModel::Isotropic::Sigma(3, 0.1)),
+      plane_1,
+      plane_2);
+  accumulated_error += VIO::timeFactor<
+      gtsam::GeneralParallelPlaneRegularBasicFactor, gtsam::Matrix43>(
+      "GeneralParallelPlaneRegularBasicFactor",
+      gtsam::GeneralParallelPlaneRegularBasicFactor(
+          1, 2, gtsam::noiseModel::Isotropic::Sigma(4, 0.1), 1.0),
+      plane_1,
+      plane_2);
+  // Dynamic and fixed-size evaluations cancel out.
+  LOG_IF(ERROR, std::abs(accumulated_error) > 1e-6)
+      << "Dynamic and fixed-size errors differ: " << accumulated_error;
+  return 0;
+}
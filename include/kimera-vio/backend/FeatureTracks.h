@@ -0,0 +1,171 @@
+/* ----------------------------------------------------------------------------
+ * Copyright 2017, Massachusetts Institute of Technology,
+ * Cambridge, MA 02139
+ * All Rights Reserved
+ * Authors: Luca Carlone, et al. (see THANKS for the full author list)
+ * See LICENSE for the license information
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @file   FeatureTracks.h
+ * @brief  Feature tracks of the landmarks in the time horizon of the Backend.
+ * @author Antoni Rosinol
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <iostream>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <boost/circular_buffer.hpp>
+
+#include <glog/logging.h>
+
+#include <gtsam/geometry/StereoPoint2.h>
+
+#include "kimera-vio/common/vio_types.h"
+
+namespace VIO {
+
+////////////////////////////////////////////////////////////////////////////////
+// FeatureTrack
+// TODO(Toni): what is this doing here... should be in Frontend at worst.
+class FeatureTrack {
+  // TODO(Toni): a feature track should have a landmark id...
+  // TODO(Toni): a feature track should contain a pixel measurement per frame
+  // but allow for multi-frame measurements at a time.
+  // TODO(Toni): add getters for feature track length
+ public:
+  using Observation = std::pair<FrameId, gtsam::StereoPoint2>;
+  //! Observations are in a ring buffer that only grows when the oldest one
+  //! is still in the time horizon.
+  using Observations = boost::circular_buffer<Observation>;
+  static constexpr size_t kInitialCapacity = 8u;
+
+  //! Observation: {FrameId, Px-Measurement}
+  Observations obs_;
+
+  // Is the lmk in the graph?
+  bool in_ba_graph_ = false;
+
+  FeatureTrack() : obs_(kInitialCapacity) {}
+
+  FeatureTrack(FrameId frame_id, const gtsam::StereoPoint2& px)
+      : obs_(kInitialCapacity) {
+    obs_.push_back(std::make_pair(frame_id, px));
+  }
+
+  //! Starts a new track with a single observation, keeping the memory.
+  void reset(const FrameId& frame_id, const gtsam::StereoPoint2& px) {
+    obs_.clear();
+    obs_.push_back(std::make_pair(frame_id, px));
+    in_ba_graph_ = false;
+  }
+
+  /**
+   * @brief addObservation Appends an observation and drops the ones from
+   * frames older than oldest_frame_id, which have left the time horizon.
+   */
+  void addObservation(const FrameId& frame_id,
+                      const gtsam::StereoPoint2& px,
+                      const FrameId& oldest_frame_id) {
+    while (!obs_.empty() && obs_.front().first < oldest_frame_id) {
+      obs_.pop_front();
+    }
+    if (obs_.full()) obs_.set_capacity(2u * obs_.capacity());
+    obs_.push_back(std::make_pair(frame_id, px));
+  }
+
+  void print() const {
+    LOG(INFO) << "Feature track with cameras: ";
+    for (size_t i = 0u; i < obs_.size(); i++) {
+      std::cout << " " << obs_[i].first << " ";
+    }
+    std::cout << std::endl;
+  }
+};
+
+/**
+ * @brief The FeatureTracks class holds the feature track of each landmark
+ * (lmk_id -> collection of pairs of frame id and pixel location).
+ *
+ * Tracks live in a slot-indexed arena: a landmark id is mapped to a slot, and
+ * the slots of erased or stale tracks are reused by new tracks together with
+ * their observation buffers, so that the memory stays flat once the arena
+ * covers the landmarks in the time horizon. Tracks that have not been
+ * observed in the time horizon and are not in the graph are recycled in time
+ * linear in the number of observations added since the last call.
+ */
+// TODO(Toni): what is this doing here... should be in Frontend at worst.
+class FeatureTracks {
+ public:
+  FeatureTracks() = default;
+  ~FeatureTracks() = default;
+
+ public:
+  //! Feature track of the landmark, nullptr if there is none.
+  FeatureTrack* find(const LandmarkId& lmk_id);
+  const FeatureTrack* find(const LandmarkId& lmk_id) const;
+
+  //! Feature track of the landmark, which must exist.
+  FeatureTrack& at(const LandmarkId& lmk_id);
+  const FeatureTrack& at(const LandmarkId& lmk_id) const;
+
+  /**
+   * @brief addObservation Adds an observation to the feature track of the
+   * landmark, creating the track if there is none.
+   * @param oldest_frame_id Id of the oldest frame in the time horizon, older
+   * observations of the track are dropped.
+   * @return True if a new track was created.
+   */
+  bool addObservation(const LandmarkId& lmk_id,
+                      const FrameId& frame_id,
+                      const gtsam::StereoPoint2& px,
+                      const FrameId& oldest_frame_id);
+
+  //! Removes the feature track of the landmark, false if there is none.
+  bool erase(const LandmarkId& lmk_id);
+
+  /**
+   * @brief recycleStaleTracks Removes the tracks that are not in the graph
+   * and whose last observation is older than oldest_frame_id.
+   * @return Number of removed tracks.
+   */
+  size_t recycleStaleTracks(const FrameId& oldest_frame_id);
+
+  //! Removes all tracks and frees the arena.
+  void clear();
+
+  //! Ids of the landmarks with a feature track, in no particular order.
+  void getLandmarkIds(LandmarkIds* lmk_ids) const;
+
+  inline size_t size() const { return slot_of_lmk_.size(); }
+  inline bool empty() const { return slot_of_lmk_.empty(); }
+  //! Number of slots in the arena, used or not.
+  inline size_t capacity() const { return slots_.size(); }
+
+  void print() const;
+
+ private:
+  struct Expiry {
+    FrameId frame_id_;
+    size_t slot_;
+    LandmarkId lmk_id_;
+  };
+
+  //! Arena of feature tracks, and the landmark in each slot (-1 if free).
+  std::vector<FeatureTrack> slots_;
+  std::vector<LandmarkId> slot_lmk_ids_;
+  std::vector<size_t> free_slots_;
+  std::unordered_map<LandmarkId, size_t> slot_of_lmk_;
+
+  //! One entry per added observation, in order of frame id. An entry is
+  //! stale if its track has been observed since, or the slot was reused.
+  std::deque<Expiry> expiry_queue_;
+};
+
+}  // namespace VIO
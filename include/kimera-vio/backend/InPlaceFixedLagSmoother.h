@@ -0,0 +1,84 @@
+/* ----------------------------------------------------------------------------
+ * Copyright 2017, Massachusetts Institute of Technology,
+ * Cambridge, MA 02139
+ * All Rights Reserved
+ * Authors: Luca Carlone, et al. (see THANKS for the full author list)
+ * See LICENSE for the license information
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @file   InPlaceFixedLagSmoother.h
+ * @brief  Incremental fixed-lag smoother that accepts factors extended in
+ * place, such as smart factors with new measurements.
+ * @author Antoni Rosinol
+ */
+
+#pragma once
+
+#include <gtsam/config.h>
+#include <gtsam/inference/Key.h>
+#include <gtsam/nonlinear/ISAM2.h>
+#include <gtsam/nonlinear/NonlinearFactor.h>
+#include <gtsam_unstable/nonlinear/IncrementalFixedLagSmoother.h>
+
+// iSAM2 takes factors that gained keys through its newAffectedKeys update
+// parameter since GTSAM 4.1.
+#if GTSAM_VERSION_MAJOR > 4 || \
+    (GTSAM_VERSION_MAJOR == 4 && GTSAM_VERSION_MINOR >= 1)
+#define KIMERA_IN_PLACE_SMOOTHER_UPDATE
+#endif
+
+namespace VIO {
+
+//! Factor slot -> copy of the factor in that slot, extended with new keys.
+using ExtendedFactors =
+    gtsam::FastMap<gtsam::FactorIndex, gtsam::NonlinearFactor::shared_ptr>;
+
+#ifdef KIMERA_IN_PLACE_SMOOTHER_UPDATE
+/**
+ * @brief The InPlaceFixedLagSmoother class is a
+ * gtsam::IncrementalFixedLagSmoother whose update can also replace factors
+ * already in the smoother by copies extended with new keys (a smart factor
+ * with a new measurement), so that they keep their slot instead of being
+ * removed and added again. iSAM2 takes their new keys through its
+ * newAffectedKeys update parameter: the keys are added to the variable index
+ * and the factor is relinearized, as if it was new.
+ *
+ * The factors are never modified: the copy takes the place of the original in
+ * the graph of the smoother, so graphs sharing the original factors (copies
+ * of the smoother, outputs) are left as they were.
+ *
+ * A factor cannot be extended and removed in the same update: iSAM2 removes
+ * factors before it learns about their new keys.
+ */
+class InPlaceFixedLagSmoother : public gtsam::IncrementalFixedLagSmoother {
+ public:
+  explicit InPlaceFixedLagSmoother(
+      const double& smoother_lag = 0.0,
+      const gtsam::ISAM2Params& parameters = DefaultISAM2Params())
+      : gtsam::IncrementalFixedLagSmoother(smoother_lag, parameters) {}
+  virtual ~InPlaceFixedLagSmoother() = default;
+
+  Result update(const gtsam::NonlinearFactorGraph& new_factors =
+                    gtsam::NonlinearFactorGraph(),
+                const gtsam::Values& new_theta = gtsam::Values(),
+                const KeyTimestampMap& timestamps = KeyTimestampMap(),
+                const gtsam::FactorIndices& factors_to_remove =
+                    gtsam::FactorIndices()) override;
+
+  /**
+   * @brief update Same as IncrementalFixedLagSmoother::update, plus the
+   * factors that replace the ones in their slot with more keys.
+   * @param extended_factors Slot of each factor to replace, and the extended
+   * copy that replaces it. Its keys must include the ones of the factor in
+   * the slot. None of these slots can be in factors_to_remove.
+   */
+  Result update(const gtsam::NonlinearFactorGraph& new_factors,
+                const gtsam::Values& new_theta,
+                const KeyTimestampMap& timestamps,
+                const gtsam::FactorIndices& factors_to_remove,
+                const ExtendedFactors& extended_factors);
+};
+#endif
+
+}  // namespace VIO
@@ -20,6 +20,9 @@
 
 #pragma once
 
+#include <map>
+#include <set>
+
 #include <gtsam/slam/StereoFactor.h>
 
 #include "kimera-vio/backend/RegularVioBackend-definitions.h"
@@ -64,6 +67,14 @@ class RegularVioBackend : public VioBackend {
   typedef std::map<LandmarkId, RegularityType> LmkIdToRegularityTypeMap;
   typedef std::map<PlaneId, LmkIdToRegularityTypeMap> PlaneIdToLmkIdRegType;
   PlaneIdToLmkIdRegType plane_id_to_lmk_id_reg_type_;
+  // Slots of the regularity factors in the smoother graph, recorded from the
+  // manifest of new factors.
+  typedef std::map<LandmarkId, FactorSlot> LmkIdToFactorSlotMap;
+  std::map<PlaneId, LmkIdToFactorSlotMap> plane_id_to_point_plane_slots_;
+  std::map<PlaneId, FactorSlot> plane_id_to_prior_slot_;
+  // Planes with a linear container factor, left by the marginalization of
+  // some of their point-plane factors.
+  std::set<PlaneId> planes_with_linear_factor_;
   gtsam::FactorIndices delete_slots_of_converted_smart_factors_;
 
   // For Stereo and Projection factors.
@@ -109,12 +120,6 @@ class RegularVioBackend : public VioBackend {
                                 const size_t& min_num_of_observations);
 
   /* ------------------------------------------------------------------------ */
-  void updateExistingSmartFactor(
-      const LandmarkId& lmk_id,
-      const std::pair<FrameId, StereoPoint2>& new_obs,
-      LandmarkIdSmartFactorMap* new_smart_factors,
-      SmartFactorMap* old_smart_factors);
-  /* ------------------------------------------------------------------------ */
   bool convertSmartToProjectionFactor(
       const LandmarkId& lmk_id,
       LandmarkIdSmartFactorMap* new_smart_factors,
@@ -130,6 +135,14 @@ class RegularVioBackend : public VioBackend {
   /* ------------------------------------------------------------------------ */
   virtual void deleteLmkFromExtraStructures(const LandmarkId& lmk_id) override;
 
+  /* ------------------------------------------------------------------------ */
+  virtual void recordNewFactorSlot(const NewFactorManifestEntry& entry,
+                                   const VIO::Slot& slot) override;
+
+  /* ------------------------------------------------------------------------ */
+  virtual void pruneFactorSlots(
+      const gtsam::NonlinearFactorGraph& graph) override;
+
   /* ------------------------------------------------------------------------ */
   void addProjectionFactor(
       const LandmarkId& lmk_id,
@@ -144,7 +157,7 @@ class RegularVioBackend : public VioBackend {
           idx_of_point_plane_factors_to_add);
 
   /* ------------------------------------------------------------------------ */
-  void removeOldRegularityFactors_Slow(
+  void removeOldRegularityFactors(
       const std::vector<Plane>& planes,
       const std::map<PlaneId, std::vector<std::pair<Slot, LandmarkId>>>&
           map_idx_of_point_plane_factors_to_add,
@@ -153,6 +166,7 @@ class RegularVioBackend : public VioBackend {
 
   /* ------------------------------------------------------------------------ */
   void fillDeleteSlots(
+      const PlaneId& plane_key,
       const std::vector<std::pair<Slot, LandmarkId>>& point_plane_factor_slots,
       LmkIdToRegularityTypeMap* lmk_id_to_regularity_type_map,
       gtsam::FactorIndices* delete_slots);
@@ -14,6 +14,7 @@
 
 #pragma once
 
+#include <string>
 #include <vector>
 
 #include <boost/optional.hpp>
@@ -22,9 +23,12 @@
 
 #include <gtsam/geometry/Cal3_S2.h>
 #include <gtsam/geometry/StereoPoint2.h>
+#include <gtsam_unstable/nonlinear/BatchFixedLagSmoother.h>
 #include <gtsam_unstable/nonlinear/IncrementalFixedLagSmoother.h>
 #include <gtsam_unstable/slam/SmartStereoProjectionPoseFactor.h>
 
+#include "kimera-vio/backend/FeatureTracks.h"
+#include "kimera-vio/backend/InPlaceFixedLagSmoother.h"
 #include "kimera-vio/common/VioNavState.h"
 #include "kimera-vio/common/vio_types.h"
 #include "kimera-vio/frontend/StereoVisionImuFrontend-definitions.h"
@@ -55,7 +59,11 @@ static constexpr SymbolChar kLandmarkSymbolChar = 'l';
 
 #define INCREMENTAL_SMOOTHER
 #ifdef INCREMENTAL_SMOOTHER
+#ifdef KIMERA_IN_PLACE_SMOOTHER_UPDATE
+typedef InPlaceFixedLagSmoother Smoother;
+#else
 typedef gtsam::IncrementalFixedLagSmoother Smoother;
+#endif
 #else
 typedef gtsam::BatchFixedLagSmoother Smoother;
 #endif
@@ -68,6 +76,48 @@ using LandmarkIdSmartFactorMap =
 using Slot = long int;
 using SmartFactorMap =
     gtsam::FastMap<LandmarkId, std::pair<SmartStereoFactor::shared_ptr, Slot>>;
+//! landmarkId -> new measurements of a smart factor already in the smoother.
+using LandmarkIdNewMeasurementsMap = std::unordered_map<
+    LandmarkId,
+    std::vector<std::pair<FrameId, StereoPoint2>>>;
+
+// Role of a factor submitted to the smoother, recorded when the factor is
+// queued so that its slot can be recovered after the update regardless of
+// the order in which factors were submitted.
+enum class FactorRole {
+  kSmartStereo = 0,  //! Smart stereo factor of a landmark.
+  kProjection = 1,   //! Stereo projection factor of an explicit landmark.
+  kPointPlane = 2,   //! Point-plane factor between a landmark and a plane.
+  kPlanePrior = 3,   //! Prior factor on a plane.
+  kOther = 4         //! Imu, priors, and any other factor.
+};
+
+struct NewFactorManifestEntry {
+  //! Keeps the factor alive until its slot is known, so that its address is
+  //! not reused by another factor in the meantime.
+  gtsam::NonlinearFactor::shared_ptr factor_;
+  FactorRole role_ = FactorRole::kOther;
+  LandmarkId lmk_id_ = -1;
+};
+//! Factor address -> role of the factor, for factors not yet in the smoother.
+using NewFactorManifest =
+    std::unordered_map<const gtsam::NonlinearFactor*, NewFactorManifestEntry>;
+
+// Slot of a factor in the smoother graph. The factor is kept to tell whether
+// the slot still holds it, since the smoother reuses the slots of removed and
+// marginalized factors.
+struct FactorSlot {
+  Slot slot_ = -1;
+  gtsam::NonlinearFactor::shared_ptr factor_;
+
+  inline bool isValid(const gtsam::NonlinearFactorGraph& graph) const {
+    return slot_ >= 0 && graph.exists(static_cast<size_t>(slot_)) &&
+           graph.at(static_cast<size_t>(slot_)).get() == factor_.get();
+  }
+};
+using FactorSlots = std::vector<FactorSlot>;
+//! landmarkId -> slots of the non-smart factors in the graph that involve it.
+using LandmarkIdFactorSlotsMap = std::unordered_map<LandmarkId, FactorSlots>;
 
 using Landmark = gtsam::Point3;
 using Landmarks = std::vector<Landmark>;
@@ -76,39 +126,31 @@ using PointsWithId = std::vector<PointWithId>;
 using PointsWithIdMap = std::unordered_map<LandmarkId, Landmark>;
 using LmkIdToLmkTypeMap = std::unordered_map<LandmarkId, LandmarkType>;
 
-////////////////////////////////////////////////////////////////////////////////
-// FeatureTrack
-// TODO(Toni): what is this doing here... should be in Frontend at worst.
-class FeatureTrack {
-  // TODO(Toni): a feature track should have a landmark id...
-  // TODO(Toni): a feature track should contain a pixel measurement per frame
-  // but allow for multi-frame measurements at a time.
-  // TODO(Toni): add getters for feature track length
- public:
-  //! Observation: {FrameId, Px-Measurement}
-  std::vector<std::pair<FrameId, StereoPoint2>> obs_;
-
-  // Is the lmk in the graph?
-  bool in_ba_graph_ = false;
-
-  FeatureTrack(FrameId frame_id, const StereoPoint2& px) {
-    obs_.push_back(std::make_pair(frame_id, px));
-  }
-
-  void print() const {
-    LOG(INFO) << "Feature track with cameras: ";
-    for (size_t i = 0u; i < obs_.size(); i++) {
-      std::cout << " " << obs_[i].first << " ";
-    }
-    std::cout << std::endl;
-  }
+// Why VioBackend::optimize stopped doing extra iSAM2 iterations.
+enum class ExtraIterationsStopReason {
+  kMaxIterations = 0,      //! Reached the maximum number of iterations.
+  kSmallDelta = 1,         //! Max entry of the iSAM2 delta below threshold.
+  kSmallErrorReduction = 2,  //! Relative error decrease below threshold.
+  kDeadline = 3,           //! Ran out of the per-keyframe time budget.
+  kSmootherFailure = 4     //! The smoother update failed.
 };
 
-// Landmark id to measurements.
-// Key is the lmk_id and feature track the collection of pairs of
-// frame id and pixel location.
-// TODO(Toni): what is this doing here... should be in Frontend at worst.
-using FeatureTracks = std::unordered_map<LandmarkId, FeatureTrack>;
+inline std::string extraIterationsStopReasonAsString(
+    const ExtraIterationsStopReason& reason) {
+  switch (reason) {
+    case ExtraIterationsStopReason::kMaxIterations:
+      return "max iterations";
+    case ExtraIterationsStopReason::kSmallDelta:
+      return "small delta";
+    case ExtraIterationsStopReason::kSmallErrorReduction:
+      return "small error reduction";
+    case ExtraIterationsStopReason::kDeadline:
+      return "deadline";
+    case ExtraIterationsStopReason::kSmootherFailure:
+      return "smoother failure";
+  }
+  return "unknown";
+}
 
 ////////////////////////////////////////////////////////////////////////////////
 class DebugVioInfo {
@@ -133,6 +175,10 @@ class DebugVioInfo {
   double updateSlotTime_;
   double extraIterationsTime_;
 
+  size_t numExtraIterations_ = 0u;
+  ExtraIterationsStopReason extraIterationsStopReason_ =
+      ExtraIterationsStopReason::kMaxIterations;
+
   double meanPixelError_;
   double maxPixelError_;
   double meanTrackLength_;
@@ -25,10 +25,14 @@
 
 #pragma once
 
+#include <chrono>
+#include <deque>
 #include <fstream>
+#include <future>
 #include <iostream>
 #include <memory>
 #include <unordered_map>
+#include <unordered_set>
 
 #include <boost/foreach.hpp>
 
@@ -52,6 +56,7 @@
 #include "kimera-vio/factors/PointPlaneFactor.h"
 #include "kimera-vio/frontend/StereoVisionImuFrontend-definitions.h"
 #include "kimera-vio/imu-frontend/ImuFrontend.h"
+#include "kimera-vio/initial/InitializationBackend-definitions.h"
 #include "kimera-vio/initial/InitializationFromImu.h"
 #include "kimera-vio/logging/Logger.h"
 #include "kimera-vio/utils/Macros.h"
@@ -138,6 +143,13 @@ class VioBackend {
         initializeFromIMU(input);
         break;
       }
+      case 2: {
+        // Fast start: publish right away from the IMU attitude and the
+        // visual odometry, and refine with the visual-inertial alignment
+        // once it is available, see spinFastStartAlignment.
+        initializeFromIMU(input);
+        break;
+      }
       default: { LOG(FATAL) << "Wrong initialization mode."; }
     }
     // Signal that the Backend has been initialized.
@@ -183,6 +195,20 @@ class VioBackend {
     smoother_->getFactors().saveGraph(ofstream_wrapper.ofstream_);
   }
 
+  /**
+   * @brief findSmartFactorsBehindCamera Triangulates, in parallel, the
+   * landmarks of the given smart factors with the given poses, and returns
+   * those that end up behind one of the cameras. Factors observing poses that
+   * are not in the estimate are skipped.
+   * @param estimate Poses at which the smart factors will be linearized.
+   * @param smart_factors Smart factors to screen.
+   * @param lmks_behind_camera Ids of the landmarks behind a camera.
+   */
+  static void findSmartFactorsBehindCamera(
+      const gtsam::Values& estimate,
+      const LandmarkIdSmartFactorMap& smart_factors,
+      std::unordered_set<LandmarkId>* lmks_behind_camera);
+
  protected:
   enum class BackendState {
     Bootstrap = 0u,  //! Initialize Backend
@@ -194,9 +220,15 @@ class VioBackend {
   // returns landmarks observed in current frame.
   void addStereoMeasurementsToFeatureTracks(
       const int& frameNum,
+      const Timestamp& timestamp_kf_nsec,
       const StereoMeasurements& stereoMeasurements_kf,
       LandmarkIds* landmarks_kf);
 
+  // Adds a keyframe to the ones in the time horizon of the smoother, and
+  // drops the ones that left it.
+  void updateKeyframesInHorizon(const FrameId& kf_id,
+                                const Timestamp& timestamp_kf_nsec);
+
   // Workhorse that stores data and optimizes at each keyframe.
   // [in] timestamp_kf_nsec, keyframe timestamp.
   // [in] status_smart_stereo_measurements_kf, vision data.
@@ -235,6 +267,17 @@ class VioBackend {
                         const FrameId& to_id,
                         const gtsam::Pose3& from_id_POSE_to_id);
 
+  /**
+   * @brief registerNewFactor Records the role of a factor that is queued for
+   * the next smoother update, so that its slot can be recovered afterwards.
+   * @param factor Factor to be added to the smoother.
+   * @param role Role of the factor.
+   * @param lmk_id Landmark the factor constrains, -1 if none.
+   */
+  void registerNewFactor(const gtsam::NonlinearFactor::shared_ptr& factor,
+                         const FactorRole& role,
+                         const LandmarkId& lmk_id = -1);
+
   /**
    * @brief optimize
    * @param timestamp_kf_nsec
@@ -262,6 +305,27 @@ class VioBackend {
   // Add initial prior factors.
   void addInitialPriorFactors(const FrameId& frame_id);
 
+  // Add pose, velocity and IMU bias priors on the given state, with the
+  // initial uncertainties of the Backend params.
+  void addStatePriorFactors(const FrameId& frame_id,
+                            const gtsam::Pose3& W_Pose_B,
+                            const gtsam::Vector3& W_Vel_B,
+                            const ImuBias& imu_bias);
+
+  /**
+   * @brief spinFastStartAlignment Fast-start initialization
+   * (autoInitialize: 2). Collects the first keyframes and runs the
+   * bundle-adjustment and gravity alignment on them on a background worker,
+   * which owns its own InitializationBackend and shares nothing mutable
+   * with this Backend. Once the worker is done, the aligned roll, pitch,
+   * velocity and gyro bias of the last collected keyframe are added as
+   * priors, so that the next smoother update switches to them in one go.
+   * Must be called from the Backend thread, after the keyframe of the given
+   * input has been added.
+   * @param input Latest Backend input.
+   */
+  void spinFastStartAlignment(const BackendInput& input);
+
   void addConstantVelocityFactor(const FrameId& from_id, const FrameId& to_id);
 
   // Update states.
@@ -274,6 +338,8 @@ class VioBackend {
    * @param new_values
    * @param timestamps
    * @param delete_slots
+   * @param extended_factors Slots of the factors to replace by a copy with
+   * more keys, and their copy.
    * @return False if the update failed, true otw.
    */
   bool updateSmoother(
@@ -283,7 +349,39 @@ class VioBackend {
       const gtsam::Values& new_values = gtsam::Values(),
       const std::map<Key, double>& timestamps =
           gtsam::FixedLagSmoother::KeyTimestampMap(),
-      const gtsam::FactorIndices& delete_slots = gtsam::FactorIndices());
+      const gtsam::FactorIndices& delete_slots = gtsam::FactorIndices(),
+      const ExtendedFactors& extended_factors = ExtendedFactors());
+
+  /**
+   * @brief appendNewSmartFactorMeasurements Adds the new measurements of the
+   * smart factors already in the smoother to copies of the factors, which
+   * replace them in old_smart_factors_ and, at the next update, in their slot
+   * of the smoother. The factors themselves are never modified, since they
+   * are shared with the graphs of the Backend outputs.
+   * Factors that left the smoother are forgotten, together with their
+   * landmark, and factors in delete_slots are left untouched.
+   * @param delete_slots Slots of the factors removed in the next update.
+   * @param updated_smart_factors Smart factors that were extended.
+   * @param extended_factors Slot of each extended factor and its copy, for
+   * the next smoother update.
+   */
+  void appendNewSmartFactorMeasurements(
+      const gtsam::FactorIndices& delete_slots,
+      LandmarkIdSmartFactorMap* updated_smart_factors,
+      ExtendedFactors* extended_factors);
+
+  /**
+   * @brief shouldStopExtraIterations Checks the convergence criteria and the
+   * time budget of the extra iterations in optimize.
+   * @param result Result of the last smoother update.
+   * @param optimize_start_time Time at which optimize was called.
+   * @param stop_reason Why the iterations should stop, if they should.
+   * @return True if no more extra iterations should be done.
+   */
+  bool shouldStopExtraIterations(
+      const gtsam::ISAM2Result& result,
+      const std::chrono::high_resolution_clock::time_point& optimize_start_time,
+      ExtraIterationsStopReason* stop_reason);
 
   void cleanCheiralityLmk(
       const gtsam::Symbol& lmk_symbol,
@@ -312,17 +410,32 @@ class VioBackend {
                            const gtsam::Values& values,
                            gtsam::Values* values_output);
 
-  // Find all slots of factors that have the given key in the list of keys.
-  void findSlotsOfFactorsWithKey(
-      const gtsam::Key& key,
-      const gtsam::NonlinearFactorGraph& graph,
-      std::vector<size_t>* slots_of_factors_with_key);
-
   virtual void deleteLmkFromExtraStructures(const LandmarkId& lmk_id);
 
-  void updateNewSmartFactorsSlots(
-      const std::vector<LandmarkId>& lmk_ids_of_new_smart_factors_tmp,
-      SmartFactorMap* old_smart_factors);
+  /**
+   * @brief updateNewFactorsSlots Uses the manifest of new factors to find the
+   * slots that the last smoother update assigned to new smart factors, in
+   * O(new factors) and independently of the order of submission.
+   * @param old_smart_factors Smart factors whose slots are updated.
+   */
+  void updateNewFactorsSlots(SmartFactorMap* old_smart_factors);
+
+  /**
+   * @brief recordNewFactorSlot Records the slot of a new non-smart factor so
+   * that it can be deleted later without scanning the smoother graph.
+   * Derived classes record the roles they introduce.
+   * @param entry Manifest entry of the factor.
+   * @param slot Slot of the factor in the smoother graph.
+   */
+  virtual void recordNewFactorSlot(const NewFactorManifestEntry& entry,
+                                   const Slot& slot);
+
+  /**
+   * @brief pruneFactorSlots Drops the recorded slots whose factor is not in
+   * the graph anymore, i.e. factors marginalized by the smoother.
+   * @param graph Factors of the smoother.
+   */
+  virtual void pruneFactorSlots(const gtsam::NonlinearFactorGraph& graph);
 
   // Set parameters for all types of factors.
   void setFactorsParams(
@@ -470,12 +583,20 @@ class VioBackend {
   LandmarkIdSmartFactorMap new_smart_factors_;
   //!< landmarkId -> {SmartFactorPtr, SlotIndex}
   SmartFactorMap old_smart_factors_;
+  //!< landmarkId -> new measurements to append to its smart factor in the
+  //! graph at the next update.
+  LandmarkIdNewMeasurementsMap new_smart_factor_measurements_;
   // if SlotIndex is -1, means that the factor has not been inserted yet in
   // the graph
+  //!< factor address -> {role, lmk id} of factors not yet in the smoother
+  NewFactorManifest new_factors_manifest_;
+  //!< landmarkId -> slots of its projection and regularity factors.
+  LandmarkIdFactorSlotsMap lmk_factor_slots_;
 
   // Data:
-  // TODO grows unbounded currently, but it should be limited to time horizon.
   FeatureTracks feature_tracks_;
+  //! {kf id, timestamp} of the keyframes in the time horizon, oldest first.
+  std::deque<std::pair<FrameId, Timestamp>> keyframes_in_horizon_;
 
   // Counters.
   //! Last keyframe id.
@@ -505,6 +626,15 @@ class VioBackend {
   //! Number of Cheirality exceptions
   size_t counter_of_exceptions_ = 0;
 
+  //! Fast-start initialization: keyframes collected for the alignment, id of
+  //! the last of them, and the background alignment worker. The future is
+  //! only accessed from the Backend thread, and its destructor waits for
+  //! the worker.
+  std::vector<BackendInput::UniquePtr> fast_start_inputs_;
+  FrameId fast_start_last_kf_id_ = 0;
+  std::future<InitializationAlignmentResult::UniquePtr> fast_start_alignment_;
+  bool is_fast_start_done_ = false;
+
   //! Logger.
   const bool log_output_ = {false};
   std::unique_ptr<BackendLogger> logger_;
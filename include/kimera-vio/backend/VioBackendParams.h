@@ -94,6 +94,8 @@ class BackendParams : public PipelineParams {
  public:
   //! Initialization params
   // TODO(Toni): make an enum class...
+  //! 0: ground truth, 1: IMU, 2: IMU, then refined by a background
+  //! visual-inertial alignment (fast start).
   int autoInitialize_ = 0;
   double initialPositionSigma_ = 0.00001;
   double initialRollPitchSigma_ = 10.0 / 180.0 * M_PI;
@@ -127,6 +129,15 @@ class BackendParams : public PipelineParams {
   double relinearizeSkip_ = 1.0;
   double horizon_ = 6.0;
   int numOptimize_ = 2;
+  //! Stop extra iterations once the largest entry of the iSAM2 delta is below
+  //! this value. Non-positive to disable.
+  double extraIterationsDeltaThreshold_ = 0.0;
+  //! Stop extra iterations once an update decreases the error by less than
+  //! this fraction. Non-positive to disable, else iSAM2 evaluates the error.
+  double extraIterationsErrorReductionThreshold_ = 0.0;
+  //! Wall-clock budget of an optimize call per keyframe [ms], no extra
+  //! iterations are started past it. Non-positive to disable.
+  double maxOptimizeTimeMs_ = 0.0;
   double wildfire_threshold_ = 0.001;
   bool useDogLeg_ = false;
 
@@ -74,6 +74,15 @@ public:
       return doEvaluateError(plane_1, plane_2, H_plane_1, H_plane_2);
   }
 
+protected:
+  /// Jacobian handed over by NoiseModelFactor2 (i.e. by linearize) as a
+  /// fixed-size view, so that evaluateErrorFixed writes it in place.
+  template <int Rows>
+  static OptionalJacobian<Rows, 3> fixedSizeJacobian(
+      boost::optional<Matrix&> H) {
+    return H ? OptionalJacobian<Rows, 3>(*H) : OptionalJacobian<Rows, 3>();
+  }
+
 private:
 
   //// See non-virtual interface idiom (NVI idiom) for reasons to do this.
@@ -116,22 +125,27 @@ private:
                        const OrientedPlane3& plane_2,
                        boost::optional<Matrix&> H_plane_1,
                        boost::optional<Matrix&> H_plane_2) const {
-    Unit3 plane_normal_1 = plane_1.normal();
-    Unit3 plane_normal_2 = plane_2.normal();
+    return evaluateErrorFixed(plane_1, plane_2,
+                              fixedSizeJacobian<2>(H_plane_1),
+                              fixedSizeJacobian<2>(H_plane_2));
+  }
+
+public:
+  /// evaluateError with compile-time sized Jacobians.
+  /// Hplane1: jacobian of h wrt plane1
+  /// Hplane2: jacobian of h wrt plane2
+  inline Vector2 evaluateErrorFixed(
+                       const OrientedPlane3& plane_1,
+                       const OrientedPlane3& plane_2,
+                       OptionalJacobian<2, 3> H_plane_1 = boost::none,
+                       OptionalJacobian<2, 3> H_plane_2 = boost::none) const {
     Matrix22 H_n_1, H_n_2;
-    Vector2 err;
-    err =  plane_normal_1.errorVector(plane_normal_2, H_n_1, H_n_2);
-    if (H_plane_1) {
-      Matrix23 tmp;
-      tmp << H_n_1, Vector2::Zero();
-      *H_plane_1 = tmp;
-    }
-    if (H_plane_2) {
-      Matrix23 tmp;
-      tmp << H_n_2, Vector2::Zero();
-      *H_plane_2 = tmp;
-    }
-    return (err);
+    const Vector2 err = plane_1.normal().errorVector(
+        plane_2.normal(), H_plane_1 ? &H_n_1 : nullptr,
+        H_plane_2 ? &H_n_2 : nullptr);
+    if (H_plane_1) *H_plane_1 << H_n_1, Vector2::Zero();
+    if (H_plane_2) *H_plane_2 << H_n_2, Vector2::Zero();
+    return err;
   }
 };
 
@@ -167,26 +181,29 @@ private:
                        const OrientedPlane3& plane_2,
                        boost::optional<Matrix&> H_plane_1,
                        boost::optional<Matrix&> H_plane_2) const {
-    Unit3 plane_normal_1 = plane_1.normal();
-    Unit3 plane_normal_2 = plane_2.normal();
+    return evaluateErrorFixed(plane_1, plane_2,
+                              fixedSizeJacobian<3>(H_plane_1),
+                              fixedSizeJacobian<3>(H_plane_2));
+  }
+
+public:
+  /// evaluateError with compile-time sized Jacobians.
+  /// Hplane1: jacobian of h wrt plane1
+  /// Hplane2: jacobian of h wrt plane2
+  inline Vector3 evaluateErrorFixed(
+                       const OrientedPlane3& plane_1,
+                       const OrientedPlane3& plane_2,
+                       OptionalJacobian<3, 3> H_plane_1 = boost::none,
+                       OptionalJacobian<3, 3> H_plane_2 = boost::none) const {
     Matrix22 H_n_1, H_n_2;
-    Vector2 normal_err(plane_normal_1.errorVector(plane_normal_2,
-                                                  H_n_1, H_n_2));
-    Vector3 err;
-    err = Vector3(normal_err(0), normal_err(1),
-                  plane_1.distance() - plane_2.distance()
-                  - measured_distance_from_plane2_to_plane1);
-    if (H_plane_1) {
-      Matrix33 a;
-      a << H_n_1, Vector2::Zero(), 0, 0, 1;
-      *H_plane_1 = a;
-    }
-    if (H_plane_2) {
-      Matrix33 a;
-      a << H_n_2, Vector2::Zero(), 0, 0, -1;
-      *H_plane_2 = a;
-    }
-    return (err);
+    const Vector2 normal_err = plane_1.normal().errorVector(
+        plane_2.normal(), H_plane_1 ? &H_n_1 : nullptr,
+        H_plane_2 ? &H_n_2 : nullptr);
+    if (H_plane_1) *H_plane_1 << H_n_1, Vector2::Zero(), 0, 0, 1;
+    if (H_plane_2) *H_plane_2 << H_n_2, Vector2::Zero(), 0, 0, -1;
+    return Vector3(normal_err(0), normal_err(1),
+                   plane_1.distance() - plane_2.distance()
+                   - measured_distance_from_plane2_to_plane1);
   }
 };
 
@@ -220,25 +237,27 @@ private:
                        const OrientedPlane3& plane_2,
                        boost::optional<Matrix&> H_plane_1,
                        boost::optional<Matrix&> H_plane_2) const {
+    return evaluateErrorFixed(plane_1, plane_2,
+                              fixedSizeJacobian<3>(H_plane_1),
+                              fixedSizeJacobian<3>(H_plane_2));
+  }
+
+public:
+  /// evaluateError with compile-time sized Jacobians.
+  /// Hplane1: jacobian of h wrt plane1
+  /// Hplane2: jacobian of h wrt plane2
+  inline Vector3 evaluateErrorFixed(
+                       const OrientedPlane3& plane_1,
+                       const OrientedPlane3& plane_2,
+                       OptionalJacobian<3, 3> H_plane_1 = boost::none,
+                       OptionalJacobian<3, 3> H_plane_2 = boost::none) const {
     const Unit3& plane_normal_1 = plane_1.normal();
     const Unit3& plane_normal_2 = plane_2.normal();
-    Vector3 err (plane_normal_1.unitVector() - plane_normal_2.unitVector());
-
-    if (H_plane_1) {
-      // Jacobian of plane retraction when v = Vector3::Zero(), to speed-up
-      // computations.
-      Matrix33 tmp;
-      tmp << plane_normal_1.basis(), Vector3::Zero();
-      *H_plane_1 = tmp;
-    }
-    if (H_plane_2) {
-      // Jacobian of plane retraction when v = Vector3::Zero(), to speed-up
-      // computations.
-      Matrix33 tmp;
-      tmp << -plane_normal_2.basis(), Vector3::Zero();
-      *H_plane_2 = tmp;
-    }
-    return (err);
+    // Jacobians of plane retraction when v = Vector3::Zero(), to speed-up
+    // computations.
+    if (H_plane_1) *H_plane_1 << plane_normal_1.basis(), Vector3::Zero();
+    if (H_plane_2) *H_plane_2 << -plane_normal_2.basis(), Vector3::Zero();
+    return plane_normal_1.unitVector() - plane_normal_2.unitVector();
   }
 };
 
@@ -274,31 +293,37 @@ private:
                        const OrientedPlane3& plane_2,
                        boost::optional<Matrix&> H_plane_1,
                        boost::optional<Matrix&> H_plane_2) const {
+    return evaluateErrorFixed(plane_1, plane_2,
+                              fixedSizeJacobian<4>(H_plane_1),
+                              fixedSizeJacobian<4>(H_plane_2));
+  }
+
+public:
+  /// evaluateError with compile-time sized Jacobians.
+  /// Hplane1: jacobian of h wrt plane1
+  /// Hplane2: jacobian of h wrt plane2
+  inline Vector4 evaluateErrorFixed(
+                       const OrientedPlane3& plane_1,
+                       const OrientedPlane3& plane_2,
+                       OptionalJacobian<4, 3> H_plane_1 = boost::none,
+                       OptionalJacobian<4, 3> H_plane_2 = boost::none) const {
     const Unit3& plane_normal_1(plane_1.normal());
     const Unit3& plane_normal_2(plane_2.normal());
-    Vector4 err (0.0, 0.0, 0.0, 0.0);
-    err =  Vector4(plane_normal_1.point3().x() - plane_normal_2.point3().x(),
-                   plane_normal_1.point3().y() - plane_normal_2.point3().y(),
-                   plane_normal_1.point3().z() - plane_normal_2.point3().z(),
-                   plane_1.distance() - plane_2.distance() -
-                                       measured_distance_from_plane2_to_plane1);
+    // Jacobians of plane retraction when v = Vector3::Zero(), to speed-up
+    // computations.
     if (H_plane_1) {
-      // Jacobian of plane retraction when v = Vector3::Zero(), to speed-up
-      // computations.
-      Matrix43 tmp;
-      tmp << plane_normal_1.basis(), Vector3::Zero(),
-              0, 0, 1;
-      *H_plane_1 = tmp;
+      *H_plane_1 << plane_normal_1.basis(), Vector3::Zero(),
+                    0, 0, 1;
     }
     if (H_plane_2) {
-      // Jacobian of plane retraction when v = Vector3::Zero(), to speed-up
-      // computations.
-      Matrix43 tmp;
-      tmp << -plane_normal_2.basis(), Vector3::Zero(),
-              0, 0, -1;
-      *H_plane_2 = tmp;
+      *H_plane_2 << -plane_normal_2.basis(), Vector3::Zero(),
+                    0, 0, -1;
     }
-    return (err);
+    Vector4 err;
+    err << plane_normal_1.unitVector() - plane_normal_2.unitVector(),
+           plane_1.distance() - plane_2.distance() -
+               measured_distance_from_plane2_to_plane1;
+    return err;
   }
 };
 
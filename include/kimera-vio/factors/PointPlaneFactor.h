@@ -54,23 +54,35 @@ public:
   virtual Vector evaluateError(const Point3& point, const OrientedPlane3& plane,
                                boost::optional<Matrix&> H_point = boost::none,
                                boost::optional<Matrix&> H_plane = boost::none) const {
-    Vector err(1);
-    Unit3 plane_normal = plane.normal();
-    double plane_distance = plane.distance();
+    // linearize() goes through here: the Jacobians are resized to 1x3 and
+    // written in place by the fixed-size implementation.
+    return Vector1(evaluateErrorFixed(
+        point, plane,
+        H_point ? OptionalJacobian<1, 3>(*H_point) : OptionalJacobian<1, 3>(),
+        H_plane ? OptionalJacobian<1, 3>(*H_plane) : OptionalJacobian<1, 3>()));
+  }
 
-    if (H_point) *H_point = plane_normal.unitVector().transpose();
+  /// evaluateError with compile-time sized Jacobians, does not allocate when
+  /// given fixed-size matrices.
+  /// Hpoint: jacobian of h wrt point landmark
+  /// Hplane: jacobian of h wrt plane
+  inline double evaluateErrorFixed(
+      const Point3& point, const OrientedPlane3& plane,
+      OptionalJacobian<1, 3> H_point = boost::none,
+      OptionalJacobian<1, 3> H_plane = boost::none) const {
+    const Unit3& plane_normal = plane.normal();
+    const Vector3& n = plane_normal.unitVector();
+
+    if (H_point) *H_point = n.transpose();
     if (H_plane) {
-      Matrix43 H_plane_retract;
       // Jacobian of plane retraction when v = Vector3::Zero(), to speed-up
-      // computations.
-      H_plane_retract << plane_normal.basis(), Vector3::Zero(), 0, 0, 1;
-      Vector4 p;
-      p << point, -1;
-      *H_plane =  p.transpose() * H_plane_retract;
+      // computations: [point^T, -1] * [basis, 0; 0 0 1].
+      const Matrix32& basis = plane_normal.basis();
+      H_plane->leftCols<2>() = point.transpose() * basis;
+      (*H_plane)(2) = -1.0;
     }
 
-    err << point.dot(plane_normal.unitVector()) - plane_distance;
-    return (err);
+    return point.dot(n) - plane.distance();
   }
 
   inline Key getPointKey() const {
@@ -15,6 +15,9 @@
 
 #pragma once
 
+#include <cstdint>
+#include <vector>
+
 #include <Eigen/Core>
 
 #include <opencv2/core.hpp>
@@ -23,6 +26,7 @@
 #include <gtsam/geometry/Pose3.h>
 #include <gtsam/geometry/StereoCamera.h>
 
+#include "kimera-vio/common/vio_types.h"
 #include "kimera-vio/frontend/Camera.h"
 #include "kimera-vio/frontend/CameraParams.h"
 #include "kimera-vio/frontend/StereoMatchingParams.h"
@@ -31,6 +35,21 @@
 
 namespace VIO {
 
+/**
+ * @brief Voxel-grid downsampled point cloud of a dense stereo reconstruction,
+ * see StereoCamera::backProjectDisparityToVoxelCloud.
+ */
+struct DenseStereoCloud {
+  KIMERA_POINTER_TYPEDEFS(DenseStereoCloud);
+
+  Timestamp timestamp_ = 0;
+  float voxel_size_ = 0.0f;
+  //! Centroid of each occupied voxel, in the left rectified camera frame.
+  std::vector<cv::Point3f> points_;
+  //! Number of pixels averaged in each point.
+  std::vector<uint32_t> weights_;
+};
+
 class StereoFrame;
 
 class StereoCamera {
@@ -131,6 +150,25 @@ class StereoCamera {
   void backProjectDisparityTo3DManual(const cv::Mat& disparity_img,
                                       cv::Mat* depth) const;
 
+  /**
+   * @brief backProjectDisparityToVoxelCloud Back-projects a dense disparity
+   * image and downsamples the result with a voxel grid in a single pass,
+   * without building the full resolution depth map.
+   * Pixels whose depth is not finite or outside [cloud_min_depth_,
+   * cloud_max_depth_] are discarded, and every voxel of size cloud_voxel_size_
+   * with points is replaced by their centroid. Rows are processed in parallel.
+   * @param disparity_img CV_32F disparity image (see backProjectDisparityTo3D).
+   * @param timestamp Timestamp of the stereo frame of the disparity image.
+   * @param dense_stereo_params Voxel size and depth range.
+   * @param cloud Output point cloud, in the left rectified camera frame, with
+   * voxels in the order they are first seen in the image (row-major).
+   */
+  void backProjectDisparityToVoxelCloud(
+      const cv::Mat& disparity_img,
+      const Timestamp& timestamp,
+      const DenseStereoParams& dense_stereo_params,
+      DenseStereoCloud* cloud) const;
+
   inline const Camera::ConstPtr& getOriginalLeftCamera() const {
     return original_left_camera_;
   }
@@ -82,6 +82,10 @@ struct DenseStereoParams {
   int p2_ = 240;
   int disp_12_max_diff_ = -1;
   bool use_mode_HH_ = true;
+  // dense point cloud parameters, see backProjectDisparityToVoxelCloud
+  float cloud_voxel_size_ = 0.05f;  // m
+  float cloud_min_depth_ = 0.3f;    // m
+  float cloud_max_depth_ = 5.0f;    // m
 };
 
 }  // namespace VIO
@@ -61,6 +61,8 @@ public:
   size_t nrDetectedFeatures_ = 0, nrTrackerFeatures_ = 0, nrMonoInliers_ = 0;
   size_t nrMonoPutatives_ = 0, nrStereoInliers_ = 0, nrStereoPutatives_ = 0;
   size_t monoRansacIters_ = 0, stereoRansacIters_ = 0;
+  // Tracks rejected before RANSAC, by KLT error and forward-backward check.
+  size_t nrKltErrorPrunedFeatures_ = 0, nrKltFbRejectedFeatures_ = 0;
 
   // Info about performance of sparse stereo matching (and ransac):
   // RPK = right keypoints
@@ -86,6 +88,10 @@ public:
   void print() const {
     LOG(INFO) << "nrDetectedFeatures_: " << nrDetectedFeatures_ << "\n"
               << "nrTrackerFeatures_: " << nrTrackerFeatures_ << "\n"
+              << "nrKltErrorPrunedFeatures_: " << nrKltErrorPrunedFeatures_
+              << "\n"
+              << "nrKltFbRejectedFeatures_: " << nrKltFbRejectedFeatures_
+              << "\n"
               << "nrMonoInliers_: " << nrMonoInliers_ << "\n"
               << "nrMonoPutatives_: " << nrMonoPutatives_ << "\n"
               << "nrStereoInliers_: " << nrStereoInliers_ << "\n"
@@ -30,6 +30,7 @@
 #include "kimera-vio/frontend/optical-flow/OpticalFlowPredictor.h"
 #include "kimera-vio/frontend/StereoFrame.h"
 #include "kimera-vio/frontend/Tracker-definitions.h"
+#include "kimera-vio/frontend/TranslationVoting.h"
 #include "kimera-vio/frontend/VisionImuFrontendParams.h"
 #include "kimera-vio/utils/Macros.h"
 #include "kimera-vio/utils/ThreadsafeQueue.h"
@@ -146,10 +147,60 @@ class Tracker {
       const gtsam::Matrix3& stereoPtCov,
       boost::optional<gtsam::Matrix3> Rmat = boost::none);
 
+  /**
+   * @brief getPoints3AndCovariances Batched version of getPoint3AndCovariance:
+   * returns the 3D points in keypoints_3d_ of the given keypoints and their
+   * covariance, propagated from the covariance of the stereo measurement
+   * through the Jacobian of the stereo back-projection, computed in closed
+   * form. In debug builds, checks that the back-projection is consistent
+   * with keypoints_3d_.
+   * @param stereo_frame Stereo frame with rectified keypoints and 3D points.
+   * @param stereo_cam Stereo camera that back-projects the keypoints.
+   * @param point_ids Ids of the keypoints in stereo_frame.
+   * @param stereo_pt_cov Covariance of the (uL, uR, v) stereo measurement.
+   * @param R Optional rotation applied to the points and covariances.
+   * @param points 3D points, in the order of point_ids.
+   * @param covariances Covariance of each point, in the order of point_ids.
+   */
+  static void getPoints3AndCovariances(
+      const StereoFrame& stereo_frame,
+      const gtsam::StereoCamera& stereo_cam,
+      const std::vector<size_t>& point_ids,
+      const gtsam::Matrix3& stereo_pt_cov,
+      const boost::optional<gtsam::Matrix3>& R,
+      Vectors3* points,
+      Matrices3* covariances);
+
  public:
   //! Debug info (its public to allow stereo frames to populate it).
   DebugTrackerInfo debug_info_;
 
+ private:
+  /**
+   * @brief pruneTracksByKltError Marks as not tracked the tracks whose KLT
+   * error is above klt_error_pruning_factor_ times the median KLT error of
+   * the tracked points, so that the threshold adapts to the image content,
+   * and above klt_error_pruning_min_error_.
+   * @return Nr of pruned tracks.
+   */
+  size_t pruneTracksByKltError(const std::vector<float>& error,
+                               std::vector<uchar>* status) const;
+
+  /**
+   * @brief forwardBackwardCheck Tracks the current keypoints back to the
+   * reference frame and marks as not tracked the ones that do not land
+   * within klt_fb_threshold_ of their reference keypoint. At most
+   * klt_fb_max_tracks_ tracks are checked, the ones with largest KLT error.
+   * @return Nr of rejected tracks.
+   */
+  size_t forwardBackwardCheck(const std::vector<cv::Mat>& ref_pyramid,
+                              const std::vector<cv::Mat>& cur_pyramid,
+                              const int& max_level,
+                              const KeypointsCV& px_ref,
+                              const KeypointsCV& px_cur,
+                              const std::vector<float>& error,
+                              std::vector<uchar>* status) const;
+
  private:
   // Incremental id assigned to new landmarks.
   LandmarkId landmark_count_;
@@ -162,6 +213,12 @@ class Tracker {
   // where the features moved from frame to frame.
   OpticalFlowPredictor::UniquePtr optical_flow_predictor_;
 
+  // Optical flow pyramid of the last tracked frame, which is the reference
+  // frame of the next call to featureTracking.
+  FrameId pyramid_frame_id_;
+  cv::Mat pyramid_img_;
+  std::vector<cv::Mat> pyramid_;
+
   // Display queue: push to this queue if you want to display an image.
   DisplayQueue* display_queue_;
 
@@ -175,6 +232,9 @@ class Tracker {
 
   // Stereo RANSAC
   opengv::sac::Ransac<ProblemStereo> stereo_ransac_;
+
+  // 1-point stereo RANSAC given rotation, keeps its buffers between frames.
+  TranslationVoting translation_voting_;
 };
 
 }  // namespace VIO
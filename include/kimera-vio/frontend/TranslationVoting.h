@@ -0,0 +1,140 @@
+/* ----------------------------------------------------------------------------
+ * Copyright 2017, Massachusetts Institute of Technology,
+ * Cambridge, MA 02139
+ * All Rights Reserved
+ * Authors: Luca Carlone, et al. (see THANKS for the full author list)
+ * See LICENSE for the license information
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @file   TranslationVoting.h
+ * @brief  Voting of relative translation hypotheses for 1-point stereo RANSAC.
+ * @author Antoni Rosinol
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "kimera-vio/common/vio_types.h"
+#include "kimera-vio/utils/Macros.h"
+
+namespace VIO {
+
+/**
+ * @brief The TranslationVoting class finds the largest set of relative
+ * translation hypotheses (with covariance) that are coherent with one of them.
+ * Hypotheses i and j are coherent if the Mahalanobis norm of their mismatch,
+ * (t_i - t_j)' (C_i + C_j)^-1 (t_i - t_j), is below a threshold.
+ *
+ * Instead of testing all pairs, the hypotheses are bucketed in a spatial hash
+ * grid. Since the norm is lower bounded by |t_i - t_j|^2 / trace(C_i + C_j),
+ * two hypotheses can only be coherent if they are closer than
+ * sqrt(threshold * (trace(C_i) + trace(C_j))). The cell size is chosen such
+ * that most hypotheses only need to be tested against the 27 cells around
+ * them, while the few with a larger covariance are tested against all others.
+ * Pairs are tested in contiguous batches of structure-of-arrays buffers so
+ * that the compiler vectorizes the closed-form Mahalanobis norm, and only the
+ * sizes of the coherent sets are counted, not the sets themselves.
+ *
+ * The result is the same as testing all pairs: the buffers are kept between
+ * calls so that voting does not allocate once they are large enough.
+ */
+class TranslationVoting {
+ public:
+  KIMERA_POINTER_TYPEDEFS(TranslationVoting);
+  KIMERA_DELETE_COPY_CONSTRUCTORS(TranslationVoting);
+
+  TranslationVoting() = default;
+  virtual ~TranslationVoting() = default;
+
+ public:
+  /**
+   * @brief vote Finds the hypothesis with the largest coherent set (the first
+   * one in case of ties) and returns its coherent set.
+   * @param translations Relative translation hypotheses.
+   * @param covariances Covariance of each translation hypothesis.
+   * @param threshold Threshold on the Mahalanobis norm of the mismatch.
+   * @param inliers Sorted indices of the hypotheses in the largest coherent
+   * set, including the hypothesis that has it.
+   * @return Size of the largest coherent set, 0 if there are no hypotheses.
+   */
+  size_t vote(const Vectors3f& translations,
+              const Matrices3f& covariances,
+              const float& threshold,
+              std::vector<int>* inliers);
+
+  //! Number of Mahalanobis norms evaluated in the last call to vote().
+  inline size_t getNrTestedPairs() const { return nr_tested_pairs_; }
+
+ private:
+  /**
+   * @brief buildGrid Sorts the hypotheses by hash bucket of their grid cell,
+   * with the ones with too large a covariance for the grid at the end.
+   */
+  void buildGrid(const Vectors3f& translations,
+                 const Matrices3f& covariances);
+
+  /**
+   * @brief testBatch Tests hypothesis i against the hypotheses in [begin, end)
+   * and marks in coherent_ the ones that are coherent with it.
+   * @param i Sorted index of the query hypothesis.
+   * @param begin First sorted index of the batch.
+   * @param end Past-the-end sorted index of the batch.
+   * @param check_cell Only mark hypotheses in cell (cx, cy, cz).
+   * @return Number of coherent hypotheses in the batch.
+   */
+  size_t testBatch(const size_t& i,
+                   const size_t& begin,
+                   const size_t& end,
+                   const bool& check_cell,
+                   const int32_t& cx,
+                   const int32_t& cy,
+                   const int32_t& cz);
+
+  //! Adds the pairs marked by the last testBatch() to the coherent set sizes.
+  void countBatch(const size_t& i, const size_t& begin, const size_t& end);
+
+  inline size_t getBucket(const int32_t& cx,
+                          const int32_t& cy,
+                          const int32_t& cz) const {
+    return (static_cast<uint32_t>(cx) * 73856093u ^
+            static_cast<uint32_t>(cy) * 19349663u ^
+            static_cast<uint32_t>(cz) * 83492791u) &
+           (nr_buckets_ - 1u);
+  }
+
+ private:
+  float threshold_ = 0.0f;
+
+  //! Hypotheses sorted by bucket, in structure-of-arrays layout.
+  std::vector<float> tx_, ty_, tz_;
+  //! Covariance entries, row-major: cov_[3 * r + c][k].
+  std::vector<float> cov_[9];
+  std::vector<int32_t> cx_, cy_, cz_;
+  //! Original index of each sorted hypothesis.
+  std::vector<int> idx_;
+
+  //! Sorted hypotheses [0, nr_in_grid_) are in the grid, the rest are not.
+  size_t nr_in_grid_ = 0u;
+  //! Power of two, hypotheses of bucket b are in [bucket_start_[b],
+  //! bucket_start_[b + 1]).
+  size_t nr_buckets_ = 1u;
+  std::vector<size_t> bucket_start_;
+
+  //! Coherent set size of each hypothesis, by original index.
+  std::vector<size_t> coherent_set_sizes_;
+  //! Result of the last testBatch().
+  std::vector<int32_t> coherent_;
+
+  //! Scratch buffers for buildGrid().
+  std::vector<float> bounds_, sorted_bounds_;
+  std::vector<int32_t> cells_;
+  std::vector<uint8_t> in_grid_;
+  std::vector<size_t> buckets_;
+
+  size_t nr_tested_pairs_ = 0u;
+};
+
+}  // namespace VIO
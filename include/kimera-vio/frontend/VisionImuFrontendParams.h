@@ -58,6 +58,20 @@ protected:
   int klt_max_level_ = 4;
   double klt_eps_ = 0.1;    // @TODO: add comments on each parameter
   int maxFeatureAge_ = 25;  // we cut feature tracks longer than that
+  // Experimental track pruning, off by default: the thresholds below are not
+  // tuned on any dataset yet.
+  //! Tracks whose KLT error is above this factor times the median KLT error
+  //! of the frame are pruned. Non-positive disables the pruning.
+  double klt_error_pruning_factor_ = 0.0;
+  //! KLT errors below this are never pruned, however low the median error
+  //! (mean absolute intensity difference of the window, as OpenCV's).
+  double klt_error_pruning_min_error_ = 10.0;
+  //! Max distance [px] between a reference keypoint and its track tracked
+  //! back to the reference frame. Non-positive disables the check.
+  double klt_fb_threshold_ = 0.0;
+  //! Max nr of tracks checked backwards per frame, the ones with largest KLT
+  //! error first. Negative checks all tracks.
+  int klt_fb_max_tracks_ = -1;
 
   // Detection parameters
   FeatureDetectorParams feature_detector_params_ = FeatureDetectorParams();
@@ -14,12 +14,14 @@
 
 #pragma once
 
+#include <atomic>
+#include <cstdint>
 #include <map>
+#include <memory>
 #include <string>
 #include <tuple>
 #include <thread>
 #include <utility>
-#include <mutex>
 
 #include <Eigen/Dense>
 
@@ -112,21 +114,21 @@ public:
 
  /* ------------------------------------------------------------------------ */
  // This should be called by the Backend, whenever there
- // is a new imu bias estimate. Note that we only store the new
- // bias, but we don't reset the pre-integration.This is because we
+ // is a new imu bias estimate. Note that we only publish the new
+ // bias, but we don't reset the pre-integration. This is because we
  // might have already started preintegrating measurements from
- // latest keyframe to the current frame using the previous bias,
- // which at the moment was the best last estimate.
- // The pre-integration is updated with the correct bias
- // in the Backend.
+ // latest keyframe to the current frame using the previous bias.
+ // Instead, the next call to preintegrateImuMeasurements corrects the
+ // in-flight pre-integration to the new bias to first order.
+ // THREAD-SAFE and lock-free.
  inline void updateBias(const ImuBias& imu_bias_prev_kf) {
-   std::lock_guard<std::mutex> lock(imu_bias_mutex_);
-   latest_imu_bias_ = imu_bias_prev_kf;
+   std::atomic_store(&latest_imu_bias_,
+                     std::make_shared<const ImuBias>(imu_bias_prev_kf));
+   latest_imu_bias_version_.fetch_add(1u, std::memory_order_release);
    // Debug output.
    if (VLOG_IS_ON(10)) {
-     LOG(INFO) << "Updating Preintegration imu bias (needs to reset "
-                  "integration for the bias to have effect):";
-     latest_imu_bias_.print();
+     LOG(INFO) << "Updating Preintegration imu bias:";
+     imu_bias_prev_kf.print();
    }
   }
 
@@ -136,30 +138,32 @@ public:
   // use the latest imu bias.
   // THIS IS NOT THREAD-SAFE: pim_ is not protected.
   inline void resetIntegrationWithCachedBias() {
-    std::lock_guard<std::mutex> lock(imu_bias_mutex_);
-    pim_->resetIntegrationAndSetBias(latest_imu_bias_);
+    // Read the version before the snapshot, which is then at least as recent.
+    pim_bias_version_ =
+        latest_imu_bias_version_.load(std::memory_order_acquire);
+    const std::shared_ptr<const ImuBias> imu_bias =
+        std::atomic_load(&latest_imu_bias_);
+    pim_->resetIntegrationAndSetBias(*imu_bias);
     // For debugging.
     if (VLOG_IS_ON(10)) {
       LOG(ERROR) << "Reset preintegration with new bias:";
-      latest_imu_bias_.print();
+      imu_bias->print();
     }
   }
 
   /* ------------------------------------------------------------------------ */
   // THREAD-SAFE.
   inline ImuBias getCurrentImuBias() const {
-    std::lock_guard<std::mutex> lock(imu_bias_mutex_);
-    return latest_imu_bias_;
+    return *std::atomic_load(&latest_imu_bias_);
   }
 
   /* ------------------------------------------------------------------------ */
   // Reset gravity value in pre-integration.
   // This is needed for the online initialization.
-  // THREAD-SAFE.
+  // THIS IS NOT THREAD-SAFE: pim_ is not protected.
   inline void resetPreintegrationGravity(const gtsam::Vector3& reset_value) {
     LOG(WARNING) << "Resetting value of gravity in ImuFrontend to: "
                  << reset_value;
-    std::lock_guard<std::mutex> lock(imu_bias_mutex_);
     pim_->params()->n_gravity = reset_value;
     CHECK(gtsam::assert_equal(pim_->params()->getGravity(), reset_value));
     // TODO(Toni): should we update imu_params n_gravity for consistency?
@@ -173,8 +177,6 @@ public:
   }
 
   inline gtsam::Vector3 getPreintegrationGravity() const {
-    // TODO(Toni): why are we locking the imu_bias_mutex here???
-    std::lock_guard<std::mutex> lock(imu_bias_mutex_);
     return imu_params_.n_gravity_;
   }
 
@@ -197,11 +199,23 @@ public:
  private:
   void initializeImuFrontend(const ImuBias& imu_bias);
 
+  // If a bias newer than the one of pim_ was published, move pim_ to the new
+  // bias using its first-order bias Jacobians, rather than waiting for the
+  // next resetIntegrationWithCachedBias.
+  void correctPimWithLatestBias();
+
  private:
   ImuParams imu_params_;
   PimUniquePtr pim_ = nullptr;
-  ImuBias latest_imu_bias_;
-  mutable std::mutex imu_bias_mutex_;
+  // Latest bias published by updateBias, only accessed through the
+  // std::atomic_load/atomic_store overloads for shared_ptr.
+  std::shared_ptr<const ImuBias> latest_imu_bias_;
+  // Incremented after each published bias, so that the preintegration only
+  // loads the snapshot when it has changed.
+  std::atomic<uint64_t> latest_imu_bias_version_;
+  // Version of the bias pim_ is integrated with. Owned by the thread calling
+  // preintegrateImuMeasurements, like pim_.
+  uint64_t pim_bias_version_ = 0u;
 };
 
 } // End of VIO namespace.
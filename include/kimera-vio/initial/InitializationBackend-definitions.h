@@ -17,6 +17,7 @@
 #pragma once
 
 #include <gtsam/navigation/AHRSFactor.h>
+#include <gtsam/navigation/NavState.h>
 
 #include "kimera-vio/frontend/StereoVisionImuFrontend-definitions.h"
 #include "kimera-vio/utils/Macros.h"
@@ -60,4 +61,19 @@ struct InitializationInputPayload : public StereoFrontendOutput {
   const gtsam::AHRSFactor::PreintegratedMeasurements ahrs_pim_;
 };
 
+// Output of the bundle-adjustment and gravity alignment over a window of
+// keyframes.
+struct InitializationAlignmentResult {
+  KIMERA_POINTER_TYPEDEFS(InitializationAlignmentResult);
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  bool is_success_ = false;
+  gtsam::Vector3 gyro_bias_ = gtsam::Vector3::Zero();
+  gtsam::Vector3 g_iter_b0_ = gtsam::Vector3::Zero();
+  //! Aligned state at the first keyframe of the window.
+  gtsam::NavState init_navstate_;
+  //! Aligned state at the last keyframe of the window.
+  gtsam::NavState latest_navstate_;
+};
+
 }  // namespace VIO
@@ -55,6 +55,14 @@ class InitializationBackend : public VioBackend {
                                            gtsam::Vector3* g_iter_b0,
                                            gtsam::NavState* init_navstate);
 
+  /* ------------------------------------------------------------------------ */
+  // Perform Bundle-Adjustment and initial gravity alignment on the given
+  // keyframes, and propagate the aligned state up to the last of them.
+  // Only touches this Backend, so it can run on a worker thread.
+  bool bundleAdjustmentAndGravityAlignment(
+      const std::vector<BackendInput::UniquePtr>& inputs_backend,
+      InitializationAlignmentResult* result);
+
  public:
   /* ------------------------------------------------------------------------ */
   std::vector<gtsam::Pose3> addInitialVisualStatesAndOptimize(
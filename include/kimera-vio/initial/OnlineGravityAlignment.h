@@ -86,7 +86,7 @@ class OnlineGravityAlignment {
                                    const bool &use_ahrs_estimator);
 
   /* ------------------------------------------------------------------------ */
-  void estimateGyroscopeBias(const VisualInertialFrames &vi_frames,
+  bool estimateGyroscopeBias(const VisualInertialFrames &vi_frames,
                              gtsam::Vector3 *gyro_bias);
 
   /* ------------------------------------------------------------------------ */
@@ -106,7 +106,7 @@ class OnlineGravityAlignment {
                               gtsam::Velocity3 *init_vel);
 
   /* ------------------------------------------------------------------------ */
-  void refineGravity(const VisualInertialFrames &vi_frames,
+  bool refineGravity(const VisualInertialFrames &vi_frames,
                      const gtsam::Vector3 &g_world,
                      gtsam::Vector3 *g_iter,
                      gtsam::Velocity3 *init_vel);
@@ -0,0 +1,172 @@
+/* ----------------------------------------------------------------------------
+ * Copyright 2017, Massachusetts Institute of Technology,
+ * Cambridge, MA 02139
+ * All Rights Reserved
+ * Authors: Luca Carlone, et al. (see THANKS for the full author list)
+ * See LICENSE for the license information
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @file   KeyframeSummaryStream.h
+ * @brief  Compact binary summary of each keyframe for external readers.
+ * @author Antoni Rosinol
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <type_traits>
+
+#include "kimera-vio/backend/VioBackend-definitions.h"
+#include "kimera-vio/frontend/Tracker-definitions.h"
+#include "kimera-vio/utils/Macros.h"
+#include "kimera-vio/utils/SpscRingBuffer.h"
+
+namespace VIO {
+
+/**
+ * @brief The KeyframeSummary struct is the fixed-layout binary record written
+ * per keyframe. All fields are naturally aligned, so the layout has no
+ * implicit padding and is the same on every little-endian 64-bit platform.
+ * Readers should check magic_, version_ and size_ before using a record;
+ * fields are only ever appended, with a version bump.
+ *
+ * Offset  Type        Field
+ *      0  uint32      magic_ ("KVKS")
+ *      4  uint16      version_
+ *      6  uint16      size_ (bytes of the record)
+ *      8  uint64      sequence_ (0, 1, 2... gaps mean dropped records)
+ *     16  int64       timestamp_ [ns]
+ *     24  uint64      kf_id_
+ *     32  double[3]   W_t_B_ (position of the body in the world frame)
+ *     56  double[4]   W_q_B_ (qw, qx, qy, qz)
+ *     88  double[3]   W_v_B_
+ *    112  double[3]   gyro_bias_
+ *    136  double[3]   acc_bias_
+ *    160  uint8       tracking_status_mono_ (TrackingStatus)
+ *    161  uint8       tracking_status_stereo_ (TrackingStatus)
+ *    162  uint8       flags_ (kHasCovariance | kHasTrackingStatus)
+ *    163  uint8       reserved
+ *    164  int32       landmark_count_
+ *    168  double[4]   frontend_times_ [s]: detection, tracking, mono ransac,
+ *                     stereo ransac
+ *    200  double[5]   backend_times_ [s]: factors and slots, pre-update,
+ *                     update, update slots, extra iterations
+ *    240  uint32      nr_extra_iterations_
+ *    244  uint32      reserved
+ *    248  double[21]  pose_covariance_: upper triangle, row-major, of the
+ *                     6x6 pose covariance (rotation first, as gtsam::Pose3)
+ *    416
+ */
+struct KeyframeSummary {
+  static constexpr uint32_t kMagic = 0x534B564Bu;  // "KVKS" in little-endian.
+  static constexpr uint16_t kVersion = 1u;
+  static constexpr uint8_t kHasCovariance = 1u << 0;
+  static constexpr uint8_t kHasTrackingStatus = 1u << 1;
+  static constexpr size_t kNrFrontendTimes = 4u;
+  static constexpr size_t kNrBackendTimes = 5u;
+  static constexpr size_t kNrCovarianceEntries = 21u;
+
+  uint32_t magic_;
+  uint16_t version_;
+  uint16_t size_;
+  uint64_t sequence_;
+  int64_t timestamp_;
+  uint64_t kf_id_;
+  double W_t_B_[3];
+  double W_q_B_[4];
+  double W_v_B_[3];
+  double gyro_bias_[3];
+  double acc_bias_[3];
+  uint8_t tracking_status_mono_;
+  uint8_t tracking_status_stereo_;
+  uint8_t flags_;
+  uint8_t reserved0_;
+  int32_t landmark_count_;
+  double frontend_times_[kNrFrontendTimes];
+  double backend_times_[kNrBackendTimes];
+  uint32_t nr_extra_iterations_;
+  uint32_t reserved1_;
+  double pose_covariance_[kNrCovarianceEntries];
+};
+static_assert(std::is_standard_layout<KeyframeSummary>::value &&
+                  std::is_trivial<KeyframeSummary>::value,
+              "KeyframeSummary must be a plain-old-data record.");
+static_assert(sizeof(KeyframeSummary) == 416u,
+              "The layout of KeyframeSummary changed, bump its version.");
+
+/**
+ * @brief The KeyframeSummaryStream class writes a KeyframeSummary per
+ * Backend output to a binary file, which external readers can follow while
+ * VIO runs (e.g. put the file in /dev/shm to keep it in memory).
+ *
+ * The pipeline threads only fill records into lock-free rings: the Frontend
+ * thread pushes the tracking status of each keyframe, the Backend thread
+ * pairs it with its output, and a writer thread owned by this class does the
+ * file IO. If the writer falls behind, records are dropped and counted
+ * rather than stalling the Backend.
+ */
+class KeyframeSummaryStream {
+ public:
+  KIMERA_POINTER_TYPEDEFS(KeyframeSummaryStream);
+  KIMERA_DELETE_COPY_CONSTRUCTORS(KeyframeSummaryStream);
+  /**
+   * @param filename Name of the file, inside FLAGS_output_path.
+   * @param ring_capacity Nr of records buffered before dropping them.
+   */
+  KeyframeSummaryStream(const std::string& filename,
+                        const size_t& ring_capacity = 64u);
+  //! Writes the buffered records and closes the file.
+  virtual ~KeyframeSummaryStream();
+
+  //! To be called from the Frontend thread only, for keyframes.
+  void addFrontendOutput(const Timestamp& timestamp_kf,
+                         const TrackerStatusSummary& tracker_status,
+                         const DebugTrackerInfo& tracker_info);
+
+  //! To be called from the Backend thread only.
+  void addBackendOutput(const BackendOutput& backend_output);
+
+  //! Nr of records dropped because the writer thread fell behind.
+  inline size_t getNrDroppedSummaries() const { return nr_dropped_; }
+
+  //! Fills the header and the fields of the record that come from the
+  //! Backend output; the Frontend fields are left zeroed.
+  static void fillSummary(const BackendOutput& backend_output,
+                          KeyframeSummary* summary);
+
+  //! Checks the header of a record read from a stream of summaries.
+  static bool isValid(const KeyframeSummary& summary);
+
+ private:
+  struct FrontendSummary {
+    Timestamp timestamp_;
+    TrackingStatus tracking_status_mono_;
+    TrackingStatus tracking_status_stereo_;
+    double frontend_times_[KeyframeSummary::kNrFrontendTimes];
+  };
+
+  //! Writer thread: moves records from the ring to the file.
+  void spinWriter();
+  //! Writes the buffered records, returns the nr of written records.
+  size_t writeSummaries();
+
+ private:
+  std::ofstream ofstream_;
+  SpscRingBuffer<FrontendSummary> frontend_summaries_;
+  SpscRingBuffer<KeyframeSummary> summaries_;
+
+  //! Sequence number of the next record, only used by the Backend thread.
+  uint64_t sequence_ = 0u;
+  std::atomic<size_t> nr_dropped_ = {0u};
+
+  std::atomic_bool shutdown_ = {false};
+  std::thread writer_thread_;
+};
+
+}  // namespace VIO
@@ -0,0 +1,157 @@
+/* ----------------------------------------------------------------------------
+ * Copyright 2017, Massachusetts Institute of Technology,
+ * Cambridge, MA 02139
+ * All Rights Reserved
+ * Authors: Luca Carlone, et al. (see THANKS for the full author list)
+ * See LICENSE for the license information
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @file   FlatOrbVocabulary.h
+ * @brief  Contiguous copy of a DBoW2 ORB vocabulary tree for fast BoW
+ * transforms.
+ * @author Marcus Abate
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <DBoW2/DBoW2.h>
+
+#include "kimera-vio/loopclosure/LoopClosureDetector-definitions.h"
+#include "kimera-vio/utils/Macros.h"
+
+namespace VIO {
+
+/**
+ * @brief The FlatOrbVocabulary class stores the nodes of an OrbVocabulary in
+ * breadth-first order, such that the children of a node are adjacent in
+ * memory, and the 256-bit ORB descriptors of the nodes are packed in a single
+ * array of uint64_t. Descending the tree is then a linear scan over a few
+ * cache lines per level with popcount Hamming distances, instead of chasing
+ * node pointers and comparing cv::Mat rows.
+ *
+ * The output of transform() is identical to that of
+ * OrbVocabulary::transform(), so the resulting BowVector can be used with the
+ * OrbDatabase and the OrbVocabulary scoring functions.
+ */
+class FlatOrbVocabulary {
+ public:
+  KIMERA_POINTER_TYPEDEFS(FlatOrbVocabulary);
+  KIMERA_DELETE_COPY_CONSTRUCTORS(FlatOrbVocabulary);
+
+  //! Number of uint64_t words in a packed 256-bit ORB descriptor.
+  static constexpr size_t kDescriptorWords = 4u;
+
+ public:
+  /**
+   * @brief FlatOrbVocabulary builds the flattened tree from a DBoW2 vocabulary.
+   * @param vocabulary The ORB vocabulary to flatten. It is not referenced
+   * after construction.
+   */
+  explicit FlatOrbVocabulary(const OrbVocabulary& vocabulary);
+  virtual ~FlatOrbVocabulary() = default;
+
+ public:
+  /**
+   * @brief transform Converts a batch of ORB descriptors to a BoW vector,
+   * equivalent to OrbVocabulary::transform(features, bow_vec).
+   * @param features ORB descriptors, each a 1x32 CV_8U cv::Mat.
+   * @param bow_vec Output BoW vector.
+   */
+  void transform(const OrbDescriptorVec& features,
+                 DBoW2::BowVector* bow_vec) const;
+
+  /**
+   * @brief transform Converts a batch of ORB descriptors to a BoW vector and a
+   * feature vector, equivalent to
+   * OrbVocabulary::transform(features, bow_vec, feat_vec, levels_up).
+   * @param features ORB descriptors, each a 1x32 CV_8U cv::Mat.
+   * @param bow_vec Output BoW vector.
+   * @param feat_vec Output feature vector, indexed by the node ids found
+   * levels_up levels above the leaves.
+   * @param levels_up Levels to go up the vocabulary tree to get the node ids
+   * of the feature vector.
+   */
+  void transform(const OrbDescriptorVec& features,
+                 DBoW2::BowVector* bow_vec,
+                 DBoW2::FeatureVector* feat_vec,
+                 const int& levels_up) const;
+
+  //! Number of nodes in the tree, including the root.
+  inline size_t nrNodes() const { return nodes_.size(); }
+
+  //! Number of visual words (leaves) in the tree.
+  inline size_t size() const { return nr_words_; }
+
+  inline bool empty() const { return nr_words_ == 0u; }
+
+ private:
+  //! Grants access to the protected tree of the DBoW2 vocabulary.
+  struct VocabularyAccessor;
+
+  struct FlatNode {
+    //! Index in nodes_ of the first child, children are contiguous.
+    uint32_t first_child_ = 0u;
+    uint32_t nr_children_ = 0u;
+    //! Ids of this node in the original DBoW2 vocabulary.
+    DBoW2::NodeId node_id_ = 0u;
+    DBoW2::WordId word_id_ = 0u;
+    DBoW2::WordValue weight_ = 0.0;
+  };
+
+  /**
+   * @brief findLeaf Descends the tree greedily, picking at each level the
+   * first child with the smallest Hamming distance, as DBoW2 does.
+   * @param descriptor Packed descriptor of kDescriptorWords words.
+   * @param nid_level Level at which to record the node id for feature vectors.
+   * @param level_node Index in nodes_ of the node at nid_level.
+   * @return Index in nodes_ of the leaf reached.
+   */
+  uint32_t findLeaf(const uint64_t* descriptor,
+                    const int& nid_level,
+                    uint32_t* level_node) const;
+
+  /**
+   * @brief transformBatch Finds the leaves of all features, processing them
+   * in parallel.
+   * @param features Descriptors to transform.
+   * @param nid_level Level at which to record the node id for feature vectors.
+   * @param leaves Index in nodes_ of the leaf of each feature.
+   * @param level_nodes Index in nodes_ of the node at nid_level of each
+   * feature.
+   */
+  void transformBatch(const OrbDescriptorVec& features,
+                      const int& nid_level,
+                      std::vector<uint32_t>* leaves,
+                      std::vector<uint32_t>* level_nodes) const;
+
+  //! Accumulates the leaves' weights in the BoW vector as DBoW2 does.
+  void accumulateWeights(const std::vector<uint32_t>& leaves,
+                         const std::vector<uint32_t>& level_nodes,
+                         DBoW2::BowVector* bow_vec,
+                         DBoW2::FeatureVector* feat_vec) const;
+
+  static inline uint32_t hammingDistance(const uint64_t* a,
+                                         const uint64_t* b) {
+    return __builtin_popcountll(a[0] ^ b[0]) +
+           __builtin_popcountll(a[1] ^ b[1]) +
+           __builtin_popcountll(a[2] ^ b[2]) +
+           __builtin_popcountll(a[3] ^ b[3]);
+  }
+
+ private:
+  //! Nodes in breadth-first order, the root is nodes_[0].
+  std::vector<FlatNode> nodes_;
+  //! Packed descriptors, kDescriptorWords per node, in the order of nodes_.
+  std::vector<uint64_t> descriptors_;
+  size_t nr_words_ = 0u;
+  int depth_levels_ = 0;
+  DBoW2::WeightingType weighting_ = DBoW2::TF_IDF;
+  bool must_normalize_ = false;
+  DBoW2::LNorm norm_ = DBoW2::L1;
+};
+
+}  // namespace VIO
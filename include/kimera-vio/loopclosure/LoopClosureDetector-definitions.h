@@ -43,7 +43,8 @@ enum class LCDStatus : int {
   NO_GROUPS,
   FAILED_TEMPORAL_CONSTRAINT,
   FAILED_GEOM_VERIFICATION,
-  FAILED_POSE_RECOVERY
+  FAILED_POSE_RECOVERY,
+  REDUNDANT_KEYFRAME
 };
 
 enum class GeomVerifOption : int { NISTER, NONE };
@@ -73,6 +74,11 @@ struct LCDFrame {
         left_keypoints_rectified_(left_keypoints_rectified),
         right_keypoints_rectified_(right_keypoints_rectified) {}
 
+  //! True if the 3D keypoints, versors and rectified keypoints are available.
+  inline bool isStereoReconstructed() const {
+    return left_img_rectified_.empty();
+  }
+
   Timestamp timestamp_;
   FrameId id_;
   FrameId id_kf_;
@@ -83,6 +89,11 @@ struct LCDFrame {
   BearingVectors versors_;
   StatusKeypointsCV left_keypoints_rectified_;
   StatusKeypointsCV right_keypoints_rectified_;
+  //! Undistorted rectified stereo images, which together with keypoints_ are
+  //! all the fields above are computed from when the frame first takes part
+  //! in a loop candidate. Released once they are.
+  cv::Mat left_img_rectified_;
+  cv::Mat right_img_rectified_;
 };  // struct LCDFrame
 
 struct MatchIsland {
@@ -170,6 +181,10 @@ struct LoopResult {
         status_str = "FAILED_POSE_RECOVERY";
         break;
       }
+      case LCDStatus::REDUNDANT_KEYFRAME: {
+        status_str = "REDUNDANT_KEYFRAME";
+        break;
+      }
     }
     return status_str;
   }
@@ -178,6 +193,8 @@ struct LoopResult {
   FrameId query_id_;
   FrameId match_id_;
   gtsam::Pose3 relative_pose_;
+  //! Noise of relative_pose_ from the pose refinement, null if not available.
+  gtsam::SharedNoiseModel relative_pose_noise_;
 };  // struct LoopResult
 
 struct LcdDebugInfo {
@@ -29,9 +29,11 @@
 #include "kimera-vio/frontend/StereoMatcher.h"
 #include "kimera-vio/frontend/StereoCamera.h"
 #include "kimera-vio/logging/Logger.h"
+#include "kimera-vio/loopclosure/FlatOrbVocabulary.h"
 #include "kimera-vio/loopclosure/LcdThirdPartyWrapper.h"
 #include "kimera-vio/loopclosure/LoopClosureDetector-definitions.h"
 #include "kimera-vio/loopclosure/LoopClosureDetectorParams.h"
+#include "kimera-vio/loopclosure/StereoPoseRefiner.h"
 #include "kimera-vio/pipeline/PipelineModule.h"
 #include "kimera-vio/utils/ThreadsafeQueue.h"
 
@@ -73,13 +75,23 @@ class LoopClosureDetector {
 
   /* ------------------------------------------------------------------------ */
   /** @brief Processed a single frame and adds it to relevant internal
-   * databases.
+   * databases. Only the ORB features are computed: the stereo reconstruction
+   * of the frame is deferred until it is needed, see reconstructStereoFrame.
+   * Until then the frame keeps its rectified stereo images.
    * @param[in] stereo_frame A StereoFrame object with two images and a pose to
    * the body frame at a minimum. Other fields may also be populated.
    * @return The local ID of the frame after it is added to the databases.
    */
   FrameId processAndAddFrame(const StereoFrame& stereo_frame);
 
+  /* ------------------------------------------------------------------------ */
+  /** @brief Computes the versors, rectified keypoints and 3D keypoints of the
+   *  ORB features of a frame in the database, if not done yet, and releases
+   *  the rectified images they are computed from.
+   * @param[in] frame_id The frame ID of the frame in the database.
+   */
+  void reconstructStereoFrame(const FrameId& frame_id);
+
   /* ------------------------------------------------------------------------ */
   /** @brief Runs all checks on a frame and determines whether it a loop-closure
       with a previous frame or not. Fills the LoopResult with this information.
@@ -92,6 +104,18 @@ class LoopClosureDetector {
    */
   bool detectLoop(const StereoFrame& stereo_frame, LoopResult* result);
 
+  /* ------------------------------------------------------------------------ */
+  /** @brief Determines whether a keyframe differs enough from the last frame
+   *  added to the LCD database to be worth running loop detection on. Always
+   *  true if skip_redundant_keyframes_ is false or the database is empty.
+   * @param[in] W_Pose_Blkf The pose of the keyframe in the world frame.
+   * @param[in] img The left image of the keyframe.
+   * @return True if the keyframe moved or rotated more than the thresholds in
+   *  the parameters, or if its low-resolution image is different enough.
+   */
+  bool isNovelKeyframe(const gtsam::Pose3& W_Pose_Blkf,
+                       const cv::Mat& img) const;
+
   /* ------------------------------------------------------------------------ */
   /** @brief Verify that the geometry between two frames is close enough to be
       considered a match, and generate a monocular transformation between them.
@@ -116,31 +140,40 @@ class LoopClosureDetector {
    *  and the query frame, in the coordinates of the match frame.
    * @param[out] bodyMatch_T_bodyQuery_stereo The 3D pose between the match frame
    *  and the query frame, in the coordinates of the match frame.
+   * @param[out] bodyMatch_noise_bodyQuery_stereo If not null, the noise of
+   *  bodyMatch_T_bodyQuery_stereo given by the pose refinement, null if the
+   *  pose was not refined.
    * @return True if the pose is recovered successfully, false otherwise.
    */
-  bool recoverPose(const FrameId& query_id,
-                   const FrameId& match_id,
-                   const gtsam::Pose3& camMatch_T_camQuery_mono,
-                   gtsam::Pose3* bodyMatch_T_bodyQuery_stereo,
-                   std::vector<FrameId>* inlier_id_in_query_frame,
-                   std::vector<FrameId>* inlier_id_in_match_frame);
+  bool recoverPose(
+      const FrameId& query_id,
+      const FrameId& match_id,
+      const gtsam::Pose3& camMatch_T_camQuery_mono,
+      gtsam::Pose3* bodyMatch_T_bodyQuery_stereo,
+      std::vector<FrameId>* inlier_id_in_query_frame,
+      std::vector<FrameId>* inlier_id_in_match_frame,
+      gtsam::SharedNoiseModel* bodyMatch_noise_bodyQuery_stereo = nullptr);
 
   /* ------------------------------------------------------------------------ */
-  /** @brief Refine relative pose given by ransac using smart factors.
+  /** @brief Refine relative pose given by ransac by minimizing the stereo
+   * reprojection errors of the inlier correspondences in both frames.
    * @param[in] query_id The frame ID of the query image in the database.
    * @param[in] match_id The frame ID of the match image in the database.
    * @param[in] camMatch_T_camQuery_stereo The relative pose between the match frame
    *  and the query frame, in the coordinates of the match frame.
    * @param[in] inlier correspondences (from ransac) in the query frame
    * @param[in] inlier correspondences (from ransac) in the match frame
-   * @return refined relative pose
+   * @param[out] camMatch_info_camQuery If not null, the information matrix of
+   *  the refined pose for unit pixel noise, zero if refinement fails
+   * @return refined relative pose, the input pose if refinement fails
    */
   gtsam::Pose3 refinePoses(
       const FrameId query_id,
       const FrameId match_id,
       const gtsam::Pose3& camMatch_T_camQuery_stereo,
       const std::vector<FrameId>& inlier_id_in_query_frame,
-      const std::vector<FrameId>& inlier_id_in_match_frame);
+      const std::vector<FrameId>& inlier_id_in_match_frame,
+      gtsam::Matrix6* camMatch_info_camQuery = nullptr);
 
   /* ------------------------------------------------------------------------ */
   /** @brief Gets a copy of the parameters of the LoopClosureDetector.
@@ -292,6 +325,14 @@ class LoopClosureDetector {
    */
   void initializePGO(const OdometryFactor& factor);
 
+  /* ------------------------------------------------------------------------ */
+  /** @brief Downsamples an image to the low-resolution grayscale thumbnail
+   *  used by isNovelKeyframe.
+   * @param[in] img The image to downsample.
+   * @return The kThumbnailWidth x kThumbnailHeight CV_8U thumbnail.
+   */
+  static cv::Mat computeThumbnail(const cv::Mat& img);
+
   /* ------------------------------------------------------------------------ */
   /** @brief Computes the indices of keypoints that match between two frames.
    * @param[in] query_id The frame ID of the query frame in the database.
@@ -362,6 +403,10 @@ class LoopClosureDetector {
   };
   LcdState lcd_state_ = LcdState::Bootstrap;
 
+  // Size of the images compared by the keyframe novelty check
+  static constexpr int kThumbnailWidth = 32;
+  static constexpr int kThumbnailHeight = 24;
+
   // Parameter members
   LoopClosureDetectorParams lcd_params_;
   const bool log_output_ = false;
@@ -372,17 +417,27 @@ class LoopClosureDetector {
 
   // BoW and Loop Detection database and members
   std::unique_ptr<OrbDatabase> db_BoW_;
+  //! Flattened copy of the vocabulary of db_BoW_, used for BoW transforms.
+  FlatOrbVocabulary::UniquePtr flat_vocab_;
   std::vector<LCDFrame> db_frames_;
+  //! PGO key (keyframe id) of each frame in db_frames_, which differ when
+  //! redundant keyframes are skipped.
+  std::vector<FrameId> db_frames_pgo_keys_;
   FrameIDTimestampMap timestamp_map_;
 
   // Store latest computed objects for temporal matching and nss scoring
   LcdThirdPartyWrapper::UniquePtr lcd_tp_wrapper_;
   DBoW2::BowVector latest_bowvec_;
 
+  // Last keyframe added to the LCD database, for the novelty check
+  gtsam::Pose3 last_lcd_W_Pose_Blkf_;
+  cv::Mat last_lcd_thumbnail_;
+
   // Store camera parameters and StereoFrame stuff once
   gtsam::Pose3 B_Pose_camLrect_;
   StereoCamera::ConstPtr stereo_camera_;
   StereoMatcher::UniquePtr stereo_matcher_;
+  StereoPoseRefiner::UniquePtr stereo_pose_refiner_;
 
   // Robust PGO members
   std::unique_ptr<KimeraRPGO::RobustSolver> pgo_;
@@ -451,7 +506,9 @@ class LcdModule : public MIMOPipelineModule<LcdInput, LcdOutput> {
       : MIMOPipelineModule<LcdInput, LcdOutput>("Lcd", parallel_run),
         frontend_queue_("lcd_frontend_queue"),
         backend_queue_("lcd_backend_queue"),
-        lcd_(std::move(lcd)) {}
+        lcd_(std::move(lcd)) {
+    latchWorkingOnPop(&backend_queue_);
+  }
   virtual ~LcdModule() = default;
 
   //! Callbacks to fill queues: they should be all lighting fast.
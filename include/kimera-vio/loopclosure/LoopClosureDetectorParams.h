@@ -62,6 +62,9 @@ class LoopClosureDetectorParams : public PipelineParams {
       double ransac_inlier_threshold_stereo = 0.5,
       bool use_mono_rot = true,
       bool refine_pose = true,
+      double refine_pose_huber_threshold = 1.345,
+      double refine_pose_outlier_threshold = 3.0,
+      double refine_pose_landmark_distance_threshold = 10.0,
       double lowe_ratio = 0.7,
 #if CV_VERSION_MAJOR == 3
       int matcher_type = cv::DescriptorMatcher::BRUTEFORCE_HAMMING,
@@ -88,7 +91,12 @@ class LoopClosureDetectorParams : public PipelineParams {
       double betweenTranslationPrecision = 1 / (0.1 * 0.1),
 
       double pgo_rot_threshold = 0.01,
-      double pgo_trans_threshold = 0.1);
+      double pgo_trans_threshold = 0.1,
+
+      bool skip_redundant_keyframes = false,
+      double min_keyframe_translation = 0.1,
+      double min_keyframe_rotation = 0.1,
+      double min_keyframe_image_difference = 0.0);
 
  public:
   virtual ~LoopClosureDetectorParams() = default;
@@ -134,6 +142,10 @@ class LoopClosureDetectorParams : public PipelineParams {
       ransac_inlier_threshold_stereo_== rhs.ransac_inlier_threshold_stereo_ &&
       use_mono_rot_== rhs.use_mono_rot_ &&
       refine_pose_ == rhs.refine_pose_ &&
+      refine_pose_huber_threshold_ == rhs.refine_pose_huber_threshold_ &&
+      refine_pose_outlier_threshold_ == rhs.refine_pose_outlier_threshold_ &&
+      refine_pose_landmark_distance_threshold_ ==
+          rhs.refine_pose_landmark_distance_threshold_ &&
       lowe_ratio_== rhs.lowe_ratio_ &&
       matcher_type_== rhs.matcher_type_ &&
 
@@ -151,7 +163,12 @@ class LoopClosureDetectorParams : public PipelineParams {
       betweenTranslationPrecision_ == rhs.betweenTranslationPrecision_ &&
 
       pgo_rot_threshold_== rhs.pgo_rot_threshold_ &&
-      pgo_trans_threshold_== rhs.pgo_trans_threshold_;
+      pgo_trans_threshold_== rhs.pgo_trans_threshold_ &&
+
+      skip_redundant_keyframes_ == rhs.skip_redundant_keyframes_ &&
+      min_keyframe_translation_ == rhs.min_keyframe_translation_ &&
+      min_keyframe_rotation_ == rhs.min_keyframe_rotation_ &&
+      min_keyframe_image_difference_ == rhs.min_keyframe_image_difference_;
   }
 
  public:
@@ -194,6 +211,9 @@ class LoopClosureDetectorParams : public PipelineParams {
   double ransac_inlier_threshold_stereo_;
   bool use_mono_rot_;
   bool refine_pose_;
+  double refine_pose_huber_threshold_;    // Huber threshold on the stereo reprojection error norm [px]
+  double refine_pose_outlier_threshold_;  // Stereo reprojection errors above this are outliers [px]
+  double refine_pose_landmark_distance_threshold_;  // Landmarks further than this from the match camera are ignored [m]
   //////////////////////////////////////////////////////////////////////////////
 
   double betweenRotationPrecision_;
@@ -228,6 +248,13 @@ class LoopClosureDetectorParams : public PipelineParams {
   double pgo_rot_threshold_;
   double pgo_trans_threshold_;
   //////////////////////////////////////////////////////////////////////////////
+
+  //////////////////////////// Keyframe Novelty Params /////////////////////////
+  bool skip_redundant_keyframes_;  // If true, skip loop detection for keyframes too similar to the last one processed; odometry is always added to the PGO. The frame windows above then count LCD database frames, not keyframes
+  double min_keyframe_translation_;  // Min translation [m] wrt the last processed keyframe to be novel
+  double min_keyframe_rotation_;     // Min rotation [rad] wrt the last processed keyframe to be novel
+  double min_keyframe_image_difference_;  // Min mean abs. intensity difference [0, 1] of low-res images to be novel; 0 disables the image check
+  //////////////////////////////////////////////////////////////////////////////
 };
 
 }  // namespace VIO
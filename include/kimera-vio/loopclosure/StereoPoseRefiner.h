@@ -0,0 +1,171 @@
+/* ----------------------------------------------------------------------------
+ * Copyright 2017, Massachusetts Institute of Technology,
+ * Cambridge, MA 02139
+ * All Rights Reserved
+ * Authors: Luca Carlone, et al. (see THANKS for the full author list)
+ * See LICENSE for the license information
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @file   StereoPoseRefiner.h
+ * @brief  Refinement of the relative pose between two stereo frames.
+ * @author Marcus Abate
+ */
+
+#pragma once
+
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <gtsam/base/Matrix.h>
+#include <gtsam/geometry/Cal3_S2Stereo.h>
+#include <gtsam/geometry/Pose3.h>
+#include <gtsam/geometry/StereoPoint2.h>
+
+#include "kimera-vio/utils/Macros.h"
+
+namespace VIO {
+
+/**
+ * @brief The StereoPoseRefiner class refines the relative pose between a
+ * query and a match stereo frame given stereo correspondences between them.
+ * It minimizes the stereo reprojection errors (uL, uR, v) of the
+ * correspondences in both frames over the pose of the query camera and the
+ * landmarks (in the match camera frame, which is fixed), with a Huber kernel
+ * and unit pixel noise. This is the problem solved by one smart stereo factor
+ * per correspondence, but the landmarks are eliminated with fixed-size 3x3
+ * Schur complements into a 6x6 Levenberg-Marquardt step on the pose, with
+ * analytic Jacobians and no factor graph.
+ *
+ * As the smart factors did, correspondences whose landmark is further than
+ * the landmark distance threshold from the match camera, or whose reprojection
+ * error is above the outlier threshold, at a linearization point are ignored.
+ *
+ * The information of the refined pose is the Schur complement of the
+ * landmarks in the undamped Hessian at the solution, i.e. the Gauss-Newton
+ * information of the pose with the landmarks marginalized out.
+ */
+class StereoPoseRefiner {
+ public:
+  KIMERA_POINTER_TYPEDEFS(StereoPoseRefiner);
+  KIMERA_DELETE_COPY_CONSTRUCTORS(StereoPoseRefiner);
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  //! Minimum number of inlier correspondences to refine the pose.
+  static constexpr size_t kMinNrInliers = 3u;
+
+  /**
+   * @param stereo_calib Calibration of the rectified stereo camera.
+   * @param huber_threshold Huber threshold on the reprojection error [px].
+   * @param outlier_threshold Reprojection errors above this are outliers [px].
+   * @param landmark_distance_threshold Landmarks further than this from the
+   * match camera are ignored [m].
+   */
+  StereoPoseRefiner(const gtsam::Cal3_S2Stereo& stereo_calib,
+                    const double& huber_threshold,
+                    const double& outlier_threshold,
+                    const double& landmark_distance_threshold);
+  virtual ~StereoPoseRefiner() = default;
+
+ public:
+  //! Removes all correspondences, keeping the allocated memory.
+  inline void clear() { measurements_.clear(); }
+
+  /**
+   * @brief addCorrespondence Adds a stereo correspondence between frames.
+   * @param z_query Rectified stereo measurement in the query frame.
+   * @param z_match Rectified stereo measurement in the match frame.
+   */
+  void addCorrespondence(const gtsam::StereoPoint2& z_query,
+                         const gtsam::StereoPoint2& z_match);
+
+  /**
+   * @brief refine Refines the pose of the query camera in the match camera
+   * frame.
+   * @param camMatch_T_camQuery_initial Initial guess.
+   * @param camMatch_T_camQuery Refined pose, the initial guess if there are
+   * fewer than kMinNrInliers inliers.
+   * @param information If not null and the pose was refined, information
+   * matrix of the refined pose for unit pixel noise, in the tangent space of
+   * camMatch_T_camQuery (rotation first). Set to zero if it is not positive
+   * definite.
+   * @return True if the pose was refined.
+   */
+  bool refine(const gtsam::Pose3& camMatch_T_camQuery_initial,
+              gtsam::Pose3* camMatch_T_camQuery,
+              gtsam::Matrix6* information = nullptr);
+
+  //! Number of inlier correspondences at the last linearization.
+  inline size_t getNrInliers() const { return nr_inliers_; }
+
+ private:
+  typedef Eigen::Matrix<double, 3, 6, Eigen::DontAlign> Matrix36;
+
+  struct Measurement {
+    gtsam::Vector3 z_query_;
+    gtsam::Vector3 z_match_;
+    //! Landmark in the match camera frame, and its value after a step.
+    gtsam::Vector3 landmark_;
+    gtsam::Vector3 landmark_candidate_;
+    bool inlier_ = false;
+    //! Blocks of the Hessian and gradient of the landmark at the last
+    //! linearization: H_ll, H_lp and g_l, and the damped inverse of H_ll.
+    gtsam::Matrix3 H_ll_;
+    Matrix36 H_lp_;
+    gtsam::Vector3 g_l_;
+    gtsam::Matrix3 H_ll_inv_;
+  };
+
+  /**
+   * @brief projectStereo Stereo projection of a point in the left camera
+   * frame, as gtsam::StereoCamera::project2, and its Jacobian wrt the point.
+   * @return False if the point is not in front of the camera.
+   */
+  bool projectStereo(const gtsam::Vector3& point,
+                     gtsam::Vector3* z,
+                     gtsam::Matrix3* H_point) const;
+
+  //! Back-projection of a stereo measurement, false if it has no disparity.
+  bool backprojectStereo(const gtsam::Vector3& z, gtsam::Vector3* point) const;
+
+  /**
+   * @brief linearize Flags the inliers and computes the blocks of the
+   * Hessian and gradient at the current estimate.
+   * @return Robust cost of the inliers.
+   */
+  double linearize(const gtsam::Pose3& camMatch_T_camQuery);
+
+  /**
+   * @brief solve Solves the damped normal equations for the pose step, and
+   * computes the landmark candidates by back-substitution.
+   * @param lambda Levenberg-Marquardt damping.
+   * @param delta Step in the tangent space of the pose.
+   */
+  void solve(const double& lambda, gtsam::Vector6* delta);
+
+  //! Robust cost of the inliers with the pose and landmark candidates.
+  double evaluate(const gtsam::Pose3& camMatch_T_camQuery) const;
+
+  //! Schur complement of the landmarks in the undamped Hessian at the last
+  //! linearization.
+  gtsam::Matrix6 marginalInformation() const;
+
+  //! Robust cost of a residual and its IRLS weight.
+  double huberCost(const double& error_norm) const;
+  double huberWeight(const double& error_norm) const;
+
+ private:
+  const double fx_, fy_, cx_, cy_, baseline_;
+  const double huber_threshold_;
+  const double outlier_threshold_;
+  const double landmark_distance_threshold_;
+
+  std::vector<Measurement> measurements_;
+  size_t nr_inliers_ = 0u;
+  //! Pose blocks of the Hessian and gradient at the last linearization.
+  gtsam::Matrix6 H_pp_;
+  gtsam::Vector6 g_p_;
+};
+
+}  // namespace VIO
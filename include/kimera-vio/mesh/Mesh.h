@@ -15,7 +15,7 @@
 #pragma once
 
 #include <math.h>
-#include <map>
+#include <unordered_map>
 #include <vector>
 
 #include <opencv2/core/core.hpp>
@@ -24,6 +24,9 @@
 
 #include <glog/logging.h>
 
+#include <boost/serialization/unordered_map.hpp>
+#include <boost/serialization/vector.hpp>
+
 #include "kimera-vio/utils/Macros.h"
 #include "kimera-vio/utils/SerializationOpenCv.h"
 #include "kimera-vio/utils/UtilsOpenCV.h"
@@ -69,8 +72,10 @@ class Mesh {
 
  private:
   // Maps (for internal processing).
-  typedef std::map<VertexId, LandmarkId> VertexToLmkIdMap;
-  typedef std::map<LandmarkId, VertexId> LmkIdToVertexMap;
+  // Vertex ids are compact (they are rows of vertices_mesh_), so the lmk id of
+  // each vertex is simply stored at the vertex id.
+  typedef std::vector<LandmarkId> VertexToLmkIdMap;
+  typedef std::unordered_map<LandmarkId, VertexId> LmkIdToVertexMap;
 
  public:
   template <typename PositionType = cv::Point3f>
@@ -140,6 +145,24 @@ class Mesh {
   //! Completely clears the mesh.
   void clearMesh();
 
+  /**
+   * @brief removePolygons Removes in place the polygons that are not flagged
+   * to be kept, together with the edges that no remaining polygon uses.
+   * Vertices are left in the mesh, call garbageCollectVertices to drop them.
+   * @param keep_polygon One flag per polygon, in the order of getPolygon.
+   * @return Number of polygons removed.
+   */
+  size_t removePolygons(const std::vector<bool>& keep_polygon);
+
+  /**
+   * @brief garbageCollectVertices Drops the vertices that no polygon
+   * references and compacts the ids of the remaining ones, preserving their
+   * relative order. Vertex ids retrieved before the call are invalidated,
+   * landmark ids are not.
+   * @return Number of vertices removed.
+   */
+  size_t garbageCollectVertices();
+
   /// Getters
   inline size_t getNumberOfPolygons() const {
     return static_cast<size_t>(polygons_mesh_.rows / (polygon_dimension_ + 1));
@@ -164,10 +187,9 @@ class Mesh {
     }
   }
   inline bool isVtxIdInMesh(const VertexId& vtx_id) const {
-    const auto& it = vertex_to_lmk_id_map_.find(vtx_id);
-    if (it != vertex_to_lmk_id_map_.end()) {
+    if (vtx_id < vertex_to_lmk_id_map_.size()) {
       // Sanity check
-      CHECK(isLmkIdInMesh(it->second));
+      DCHECK(lmk_id_to_vertex_map_.count(vertex_to_lmk_id_map_[vtx_id]));
       return true;
     } else {
       return false;
@@ -187,9 +209,8 @@ class Mesh {
   inline bool getLmkIdForVtxId(const VertexId& vtx_id,
                                LandmarkId* lmk_id) const {
     CHECK_NOTNULL(lmk_id);
-    auto it = vertex_to_lmk_id_map_.find(vtx_id);
-    if (it != vertex_to_lmk_id_map_.end()) {
-      *lmk_id = it->second;
+    if (vtx_id < vertex_to_lmk_id_map_.size()) {
+      *lmk_id = vertex_to_lmk_id_map_[vtx_id];
       return true;
     } else {
       return false;
@@ -201,6 +222,16 @@ class Mesh {
   void getPolygonsMeshToMat(cv::Mat* polygons_mesh) const;
   cv::Mat getColorsMesh(const bool& safe = true) const;
 
+  // Read-only views of the mesh data structures, nothing is copied.
+  // The views share the buffers of the mesh: do not write to them, and
+  // note that modifying the mesh afterwards may or may not be reflected in
+  // them. Use the functions above if you need a snapshot.
+  inline const cv::Mat& getVerticesMeshView() const { return vertices_mesh_; }
+  inline const cv::Mat& getPolygonsMeshView() const { return polygons_mesh_; }
+  inline const cv::Mat& getColorsMeshView() const {
+    return vertices_mesh_color_;
+  }
+
   /**
    * @brief setTopology DANGEROUS: it replaces the current topology by the
    * given one. NOTE THAT we don't check for consistency, meaning that we
@@ -266,8 +297,8 @@ class Mesh {
       const VertexPosition& lmk_position,
       const VertexColorRGB& vertex_color,
       const VertexNormal& vertex_normal,
-      std::map<VertexId, LandmarkId>* vertex_to_lmk_id_map,
-      std::map<LandmarkId, VertexId>* lmk_id_to_vertex_id_map,
+      VertexToLmkIdMap* vertex_to_lmk_id_map,
+      LmkIdToVertexMap* lmk_id_to_vertex_id_map,
       cv::Mat* vertices_mesh,
       VertexNormals* vertices_mesh_normal,
       cv::Mat* vertices_mesh_color) const;
@@ -275,6 +306,13 @@ class Mesh {
   // Sets all vertex normals to 0.
   inline void clearVertexNormals() { vertices_mesh_normal_.clear(); }
 
+  // Order-independent hash of the triangle with the given vertex ids.
+  static size_t getTriangleHash(const int32_t* vtx_ids);
+
+  // Sets the entries of the adjacency matrix for the three edges of the
+  // triangle with the given vertex ids.
+  void setTriangleEdges(const int32_t* vtx_ids, const uint8_t& value);
+
   friend class boost::serialization::access;
   // When the class Archive corresponds to an output archive, the
   // & operator is defined similar to <<.  Likewise, when the class Archive
@@ -15,8 +15,10 @@
 #pragma once
 
 #include <stdlib.h>
+#include <array>
 #include <atomic>
 #include <limits>   // for numeric_limits<>
+#include <unordered_map>
 #include <utility>  // for move
 #include <vector>
 
@@ -377,6 +379,36 @@ class Mesher {
                      const double& min_elongation_ratio,
                      const double& max_triangle_side) const;
 
+  /* ------------------------------------------------------------------------ */
+  // Votes of a polygon of the mesh in the histograms used to segment new
+  // planes.
+  struct PolygonHistogramVotes {
+    // Bins of z_hist_ voted by the vertices of the polygon, -1 for none.
+    std::array<int, 3> z_bins_ = {{-1, -1, -1}};
+    // Bin of hist_2d_ voted by the polygon, -1 for none.
+    int wall_bin_ = -1;
+    // Last call to segmentPlanesInMesh in which the polygon voted.
+    size_t stamp_ = 0u;
+
+    inline bool hasVotes() const {
+      return wall_bin_ >= 0 || z_bins_[0] >= 0 || z_bins_[1] >= 0 ||
+             z_bins_[2] >= 0;
+    }
+  };
+
+  // Sorted lmk ids of the vertices of a polygon, which identify it across
+  // calls, unlike its index in the mesh.
+  using PolygonLmkIds = std::array<LandmarkId, 3>;
+  struct PolygonLmkIdsHash {
+    size_t operator()(const PolygonLmkIds& lmk_ids) const;
+  };
+
+  /* ------------------------------------------------------------------------ */
+  // Replaces the votes of a polygon in the histograms with new ones, touching
+  // the histograms only if the voted bins changed.
+  void updatePolygonHistogramVotes(const PolygonHistogramVotes& new_votes,
+                                   PolygonHistogramVotes* votes);
+
   /* ------------------------------------------------------------------------ */
   // Segment planes in the mesh:
   // Updates seed_planes lmk ids of the plane by using initial plane seeds.
@@ -429,28 +461,21 @@ class Mesher {
   /* --------------------------------------------------------------------------
    */
   // Segment new planes in the mesh.
-  // Currently segments horizontal planes using z_components, which is
-  // expected to be a cv::Mat z_components (1, 0, CV_32F);
-  // And walls perpendicular to the ground, using a cv::Mat which is expected to
-  // be a cv::Mat walls (0, 0, CV_32FC2), with first channel being theta (yaw
-  // angle of the wall) and the second channel the distance of it.
-  // points_with_id_vio is only used if we are using stereo points...
-  void segmentNewPlanes(std::vector<Plane>* new_segmented_planes,
-                        const cv::Mat& z_components,
-                        const cv::Mat& walls);
+  // Currently segments horizontal planes using the peaks of the z histogram
+  // (z_hist_), and walls perpendicular to the ground using the peaks of the 2D
+  // histogram (hist_2d_) of theta (yaw angle of the wall) and distance.
+  // Both histograms are expected to be updated by segmentPlanesInMesh.
+  void segmentNewPlanes(std::vector<Plane>* new_segmented_planes);
 
   /* ------------------------------------------------------------------------ */
   // Segment wall planes.
-  void segmentWalls(std::vector<Plane>* wall_planes,
-                    size_t* plane_id,
-                    const cv::Mat& walls);
+  void segmentWalls(std::vector<Plane>* wall_planes, size_t* plane_id);
 
   /* ------------------------------------------------------------------------ */
   // Segment new planes horizontal.
   void segmentHorizontalPlanes(std::vector<Plane>* horizontal_planes,
                                size_t* plane_id,
-                               const Plane::Normal& normal,
-                               const cv::Mat& z_components);
+                               const Plane::Normal& normal);
 
   /* ------------------------------------------------------------------------ */
   // Data association between planes:
@@ -528,11 +553,27 @@ class Mesher {
   Mesh2D mesh_2d_;
   // The 3D mesh.
   Mesh3D mesh_3d_;
+  // Number of calls to updatePolygonMeshToTimeHorizon since the last
+  // garbage collection of the 3D mesh vertices.
+  size_t nr_updates_since_vertex_gc_ = 0u;
   // The histogram of z values for vertices of polygons parallel to ground.
   Histogram z_hist_;
   // The 2d histogram of theta angle (latitude) and distance of polygons
   // perpendicular to the vertical (aka parallel to walls).
   Histogram hist_2d_;
+  // Votes in z_hist_ and hist_2d_ of each polygon, keyed by its sorted lmk
+  // ids.
+  std::unordered_map<PolygonLmkIds, PolygonHistogramVotes, PolygonLmkIdsHash>
+      polygon_histogram_votes_;
+  // Number of calls to segmentPlanesInMesh.
+  size_t histogram_votes_stamp_ = 0u;
+  // Peaks of the histograms, and the histogram versions they were found in.
+  // Any vote bumps the version, so the peaks are searched again whenever a
+  // polygon moved its votes since the last search.
+  std::vector<Histogram::PeakInfo> z_hist_peaks_;
+  size_t z_hist_peaks_version_ = 0u;
+  std::vector<Histogram::PeakInfo2D> hist_2d_peaks_;
+  size_t hist_2d_peaks_version_ = 0u;
 
   const MesherParams mesher_params_;
   std::unique_ptr<MesherLogger> mesher_logger_;
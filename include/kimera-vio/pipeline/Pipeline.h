@@ -19,8 +19,10 @@
 #include <stddef.h>
 
 #include <atomic>
+#include <condition_variable>
 #include <cstdlib>  // for srand()
 #include <memory>
+#include <mutex>
 #include <thread>
 #include <vector>
 
@@ -29,6 +31,7 @@
 #include "kimera-vio/common/VioNavState.h"
 #include "kimera-vio/dataprovider/MonoDataProviderModule.h"
 #include "kimera-vio/frontend/VisionImuFrontendModule.h"
+#include "kimera-vio/logging/KeyframeSummaryStream.h"
 #include "kimera-vio/loopclosure/LoopClosureDetector.h"
 #include "kimera-vio/mesh/MesherModule.h"
 #include "kimera-vio/utils/ThreadsafeQueue.h"
@@ -38,6 +41,7 @@
 #include "kimera-vio/visualizer/Visualizer3DModule.h"
 
 DECLARE_bool(log_output);
+DECLARE_bool(log_keyframe_summary);
 DECLARE_bool(extract_planes_from_the_scene);
 DECLARE_bool(visualize);
 DECLARE_bool(visualize_lmk_type);
@@ -115,11 +119,24 @@ class Pipeline {
    */
   virtual bool hasFinished() const;
 
+  /**
+   * @brief drain Blocks until the pipeline has finished (see hasFinished()):
+   * all the data given to it has been processed, or the Backend has died, or
+   * the pipeline has been shutdown. Modules signal every time they become
+   * idle, so this returns as soon as the last payload has been processed,
+   * without polling.
+   * @param timeout_ms Maximum time to wait [ms], negative to wait forever.
+   * @return Whether the pipeline has finished, false on timeout. In sequential
+   * mode it does not wait, since nothing else is running.
+   */
+  virtual bool drain(const int& timeout_ms = -1);
+
   /**
    * @brief shutdownWhenFinished
    * Shutdown the pipeline once all data has been consumed, or if the Backend
    * has died unexpectedly.
-   * @param sleep_time_ms period of time between checks of vio status.
+   * @param sleep_time_ms period of time between prints of vio status (and
+   * statistics) while waiting for the pipeline to finish.
    * @return true if shutdown succesful, false otherwise (only returns
    * if running in sequential mode, or if shutdown happens).
    */
@@ -178,8 +195,12 @@ class Pipeline {
   virtual void signalBackendFailure() {
     VLOG(1) << "Backend failure signal received.";
     is_backend_ok_ = false;
+    notifyDrain();
   }
 
+  //! Wakes up drain() to re-evaluate whether the pipeline has finished.
+  void notifyDrain();
+
   inline void registerBackendOutputCallback(
       const VioBackendModule::OutputCallback& callback) {
     CHECK(vio_backend_module_);
@@ -237,6 +258,10 @@ class Pipeline {
   //! Shutdown switch to stop pipeline, threads, and queues.
   std::atomic_bool shutdown_ = {false};
 
+  //! Signaled by the modules when they become idle, see drain().
+  std::mutex drain_mutex_;
+  std::condition_variable drain_cv_;
+
   // Pipeline Modules
   // TODO(Toni) this should go to another class to avoid not having copy-ctor...
   //! Frontend.
@@ -269,6 +294,9 @@ class Pipeline {
   //! Displays actual images and 3D visualization
   DisplayModule::UniquePtr display_module_;
 
+  //! Binary summary of each keyframe for external readers.
+  KeyframeSummaryStream::UniquePtr keyframe_summary_stream_;
+
   // Atomic Flags
   std::atomic_bool is_backend_ok_ = {true};
 
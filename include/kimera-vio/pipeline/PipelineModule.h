@@ -46,6 +46,8 @@ class PipelineModuleBase {
   //! Callback used to signal if the pipeline module failed.
   //! TODO(Toni): return an error code perhaps.
   using OnFailureCallback = std::function<void()>;
+  //! Callback used to signal that the module became idle after processing.
+  using OnIdleCallback = std::function<void()>;
 
  public:
   /**
@@ -80,7 +82,10 @@ class PipelineModuleBase {
     shutdown_ = false;
   }
 
-  inline bool isWorking() const { return is_thread_working_ || hasWork(); }
+  //! The input queues are checked before the working flag: latched queues
+  //! (see latchWorkingOnPop) raise the flag while popping, so an input is
+  //! either still queued or already flagged when the flag is read.
+  inline bool isWorking() const { return hasWork() || is_thread_working_; }
 
   /**
    * @brief registerOnFailureCallback Add an extra on-failure callback to the
@@ -93,6 +98,19 @@ class PipelineModuleBase {
     on_failure_callbacks_.push_back(callback);
   }
 
+  /**
+   * @brief registerOnIdleCallback Add an extra on-idle callback to the list of
+   * callbacks. This will be called from the module's thread every time it has
+   * finished processing an input and is about to wait for the next one (and
+   * when it stops spinning).
+   * Mind that the module might still have queued inputs, check isWorking().
+   * @param on_idle_callback actual callback to register.
+   */
+  virtual void registerOnIdleCallback(const OnIdleCallback& callback) {
+    CHECK(callback);
+    on_idle_callbacks_.push_back(callback);
+  }
+
  protected:
   // TODO(Toni) Pass the specific queue synchronizer at the ctor level
   // (kind of like visitor pattern), and use the queue synchronizer base class.
@@ -117,6 +135,27 @@ class PipelineModuleBase {
   //! Checks if the module has work to do (should check input queues are empty)
   virtual bool hasWork() const = 0;
 
+  /**
+   * @brief latchWorkingOnPop Raises the working flag every time an input is
+   * popped from the given queue, before the queue is unlocked. Otherwise,
+   * between the pop and the flag being set after getInputPacket(), the module
+   * looks idle with an input in flight. Latch the queues checked by hasWork().
+   */
+  template <class T>
+  inline void latchWorkingOnPop(ThreadsafeQueue<T>* queue) {
+    CHECK_NOTNULL(queue)->setPopLatch(&is_thread_working_);
+  }
+
+  //! Clears the working flag and, if it was set, notifies the on-idle
+  //! callbacks.
+  inline void setIdle() {
+    if (is_thread_working_.exchange(false)) {
+      for (const auto& on_idle_callback : on_idle_callbacks_) {
+        on_idle_callback();
+      }
+    }
+  }
+
   virtual void notifyOnFailure() {
     for (const auto& on_failure_callback : on_failure_callbacks_) {
       if (on_failure_callback) {
@@ -134,6 +173,8 @@ class PipelineModuleBase {
 
   //! Callbacks to be called in case module does not return an output.
   std::vector<OnFailureCallback> on_failure_callbacks_;
+  //! Callbacks to be called when the module becomes idle.
+  std::vector<OnIdleCallback> on_idle_callbacks_;
 
   //! Thread related members.
   std::atomic_bool shutdown_ = {false};
@@ -191,7 +232,7 @@ class PipelineModule : public PipelineModuleBase {
     utils::StatsCollector timing_stats(name_id_ + " [ms]");
     while (!shutdown_) {
       // Get input data from queue by waiting for payload.
-      is_thread_working_ = false;
+      setIdle();
       InputUniquePtr input = getInputPacket();
       is_thread_working_ = true;
       if (input) {
@@ -220,11 +261,11 @@ class PipelineModule : public PipelineModuleBase {
 
       // Break the while loop if we are in sequential mode.
       if (!parallel_run_) {
-        is_thread_working_ = false;
+        setIdle();
         return true;
       }
     }
-    is_thread_working_ = false;
+    setIdle();
     VLOG(1) << "Module: " << name_id_ << " - Successful shutdown.";
     return false;
   }
@@ -370,8 +411,10 @@ class SIMOPipelineModule : public MIMOPipelineModule<Input, Output> {
     CHECK(input_queue_ != nullptr)
         << "Input queue must be non NULL for a SIMO pipeline module.\n"
         << "SIMO Pipeline Module: " << PIO::name_id_;
+    PIO::latchWorkingOnPop(input_queue_);
   }
-  virtual ~SIMOPipelineModule() = default;
+  //! The input queue is not owned and might outlive the module.
+  virtual ~SIMOPipelineModule() { input_queue_->setPopLatch(nullptr); }
 
  protected:
   /**
@@ -512,8 +555,10 @@ class SISOPipelineModule : public MISOPipelineModule<Input, Output> {
       : MISOPipelineModule<Input, Output>(output_queue, name_id, parallel_run),
         input_queue_(input_queue) {
     CHECK_NOTNULL(input_queue_);
+    MISO::latchWorkingOnPop(input_queue_);
   }
-  virtual ~SISOPipelineModule() = default;
+  //! The input queue is not owned and might outlive the module.
+  virtual ~SISOPipelineModule() { input_queue_->setPopLatch(nullptr); }
 
   //! Override registering of output callbacks since this is only used for
   //! multiple output pipelines.
@@ -129,6 +129,28 @@ public:
   // Calculates histogram.
   void calculateHistogram(const cv::Mat& input, bool log_histogram = false);
 
+  /* ------------------------------------------------------------------------ */
+  // Incremental interface, as an alternative to calculateHistogram, for
+  // uniform histograms whose samples come and go one at a time.
+  // Returns the index of the bin where a sample of dims values falls, using the
+  // same binning as calculateHistogram, or -1 if it is out of range.
+  int getBinIndex(const float* sample) const;
+
+  // Adds votes (negative to remove them) to a bin given by getBinIndex.
+  void addVotesToBin(const int& bin_idx, const float& votes = 1.0f);
+
+  // Removes all votes, keeping the histogram allocated.
+  void clearHistogram();
+
+  // Saves the histogram in a yaml file.
+  void logHistogram() const;
+
+  // Increased every time the votes change, so that results derived from the
+  // histogram (e.g. its peaks) can be reused while it does not change.
+  inline size_t getVersion() const { return version_; }
+
+  inline const cv::Mat& getHistogram() const { return histogram_; }
+
   /* ------------------------------------------------------------------------ */
   // If you play with the peak_per attribute value, you can increase/decrease the
   // number of peaks found.
@@ -164,6 +186,7 @@ private:
 
   // The actual histogram.
   cv::Mat histogram_;
+  size_t version_ = 0u;
 
   /* ------------------------------------------------------------------------ */
   struct Length {
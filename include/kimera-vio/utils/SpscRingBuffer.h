@@ -0,0 +1,111 @@
+/* ----------------------------------------------------------------------------
+ * Copyright 2017, Massachusetts Institute of Technology,
+ * Cambridge, MA 02139
+ * All Rights Reserved
+ * Authors: Luca Carlone, et al. (see THANKS for the full author list)
+ * See LICENSE for the license information
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @file   SpscRingBuffer.h
+ * @brief  Lock-free ring buffer for one producer and one consumer thread.
+ * @author Antoni Rosinol
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "kimera-vio/utils/Macros.h"
+
+namespace VIO {
+
+/**
+ * @brief The SpscRingBuffer class is a bounded, wait-free queue of values
+ * for exactly one producer thread (push) and one consumer thread (peek/pop).
+ * Pushing to a full ring fails instead of blocking, so the producer never
+ * waits on the consumer.
+ */
+template <typename T>
+class SpscRingBuffer {
+ public:
+  KIMERA_POINTER_TYPEDEFS(SpscRingBuffer);
+  KIMERA_DELETE_COPY_CONSTRUCTORS(SpscRingBuffer);
+
+  //! The capacity is rounded up to a power of two.
+  explicit SpscRingBuffer(const size_t& capacity)
+      : buffer_(roundUpToPowerOfTwo(capacity)), mask_(buffer_.size() - 1u) {
+    CHECK_GT(capacity, 0u);
+  }
+  ~SpscRingBuffer() = default;
+
+  //! Producer only. Returns false if the ring is full.
+  bool push(const T& value) {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) == buffer_.size()) {
+      return false;
+    }
+    buffer_[tail & mask_] = value;
+    tail_.store(tail + 1u, std::memory_order_release);
+    return true;
+  }
+
+  //! Consumer only. Oldest value, or nullptr if the ring is empty. The value
+  //! stays valid until it is popped.
+  const T* peek() const {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) return nullptr;
+    return &buffer_[head & mask_];
+  }
+
+  //! Consumer only. Returns false if the ring is empty.
+  bool pop(T* value) {
+    DCHECK(value);
+    const T* front = peek();
+    if (!front) return false;
+    *value = *front;
+    head_.store(head_.load(std::memory_order_relaxed) + 1u,
+                std::memory_order_release);
+    return true;
+  }
+
+  //! Consumer only. Drops the oldest value, if any.
+  void pop() {
+    if (peek()) {
+      head_.store(head_.load(std::memory_order_relaxed) + 1u,
+                  std::memory_order_release);
+    }
+  }
+
+  //! Approximate when called concurrently with push or pop.
+  inline size_t size() const {
+    return tail_.load(std::memory_order_acquire) -
+           head_.load(std::memory_order_acquire);
+  }
+  inline bool empty() const { return size() == 0u; }
+  inline size_t capacity() const { return buffer_.size(); }
+
+ private:
+  static size_t roundUpToPowerOfTwo(const size_t& n) {
+    size_t power = 1u;
+    while (power < n) power <<= 1u;
+    return power;
+  }
+
+ private:
+  std::vector<T> buffer_;
+  const size_t mask_;
+  //! Keep the indices in different cache lines to avoid false sharing
+  //! between the producer and the consumer. Padding instead of alignas, so
+  //! that heap allocation does not need over-aligned new.
+  char padding_head_[64];
+  std::atomic<size_t> head_ = {0u};
+  char padding_tail_[64];
+  std::atomic<size_t> tail_ = {0u};
+};
+
+}  // namespace VIO
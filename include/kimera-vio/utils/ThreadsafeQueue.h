@@ -135,14 +135,32 @@ class ThreadsafeQueueBase {
     return shutdown_;
   }
 
+  /** \brief Sets a flag that is raised, while holding the queue lock, every
+   * time values are popped. A consumer passing its working flag is seen as
+   * working as soon as a value leaves the queue: checking empty() and then
+   * the flag never misses a value in flight.
+   * Pass a nullptr to stop raising the flag.
+   */
+  void setPopLatch(std::atomic_bool* pop_latch) {
+    std::lock_guard<std::mutex> lk(mutex_);
+    pop_latch_ = pop_latch;
+  }
+
  public:
   std::string queue_id_;
 
+ protected:
+  //! Must be called with the mutex locked, right after popping.
+  inline void raisePopLatch() {
+    if (pop_latch_) *pop_latch_ = true;
+  }
+
  protected:
   mutable std::mutex mutex_;  //! mutable for empty() and copy-constructor.
   InternalQueue data_queue_;
   std::condition_variable data_cond_;
   std::atomic_bool shutdown_;  //! flag for signaling queue shutdown.
+  std::atomic_bool* pop_latch_;  //! raised on pop, guarded by mutex_.
 };
 
 template <typename T>
@@ -226,6 +244,7 @@ class ThreadsafeQueue : public ThreadsafeQueueBase<T> {
   using TQB::data_cond_;
   using TQB::data_queue_;
   using TQB::mutex_;
+  using TQB::raisePopLatch;
   using TQB::shutdown_;
 
   //! Stats on how full the queue gets.
@@ -261,7 +280,8 @@ ThreadsafeQueueBase<T>::ThreadsafeQueueBase(const std::string& queue_id)
       mutex_(),
       data_queue_(),
       data_cond_(),
-      shutdown_(false) {}
+      shutdown_(false),
+      pop_latch_(nullptr) {}
 
 template <typename T>
 ThreadsafeQueue<T>::ThreadsafeQueue(const std::string& queue_id,
@@ -319,6 +339,7 @@ bool ThreadsafeQueue<T>::popBlocking(T& value) {
   if (shutdown_) return false;
   value = std::move(*data_queue_.front());
   data_queue_.pop();
+  raisePopLatch();
   lk.unlock();  // Unlock before notify.
   data_cond_.notify_one();
   return true;
@@ -331,6 +352,7 @@ std::shared_ptr<T> ThreadsafeQueue<T>::popBlocking() {
   if (shutdown_) return std::shared_ptr<T>(nullptr);
   std::shared_ptr<T> result = data_queue_.front();
   data_queue_.pop();
+  raisePopLatch();
   lk.unlock();  // Unlock before notify.
   data_cond_.notify_one();
   return result;
@@ -349,6 +371,7 @@ bool ThreadsafeQueue<T>::popBlockingWithTimeout(T& value, size_t duration_ms) {
   if (shutdown_ || data_queue_.empty()) return false;
   value = std::move(*data_queue_.front());
   data_queue_.pop();
+  raisePopLatch();
   return true;
 }
 
@@ -359,6 +382,7 @@ bool ThreadsafeQueue<T>::pop(T& value) {
   if (data_queue_.empty()) return false;
   value = std::move(*data_queue_.front());
   data_queue_.pop();
+  raisePopLatch();
   lk.unlock();  // Unlock before notify.
   data_cond_.notify_one();
   return true;
@@ -371,6 +395,7 @@ std::shared_ptr<T> ThreadsafeQueue<T>::pop() {
   if (data_queue_.empty()) return std::shared_ptr<T>(nullptr);
   std::shared_ptr<T> result = data_queue_.front();
   data_queue_.pop();
+  raisePopLatch();
   lk.unlock();  // Unlock before notify.
   data_cond_.notify_one();
   return result;
@@ -386,6 +411,7 @@ bool ThreadsafeQueue<T>::batchPop(typename TQB::InternalQueue* output_queue) {
   bool success = false;
   if (!data_queue_.empty()) {
     data_queue_.swap(*output_queue);
+    raisePopLatch();
     success = true;
   }
   lk.unlock();  // Unlock before notify.
@@ -342,6 +342,7 @@ class UtilsOpenCV {
   // compute max intensity of pixels within a triangle specified by the pixel
   // location of its vertices
   // If intensityThreshold is < 0, then the check is disabled.
+  // img must be CV_8UC1, typically a gradient or edge image.
   static std::vector<std::pair<KeypointCV, double>> FindHighIntensityInTriangle(
       const cv::Mat img,
       const cv::Vec6f& px_vertices,
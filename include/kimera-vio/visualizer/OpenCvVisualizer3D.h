@@ -18,6 +18,8 @@
 #include <map>
 #include <memory>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include <glog/logging.h>
@@ -89,6 +91,9 @@ class OpenCvVisualizer3D : public Visualizer3D {
 
   /**
    * @brief addPoseToTrajectory Add pose to the previous trajectory.
+   * The trajectory is stored in segments of FLAGS_trajectory_segment_length
+   * poses. Old segments are dropped beyond FLAGS_displayed_trajectory_length,
+   * and decimated to keep at most FLAGS_max_trajectory_poses poses.
    * @param current_pose_gtsam Pose to be added
    * @param img Optional img to be displayed at the pose's frustum.
    */
@@ -97,7 +102,8 @@ class OpenCvVisualizer3D : public Visualizer3D {
   /**
    * @brief visualizeTrajectory3D
    * Visualize currently stored 3D trajectory (user needs to add poses with
-   * addPoseToTrajectory).
+   * addPoseToTrajectory). Only the segments that changed since the last call
+   * are added to the widgets map, the others are still in the window.
    * @param frustum_image
    * @param widgets_map
    */
@@ -388,6 +394,50 @@ class OpenCvVisualizer3D : public Visualizer3D {
                      const gtsam::Pose3& body_pose_camLrect,
                      WidgetsMap* widgets_map);
 
+  //! Geometry and appearance that a factor graph widget is drawn from:
+  //! widgets are only re-created when their signature changes.
+  struct WidgetSignature {
+    //! Compared up to FLAGS_factor_graph_viz_update_tolerance.
+    std::vector<double> geometry_;
+    //! Color, style and line width, compared exactly.
+    std::vector<double> appearance_;
+  };
+  enum class WidgetStyle {
+    kCoordinateSystem = 0,
+    kFrustum = 1,
+    kArrow = 2,
+    kCylinder = 3,
+    kSphere = 4,
+    kText = 5,
+    kWireframeCube = 6
+  };
+  static void appendToSignature(const cv::Affine3d& pose,
+                                WidgetSignature* signature);
+  static void appendToSignature(const cv::Point3d& point,
+                                WidgetSignature* signature);
+  //! Line width is the scale, thickness, radius or size of the widget,
+  //! depending on its style.
+  static void appendToSignature(const cv::viz::Color& color,
+                                const WidgetStyle& style,
+                                const double& line_width,
+                                WidgetSignature* signature);
+
+  /**
+   * @brief needsFactorGraphWidgetUpdate Records that a factor graph widget is
+   * drawn in the current call to visualizeFactorGraph, and checks whether it
+   * has to be (re-)created.
+   * @param widget_id Id of the widget.
+   * @param signature Geometry and appearance of the widget.
+   * @param remove_when_stale Whether to remove the widget from the window
+   * once it is not drawn anymore, otherwise it stays as it was last drawn.
+   * @return True if the widget is not displayed yet, or if its signature
+   * differs from the displayed one by more than
+   * FLAGS_factor_graph_viz_update_tolerance.
+   */
+  bool needsFactorGraphWidgetUpdate(const std::string& widget_id,
+                                    const WidgetSignature& signature,
+                                    const bool& remove_when_stale);
+
  private:
   //! Flags for visualization behaviour.
   const BackendType backend_type_;
@@ -399,7 +449,28 @@ class OpenCvVisualizer3D : public Visualizer3D {
   //! Mesh 3d visualization properties setter callback.
   Mesh3dVizPropertiesSetterCallback mesh3d_viz_properties_callback_;
 
+  //! Piece of the trajectory displayed as one widget. Consecutive segments
+  //! share their boundary pose so that the path is connected.
+  struct TrajectorySegment {
+    size_t id_ = 0u;
+    std::vector<cv::Affine3f> poses_;
+    //! Whether the widget needs to be (re-)sent to the display.
+    bool dirty_ = true;
+  };
+
+  // Remove the oldest trajectory segment, and its widget.
+  void popFrontTrajectorySegment();
+  // Halve the number of poses in the oldest half of the trajectory, and merge
+  // the thinned segments that fit into one.
+  void decimateTrajectory();
+  static std::string trajectorySegmentWidgetId(const size_t& segment_id);
+
+  //! Most recent poses, for the frustums, bounded by the segment length.
   std::deque<cv::Affine3d> trajectory_poses_3d_;
+  std::deque<TrajectorySegment> trajectory_segments_;
+  size_t next_trajectory_segment_id_ = 0u;
+  //! Sum of the poses of all segments, counting shared poses twice.
+  size_t nr_trajectory_poses_ = 0u;
 
   std::map<PlaneId, LineNr> plane_to_line_nr_map_;
   PlaneIdMap plane_id_map_;
@@ -410,7 +481,15 @@ class OpenCvVisualizer3D : public Visualizer3D {
   std::map<std::string, cv::Affine3d> widget_id_to_pose_map_;
 
   WidgetIds widget_ids_to_remove_;
-  WidgetIds widget_ids_to_remove_in_next_iter_;
+
+  //! Factor graph widgets currently displayed.
+  struct FactorGraphWidget {
+    WidgetSignature signature_;
+    bool remove_when_stale_ = true;
+  };
+  std::unordered_map<std::string, FactorGraphWidget> factor_graph_widgets_;
+  //! Ids of the factor graph widgets drawn in the current iteration.
+  std::unordered_set<std::string> factor_graph_widgets_drawn_;
 
   //! Colors & Scales
   cv::viz::Color cloud_color_ = cv::viz::Color::white();
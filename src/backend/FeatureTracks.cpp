@@ -0,0 +1,139 @@
+/* ----------------------------------------------------------------------------
+ * Copyright 2017, Massachusetts Institute of Technology,
+ * Cambridge, MA 02139
+ * All Rights Reserved
+ * Authors: Luca Carlone, et al. (see THANKS for the full author list)
+ * See LICENSE for the license information
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @file   FeatureTracks.cpp
+ * @brief  Feature tracks of the landmarks in the time horizon of the Backend.
+ * @author Antoni Rosinol
+ */
+
+#include "kimera-vio/backend/FeatureTracks.h"
+
+namespace VIO {
+
+constexpr size_t FeatureTrack::kInitialCapacity;
+
+/* -------------------------------------------------------------------------- */
+FeatureTrack* FeatureTracks::find(const LandmarkId& lmk_id) {
+  const auto it = slot_of_lmk_.find(lmk_id);
+  return it == slot_of_lmk_.end() ? nullptr : &slots_[it->second];
+}
+
+/* -------------------------------------------------------------------------- */
+const FeatureTrack* FeatureTracks::find(const LandmarkId& lmk_id) const {
+  const auto it = slot_of_lmk_.find(lmk_id);
+  return it == slot_of_lmk_.end() ? nullptr : &slots_[it->second];
+}
+
+/* -------------------------------------------------------------------------- */
+FeatureTrack& FeatureTracks::at(const LandmarkId& lmk_id) {
+  FeatureTrack* feature_track = find(lmk_id);
+  CHECK(feature_track) << "No feature track for lmk with id: " << lmk_id;
+  return *feature_track;
+}
+
+/* -------------------------------------------------------------------------- */
+const FeatureTrack& FeatureTracks::at(const LandmarkId& lmk_id) const {
+  const FeatureTrack* feature_track = find(lmk_id);
+  CHECK(feature_track) << "No feature track for lmk with id: " << lmk_id;
+  return *feature_track;
+}
+
+/* -------------------------------------------------------------------------- */
+bool FeatureTracks::addObservation(const LandmarkId& lmk_id,
+                                   const FrameId& frame_id,
+                                   const gtsam::StereoPoint2& px,
+                                   const FrameId& oldest_frame_id) {
+  DCHECK(expiry_queue_.empty() || expiry_queue_.back().frame_id_ <= frame_id)
+      << "Observations must be added in order of frame id.";
+  const auto it = slot_of_lmk_.find(lmk_id);
+  size_t slot;
+  bool is_new_track = false;
+  if (it != slot_of_lmk_.end()) {
+    slot = it->second;
+    slots_[slot].addObservation(frame_id, px, oldest_frame_id);
+  } else {
+    if (free_slots_.empty()) {
+      slot = slots_.size();
+      slots_.emplace_back(frame_id, px);
+      slot_lmk_ids_.push_back(lmk_id);
+    } else {
+      slot = free_slots_.back();
+      free_slots_.pop_back();
+      slots_[slot].reset(frame_id, px);
+      slot_lmk_ids_[slot] = lmk_id;
+    }
+    slot_of_lmk_.emplace(lmk_id, slot);
+    is_new_track = true;
+  }
+  expiry_queue_.push_back({frame_id, slot, lmk_id});
+  return is_new_track;
+}
+
+/* -------------------------------------------------------------------------- */
+bool FeatureTracks::erase(const LandmarkId& lmk_id) {
+  const auto it = slot_of_lmk_.find(lmk_id);
+  if (it == slot_of_lmk_.end()) return false;
+  const size_t slot = it->second;
+  slot_of_lmk_.erase(it);
+  slots_[slot].obs_.clear();
+  slots_[slot].in_ba_graph_ = false;
+  slot_lmk_ids_[slot] = -1;
+  free_slots_.push_back(slot);
+  return true;
+}
+
+/* -------------------------------------------------------------------------- */
+size_t FeatureTracks::recycleStaleTracks(const FrameId& oldest_frame_id) {
+  size_t nr_recycled_tracks = 0u;
+  while (!expiry_queue_.empty() &&
+         expiry_queue_.front().frame_id_ < oldest_frame_id) {
+    const Expiry& expiry = expiry_queue_.front();
+    // Only the entry of the last observation of a track can expire it.
+    if (slot_lmk_ids_[expiry.slot_] == expiry.lmk_id_) {
+      const FeatureTrack& feature_track = slots_[expiry.slot_];
+      if (!feature_track.in_ba_graph_ && !feature_track.obs_.empty() &&
+          feature_track.obs_.back().first == expiry.frame_id_) {
+        VLOG(20) << "Recycling feature track for lmk: " << expiry.lmk_id_;
+        CHECK(erase(expiry.lmk_id_));
+        ++nr_recycled_tracks;
+      }
+    }
+    expiry_queue_.pop_front();
+  }
+  return nr_recycled_tracks;
+}
+
+/* -------------------------------------------------------------------------- */
+void FeatureTracks::clear() {
+  slots_.clear();
+  slot_lmk_ids_.clear();
+  free_slots_.clear();
+  slot_of_lmk_.clear();
+  expiry_queue_.clear();
+}
+
+/* -------------------------------------------------------------------------- */
+void FeatureTracks::getLandmarkIds(LandmarkIds* lmk_ids) const {
+  CHECK_NOTNULL(lmk_ids);
+  lmk_ids->clear();
+  lmk_ids->reserve(slot_of_lmk_.size());
+  for (const auto& lmk_id_slot : slot_of_lmk_) {
+    lmk_ids->push_back(lmk_id_slot.first);
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+void FeatureTracks::print() const {
+  for (const auto& lmk_id_slot : slot_of_lmk_) {
+    std::cout << "Landmark " << lmk_id_slot.first << " having ";
+    slots_[lmk_id_slot.second].print();
+  }
+}
+
+}  // namespace VIO
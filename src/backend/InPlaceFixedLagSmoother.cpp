@@ -0,0 +1,143 @@
+/* ----------------------------------------------------------------------------
+ * Copyright 2017, Massachusetts Institute of Technology,
+ * Cambridge, MA 02139
+ * All Rights Reserved
+ * Authors: Luca Carlone, et al. (see THANKS for the full author list)
+ * See LICENSE for the license information
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @file   InPlaceFixedLagSmoother.cpp
+ * @brief  Incremental fixed-lag smoother that accepts factors extended in
+ * place, such as smart factors with new measurements.
+ * @author Antoni Rosinol
+ */
+
+#include "kimera-vio/backend/InPlaceFixedLagSmoother.h"
+
+#include <algorithm>
+#include <unordered_set>
+
+#include <glog/logging.h>
+
+#ifdef KIMERA_IN_PLACE_SMOOTHER_UPDATE
+
+namespace VIO {
+
+namespace {
+// Marks the frontal keys of the cliques below a marginalized key that have it
+// in their separator, as gtsam::IncrementalFixedLagSmoother does.
+void recursiveMarkAffectedKeys(const gtsam::Key& key,
+                               const gtsam::ISAM2Clique::shared_ptr& clique,
+                               std::unordered_set<gtsam::Key>* marked_keys) {
+  const auto& conditional = clique->conditional();
+  if (std::find(conditional->beginParents(),
+                conditional->endParents(),
+                key) == conditional->endParents()) {
+    // If the key is not in the separator, none of the children have it.
+    return;
+  }
+  for (const gtsam::Key& frontal : conditional->frontals()) {
+    marked_keys->insert(frontal);
+  }
+  for (const gtsam::ISAM2Clique::shared_ptr& child : clique->children) {
+    recursiveMarkAffectedKeys(key, child, marked_keys);
+  }
+}
+}  // namespace
+
+/* -------------------------------------------------------------------------- */
+InPlaceFixedLagSmoother::Result InPlaceFixedLagSmoother::update(
+    const gtsam::NonlinearFactorGraph& new_factors,
+    const gtsam::Values& new_theta,
+    const KeyTimestampMap& timestamps,
+    const gtsam::FactorIndices& factors_to_remove) {
+  return update(new_factors,
+                new_theta,
+                timestamps,
+                factors_to_remove,
+                ExtendedFactors());
+}
+
+/* -------------------------------------------------------------------------- */
+InPlaceFixedLagSmoother::Result InPlaceFixedLagSmoother::update(
+    const gtsam::NonlinearFactorGraph& new_factors,
+    const gtsam::Values& new_theta,
+    const KeyTimestampMap& timestamps,
+    const gtsam::FactorIndices& factors_to_remove,
+    const ExtendedFactors& extended_factors) {
+  // Same steps as gtsam::IncrementalFixedLagSmoother::update, which does not
+  // expose the newAffectedKeys parameter of iSAM2.
+  updateKeyTimestampMap(timestamps);
+
+  // Find the variables to be marginalized out, and force iSAM2 to eliminate
+  // them first.
+  const gtsam::KeyVector marginalizable_keys =
+      findKeysBefore(getCurrentTimestamp() - smootherLag_);
+  boost::optional<gtsam::FastMap<gtsam::Key, int>> constrained_keys =
+      boost::none;
+  createOrderingConstraints(marginalizable_keys, constrained_keys);
+
+  // Mark the keys between the marginalized keys and the leaves.
+  std::unordered_set<gtsam::Key> marked_keys;
+  for (const gtsam::Key& key : marginalizable_keys) {
+    const gtsam::ISAM2Clique::shared_ptr& clique = isam_[key];
+    for (const gtsam::ISAM2Clique::shared_ptr& child : clique->children) {
+      recursiveMarkAffectedKeys(key, child, &marked_keys);
+    }
+  }
+
+  gtsam::ISAM2UpdateParams update_params;
+  update_params.removeFactorIndices = factors_to_remove;
+  update_params.constrainedKeys = constrained_keys;
+  update_params.extraReelimKeys =
+      gtsam::FastList<gtsam::Key>(marked_keys.begin(), marked_keys.end());
+  if (!extended_factors.empty()) {
+    // iSAM2 has no call to replace a factor, but its graph is only exposed
+    // as const: the copy takes the slot of the factor it extends, without
+    // touching the factor itself, which may be shared with other graphs.
+    gtsam::NonlinearFactorGraph& graph =
+        const_cast<gtsam::NonlinearFactorGraph&>(isam_.getFactorsUnsafe());
+    gtsam::FastMap<gtsam::FactorIndex, gtsam::KeySet> new_affected_keys;
+    for (const auto& slot_factor : extended_factors) {
+      const gtsam::FactorIndex& slot = slot_factor.first;
+      const gtsam::NonlinearFactor::shared_ptr& factor = slot_factor.second;
+      CHECK(factor);
+      CHECK(graph.exists(slot)) << "No factor to extend in slot " << slot;
+      DCHECK(std::find(factors_to_remove.begin(),
+                       factors_to_remove.end(),
+                       slot) == factors_to_remove.end())
+          << "Factor in slot " << slot << " is both extended and removed.";
+      const gtsam::KeyVector& old_keys = graph.at(slot)->keys();
+      gtsam::KeySet& new_keys = new_affected_keys[slot];
+      for (const gtsam::Key& key : factor->keys()) {
+        if (std::find(old_keys.begin(), old_keys.end(), key) ==
+            old_keys.end()) {
+          new_keys.insert(key);
+        }
+      }
+      graph.replace(slot, factor);
+    }
+    update_params.newAffectedKeys = new_affected_keys;
+  }
+  isamResult_ = isam_.update(new_factors, new_theta, update_params);
+
+  // Marginalize out the old variables.
+  if (!marginalizable_keys.empty()) {
+    gtsam::FastList<gtsam::Key> leaf_keys(marginalizable_keys.begin(),
+                                          marginalizable_keys.end());
+    isam_.marginalizeLeaves(leaf_keys);
+  }
+  eraseKeyTimestampMap(marginalizable_keys);
+
+  Result result;
+  result.iterations = 1;
+  result.linearVariables = 0;
+  result.nonlinearVariables = 0;
+  result.error = 0;
+  return result;
+}
+
+}  // namespace VIO
+
+#endif
@@ -194,8 +194,10 @@ bool RegularVioBackend::addVisualInertialStateAndOptimize(
   // Get the landmarks visible in current keyframe. (These are not all the lmks
   // in time horizon used for the optimization!)
   LandmarkIds lmks_kf;
-  addStereoMeasurementsToFeatureTracks(
-      curr_kf_id_, smart_stereo_measurements_kf, &lmks_kf);
+  addStereoMeasurementsToFeatureTracks(curr_kf_id_,
+                                       timestamp_kf_nsec,
+                                       smart_stereo_measurements_kf,
+                                       &lmks_kf);
 
   if (VLOG_IS_ON(20)) {
     printFeatureTracks();
@@ -322,10 +324,10 @@ bool RegularVioBackend::addVisualInertialStateAndOptimize(
           if (FLAGS_remove_old_reg_factors) {
             VLOG(10) << "Removing old regularity factors.";
             gtsam::FactorIndices delete_old_regularity_factors;
-            removeOldRegularityFactors_Slow(planes_,
-                                            idx_of_point_plane_factors_to_add,
-                                            &plane_id_to_lmk_id_reg_type_,
-                                            &delete_old_regularity_factors);
+            removeOldRegularityFactors(planes_,
+                                       idx_of_point_plane_factors_to_add,
+                                       &plane_id_to_lmk_id_reg_type_,
+                                       &delete_old_regularity_factors);
             if (delete_old_regularity_factors.size() > 0) {
               delete_slots.insert(delete_slots.end(),
                                   delete_old_regularity_factors.begin(),
@@ -334,7 +336,7 @@ bool RegularVioBackend::addVisualInertialStateAndOptimize(
             VLOG(10) << "Finished removing old regularity factors.";
           }
         } else {
-          // TODO shouldn't we "removeOldRegularityFactors_Slow" because there
+          // TODO shouldn't we "removeOldRegularityFactors" because there
           // are no planes anymore? shouldn't we delete them or something?
           // Not really because the mesher will only add planes, it won't delete
           // an existing plane from planes structure...
@@ -395,7 +397,6 @@ void RegularVioBackend::addLandmarksToGraph(
 
   // Iterate over all landmarks in current key frame.
   for (const LandmarkId& lmk_id : lmks_kf) {
-    CHECK(feature_tracks_.find(lmk_id) != feature_tracks_.end());
     FeatureTrack& feature_track = feature_tracks_.at(lmk_id);
 
     // Only insert feature tracks of length at least 2
@@ -503,8 +504,7 @@ void RegularVioBackend::updateLandmarkInGraph(
     // Lmk is meant to be smart.
     VLOG(20) << "Lmk with id: " << lmk_id << " is set to be smart.\n";
 
-    updateExistingSmartFactor(
-        lmk_id, new_obs, &new_smart_factors_, &old_smart_factors_);
+    VioBackend::updateLandmarkInGraph(lmk_id, new_obs);
   } else {
     VLOG(20) << "Lmk with id: " << lmk_id
              << " is set to be a projection factor.\n";
@@ -551,62 +551,6 @@ void RegularVioBackend::updateLandmarkInGraph(
   }
 }
 
-/* -------------------------------------------------------------------------- */
-void RegularVioBackend::updateExistingSmartFactor(
-    const LandmarkId& lmk_id,
-    const std::pair<FrameId, StereoPoint2>& new_obs,
-    LandmarkIdSmartFactorMap* new_smart_factors,
-    SmartFactorMap* old_smart_factors) {
-  CHECK_NOTNULL(new_smart_factors);
-  CHECK_NOTNULL(old_smart_factors);
-  CHECK_NE(lmk_id, -1) << "When calling update existing smart factor, the slot "
-                          "should already be != -1! \n";
-
-  // Update existing smart-factor.
-  const SmartFactorMap::iterator& old_smart_factors_it =
-      old_smart_factors->find(lmk_id);
-  CHECK(old_smart_factors_it != old_smart_factors->end())
-      << "Landmark with id: " << lmk_id << " not found in old_smart_factors_\n";
-
-  // Get old factor.
-  SmartStereoFactor::shared_ptr old_factor = old_smart_factors_it->second.first;
-  CHECK(old_factor);
-
-  // Clone old factor as a new factor.
-  SmartStereoFactor::shared_ptr new_factor =
-      boost::make_shared<SmartStereoFactor>(*old_factor);
-
-  // Add observation to new factor.
-  VLOG(20) << "Added observation for smart factor of lmk with id: " << lmk_id;
-  new_factor->add(
-      new_obs.second, gtsam::Symbol('x', new_obs.first), stereo_cal_);
-
-  // If slot is still -1, it means that the factor has not been inserted yet
-  // in the graph.
-  CHECK(old_smart_factors_it->second.second != -1)
-      << "When calling update the slot should be already != -1";
-
-  // Slot is different than -1
-  // It means that the factor has already been inserted in the graph.
-  VLOG(20) << "Insert new smart factor to new_smart_factors_ for lmk with"
-           << " id: " << lmk_id;
-
-  ///// Book Keeping, update factors ///////////////////////////////////////////
-  // Update the set of new smart factors.
-  new_smart_factors->insert(std::make_pair(lmk_id, new_factor));
-
-  // TODO Why do we do this??
-  // if we don't the 3d points seem to be off.
-  // is there a way to viz 3d points?
-  // BUT then we are not pointing to the factor in the graph anymore, and a
-  // check such as old_smart_factor_it->second.first ==
-  //                graph.at[old_smart_factor_it->second.second
-  // will fail!
-  old_smart_factors_it->second.first = new_factor;
-
-  //////////////////////////////////////////////////////////////////////////////
-}
-
 /* -------------------------------------------------------------------------- */
 // Converts a smart factor to a set of projection factors.
 // Returns whether the conversion was possible or not.
@@ -689,7 +633,9 @@ bool RegularVioBackend::convertSmartToProjectionFactor(
           old_smart_factors_it->second.second);
       // Check that we are not actually updating the smart factor.
       // Otherwise we would have an sporadic smart factor.
-      CHECK(new_smart_factors->find(lmk_id) == new_smart_factors->end())
+      CHECK(new_smart_factors->find(lmk_id) == new_smart_factors->end() &&
+            new_smart_factor_measurements_.find(lmk_id) ==
+                new_smart_factor_measurements_.end())
           << "Someone is updating the smart factor while it should be a "
              "projection factor...";
       // NOTE If the slot is -1, so the smart factor is not in the graph yet,
@@ -734,19 +680,12 @@ void RegularVioBackend::convertExtraSmartFactorToProjFactor(
             << "We found a smart factor that should be in a regularity for "
                "lmk with id: "
             << lmk_id;
-        // We do FLAGS_min_num_obs_for_proj_factor + 1,
-        // because we have to substract the fact that in this iteration we added
-        // an extra measurement to the factor. This is to be consistent with the
-        // check of isSmartFactor3dPointGood when deciding if the 3d point is
-        // valid for changing from smart to projection factor. Well this is only
-        // true if lmk_id is in the set of lmks observed now... But if it is
-        // not, then there is no new observation... Check nwe_smart_factors_ to
-        // see if there is indeed a new observation or not.
-        if (isSmartFactor3dPointGood(
-                old_smart_factors_.at(lmk_id).first,
-                (new_smart_factors_.find(lmk_id) != new_smart_factors_.end())
-                    ? FLAGS_min_num_obs_for_proj_factor + 1
-                    : FLAGS_min_num_obs_for_proj_factor)) {
+        // New measurements of smart factors are only appended to the factor
+        // in the graph at the next update, so the factor holds the same
+        // measurements as when deciding if the 3d point is valid for changing
+        // from smart to projection factor.
+        if (isSmartFactor3dPointGood(old_smart_factors_.at(lmk_id).first,
+                                     FLAGS_min_num_obs_for_proj_factor)) {
           VLOG(20) << "Converting extra smart factor to proj factor for lmk"
                       " with id: "
                    << lmk_id << ", since 3d point is good enough";
@@ -807,6 +746,72 @@ void RegularVioBackend::deleteLmkFromExtraStructures(const LandmarkId& lmk_id) {
       plane_id_to_map.second.erase(lmk_id);
     }
   }
+  for (auto& plane_id_to_slots : plane_id_to_point_plane_slots_) {
+    plane_id_to_slots.second.erase(lmk_id);
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+void RegularVioBackend::recordNewFactorSlot(const NewFactorManifestEntry& entry,
+                                            const VIO::Slot& slot) {
+  VioBackend::recordNewFactorSlot(entry, slot);
+  FactorSlot factor_slot;
+  factor_slot.slot_ = slot;
+  factor_slot.factor_ = entry.factor_;
+  switch (entry.role_) {
+    case FactorRole::kPointPlane: {
+      const auto& ppf =
+          boost::dynamic_pointer_cast<gtsam::PointPlaneFactor>(entry.factor_);
+      CHECK(ppf);
+      plane_id_to_point_plane_slots_[ppf->getPlaneKey()][entry.lmk_id_] =
+          factor_slot;
+      break;
+    }
+    case FactorRole::kPlanePrior: {
+      CHECK_EQ(entry.factor_->size(), 1u);
+      plane_id_to_prior_slot_[entry.factor_->front()] = factor_slot;
+      break;
+    }
+    default: {
+      break;
+    }
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+void RegularVioBackend::pruneFactorSlots(
+    const gtsam::NonlinearFactorGraph& graph) {
+  VioBackend::pruneFactorSlots(graph);
+  // Regularity factors we delete are dropped from the maps right away, so a
+  // point-plane factor that is not in the graph anymore was marginalized,
+  // leaving a linear container factor on its plane.
+  for (auto plane_it = plane_id_to_point_plane_slots_.begin();
+       plane_it != plane_id_to_point_plane_slots_.end();) {
+    LmkIdToFactorSlotMap& lmk_id_to_factor_slot = plane_it->second;
+    for (auto it = lmk_id_to_factor_slot.begin();
+         it != lmk_id_to_factor_slot.end();) {
+      if (it->second.isValid(graph)) {
+        ++it;
+      } else {
+        planes_with_linear_factor_.insert(plane_it->first);
+        it = lmk_id_to_factor_slot.erase(it);
+      }
+    }
+    if (lmk_id_to_factor_slot.empty()) {
+      plane_it = plane_id_to_point_plane_slots_.erase(plane_it);
+    } else {
+      ++plane_it;
+    }
+  }
+  // A plane prior only leaves the graph with its plane.
+  for (auto it = plane_id_to_prior_slot_.begin();
+       it != plane_id_to_prior_slot_.end();) {
+    if (it->second.isValid(graph)) {
+      ++it;
+    } else {
+      it = plane_id_to_prior_slot_.erase(it);
+    }
+  }
 }
 
 /* -------------------------------------------------------------------------- */
@@ -830,6 +835,9 @@ void RegularVioBackend::addProjectionFactor(
                 true,
                 true,
                 B_Pose_leftCam_));
+        registerNewFactor(new_imu_prior_and_other_factors->back(),
+                          FactorRole::kProjection,
+                          lmk_id);
       } else {
         LOG(ERROR) << "Parallax for lmk_id: " << lmk_id << " is = " << parallax;
       }
@@ -849,6 +857,9 @@ void RegularVioBackend::addProjectionFactor(
             true,
             true,
             B_Pose_leftCam_));
+    registerNewFactor(new_imu_prior_and_other_factors->back(),
+                      FactorRole::kProjection,
+                      lmk_id);
   }
 }
 
@@ -1056,6 +1067,9 @@ void RegularVioBackend::addRegularityFactors(
                     gtsam::Symbol('l', lmk_id),
                     plane_key,
                     point_plane_regularity_noise_));
+            registerNewFactor(new_imu_prior_and_other_factors_.back(),
+                              FactorRole::kPointPlane,
+                              lmk_id);
             // Acknowledge that this lmk has been used in a regularity.
             (*lmk_id_to_regularity_type_map)[lmk_id] =
                 RegularityType::POINT_PLANE;
@@ -1109,6 +1123,9 @@ void RegularVioBackend::addRegularityFactors(
                       gtsam::Symbol('l', prev_lmk_id),
                       plane_key,
                       point_plane_regularity_noise_));
+              registerNewFactor(new_imu_prior_and_other_factors_.back(),
+                                FactorRole::kPointPlane,
+                                prev_lmk_id);
               // Acknowledge that this lmk has been used in a regularity.
               (*lmk_id_to_regularity_type_map)[prev_lmk_id] =
                   RegularityType::POINT_PLANE;
@@ -1189,6 +1206,9 @@ void RegularVioBackend::addRegularityFactors(
                   gtsam::Symbol('l', lmk_id),
                   plane_key,
                   point_plane_regularity_noise_));
+          registerNewFactor(new_imu_prior_and_other_factors_.back(),
+                            FactorRole::kPointPlane,
+                            lmk_id);
           // Acknowledge that this lmk has been used in a regularity.
           (*lmk_id_to_regularity_type_map)[lmk_id] =
               RegularityType::POINT_PLANE;
@@ -1217,7 +1237,7 @@ void RegularVioBackend::addRegularityFactors(
 }
 
 /* -------------------------------------------------------------------------- */
-void RegularVioBackend::removeOldRegularityFactors_Slow(
+void RegularVioBackend::removeOldRegularityFactors(
     const std::vector<Plane>& planes,
     const std::map<PlaneId, std::vector<std::pair<Slot, LandmarkId>>>&
         map_idx_of_point_plane_factors_to_add,
@@ -1227,13 +1247,6 @@ void RegularVioBackend::removeOldRegularityFactors_Slow(
   CHECK_NOTNULL(delete_slots);
 
   std::vector<size_t> plane_idx_to_clean;
-  std::map<size_t, std::vector<std::pair<Slot, LandmarkId>>>
-      plane_id_to_factor_slots_bad;
-  std::map<size_t, std::vector<std::pair<Slot, LandmarkId>>>
-      plane_id_to_factor_slots_good;
-  std::map<size_t, bool> has_plane_a_prior_map;
-  std::map<size_t, bool> has_plane_a_linear_factor_map;
-  std::map<size_t, Slot> plane_prior_slot_map;
   size_t i = 0;
   for (const Plane& plane : planes) {
     const gtsam::Symbol& plane_symbol = plane.getPlaneSymbol();
@@ -1264,104 +1277,75 @@ void RegularVioBackend::removeOldRegularityFactors_Slow(
     }
 
     plane_idx_to_clean.push_back(i);
-    // Init data structures empty, by using [] instead of .at().
-    plane_id_to_factor_slots_bad[i];
-    plane_id_to_factor_slots_good[i];
-    has_plane_a_prior_map[i] = false;
-    has_plane_a_linear_factor_map[i] = false;
-    plane_prior_slot_map[i] = 0;  // Set as invalid slot.
-
     i++;
   }
 
-  VLOG(10) << "Starting removeOldRegularityFactors_Slow...";
+  VLOG(10) << "Starting removeOldRegularityFactors...";
 
   // If the plane exists in the state_ and not in new_values_,
   // then let us remove old regularity factors.
+  // The slots of the regularity factors of each plane were recorded when the
+  // factors were added, and are pruned after each update.
   const gtsam::NonlinearFactorGraph& graph = smoother_->getFactors();
-  Slot slot = 0;
-  // Loop over current graph.
-  for (const auto& g : graph) {
-    if (g) {
-      const auto& ppf = boost::dynamic_pointer_cast<gtsam::PointPlaneFactor>(g);
-      const auto& plane_prior = boost::dynamic_pointer_cast<
-          gtsam::PriorFactor<gtsam::OrientedPlane3>>(g);
-      const auto& lcf =
-          boost::dynamic_pointer_cast<gtsam::LinearContainerFactor>(g);
-      if (ppf) {
-        // We found a PointPlaneFactor.
-        for (const size_t& plane_id : plane_idx_to_clean) {
-          const gtsam::Symbol& plane_symbol =
-              planes.at(plane_id).getPlaneSymbol().key();
-          if (plane_symbol == ppf->getPlaneKey()) {
-            // We found the plane involved in current PointPlaneFactor.
-            const LandmarkId& lmk_id =
-                gtsam::Symbol(ppf->getPointKey()).index();
-            const LandmarkIds& plane_lmk_ids = planes.at(plane_id).lmk_ids_;
-            // Try to find this lmk id in the set of lmks of the plane.
-            if (std::find(plane_lmk_ids.begin(), plane_lmk_ids.end(), lmk_id) ==
-                plane_lmk_ids.end()) {
-              // We did not find the point in plane's lmks, therefore it should
-              // not be involved in a regularity anymore, delete this slot.
-              // (but I want to remove the landmark! and all its factors,
-              // to avoid having underconstrained lmks...)
-              VLOG(20) << "Found bad point plane factor on lmk with id: "
-                       << lmk_id;
-              plane_id_to_factor_slots_bad.at(plane_id).push_back(
-                  std::make_pair(slot, lmk_id));
-
-              // Before deleting this slot, we must ensure that both the plane
-              // and the landmark are well constrained!
-            } else {
-              // Store those factors that we will potentially keep.
-              plane_id_to_factor_slots_good.at(plane_id).push_back(
-                  std::make_pair(slot, lmk_id));
-            }
-          }
-        }
-      } else if (plane_prior) {
-        for (const size_t& plane_idx : plane_idx_to_clean) {
-          const gtsam::Symbol& plane_symbol =
-              planes.at(plane_idx).getPlaneSymbol().key();
-          if (plane_prior->find(plane_symbol) != plane_prior->end()) {
-            LOG(WARNING) << "Found plane prior for plane: "
-                         << gtsam::DefaultKeyFormatter(plane_symbol.key());
-            // Store slot of plane_prior, since we might have to delete it
-            // if the plane has no constraints.
-            plane_prior_slot_map.at(plane_idx) = slot;
-            has_plane_a_prior_map.at(plane_idx) = true;
-          }
-        }
-      } else if (lcf) {
-        for (const size_t& plane_idx : plane_idx_to_clean) {
-          const gtsam::Symbol& plane_symbol =
-              planes.at(plane_idx).getPlaneSymbol().key();
-          if (lcf->find(plane_symbol.key()) != lcf->end()) {
-            VLOG(10) << "Found linear container factor for plane: "
-                     << gtsam::DefaultKeyFormatter(plane_symbol.key());
-            has_plane_a_linear_factor_map.at(plane_idx) = true;
-          }
-        }
-      }
-    }
-
-    // Next slot.
-    slot++;
-  }
 
   // Decide whether we can just delete the bad point plane factors,
   // or whether we need to delete all the factors involving the plane
   // so that it is removed.
   // For this we need to check if the plane is fully constrained!
   for (const size_t& plane_idx : plane_idx_to_clean) {
-    const gtsam::Symbol& plane_symbol =
-        planes.at(plane_idx).getPlaneSymbol().key();
-    const std::vector<std::pair<Slot, LandmarkId>>&
-        point_plane_factor_slots_bad =
-            plane_id_to_factor_slots_bad.at(plane_idx);
-    const std::vector<std::pair<Slot, LandmarkId>>&
-        point_plane_factor_slots_good =
-            plane_id_to_factor_slots_good.at(plane_idx);
+    const Plane& plane = planes.at(plane_idx);
+    const gtsam::Symbol& plane_symbol = plane.getPlaneSymbol().key();
+    std::vector<std::pair<Slot, LandmarkId>> point_plane_factor_slots_bad;
+    std::vector<std::pair<Slot, LandmarkId>> point_plane_factor_slots_good;
+    const auto& point_plane_slots_it =
+        plane_id_to_point_plane_slots_.find(plane_symbol.key());
+    if (point_plane_slots_it != plane_id_to_point_plane_slots_.end()) {
+      for (const LmkIdToFactorSlotMap::value_type& lmk_id_to_factor_slot :
+           point_plane_slots_it->second) {
+        const LandmarkId& lmk_id = lmk_id_to_factor_slot.first;
+        const FactorSlot& factor_slot = lmk_id_to_factor_slot.second;
+        DCHECK(factor_slot.isValid(graph))
+            << "Stale point plane factor slot for lmk with id: " << lmk_id;
+        const LandmarkIds& plane_lmk_ids = plane.lmk_ids_;
+        // Try to find this lmk id in the set of lmks of the plane.
+        if (std::find(plane_lmk_ids.begin(), plane_lmk_ids.end(), lmk_id) ==
+            plane_lmk_ids.end()) {
+          // We did not find the point in plane's lmks, therefore it should
+          // not be involved in a regularity anymore, delete this slot.
+          // (but I want to remove the landmark! and all its factors,
+          // to avoid having underconstrained lmks...)
+          VLOG(20) << "Found bad point plane factor on lmk with id: "
+                   << lmk_id;
+          point_plane_factor_slots_bad.push_back(
+              std::make_pair(factor_slot.slot_, lmk_id));
+
+          // Before deleting this slot, we must ensure that both the plane
+          // and the landmark are well constrained!
+        } else {
+          // Store those factors that we will potentially keep.
+          point_plane_factor_slots_good.push_back(
+              std::make_pair(factor_slot.slot_, lmk_id));
+        }
+      }
+    }
+    const auto& prior_slot_it = plane_id_to_prior_slot_.find(plane_symbol.key());
+    const bool has_plane_a_prior =
+        prior_slot_it != plane_id_to_prior_slot_.end() &&
+        prior_slot_it->second.isValid(graph);
+    if (has_plane_a_prior) {
+      LOG(WARNING) << "Found plane prior for plane: "
+                   << gtsam::DefaultKeyFormatter(plane_symbol.key());
+    }
+    const bool has_plane_a_linear_factor =
+        planes_with_linear_factor_.find(plane_symbol.key()) !=
+        planes_with_linear_factor_.end();
+    if (has_plane_a_linear_factor) {
+      VLOG(10) << "Found linear container factor for plane: "
+               << gtsam::DefaultKeyFormatter(plane_symbol.key());
+    }
+    // Set as invalid slot if there is no prior.
+    const Slot plane_prior_slot =
+        has_plane_a_prior ? prior_slot_it->second.slot_ : 0;
     DCHECK(map_idx_of_point_plane_factors_to_add.find(plane_symbol.key()) !=
            map_idx_of_point_plane_factors_to_add.end());
     const std::vector<std::pair<Slot, LandmarkId>>&
@@ -1371,10 +1355,6 @@ void RegularVioBackend::removeOldRegularityFactors_Slow(
            plane_id_to_lmk_id_to_reg_type_map->end());
     LmkIdToRegularityTypeMap& lmk_id_to_regularity_type_map =
         (*plane_id_to_lmk_id_to_reg_type_map).at(plane_symbol.key());
-    const bool& has_plane_a_prior = has_plane_a_prior_map.at(plane_idx);
-    const bool& has_plane_a_linear_factor =
-        has_plane_a_linear_factor_map.at(plane_idx);
-    const size_t& plane_prior_slot = plane_prior_slot_map.at(plane_idx);
     /// If there are enough new constraints to be added then delete only
     /// delete_slots else, if there are enough constraints left, only delete
     /// delete_slots otherwise delete ALL constraints, both old and new, so that
@@ -1402,7 +1382,8 @@ void RegularVioBackend::removeOldRegularityFactors_Slow(
       // We can just delete bad factors, assuming lmks will be well constrained.
       // TODO ensure the lmks are themselves well constrained.
       VLOG(10) << "Plane is fully constrained, removing only bad factors.";
-      fillDeleteSlots(point_plane_factor_slots_bad,
+      fillDeleteSlots(plane_symbol.key(),
+                      point_plane_factor_slots_bad,
                       &lmk_id_to_regularity_type_map,
                       delete_slots);
     } else {
@@ -1429,6 +1410,7 @@ void RegularVioBackend::removeOldRegularityFactors_Slow(
                 << "Plane has no constraints at all, deleting prior as well.";
             CHECK_NE(plane_prior_slot, 0);
             delete_slots->push_back(plane_prior_slot);
+            plane_id_to_prior_slot_.erase(plane_symbol.key());
           }
         } else {
           // This is just a patch...
@@ -1440,7 +1422,8 @@ void RegularVioBackend::removeOldRegularityFactors_Slow(
             // that won't make the optimizer try to delete the plane variable,
             // which at the current time breaks gtsam.
             VLOG(10) << "Delete bad factors attached to plane.";
-            fillDeleteSlots(point_plane_factor_slots_bad,
+            fillDeleteSlots(plane_symbol.key(),
+                            point_plane_factor_slots_bad,
                             &lmk_id_to_regularity_type_map,
                             delete_slots);
           } else {
@@ -1458,10 +1441,12 @@ void RegularVioBackend::removeOldRegularityFactors_Slow(
           LOG(ERROR) << "Plane has no prior, trying to forcefully"
                         " remove the PLANE!";
           debug_smoother_ = true;
-          fillDeleteSlots(point_plane_factor_slots_bad,
+          fillDeleteSlots(plane_symbol.key(),
+                          point_plane_factor_slots_bad,
                           &lmk_id_to_regularity_type_map,
                           delete_slots);
-          fillDeleteSlots(point_plane_factor_slots_good,
+          fillDeleteSlots(plane_symbol.key(),
+                          point_plane_factor_slots_good,
                           &lmk_id_to_regularity_type_map,
                           delete_slots);
 
@@ -1491,6 +1476,8 @@ void RegularVioBackend::removeOldRegularityFactors_Slow(
           new_imu_prior_and_other_factors_.push_back(
               boost::make_shared<gtsam::PriorFactor<gtsam::OrientedPlane3>>(
                   plane_symbol.key(), plane_estimate, prior_noise));
+          registerNewFactor(new_imu_prior_and_other_factors_.back(),
+                            FactorRole::kPlanePrior);
 
           // Delete just the bad factors.
           // TODO Remove: this is just a patch to avoid issue 32:
@@ -1501,7 +1488,8 @@ void RegularVioBackend::removeOldRegularityFactors_Slow(
             // that won't make the optimizer try to delete the plane variable,
             // which at the current time breaks gtsam.
             VLOG(10) << "Delete bad factors attached to plane.";
-            fillDeleteSlots(point_plane_factor_slots_bad,
+            fillDeleteSlots(plane_symbol.key(),
+                            point_plane_factor_slots_bad,
                             &lmk_id_to_regularity_type_map,
                             delete_slots);
           } else {
@@ -1547,6 +1535,7 @@ void RegularVioBackend::removeOldRegularityFactors_Slow(
 
 /* -------------------------------------------------------------------------- */
 void RegularVioBackend::fillDeleteSlots(
+    const PlaneId& plane_key,
     const std::vector<std::pair<Slot, LandmarkId>>&
         point_plane_factor_slots_bad,
     LmkIdToRegularityTypeMap* lmk_id_to_regularity_type_map,
@@ -1578,6 +1567,7 @@ void RegularVioBackend::fillDeleteSlots(
       VLOG(20) << "Deleting lmk_id " << lmk_id
                << " from lmk_id_to_regularity_type_map_";
       lmk_id_to_regularity_type_map->erase(lmk_id);
+      plane_id_to_point_plane_slots_[plane_key].erase(lmk_id);
     }
   } else {
     VLOG(10) << "There are no bad factors to remove.";
@@ -1748,6 +1738,9 @@ void RegularVioBackend::updatePlaneEstimates(std::vector<Plane>* planes) {
       if (plane_id_to_lmk_id_reg_type_.find(plane_key) !=
           plane_id_to_lmk_id_reg_type_.end()) {
         plane_id_to_lmk_id_reg_type_.erase(plane_key);
+        plane_id_to_point_plane_slots_.erase(plane_key);
+        plane_id_to_prior_slot_.erase(plane_key);
+        planes_with_linear_factor_.erase(plane_key);
       } else {
         LOG(WARNING) << "Plane " << gtsam::DefaultKeyFormatter(plane_key) << " "
                      << "not found in plane_id_to_lmk_id_reg_type_, this should"
@@ -29,17 +29,23 @@
 
 #include "kimera-vio/backend/VioBackend.h"
 
+#include <algorithm>
 #include <limits>  // for numeric_limits<>
 #include <map>
+#include <numeric>
 #include <string>
+#include <unordered_set>
 #include <utility>  // for make_pair
 #include <vector>
 
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 
+#include <opencv2/core/utility.hpp>
+
 #include "kimera-vio/common/VioNavState.h"
 #include "kimera-vio/imu-frontend/ImuFrontend-definitions.h"  // for safeCast
+#include "kimera-vio/initial/InitializationBackend.h"
 #include "kimera-vio/logging/Logger.h"
 #include "kimera-vio/utils/Statistics.h"
 #include "kimera-vio/utils/Timer.h"
@@ -58,6 +64,17 @@ DEFINE_int32(max_number_of_cheirality_exceptions,
              "Sets the maximum number of times we process a cheirality "
              "exception for a given optimization problem. This is to avoid too "
              "many recursive calls to update the smoother");
+DEFINE_bool(screen_cheirality_before_update,
+            false,
+            "Opt-in: triangulate all new and updated smart factors before each "
+            "smoother update, and remove the landmarks that are behind a "
+            "camera, instead of relying on cheirality exceptions during the "
+            "update. Costs one extra triangulation per new or updated smart "
+            "factor per update.");
+DEFINE_int32(fast_start_alignment_keyframes,
+             10,
+             "Number of keyframes used by the background visual-inertial "
+             "alignment of the fast-start initialization (autoInitialize: 2).");
 DEFINE_bool(compute_state_covariance,
             false,
             "Flag to compute state covariance from optimization Backend");
@@ -110,7 +127,7 @@ VioBackend::VioBackend(const Pose3& B_Pose_leftCam,
   lmParams.setlambdaInitial(0.0);     // same as GN
   lmParams.setlambdaLowerBound(0.0);  // same as GN
   lmParams.setlambdaUpperBound(0.0);  // same as GN)
-  smoother_ = VIO::make_unique<Smoother>(vioParams.horizon_, lmParams);
+  smoother_ = VIO::make_unique<Smoother>(backend_params.horizon_, lmParams);
 #endif
 
   // Set parameters for all factors.
@@ -150,6 +167,11 @@ BackendOutput::UniquePtr VioBackend::spinOnce(const BackendInput& input) {
     }
   }
 
+  if (backend_status && backend_params_.autoInitialize_ == 2 &&
+      !is_fast_start_done_) {
+    spinFastStartAlignment(input);
+  }
+
   // Fill ouput_payload (it will remain nullptr if the backend_status is not ok)
   BackendOutput::UniquePtr output_payload = nullptr;
   if (backend_status) {
@@ -232,6 +254,8 @@ bool VioBackend::initStateAndSetPriors(
   W_Vel_B_lkf_ = vio_nav_state_initial_seed.velocity_;
   imu_bias_lkf_ = vio_nav_state_initial_seed.imu_bias_;
   imu_bias_prev_kf_ = vio_nav_state_initial_seed.imu_bias_;
+  keyframes_in_horizon_.clear();
+  updateKeyframesInHorizon(curr_kf_id_, timestamp_lkf_);
 
   VLOG(2) << "Initial state seed: \n"
           << " - Initial timestamp: " << timestamp_lkf_ << '\n'
@@ -308,8 +332,10 @@ bool VioBackend::addVisualInertialStateAndOptimize(
 
   // extract relevant information from stereo frame
   LandmarkIds landmarks_kf;
-  addStereoMeasurementsToFeatureTracks(
-      curr_kf_id_, smart_stereo_measurements_kf, &landmarks_kf);
+  addStereoMeasurementsToFeatureTracks(curr_kf_id_,
+                                       timestamp_kf_nsec,
+                                       smart_stereo_measurements_kf,
+                                       &landmarks_kf);
 
   if (VLOG_IS_ON(10)) {
     printFeatureTracks();
@@ -448,34 +474,85 @@ void VioBackend::addLandmarkToGraph(const LandmarkId& lmk_id,
 void VioBackend::updateLandmarkInGraph(
     const LandmarkId& lmk_id,
     const std::pair<FrameId, StereoPoint2>& new_measurement) {
-  // Update existing smart-factor
-  auto old_smart_factors_it = old_smart_factors_.find(lmk_id);
+  const auto& old_smart_factors_it = old_smart_factors_.find(lmk_id);
   CHECK(old_smart_factors_it != old_smart_factors_.end())
       << "Landmark not found in old_smart_factors_ with id: " << lmk_id;
+  // If it's slot in the graph is still -1, it means that the factor has not
+  // been inserted yet in the graph...
+  CHECK_NE(old_smart_factors_it->second.second, -1)
+      << "When updating the smart factor, its slot should not be -1!"
+         " Offensive lmk_id: "
+      << lmk_id;
+
+  // The measurement is appended in place to the smart factor in the graph at
+  // the next update, see appendNewSmartFactorMeasurements.
+  new_smart_factor_measurements_[lmk_id].push_back(new_measurement);
+  VLOG(10) << "updateLandmarkInGraph: added observation to point: " << lmk_id;
+}
 
-  const SmartStereoFactor::shared_ptr& old_factor =
-      old_smart_factors_it->second.first;
-  // Clone old factor to keep all previous measurements, now append one.
-  SmartStereoFactor::shared_ptr new_factor =
-      boost::make_shared<SmartStereoFactor>(*old_factor);
+/* -------------------------------------------------------------------------- */
+void VioBackend::appendNewSmartFactorMeasurements(
+    const gtsam::FactorIndices& delete_slots,
+    LandmarkIdSmartFactorMap* updated_smart_factors,
+    ExtendedFactors* extended_factors) {
+  CHECK_NOTNULL(updated_smart_factors);
+  CHECK_NOTNULL(extended_factors);
+  const gtsam::NonlinearFactorGraph& graph = smoother_->getFactors();
+  for (const auto& lmk_id_measurements : new_smart_factor_measurements_) {
+    const LandmarkId& lmk_id = lmk_id_measurements.first;
+    const auto& old_smart_factors_it = old_smart_factors_.find(lmk_id);
+    if (old_smart_factors_it == old_smart_factors_.end()) {
+      // The landmark was removed (or converted) since it got the measurement.
+      VLOG(10) << "Dropping new measurements of removed lmk: " << lmk_id;
+      continue;
+    }
 
-  const gtsam::Symbol pose_symbol(kPoseSymbolChar, new_measurement.first);
-  const StereoPoint2& measurement = new_measurement.second;
-  new_factor->add(measurement, pose_symbol, stereo_cal_);
+    const Slot& slot = old_smart_factors_it->second.second;
+    DCHECK_GE(slot, 0);
+    if (!graph.exists(slot)) {
+      // This should not happen, unless feature tracks are so long (longer
+      // than factor graph's time horizon), than the factor has been removed
+      // from the optimization.
+      // Erase this factor and feature track, as it has gone past the horizon.
+      old_smart_factors_.erase(old_smart_factors_it);
+      CHECK(deleteLmkFromFeatureTracks(lmk_id));
+      continue;
+    }
+    if (std::find(delete_slots.begin(), delete_slots.end(), slot) !=
+        delete_slots.end()) {
+      // The factor is being removed, iSAM2 cannot take its new keys as well.
+      continue;
+    }
 
-  // Update the factor
-  Slot slot = old_smart_factors_it->second.second;
-  if (slot != -1) {
+    const SmartStereoFactor::shared_ptr& factor =
+        old_smart_factors_it->second.first;
+    CHECK(factor);
+    DCHECK(graph.at(slot).get() == factor.get())
+        << "Smart factor of lmk " << lmk_id << " is not the one in the graph.";
+    // The factor in the graph is shared with the graphs of previous Backend
+    // outputs and with the smoother backup in updateSmoother: add the new
+    // measurements to a copy instead.
+    SmartStereoFactor::shared_ptr new_factor =
+        boost::make_shared<SmartStereoFactor>(*factor);
+    for (const std::pair<FrameId, StereoPoint2>& obs :
+         lmk_id_measurements.second) {
+      new_factor->add(obs.second,
+                      gtsam::Symbol(kPoseSymbolChar, obs.first),
+                      stereo_cal_);
+    }
+    old_smart_factors_it->second.first = new_factor;
+#if defined(INCREMENTAL_SMOOTHER) && defined(KIMERA_IN_PLACE_SMOOTHER_UPDATE)
+    // The copy takes the slot of the factor in the smoother.
+    (*extended_factors)[slot] = new_factor;
+    updated_smart_factors->insert(std::make_pair(lmk_id, new_factor));
+#else
+    // The smoother cannot take new keys for a factor in its graph: remove the
+    // factor and add the copy instead, see how new_smart_factors_ are added
+    // in optimize.
     new_smart_factors_.insert(std::make_pair(lmk_id, new_factor));
-  } else {
-    // If it's slot in the graph is still -1, it means that the factor has not
-    // been inserted yet in the graph...
-    LOG(FATAL) << "When updating the smart factor, its slot should not be -1!"
-                  " Offensive lmk_id: "
-               << lmk_id;
+#endif
   }
-  old_smart_factors_it->second.first = new_factor;
-  VLOG(10) << "updateLandmarkInGraph: added observation to point: " << lmk_id;
+  new_smart_factor_measurements_.clear();
 }
 
 /* -------------------------------------------------------------------------- */
@@ -665,11 +742,19 @@ void VioBackend::computeStateCovariance() {
 // class...
 void VioBackend::addStereoMeasurementsToFeatureTracks(
     const int& frame_num,
+    const Timestamp& timestamp_kf_nsec,
     const StereoMeasurements& stereo_meas_kf,
     LandmarkIds* landmarks_kf) {
   CHECK_NOTNULL(landmarks_kf);
 
-  // TODO: feature tracks will grow unbounded.
+  // Observations from keyframes that left the time horizon are dropped, so
+  // that feature tracks do not grow unbounded. Not while initializing: no
+  // track is in the graph yet, and the initialization bundle adjustment
+  // needs all observations, even if its window is longer than the horizon.
+  updateKeyframesInHorizon(frame_num, timestamp_kf_nsec);
+  const bool is_initializing = backend_state_ == BackendState::Bootstrap;
+  const FrameId oldest_kf_id =
+      is_initializing ? 0u : keyframes_in_horizon_.front().first;
 
   // Make sure the landmarks_kf vector is empty and has a suitable size.
   const size_t& n_stereo_measurements = stereo_meas_kf.size();
@@ -693,38 +778,45 @@ void VioBackend::addStereoMeasurementsToFeatureTracks(
                      lmk_id_in_kf_i) == landmarks_kf->end());
     (*landmarks_kf)[i] = lmk_id_in_kf_i;
 
-    // Add features to vio->featureTracks_ if they are new.
-    const FeatureTracks::iterator& feature_track_it =
-        feature_tracks_.find(lmk_id_in_kf_i);
-    if (feature_track_it == feature_tracks_.end()) {
-      // New feature.
-      VLOG(20) << "Creating new feature track for lmk: " << lmk_id_in_kf_i
+    // Add features to vio->featureTracks_ if they are new, otherwise add the
+    // observation to the existing landmark.
+    // @TODO: It seems that adding observations to existing tracks does not
+    // help -- conjecture that it creates long feature tracks with low
+    // information (i.e. we're not moving)
+    // This is problematic in conjunction with our landmark selection
+    // mechanism which prioritizes long feature tracks
+    if (feature_tracks_.addObservation(
+            lmk_id_in_kf_i, frame_num, stereo_px_i, oldest_kf_id)) {
+      VLOG(20) << "Created new feature track for lmk: " << lmk_id_in_kf_i
                << '.';
-      feature_tracks_.insert(
-          std::make_pair(lmk_id_in_kf_i, FeatureTrack(frame_num, stereo_px_i)));
       ++landmark_count_;
     } else {
-      // @TODO: It seems that this else condition does not help --
-      // conjecture that it creates long feature tracks with low information
-      // (i.e. we're not moving)
-      // This is problematic in conjunction with our landmark selection
-      // mechanism which prioritizes long feature tracks
-
-      // TODO: to avoid making the feature tracks grow unbounded we could
-      // use a tmp feature tracks container to which we would add the old
-      // feature track plus the new observation on it. (for new tracks, it
-      // would be the same as above, using the tmp structure of course).
-
-      // Add observation to existing landmark.
-      VLOG(20) << "Updating feature track for lmk: " << lmk_id_in_kf_i << ".";
-      feature_track_it->second.obs_.push_back(
-          std::make_pair(frame_num, stereo_px_i));
-
-      // TODO(Toni):
-      // Mark feature tracks that have been re-observed, so that we can delete
-      // the broken feature tracks efficiently.
+      VLOG(20) << "Updated feature track for lmk: " << lmk_id_in_kf_i << ".";
     }
   }
+
+  // Tracks not in the graph that were not re-observed in the time horizon
+  // are broken: free their slots for new tracks.
+  if (!is_initializing) {
+    const size_t nr_recycled_tracks =
+        feature_tracks_.recycleStaleTracks(oldest_kf_id);
+    VLOG(10) << "Recycled " << nr_recycled_tracks << " feature tracks, "
+             << feature_tracks_.size() << " feature tracks in "
+             << feature_tracks_.capacity() << " slots.";
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+void VioBackend::updateKeyframesInHorizon(const FrameId& kf_id,
+                                          const Timestamp& timestamp_kf_nsec) {
+  keyframes_in_horizon_.emplace_back(kf_id, timestamp_kf_nsec);
+  // Same criterion as the smoother: keys older than the horizon are
+  // marginalized.
+  const Timestamp horizon_start_nsec =
+      timestamp_kf_nsec - UtilsNumerical::SecToNsec(backend_params_.horizon_);
+  while (keyframes_in_horizon_.front().second < horizon_start_nsec) {
+    keyframes_in_horizon_.pop_front();
+  }
 }
 
 /// Value adders.
@@ -889,13 +981,56 @@ bool VioBackend::optimize(
   // vio).
   gtsam::FactorIndices delete_slots = extra_factor_slots_to_delete;
 
+  // Smart factors already in the graph that got new measurements are replaced
+  // by copies with the new measurements, which keep their slot: iSAM2 is told
+  // about their new keys, instead of removing the factor and adding the copy.
+  LandmarkIdSmartFactorMap updated_smart_factors;
+  ExtendedFactors extended_factors;
+  appendNewSmartFactorMeasurements(
+      delete_slots, &updated_smart_factors, &extended_factors);
+
   // TODO we know the actual end size... but I am not sure how to use factor
   // graph API for appending factors without copying or re-allocation...
-  std::vector<LandmarkId> lmk_ids_of_new_smart_factors_tmp;
-  lmk_ids_of_new_smart_factors_tmp.reserve(new_smart_factors_size);
   gtsam::NonlinearFactorGraph new_factors_tmp;
   new_factors_tmp.reserve(new_smart_factors_size +
                           new_imu_prior_and_other_factors_.size());
+
+  // Screen all new smart factors at once for landmarks behind a camera, so
+  // that they are removed before the update rather than one by one through
+  // cheirality exceptions. This is an extra triangulation of every new smart
+  // factor: iSAM2 linearizes new factors at its linearization point, and the
+  // new values for new keys, so triangulating at those same poses lets the
+  // update reuse the triangulation cached in each factor.
+  std::unordered_set<LandmarkId> lmks_behind_camera;
+  std::unordered_set<LandmarkId> updated_lmks_behind_camera;
+  if (FLAGS_screen_cheirality_before_update &&
+      (!new_smart_factors_.empty() || !updated_smart_factors.empty())) {
+    gtsam::Values estimate(smoother_->getLinearizationPoint());
+    for (const gtsam::Values::ConstKeyValuePair& key_value : new_values_) {
+      if (!estimate.exists(key_value.key)) {
+        estimate.insert(key_value.key, key_value.value);
+      }
+    }
+    findSmartFactorsBehindCamera(
+        estimate, new_smart_factors_, &lmks_behind_camera);
+    findSmartFactorsBehindCamera(
+        estimate, updated_smart_factors, &updated_lmks_behind_camera);
+  }
+
+  // The extended copies of the smart factors of landmarks behind a camera
+  // are dropped, and the factors they would replace removed, together with
+  // their landmark.
+  for (const LandmarkId& lmk_id : updated_lmks_behind_camera) {
+    const auto& old_smart_factor_it = old_smart_factors_.find(lmk_id);
+    CHECK(old_smart_factor_it != old_smart_factors_.end());
+    const Slot& slot = old_smart_factor_it->second.second;
+    CHECK_EQ(extended_factors.erase(slot), 1u);
+    delete_slots.push_back(slot);
+    old_smart_factors_.erase(old_smart_factor_it);
+    CHECK(deleteLmkFromFeatureTracks(lmk_id));
+    deleteLmkFromExtraStructures(lmk_id);
+  }
+
   for (const auto& new_smart_factor : new_smart_factors_) {
     // Push back the smart factor to the list of new factors to add to the
     // graph. // Smart factor, so same address right?
@@ -909,7 +1044,15 @@ bool VioBackend::optimize(
         << " could not be found in old_smart_factors_.";
 
     Slot slot = old_smart_factor_it->second.second;
-    if (slot != -1) {
+    if (lmks_behind_camera.count(lmk_id) > 0u) {
+      // Remove the landmark altogether, including its previous smart factor.
+      if (slot != -1 && smoother_->getFactors().exists(slot)) {
+        delete_slots.push_back(slot);
+      }
+      old_smart_factors_.erase(old_smart_factor_it);
+      CHECK(deleteLmkFromFeatureTracks(lmk_id));
+      deleteLmkFromExtraStructures(lmk_id);
+    } else if (slot != -1) {
       // Smart factor Slot is different than -1, therefore the factor should be
       // already in the factor graph.
       DCHECK_GE(slot, 0);
@@ -920,8 +1063,8 @@ bool VioBackend::optimize(
         delete_slots.push_back(slot);
         // And we must add the new smart factor to the graph.
         new_factors_tmp.push_back(new_smart_factor.second);
-        // Store lmk id of the smart factor to add to the graph.
-        lmk_ids_of_new_smart_factors_tmp.push_back(lmk_id);
+        registerNewFactor(
+            new_smart_factor.second, FactorRole::kSmartStereo, lmk_id);
       } else {
         // This should not happen, unless feature tracks are so long
         // (longer than factor graph's time horizon), than the factor has been
@@ -935,14 +1078,17 @@ bool VioBackend::optimize(
       // We just add the new smart factor to the graph, as it has never been
       // there before.
       new_factors_tmp.push_back(new_smart_factor.second);
-      // Store lmk id of the smart factor to add to the graph.
-      lmk_ids_of_new_smart_factors_tmp.push_back(lmk_id);
+      registerNewFactor(
+          new_smart_factor.second, FactorRole::kSmartStereo, lmk_id);
     }
   }
 
+  for (const LandmarkId& lmk_id : lmks_behind_camera) {
+    new_smart_factors_.erase(lmk_id);
+  }
+
   // Add also other factors (imu, priors).
-  // SMART FACTORS MUST BE FIRST, otherwise when recovering the slots
-  // for the smart factors we will mess up.
+  // The order does not matter: slots are recovered from new_factors_manifest_.
   // push back many factors with an iterator over shared_ptr
   // (factors are not copied)
   new_factors_tmp.push_back(new_imu_prior_and_other_factors_.begin(),
@@ -1009,11 +1155,16 @@ bool VioBackend::optimize(
   // Compute iSAM update.
   VLOG(10) << "iSAM2 update with " << new_factors_tmp.size() << " new factors "
            << ", " << new_values_.size() << " new values "
+           << ", " << extended_factors.size() << " extended factors"
            << ", and " << delete_slots.size() << " deleted factors.";
   Smoother::Result result;
   VLOG(10) << "Starting first update.";
-  bool is_smoother_ok = updateSmoother(
-      &result, new_factors_tmp, new_values_, timestamps, delete_slots);
+  bool is_smoother_ok = updateSmoother(&result,
+                                       new_factors_tmp,
+                                       new_values_,
+                                       timestamps,
+                                       delete_slots,
+                                       extended_factors);
   VLOG(10) << "Finished first update.";
 
   // Store time after iSAM update.
@@ -1040,8 +1191,7 @@ bool VioBackend::optimize(
     // Update slots of smart factors:.
     // TODO(Toni): shouldn't we be doing this after each updateSmoother call?
     VLOG(10) << "Starting to find smart factors slots.";
-    updateNewSmartFactorsSlots(lmk_ids_of_new_smart_factors_tmp,
-                               &old_smart_factors_);
+    updateNewFactorsSlots(&old_smart_factors_);
     VLOG(10) << "Finished to find smart factors slots.";
 
     if (VLOG_IS_ON(5) || log_output_) {
@@ -1052,11 +1202,41 @@ bool VioBackend::optimize(
 
     ////////////////////////////////////////////////////////////////////////////
 
-    // Do some more optimization iterations.
-    for (size_t n_iter = 1; n_iter < max_extra_iterations && is_smoother_ok;
-         ++n_iter) {
+    // Do some more optimization iterations, unless the first update already
+    // converged or we are out of time for this keyframe.
+    size_t n_extra_iterations = 0u;
+    ExtraIterationsStopReason stop_reason =
+        ExtraIterationsStopReason::kMaxIterations;
+    for (size_t n_iter = 1; n_iter < max_extra_iterations; ++n_iter) {
+#ifdef INCREMENTAL_SMOOTHER
+      const gtsam::ISAM2Result& last_result = smoother_->getISAM2Result();
+#else
+      // The batch smoother does not report its errors, only the time budget
+      // and the delta criteria apply.
+      const gtsam::ISAM2Result last_result;
+#endif
+      if (shouldStopExtraIterations(
+              last_result, total_start_time, &stop_reason)) {
+        break;
+      }
       VLOG(10) << "Doing extra iteration nr: " << n_iter;
       is_smoother_ok = updateSmoother(&result);
+      ++n_extra_iterations;
+      if (!is_smoother_ok) {
+        stop_reason = ExtraIterationsStopReason::kSmootherFailure;
+        break;
+      }
+    }
+    debug_info_.numExtraIterations_ = n_extra_iterations;
+    debug_info_.extraIterationsStopReason_ = stop_reason;
+    if (max_extra_iterations > 1u) {
+      utils::StatsCollector stats_extra_iterations(
+          "Backend Extra Iterations [#]");
+      stats_extra_iterations.AddSample(n_extra_iterations);
+      utils::StatsCollector stats_stop_reason(
+          "Backend Extra Iterations Stop: " +
+          extraIterationsStopReasonAsString(stop_reason));
+      stats_stop_reason.IncrementOne();
     }
 
     if (VLOG_IS_ON(5) || log_output_) {
@@ -1067,6 +1247,9 @@ bool VioBackend::optimize(
 
     // Update states we need for next iteration, if smoother is ok.
     if (is_smoother_ok) {
+      // Forget the slots of factors marginalized by the updates.
+      pruneFactorSlots(smoother_->getFactors());
+
       updateStates(cur_id);
 
       // TODO: Add Update latest covariance --> move flag
@@ -1080,15 +1263,28 @@ bool VioBackend::optimize(
       LOG(ERROR) << "Smoother is not ok! Not updating Backend state.";
     }
   }
+
+  // The queued factors are either in the smoother or dropped by a failed
+  // update: do not keep them alive until the next update.
+  new_factors_manifest_.clear();
   return is_smoother_ok;
 }
 
 /// Private methods.
 /* -------------------------------------------------------------------------- */
 void VioBackend::addInitialPriorFactors(const FrameId& frame_id) {
-  // Set initial covariance for inertial factors
   // W_Pose_Blkf_ set by motion capture to start with
-  Matrix3 B_Rot_W = W_Pose_B_lkf_.rotation().matrix().transpose();
+  addStatePriorFactors(frame_id, W_Pose_B_lkf_, W_Vel_B_lkf_, imu_bias_lkf_);
+  VLOG(2) << "Added initial priors for frame " << frame_id;
+}
+
+/* -------------------------------------------------------------------------- */
+void VioBackend::addStatePriorFactors(const FrameId& frame_id,
+                                      const gtsam::Pose3& W_Pose_B,
+                                      const gtsam::Vector3& W_Vel_B,
+                                      const ImuBias& imu_bias) {
+  // Set initial covariance for inertial factors
+  Matrix3 B_Rot_W = W_Pose_B.rotation().matrix().transpose();
 
   // Set initial pose uncertainty: constrain mainly position and global yaw.
   // roll and pitch is observable, therefore low variance.
@@ -1118,7 +1314,7 @@ void VioBackend::addInitialPriorFactors(const FrameId& frame_id) {
   new_imu_prior_and_other_factors_.push_back(
       boost::make_shared<gtsam::PriorFactor<gtsam::Pose3>>(
           gtsam::Symbol(kPoseSymbolChar, frame_id),
-          W_Pose_B_lkf_,
+          W_Pose_B,
           noise_init_pose));
 
   // Add initial velocity priors.
@@ -1129,7 +1325,7 @@ void VioBackend::addInitialPriorFactors(const FrameId& frame_id) {
   new_imu_prior_and_other_factors_.push_back(
       boost::make_shared<gtsam::PriorFactor<gtsam::Vector3>>(
           gtsam::Symbol(kVelocitySymbolChar, frame_id),
-          W_Vel_B_lkf_,
+          W_Vel_B,
           noise_init_vel_prior));
 
   // Add initial bias priors:
@@ -1141,15 +1337,107 @@ void VioBackend::addInitialPriorFactors(const FrameId& frame_id) {
       gtsam::noiseModel::Diagonal::Sigmas(prior_biasSigmas);
   if (VLOG_IS_ON(10)) {
     LOG(INFO) << "Imu bias for Backend prior:";
-    imu_bias_lkf_.print();
+    imu_bias.print();
   }
   new_imu_prior_and_other_factors_.push_back(
       boost::make_shared<gtsam::PriorFactor<gtsam::imuBias::ConstantBias>>(
           gtsam::Symbol(kImuBiasSymbolChar, frame_id),
-          imu_bias_lkf_,
+          imu_bias,
           imu_bias_prior_noise));
+}
 
-  VLOG(2) << "Added initial priors for frame " << frame_id;
+/* -------------------------------------------------------------------------- */
+void VioBackend::spinFastStartAlignment(const BackendInput& input) {
+  CHECK_EQ(backend_params_.autoInitialize_, 2);
+  CHECK(!is_fast_start_done_);
+  if (!fast_start_alignment_.valid()) {
+    // Still collecting keyframes for the alignment.
+    CHECK(input.status_stereo_measurements_kf_);
+    fast_start_inputs_.push_back(
+        VIO::make_unique<BackendInput>(input.timestamp_,
+                                       input.status_stereo_measurements_kf_,
+                                       input.stereo_tracking_status_,
+                                       input.pim_,
+                                       input.imu_acc_gyrs_,
+                                       input.stereo_ransac_body_pose_));
+    fast_start_last_kf_id_ = curr_kf_id_;
+    CHECK_GT(FLAGS_fast_start_alignment_keyframes, 1);
+    if (fast_start_inputs_.size() <
+        static_cast<size_t>(FLAGS_fast_start_alignment_keyframes)) {
+      return;
+    }
+
+    // The worker gets its own Backend and the collected keyframes: it never
+    // touches this Backend, which keeps publishing in the meantime.
+    std::shared_ptr<InitializationBackend> initialization_backend =
+        std::make_shared<InitializationBackend>(B_Pose_leftCam_,
+                                                stereo_cal_,
+                                                backend_params_,
+                                                imu_params_,
+                                                backend_output_params_,
+                                                false);
+    std::shared_ptr<std::vector<BackendInput::UniquePtr>> inputs =
+        std::make_shared<std::vector<BackendInput::UniquePtr>>(
+            std::move(fast_start_inputs_));
+    fast_start_inputs_.clear();
+    fast_start_alignment_ = std::async(
+        std::launch::async,
+        [initialization_backend, inputs]() {
+          InitializationAlignmentResult::UniquePtr result =
+              VIO::make_unique<InitializationAlignmentResult>();
+          initialization_backend->bundleAdjustmentAndGravityAlignment(
+              *inputs, result.get());
+          return result;
+        });
+    LOG(INFO) << "Fast-start alignment started in background up to keyframe "
+              << fast_start_last_kf_id_ << ".";
+    return;
+  }
+
+  // Do not wait for the worker.
+  if (fast_start_alignment_.wait_for(std::chrono::seconds(0)) !=
+      std::future_status::ready) {
+    return;
+  }
+  const InitializationAlignmentResult::UniquePtr result =
+      fast_start_alignment_.get();
+  CHECK(result);
+  is_fast_start_done_ = true;
+  if (!result->is_success_) {
+    LOG(WARNING) << "Fast-start alignment failed, keeping the IMU "
+                    "initialization.";
+    return;
+  }
+  const gtsam::Symbol pose_key(kPoseSymbolChar, fast_start_last_kf_id_);
+  const gtsam::Symbol bias_key(kImuBiasSymbolChar, fast_start_last_kf_id_);
+  if (!state_.exists(pose_key) || !state_.exists(bias_key)) {
+    LOG(WARNING) << "Fast-start alignment finished after keyframe "
+                 << fast_start_last_kf_id_
+                 << " left the time horizon, keeping the IMU initialization.";
+    return;
+  }
+
+  // The alignment world frame shares the gravity direction with ours, but
+  // not the yaw nor the origin: only take roll, pitch, velocity and gyro bias
+  // from the alignment.
+  const gtsam::Pose3& W_Pose_B = state_.at<gtsam::Pose3>(pose_key);
+  const gtsam::Pose3& A_Pose_B = result->latest_navstate_.pose();
+  const gtsam::Vector3 W_ypr_B = W_Pose_B.rotation().ypr();
+  const gtsam::Vector3 A_ypr_B = A_Pose_B.rotation().ypr();
+  const gtsam::Pose3 W_Pose_B_aligned(
+      gtsam::Rot3::Ypr(W_ypr_B(0), A_ypr_B(1), A_ypr_B(2)),
+      W_Pose_B.translation());
+  const gtsam::Vector3 W_Vel_B_aligned =
+      gtsam::Rot3::Yaw(W_ypr_B(0) - A_ypr_B(0)).matrix() *
+      result->latest_navstate_.velocity();
+  const ImuBias& imu_bias = state_.at<ImuBias>(bias_key);
+  addStatePriorFactors(fast_start_last_kf_id_,
+                       W_Pose_B_aligned,
+                       W_Vel_B_aligned,
+                       ImuBias(imu_bias.accelerometer(), result->gyro_bias_));
+  LOG(INFO) << "Fast-start alignment done, switching to the aligned state of "
+               "keyframe "
+            << fast_start_last_kf_id_ << " at the next update.";
 }
 
 /* -------------------------------------------------------------------------- */
@@ -1196,12 +1484,14 @@ bool VioBackend::updateSmoother(Smoother::Result* result,
                                 const gtsam::NonlinearFactorGraph& new_factors,
                                 const gtsam::Values& new_values,
                                 const std::map<Key, double>& timestamps,
-                                const gtsam::FactorIndices& delete_slots) {
+                                const gtsam::FactorIndices& delete_slots,
+                                const ExtendedFactors& extended_factors) {
   CHECK_NOTNULL(result);
   // Store smoother as backup.
   CHECK(smoother_);
   // This is not doing a full deep copy: it is keeping same shared_ptrs for
-  // factors but copying the isam result.
+  // factors but copying the isam result. The factors are never modified,
+  // extended factors replace them in the graph instead.
   Smoother smoother_backup(*smoother_);
 
   bool got_cheirality_exception = false;
@@ -1209,8 +1499,14 @@ bool VioBackend::updateSmoother(Smoother::Result* result,
   try {
     // Update smoother.
     VLOG(10) << "Starting update of smoother_...";
+#if defined(INCREMENTAL_SMOOTHER) && defined(KIMERA_IN_PLACE_SMOOTHER_UPDATE)
+    *result = smoother_->update(
+        new_factors, new_values, timestamps, delete_slots, extended_factors);
+#else
+    DCHECK(extended_factors.empty());
     *result =
         smoother_->update(new_factors, new_values, timestamps, delete_slots);
+#endif
     VLOG(10) << "Finished update of smoother_.";
     if (debug_smoother_) {
       printSmootherInfo(new_factors, delete_slots, "CATCHING EXCEPTION", false);
@@ -1355,11 +1651,22 @@ bool VioBackend::updateSmoother(Smoother::Result* result,
       // Try again to optimize. This is a recursive call.
       LOG(WARNING) << "Starting updateSmoother after handling "
                       "cheirality exception.";
+      // The restored smoother holds the factors before their extension:
+      // extend again those that are not removed.
+      ExtendedFactors extended_factors_cheirality;
+      for (const auto& slot_factor : extended_factors) {
+        if (std::find(delete_slots_cheirality.begin(),
+                      delete_slots_cheirality.end(),
+                      slot_factor.first) == delete_slots_cheirality.end()) {
+          extended_factors_cheirality.insert(slot_factor);
+        }
+      }
       bool status = updateSmoother(result,
                                    new_factors_tmp_cheirality,
                                    new_values_cheirality,
                                    timestamps_cheirality,
-                                   delete_slots_cheirality);
+                                   delete_slots_cheirality,
+                                   extended_factors_cheirality);
       LOG(WARNING) << "Finished updateSmoother after handling "
                       "cheirality exception";
       return status;
@@ -1371,6 +1678,96 @@ bool VioBackend::updateSmoother(Smoother::Result* result,
   return true;
 }
 
+/* -------------------------------------------------------------------------- */
+bool VioBackend::shouldStopExtraIterations(
+    const gtsam::ISAM2Result& result,
+    const std::chrono::high_resolution_clock::time_point& optimize_start_time,
+    ExtraIterationsStopReason* stop_reason) {
+  CHECK_NOTNULL(stop_reason);
+  if (backend_params_.maxOptimizeTimeMs_ > 0.0) {
+    const double elapsed_ms =
+        utils::Timer::toc<std::chrono::microseconds>(optimize_start_time)
+            .count() *
+        1e-3;
+    if (elapsed_ms >= backend_params_.maxOptimizeTimeMs_) {
+      *stop_reason = ExtraIterationsStopReason::kDeadline;
+      return true;
+    }
+  }
+
+  if (backend_params_.extraIterationsDeltaThreshold_ > 0.0) {
+    // The delta is what is left to apply on top of the linearization point:
+    // if it is small, relinearizing again will barely change the estimate.
+    double max_delta = 0.0;
+    for (const auto& key_delta : smoother_->getDelta()) {
+      max_delta = std::max(
+          max_delta, key_delta.second.lpNorm<Eigen::Infinity>());
+    }
+    if (max_delta < backend_params_.extraIterationsDeltaThreshold_) {
+      *stop_reason = ExtraIterationsStopReason::kSmallDelta;
+      return true;
+    }
+  }
+
+  if (backend_params_.extraIterationsErrorReductionThreshold_ > 0.0 &&
+      result.errorBefore && result.errorAfter && *result.errorBefore > 0.0) {
+    const double error_reduction =
+        (*result.errorBefore - *result.errorAfter) / *result.errorBefore;
+    if (error_reduction <
+        backend_params_.extraIterationsErrorReductionThreshold_) {
+      *stop_reason = ExtraIterationsStopReason::kSmallErrorReduction;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/* -------------------------------------------------------------------------- */
+void VioBackend::findSmartFactorsBehindCamera(
+    const gtsam::Values& estimate,
+    const LandmarkIdSmartFactorMap& smart_factors,
+    std::unordered_set<LandmarkId>* lmks_behind_camera) {
+  CHECK_NOTNULL(lmks_behind_camera);
+  lmks_behind_camera->clear();
+  if (smart_factors.empty()) return;
+
+  std::vector<std::pair<LandmarkId, SmartStereoFactor::shared_ptr>> factors(
+      smart_factors.begin(), smart_factors.end());
+  std::vector<uint8_t> is_behind_camera(factors.size(), 0u);
+  // Each factor caches its triangulation together with the poses used, and
+  // only triangulates again if it is linearized at different poses.
+  cv::parallel_for_(cv::Range(0, factors.size()), [&](const cv::Range& range) {
+    for (int i = range.start; i < range.end; ++i) {
+      const SmartStereoFactor::shared_ptr& factor = factors[i].second;
+      CHECK(factor);
+      bool has_all_poses = true;
+      for (const Key& key : factor->keys()) {
+        if (!estimate.exists(key)) {
+          // Past the smoother horizon, leave it to the usual bookkeeping.
+          has_all_poses = false;
+          break;
+        }
+      }
+      if (has_all_poses) {
+        is_behind_camera[i] = factor->point(estimate).behindCamera();
+      }
+    }
+  });
+
+  for (size_t i = 0u; i < factors.size(); ++i) {
+    if (is_behind_camera[i]) lmks_behind_camera->insert(factors[i].first);
+  }
+
+  if (!lmks_behind_camera->empty()) {
+    VLOG(5) << "Removing " << lmks_behind_camera->size()
+            << " smart factors with landmarks behind a camera.";
+  }
+  utils::StatsCollector stats_behind_camera(
+      "Backend Smart Factors Behind Camera [#]");
+  stats_behind_camera.AddSample(lmks_behind_camera->size());
+}
+
 /* -------------------------------------------------------------------------- */
 void VioBackend::cleanCheiralityLmk(
     const gtsam::Symbol& lmk_symbol,
@@ -1414,18 +1811,23 @@ void VioBackend::cleanCheiralityLmk(
   // Delete slots in current graph.
   VLOG(10) << "Starting delete from current graph...";
   *delete_slots_cheirality = delete_slots;
-  std::vector<size_t> slots_of_extra_factors_to_delete;
+  const LandmarkId& lmk_id = lmk_symbol.index();
   // Achtung: This has the chance to make the plane underconstrained, if
   // we delete too many point_plane factors.
-  findSlotsOfFactorsWithKey(lmk_key, graph, &slots_of_extra_factors_to_delete);
-  delete_slots_cheirality->insert(delete_slots_cheirality->end(),
-                                  slots_of_extra_factors_to_delete.begin(),
-                                  slots_of_extra_factors_to_delete.end());
+  const auto& lmk_factor_slots_it = lmk_factor_slots_.find(lmk_id);
+  if (lmk_factor_slots_it != lmk_factor_slots_.end()) {
+    for (const FactorSlot& factor_slot : lmk_factor_slots_it->second) {
+      if (!factor_slot.isValid(graph)) continue;
+      LOG(WARNING) << "Delete factor in graph at slot # " << factor_slot.slot_
+                   << " corresponding to lmk with id: " << lmk_id;
+      delete_slots_cheirality->push_back(factor_slot.slot_);
+    }
+    lmk_factor_slots_.erase(lmk_factor_slots_it);
+  }
   VLOG(10) << "Finished delete from current graph.";
 
   //////////////////////////// BOOKKEEPING
   ////////////////////////////////////////
-  const LandmarkId& lmk_id = lmk_symbol.index();
 
   // Delete from feature tracks.
   VLOG(10) << "Starting delete from feature tracks...";
@@ -1440,7 +1842,7 @@ void VioBackend::cleanCheiralityLmk(
 }
 
 void VioBackend::deleteLmkFromExtraStructures(const LandmarkId& lmk_id) {
-  LOG(ERROR) << "There is nothing to delete for lmk with id: " << lmk_id;
+  VLOG(10) << "There is nothing to delete for lmk with id: " << lmk_id;
   return;
 }
 
@@ -1449,55 +1851,104 @@ void VioBackend::deleteLmkFromExtraStructures(const LandmarkId& lmk_id) {
 // this idx points to the updated slots in the graph after optimization.
 // for next iteration to know which slots have to be deleted
 // before adding the new smart factors.
-void VioBackend::updateNewSmartFactorsSlots(
-    const std::vector<LandmarkId>& lmk_ids_of_new_smart_factors,
-    SmartFactorMap* old_smart_factors) {
-  CHECK_NOTNULL(old_smart_factors);
+void VioBackend::registerNewFactor(
+    const gtsam::NonlinearFactor::shared_ptr& factor,
+    const FactorRole& role,
+    const LandmarkId& lmk_id) {
+  CHECK(factor);
+  NewFactorManifestEntry& entry = new_factors_manifest_[factor.get()];
+  entry.factor_ = factor;
+  entry.role_ = role;
+  entry.lmk_id_ = lmk_id;
+}
 
-  // Get result.
-  const gtsam::ISAM2Result& result = smoother_->getISAM2Result();
+/* -------------------------------------------------------------------------- */
+void VioBackend::updateNewFactorsSlots(SmartFactorMap* old_smart_factors) {
+  CHECK_NOTNULL(old_smart_factors);
 
-  // Simple version of find smart factors.
-  for (size_t i = 0u; i < lmk_ids_of_new_smart_factors.size(); ++i) {
-    DCHECK(i < result.newFactorsIndices.size())
-        << "There are more new smart factors than new factors added to the "
-           "graph.";
-    // Get new slot in the graph for the newly added smart factor.
-    const size_t& slot = result.newFactorsIndices.at(i);
+  const gtsam::NonlinearFactorGraph& graph = smoother_->getFactors();
+#ifdef INCREMENTAL_SMOOTHER
+  const gtsam::FactorIndices& new_factors_slots =
+      smoother_->getISAM2Result().newFactorsIndices;
+#else
+  // The batch smoother does not report the slots of the new factors, look
+  // for them in the whole graph.
+  gtsam::FactorIndices new_factors_slots(graph.size());
+  std::iota(new_factors_slots.begin(), new_factors_slots.end(), 0u);
+#endif
 
-    // TODO this will not work if there are non-smart factors!!!
-    // Update slot using isam2 indices.
-    // ORDER of inclusion of factors in the ISAM2::update() function
-    // matters, as these indices have a 1-to-1 correspondence with the
-    // factors.
+  // The slots in newFactorsIndices follow the order of the factors given to
+  // the last update, which may not be the order in which they were queued
+  // (e.g. after removing factors on cheirality exceptions). Identify each
+  // new factor by its address instead.
+  size_t nr_smart_factors = 0u;
+  for (const size_t& slot : new_factors_slots) {
+    const gtsam::NonlinearFactor::shared_ptr& factor = graph.at(slot);
+    // The factor may have been marginalized out during the update.
+    if (!factor) continue;
+    const auto& manifest_it = new_factors_manifest_.find(factor.get());
+    if (manifest_it == new_factors_manifest_.end()) continue;
+    const NewFactorManifestEntry& entry = manifest_it->second;
+    if (entry.role_ != FactorRole::kSmartStereo) {
+      recordNewFactorSlot(entry, slot);
+      continue;
+    }
 
     // BOOKKEEPING, for next iteration to know which slots have to be
     // deleted before adding the new smart factors. Find the entry in
     // old_smart_factors_.
-    const auto& it =
-        old_smart_factors->find(lmk_ids_of_new_smart_factors.at(i));
-
+    const auto& it = old_smart_factors->find(entry.lmk_id_);
     DCHECK(it != old_smart_factors->end())
         << "Trying to access unavailable factor.";
-    // CHECK that the factor in the graph at slot position is a smart
-    // factor.
-    DCHECK(boost::dynamic_pointer_cast<SmartStereoFactor>(
-        smoother_->getFactors().at(slot)));
     // CHECK that shared ptrs point to the same smart factor.
     // make sure no one is cloning SmartSteroFactors.
-    DCHECK_EQ(it->second.first,
-              boost::dynamic_pointer_cast<SmartStereoFactor>(
-                  smoother_->getFactors().at(slot)))
+    DCHECK_EQ(it->second.first.get(), factor.get())
         << "Non-matching addresses for same factors for lmk with id: "
-        << lmk_ids_of_new_smart_factors.at(i) << " in old_smart_factors_ "
+        << entry.lmk_id_ << " in old_smart_factors_ "
         << "VS factor in graph at slot: " << slot
         << ". Slot previous to update was: " << it->second.second;
 
     // Update slot number in old_smart_factors_.
     it->second.second = slot;
+    ++nr_smart_factors;
+  }
+  VLOG(10) << "Updated slots of " << nr_smart_factors << " new smart factors, "
+           << "out of " << new_factors_slots.size() << " new factors.";
+}
+
+/* -------------------------------------------------------------------------- */
+void VioBackend::recordNewFactorSlot(const NewFactorManifestEntry& entry,
+                                     const Slot& slot) {
+  if (entry.lmk_id_ == -1) return;
+  if (entry.role_ == FactorRole::kProjection ||
+      entry.role_ == FactorRole::kPointPlane) {
+    FactorSlot factor_slot;
+    factor_slot.slot_ = slot;
+    factor_slot.factor_ = entry.factor_;
+    lmk_factor_slots_[entry.lmk_id_].push_back(factor_slot);
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+void VioBackend::pruneFactorSlots(const gtsam::NonlinearFactorGraph& graph) {
+  for (auto it = lmk_factor_slots_.begin(); it != lmk_factor_slots_.end();) {
+    FactorSlots& factor_slots = it->second;
+    factor_slots.erase(
+        std::remove_if(factor_slots.begin(),
+                       factor_slots.end(),
+                       [&graph](const FactorSlot& factor_slot) {
+                         return !factor_slot.isValid(graph);
+                       }),
+        factor_slots.end());
+    if (factor_slots.empty()) {
+      it = lmk_factor_slots_.erase(it);
+    } else {
+      ++it;
+    }
   }
 }
 
+/* -------------------------------------------------------------------------- */
 void VioBackend::setFactorsParams(
     const BackendParams& vio_params,
     gtsam::SharedNoiseModel* smart_noise,
@@ -1599,10 +2050,7 @@ void VioBackend::print() const {
 
 void VioBackend::printFeatureTracks() const {
   std::cout << "---- Feature tracks: --------- " << std::endl;
-  BOOST_FOREACH (auto keyTrack_j, feature_tracks_) {
-    std::cout << "Landmark " << keyTrack_j.first << " having ";
-    keyTrack_j.second.print();
-  }
+  feature_tracks_.print();
 }
 
 void VioBackend::printSmootherInfo(
@@ -2061,42 +2509,10 @@ bool VioBackend::deleteKeyFromValues(const gtsam::Key& key,
   return false;
 }
 
-// Returns if the key in timestamps could be removed or not.
-void VioBackend::findSlotsOfFactorsWithKey(
-    const gtsam::Key& key,
-    const gtsam::NonlinearFactorGraph& graph,
-    std::vector<size_t>* slots_of_factors_with_key) {
-  CHECK_NOTNULL(slots_of_factors_with_key);
-  slots_of_factors_with_key->resize(0);
-  size_t slot = 0;
-  for (const boost::shared_ptr<gtsam::NonlinearFactor>& g : graph) {
-    if (g) {
-      // Found a valid factor.
-      if (g->find(key) != g->end()) {
-        // Whatever factor this is, it has our lmk...
-        // Sanity check, this lmk has no priors right?
-        CHECK(!boost::dynamic_pointer_cast<gtsam::LinearContainerFactor>(g));
-        CHECK(
-            !boost::dynamic_pointer_cast<gtsam::PriorFactor<gtsam::Point3>>(g));
-        // Sanity check that we are not deleting a smart factor.
-        CHECK(!boost::dynamic_pointer_cast<SmartStereoFactor>(g));
-        // Delete it.
-        LOG(WARNING) << "Delete factor in graph at slot # " << slot
-                     << " corresponding to lmk with id: "
-                     << gtsam::Symbol(key).index();
-        CHECK(graph.exists(slot));
-        slots_of_factors_with_key->push_back(slot);
-      }
-    }
-    slot++;
-  }
-}
-
 // Returns if the key in feature tracks could be removed or not.
 bool VioBackend::deleteLmkFromFeatureTracks(const LandmarkId& lmk_id) {
-  if (feature_tracks_.find(lmk_id) != feature_tracks_.end()) {
-    VLOG(2) << "Deleting feature track for lmk with id: " << lmk_id;
-    feature_tracks_.erase(lmk_id);
+  if (feature_tracks_.erase(lmk_id)) {
+    VLOG(2) << "Deleted feature track for lmk with id: " << lmk_id;
     return true;
   }
   return false;
@@ -48,7 +48,10 @@ void BackendParams::setIsam2Params(const BackendParams& vio_params,
   isam_param->relinearizeSkip = vio_params.relinearizeSkip_;
   isam_param->findUnusedFactorSlots = true;
   // isam_param->enablePartialRelinearizationCheck = true;
-  isam_param->setEvaluateNonlinearError(false);  // only for debugging
+  // Needed by the error reduction criterion of the extra iterations, else
+  // only for debugging.
+  isam_param->setEvaluateNonlinearError(
+      vio_params.extraIterationsErrorReductionThreshold_ > 0.0);
   isam_param->enableDetailedResults = false;     // only for debugging.
   isam_param->factorization = gtsam::ISAM2Params::CHOLESKY;  // QR
 }
@@ -133,6 +136,11 @@ bool BackendParams::parseYAMLVioBackendParams(const YamlParser& yaml_parser) {
   yaml_parser.getYamlParam("noMotionRotationSigma", &noMotionRotationSigma_);
   yaml_parser.getYamlParam("constantVelSigma", &constantVelSigma_);
   yaml_parser.getYamlParam("numOptimize", &numOptimize_);
+  yaml_parser.getYamlParam("extraIterationsDeltaThreshold",
+                           &extraIterationsDeltaThreshold_);
+  yaml_parser.getYamlParam("extraIterationsErrorReductionThreshold",
+                           &extraIterationsErrorReductionThreshold_);
+  yaml_parser.getYamlParam("maxOptimizeTimeMs", &maxOptimizeTimeMs_);
   yaml_parser.getYamlParam("horizon", &horizon_);
   yaml_parser.getYamlParam("wildfire_threshold", &wildfire_threshold_);
   yaml_parser.getYamlParam("useDogLeg", &useDogLeg_);
@@ -175,7 +183,13 @@ bool BackendParams::equalsVioBackendParams(const BackendParams& vp2,
       (fabs(noMotionPositionSigma_ - vp2.noMotionPositionSigma_) <= tol) &&
       (fabs(noMotionRotationSigma_ - vp2.noMotionRotationSigma_) <= tol) &&
       (fabs(constantVelSigma_ - vp2.constantVelSigma_) <= tol) &&
-      (numOptimize_ == vp2.numOptimize_) && (horizon_ == vp2.horizon_) &&
+      (numOptimize_ == vp2.numOptimize_) &&
+      (fabs(extraIterationsDeltaThreshold_ -
+            vp2.extraIterationsDeltaThreshold_) <= tol) &&
+      (fabs(extraIterationsErrorReductionThreshold_ -
+            vp2.extraIterationsErrorReductionThreshold_) <= tol) &&
+      (fabs(maxOptimizeTimeMs_ - vp2.maxOptimizeTimeMs_) <= tol) &&
+      (horizon_ == vp2.horizon_) &&
       (wildfire_threshold_ == vp2.wildfire_threshold_) &&
       (useDogLeg_ == vp2.useDogLeg_);
 }
@@ -241,6 +255,12 @@ void BackendParams::printVioBackendParams() const {
       constantVelSigma_,
       "Optimization Iterations",
       numOptimize_,
+      "Extra Iterations Delta Threshold",
+      extraIterationsDeltaThreshold_,
+      "Extra Iterations Error Reduction Threshold",
+      extraIterationsErrorReductionThreshold_,
+      "Max Optimize Time [ms]",
+      maxOptimizeTimeMs_,
       "Horizon",
       horizon_,
       "Isam Wildfire Threshold",
@@ -26,7 +26,9 @@ MonoDataProviderModule::MonoDataProviderModule(OutputQueue* output_queue,
     : DataProviderModule(output_queue,
                          name_id,
                          parallel_run),
-      left_frame_queue_("data_provider_left_frame_queue") {}
+      left_frame_queue_("data_provider_left_frame_queue") {
+  latchWorkingOnPop(&left_frame_queue_);
+}
 
 MonoDataProviderModule::InputUniquePtr
 MonoDataProviderModule::getInputPacket() {
@@ -14,6 +14,10 @@
 
 #include "kimera-vio/frontend/StereoCamera.h"
 
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
 #include <Eigen/Core>
 
 #include <opencv2/calib3d.hpp>
@@ -213,12 +217,13 @@ void StereoCamera::backProjectDisparityTo3DManual(const cv::Mat& disparity_img,
   // Same size than the disparity_img
   *depth = cv::Mat::zeros(disparity_img.size(), CV_32FC3);
 
-  // Non-zero elements from Q
-  double Q03 = Q_.at<double>(0, 3);  // -c_x
-  double Q13 = Q_.at<double>(1, 3);  // -c_y
-  double Q23 = Q_.at<double>(2, 3);  // f
-  double Q32 = Q_.at<double>(3, 2);  // -1.0 / T_x where T_x is the baseline
-  double Q33 = Q_.at<double>(3, 3);  // (c_x - c_x') / T_x
+  // Non-zero elements from Q, in single precision so that the loop below
+  // does not mix float and double arithmetic.
+  const float Q03 = Q_.at<double>(0, 3);  // -c_x
+  const float Q13 = Q_.at<double>(1, 3);  // -c_y
+  const float Q23 = Q_.at<double>(2, 3);  // f
+  const float Q32 = Q_.at<double>(3, 2);  // -1.0 / T_x, T_x is the baseline
+  const float Q33 = Q_.at<double>(3, 3);  // (c_x - c_x') / T_x
 
   // Get xyz from disparity
   for (size_t i = 0u; i < disparity_img.rows; i++) {
@@ -239,6 +244,133 @@ void StereoCamera::backProjectDisparityTo3DManual(const cv::Mat& disparity_img,
   }
 }
 
+void StereoCamera::backProjectDisparityToVoxelCloud(
+    const cv::Mat& disparity_img,
+    const Timestamp& timestamp,
+    const DenseStereoParams& dense_stereo_params,
+    DenseStereoCloud* cloud) const {
+  CHECK_NOTNULL(cloud);
+  CHECK(!disparity_img.empty());
+  CHECK_EQ(disparity_img.type(), CV_32F)
+      << "Wrong type for disparity img, mind that if the disparity image is "
+         "of type CV_16S, you might need to divide the values by 16.";
+  CHECK_EQ(Q_.type(), CV_64F);
+  const float voxel_size = dense_stereo_params.cloud_voxel_size_;
+  const float min_depth = dense_stereo_params.cloud_min_depth_;
+  const float max_depth = dense_stereo_params.cloud_max_depth_;
+  CHECK_GT(voxel_size, 0.0f);
+  CHECK_GE(min_depth, 0.0f);
+  CHECK_LT(min_depth, max_depth);
+
+  const float Q03 = Q_.at<double>(0, 3);  // -c_x
+  const float Q13 = Q_.at<double>(1, 3);  // -c_y
+  const float Q23 = Q_.at<double>(2, 3);  // f
+  const float Q32 = Q_.at<double>(3, 2);  // -1.0 / T_x, T_x is the baseline
+  const float Q33 = Q_.at<double>(3, 3);  // (c_x - c_x') / T_x
+  const float inv_voxel_size = 1.0f / voxel_size;
+
+  // Voxel coordinates are packed in 21 bits each. Since depths are bounded,
+  // so are x and y: check the bounds once here rather than for every pixel.
+  static constexpr int32_t kVoxelOffset = 1 << 20;
+  const float max_abs_u = std::max(std::abs(Q03),
+                                   std::abs(disparity_img.cols - 1 + Q03));
+  const float max_abs_v = std::max(std::abs(Q13),
+                                   std::abs(disparity_img.rows - 1 + Q13));
+  const float max_abs_coordinate =
+      std::max(std::max(max_abs_u, max_abs_v) / std::abs(Q23), 1.0f) *
+      max_depth;
+  CHECK_LT(max_abs_coordinate * inv_voxel_size + 1.0f,
+           static_cast<float>(kVoxelOffset))
+      << "Voxel coordinates overflow: the voxel size is too small for the "
+         "max depth and field of view.";
+  const auto voxel_key = [&](const float& x, const float& y, const float& z) {
+    const int32_t vx = static_cast<int32_t>(std::floor(x * inv_voxel_size));
+    const int32_t vy = static_cast<int32_t>(std::floor(y * inv_voxel_size));
+    const int32_t vz = static_cast<int32_t>(std::floor(z * inv_voxel_size));
+    DCHECK_LT(std::abs(vx), kVoxelOffset);
+    DCHECK_LT(std::abs(vy), kVoxelOffset);
+    DCHECK_LT(std::abs(vz), kVoxelOffset);
+    return static_cast<uint64_t>(vx + kVoxelOffset) << 42 |
+           static_cast<uint64_t>(vy + kVoxelOffset) << 21 |
+           static_cast<uint64_t>(vz + kVoxelOffset);
+  };
+
+  // Voxels of a stripe of rows, in the order they are first seen.
+  struct VoxelGrid {
+    std::unordered_map<uint64_t, size_t> index;
+    std::vector<uint64_t> keys;
+    std::vector<cv::Point3f> sums;
+    std::vector<uint32_t> counts;
+
+    void add(const uint64_t& key, const cv::Point3f& sum, const uint32_t& n) {
+      const auto it = index.emplace(key, keys.size());
+      if (it.second) {
+        keys.push_back(key);
+        sums.push_back(sum);
+        counts.push_back(n);
+      } else {
+        sums[it.first->second] += sum;
+        counts[it.first->second] += n;
+      }
+    }
+  };
+
+  static constexpr int kRowsPerStripe = 16;
+  const int rows = disparity_img.rows;
+  const int cols = disparity_img.cols;
+  const int nr_stripes = (rows + kRowsPerStripe - 1) / kRowsPerStripe;
+  std::vector<VoxelGrid> stripe_grids(nr_stripes);
+  cv::parallel_for_(cv::Range(0, nr_stripes), [&](const cv::Range& range) {
+    std::vector<float> xs(cols), ys(cols), zs(cols);
+    for (int s = range.start; s < range.end; ++s) {
+      VoxelGrid& grid = stripe_grids[s];
+      const int row_end = std::min(rows, (s + 1) * kRowsPerStripe);
+      for (int i = s * kRowsPerStripe; i < row_end; ++i) {
+        // Back-project the whole row first: this loop has no branches, so
+        // that it is vectorized. Invalid disparities give non-finite or
+        // negative depths, which are discarded below.
+        const float* disp_ptr = disparity_img.ptr<float>(i);
+        float* x_ptr = xs.data();
+        float* y_ptr = ys.data();
+        float* z_ptr = zs.data();
+        const float v = static_cast<float>(i) + Q13;
+        for (int j = 0; j < cols; ++j) {
+          const float pw = 1.0f / (disp_ptr[j] * Q32 + Q33);
+          x_ptr[j] = (static_cast<float>(j) + Q03) * pw;
+          y_ptr[j] = v * pw;
+          z_ptr[j] = Q23 * pw;
+        }
+
+        for (int j = 0; j < cols; ++j) {
+          const float& z = z_ptr[j];
+          // Written this way so that NaNs are discarded too.
+          if (!(z >= min_depth && z <= max_depth)) continue;
+          const cv::Point3f point(x_ptr[j], y_ptr[j], z);
+          grid.add(voxel_key(point.x, point.y, point.z), point, 1u);
+        }
+      }
+    }
+  });
+
+  // Merge the stripes in order, so that the output does not depend on the
+  // scheduling of the stripes.
+  VoxelGrid merged_grid;
+  for (const VoxelGrid& grid : stripe_grids) {
+    for (size_t k = 0u; k < grid.keys.size(); ++k) {
+      merged_grid.add(grid.keys[k], grid.sums[k], grid.counts[k]);
+    }
+  }
+
+  cloud->timestamp_ = timestamp;
+  cloud->voxel_size_ = voxel_size;
+  cloud->points_.resize(merged_grid.keys.size());
+  cloud->weights_ = std::move(merged_grid.counts);
+  for (size_t k = 0u; k < cloud->points_.size(); ++k) {
+    cloud->points_[k] =
+        merged_grid.sums[k] * (1.0f / static_cast<float>(cloud->weights_[k]));
+  }
+}
+
 void StereoCamera::undistortRectifyLeftKeypoints(
     const KeypointsCV& keypoints,
     StatusKeypointsCV* status_keypoints_rectified) const {
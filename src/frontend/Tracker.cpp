@@ -42,6 +42,9 @@ Tracker::Tracker(const FrontendParams& tracker_params,
       camera_(camera),
       // Only for debugging and visualization:
       optical_flow_predictor_(nullptr),
+      pyramid_frame_id_(0u),
+      pyramid_img_(),
+      pyramid_(),
       display_queue_(display_queue),
       output_images_path_("./outputImages/") {
   // Create the optical flow prediction module
@@ -115,21 +118,55 @@ void Tracker::featureTracking(Frame* ref_frame,
   std::vector<uchar> status;
   std::vector<float> error;
   auto time_lukas_kanade_tic = utils::Timer::tic();
-  cv::calcOpticalFlowPyrLK(ref_frame->img_,
-                           cur_frame->img_,
+  // Build the pyramids explicitly, so that the backward tracking reuses them
+  // and the current pyramid is kept as the reference one of the next call.
+  std::vector<cv::Mat> ref_pyramid;
+  int max_level = tracker_params_.klt_max_level_;
+  if (ref_frame->id_ == pyramid_frame_id_ && !pyramid_.empty() &&
+      ref_frame->img_.data == pyramid_img_.data) {
+    ref_pyramid.swap(pyramid_);
+  } else {
+    max_level = cv::buildOpticalFlowPyramid(
+        ref_frame->img_, ref_pyramid, klt_window_size, max_level);
+  }
+  std::vector<cv::Mat> cur_pyramid;
+  max_level = cv::buildOpticalFlowPyramid(
+      cur_frame->img_, cur_pyramid, klt_window_size, max_level);
+  cv::calcOpticalFlowPyrLK(ref_pyramid,
+                           cur_pyramid,
                            px_ref,
                            px_cur,
                            status,
                            error,
                            klt_window_size,
-                           tracker_params_.klt_max_level_,
+                           max_level,
                            kTerminationCriteria,
                            cv::OPTFLOW_USE_INITIAL_FLOW);
   VLOG(1) << "Optical Flow Timing [ms]: "
           << utils::Timer::toc(time_lukas_kanade_tic).count();
   VLOG(2) << "Finished Optical Flow Pyr LK tracking.";
 
-  // TODO(Toni): use the error to further take only the best tracks?
+  // Drop the tracks that are too long before spending time checking them.
+  for (size_t i = 0u; i < indices_of_valid_landmarks.size(); ++i) {
+    const size_t& lmk_age =
+        ref_frame->landmarks_age_[indices_of_valid_landmarks[i]];
+    if (lmk_age > tracker_params_.maxFeatureAge_) status[i] = 0u;
+  }
+
+  // Reject drifted and occluded tracks before they reach RANSAC.
+  debug_info_.nrKltErrorPrunedFeatures_ =
+      pruneTracksByKltError(error, &status);
+  debug_info_.nrKltFbRejectedFeatures_ = forwardBackwardCheck(
+      ref_pyramid, cur_pyramid, max_level, px_ref, px_cur, error, &status);
+  VLOG(5) << "featureTracking: pruned "
+          << debug_info_.nrKltErrorPrunedFeatures_
+          << " tracks by KLT error, and rejected "
+          << debug_info_.nrKltFbRejectedFeatures_
+          << " tracks by forward-backward check.";
+
+  pyramid_frame_id_ = cur_frame->id_;
+  pyramid_img_ = cur_frame->img_;
+  pyramid_.swap(cur_pyramid);
 
   // At this point cur_frame should have no keypoints...
   CHECK(cur_frame->keypoints_.empty());
@@ -189,6 +226,111 @@ void Tracker::featureTracking(Frame* ref_frame,
   debug_info_.featureTrackingTime_ = utils::Timer::toc(tic).count();
 }
 
+size_t Tracker::pruneTracksByKltError(const std::vector<float>& error,
+                                      std::vector<uchar>* status) const {
+  CHECK_NOTNULL(status);
+  CHECK_EQ(error.size(), status->size());
+  if (tracker_params_.klt_error_pruning_factor_ <= 0.0) return 0u;
+
+  // The error is only meaningful for the tracked points.
+  std::vector<float> tracked_error;
+  tracked_error.reserve(error.size());
+  for (size_t i = 0u; i < error.size(); ++i) {
+    if ((*status)[i]) tracked_error.push_back(error[i]);
+  }
+  if (tracked_error.empty()) return 0u;
+  const auto median_it = tracked_error.begin() + tracked_error.size() / 2u;
+  std::nth_element(tracked_error.begin(), median_it, tracked_error.end());
+  // The floor keeps good tracks when most errors are tiny (e.g. a static
+  // camera on a textured scene).
+  const float max_error = static_cast<float>(
+      std::max(tracker_params_.klt_error_pruning_factor_ * (*median_it),
+               tracker_params_.klt_error_pruning_min_error_));
+
+  size_t nr_pruned_tracks = 0u;
+  for (size_t i = 0u; i < error.size(); ++i) {
+    if ((*status)[i] && error[i] > max_error) {
+      (*status)[i] = 0u;
+      ++nr_pruned_tracks;
+    }
+  }
+  return nr_pruned_tracks;
+}
+
+size_t Tracker::forwardBackwardCheck(const std::vector<cv::Mat>& ref_pyramid,
+                                     const std::vector<cv::Mat>& cur_pyramid,
+                                     const int& max_level,
+                                     const KeypointsCV& px_ref,
+                                     const KeypointsCV& px_cur,
+                                     const std::vector<float>& error,
+                                     std::vector<uchar>* status) const {
+  CHECK_NOTNULL(status);
+  CHECK_EQ(px_ref.size(), status->size());
+  CHECK_EQ(px_cur.size(), status->size());
+  CHECK_EQ(error.size(), status->size());
+  if (tracker_params_.klt_fb_threshold_ <= 0.0) return 0u;
+
+  // Spend the budget on the tracks most likely to be wrong: the ones with
+  // largest KLT error.
+  std::vector<size_t> checked_tracks;
+  checked_tracks.reserve(status->size());
+  for (size_t i = 0u; i < status->size(); ++i) {
+    if ((*status)[i]) checked_tracks.push_back(i);
+  }
+  const auto by_decreasing_error = [&error](const size_t& a, const size_t& b) {
+    return error[a] > error[b];
+  };
+  if (tracker_params_.klt_fb_max_tracks_ >= 0 &&
+      checked_tracks.size() >
+          static_cast<size_t>(tracker_params_.klt_fb_max_tracks_)) {
+    const auto budget_end =
+        checked_tracks.begin() + tracker_params_.klt_fb_max_tracks_;
+    std::nth_element(checked_tracks.begin(),
+                     budget_end,
+                     checked_tracks.end(),
+                     by_decreasing_error);
+    checked_tracks.erase(budget_end, checked_tracks.end());
+  }
+  if (checked_tracks.empty()) return 0u;
+
+  // Track back from the current frame, starting at the reference keypoints.
+  KeypointsCV px_cur_checked, px_back;
+  px_cur_checked.reserve(checked_tracks.size());
+  px_back.reserve(checked_tracks.size());
+  for (const size_t& i : checked_tracks) {
+    px_cur_checked.push_back(px_cur[i]);
+    px_back.push_back(px_ref[i]);
+  }
+  std::vector<uchar> status_back;
+  std::vector<float> error_back;
+  cv::calcOpticalFlowPyrLK(
+      cur_pyramid,
+      ref_pyramid,
+      px_cur_checked,
+      px_back,
+      status_back,
+      error_back,
+      cv::Size2i(tracker_params_.klt_win_size_, tracker_params_.klt_win_size_),
+      max_level,
+      cv::TermCriteria(cv::TermCriteria::COUNT + cv::TermCriteria::EPS,
+                       tracker_params_.klt_max_iter_,
+                       tracker_params_.klt_eps_),
+      cv::OPTFLOW_USE_INITIAL_FLOW);
+
+  const double max_sq_distance =
+      tracker_params_.klt_fb_threshold_ * tracker_params_.klt_fb_threshold_;
+  size_t nr_rejected_tracks = 0u;
+  for (size_t j = 0u; j < checked_tracks.size(); ++j) {
+    const size_t& i = checked_tracks[j];
+    const cv::Point2f delta = px_back[j] - px_ref[i];
+    if (!status_back[j] || delta.dot(delta) > max_sq_distance) {
+      (*status)[i] = 0u;
+      ++nr_rejected_tracks;
+    }
+  }
+  return nr_rejected_tracks;
+}
+
 // TODO(Toni): this function is almost a replica of the Stereo version,
 // factorize.
 std::pair<TrackingStatus, gtsam::Pose3> Tracker::geometricOutlierRejectionMono(
@@ -377,34 +519,77 @@ std::pair<Vector3, Matrix3> Tracker::getPoint3AndCovariance(
     const size_t pointId,
     const Matrix3& stereoPtCov,
     boost::optional<gtsam::Matrix3> Rmat) {
-  gtsam::StereoPoint2 stereoPoint = gtsam::StereoPoint2(
-      static_cast<double>(stereoFrame.left_keypoints_rectified_[pointId].second.x),
-      static_cast<double>(stereoFrame.right_keypoints_rectified_[pointId].second.x),
-      static_cast<double>(
-          stereoFrame.left_keypoints_rectified_[pointId].second.y));  // uL_, uR_, v_;
-
-  Matrix3 Jac_point3_sp2;  // jacobian of the back projection
-  Vector3 point3_i_gtsam =
-      stereoCam.backproject2(stereoPoint, boost::none, Jac_point3_sp2);
-  Vector3 point3_i = stereoFrame.keypoints_3d_.at(pointId);
-  // TODO(Toni): Adapt value of this threshold for different calibration
-  // models!
-  // (1e-1)
-  if ((point3_i_gtsam - point3_i).norm() > 1e-1) {
-    VLOG(5) << "\n point3_i_gtsam \n " << point3_i_gtsam << "\n point3_i \n"
-             << point3_i;
-    LOG(FATAL) << "GetPoint3AndCovariance: inconsistent "
-               << "backprojection results (ref): "
-               << (point3_i_gtsam - point3_i).norm();
-  }
-  if (Rmat) {
-    point3_i = (*Rmat) * point3_i;  // optionally rotated to another ref frame
-    Jac_point3_sp2 = (*Rmat) * Jac_point3_sp2;
-  }
-
-  gtsam::Matrix3 cov_i =
-      Jac_point3_sp2 * stereoPtCov * Jac_point3_sp2.transpose();
-  return std::make_pair(point3_i, cov_i);
+  Vectors3 points;
+  Matrices3 covariances;
+  getPoints3AndCovariances(stereoFrame,
+                           stereoCam,
+                           std::vector<size_t>(1u, pointId),
+                           stereoPtCov,
+                           Rmat,
+                           &points,
+                           &covariances);
+  return std::make_pair(points.front(), covariances.front());
+}
+
+void Tracker::getPoints3AndCovariances(
+    const StereoFrame& stereo_frame,
+    const gtsam::StereoCamera& stereo_cam,
+    const std::vector<size_t>& point_ids,
+    const gtsam::Matrix3& stereo_pt_cov,
+    const boost::optional<gtsam::Matrix3>& R,
+    Vectors3* points,
+    Matrices3* covariances) {
+  CHECK_NOTNULL(points);
+  CHECK_NOTNULL(covariances);
+  const size_t n_points = point_ids.size();
+  points->resize(n_points);
+  covariances->resize(n_points);
+
+  const gtsam::Cal3_S2Stereo& calib = *stereo_cam.calibration();
+  const double fx = calib.fx();
+  const double fy = calib.fy();
+  const double cx = calib.px();
+  const double cy = calib.py();
+  const double fx_b = fx * calib.baseline();
+  // Rotation applied to the Jacobian of the back-projection in the left
+  // camera frame, as StereoCamera::backproject2 does with the camera pose.
+  const Matrix3 R_cam = stereo_cam.pose().rotation().matrix();
+  const Matrix3 R_jac = R ? Matrix3(*R * R_cam) : R_cam;
+
+  Matrix3 D_local_z;
+  for (size_t i = 0u; i < n_points; ++i) {
+    const size_t& point_id = point_ids[i];
+    DCHECK_LT(point_id, stereo_frame.keypoints_3d_.size());
+    const double uL = stereo_frame.left_keypoints_rectified_[point_id].second.x;
+    const double uR =
+        stereo_frame.right_keypoints_rectified_[point_id].second.x;
+    const double v = stereo_frame.left_keypoints_rectified_[point_id].second.y;
+    const double disparity = uL - uR;
+    CHECK_NE(disparity, 0.0) << "Zero disparity for keypoint " << point_id;
+
+    // Back-projection in the left camera frame and its Jacobian wrt
+    // (uL, uR, v), see StereoCamera::backproject2.
+    const double z = fx_b / disparity;
+    const double x = z * (uL - cx) / fx;
+    const double y = z * (v - cy) / fy;
+    D_local_z << -x / disparity + z / fx, x / disparity, 0.0,  //
+        -y / disparity, y / disparity, z / fy,                 //
+        -z / disparity, z / disparity, 0.0;
+
+    const Vector3& point3 = stereo_frame.keypoints_3d_[point_id];
+    // TODO(Toni): Adapt value of this threshold for different calibration
+    // models!
+    DCHECK_LT((stereo_cam.pose().transformFrom(gtsam::Point3(x, y, z)) -
+               gtsam::Point3(point3))
+                  .norm(),
+              1e-1)
+        << "Inconsistent backprojection results for keypoint " << point_id;
+
+    const Matrix3 J = R_jac * D_local_z;
+    // Optionally rotated to another ref frame.
+    (*points)[i] = R ? Vector3(*R * point3) : point3;
+    (*covariances)[i] = J * stereo_pt_cov * J.transpose();
+  }
 }
 
 // TODO(Toni) break down this gargantuan function...
@@ -441,8 +626,33 @@ Tracker::geometricOutlierRejectionStereoGivenRotation(
 
   // NOTE: 3d points are constructed by versors, which are already in the
   // rectified left camera frame. No further rectification needed.
-  Vector3 f_ref_i, R_f_cur_i;
-  Matrix3 cov_ref_i, cov_R_cur_i;
+  std::vector<size_t> ref_ids, cur_ids;
+  ref_ids.reserve(nrMatches);
+  cur_ids.reserve(nrMatches);
+  for (const KeypointMatch& it : matches_ref_cur) {
+    ref_ids.push_back(it.first);
+    cur_ids.push_back(it.second);
+  }
+  // Reference vectors and covariances.
+  Vectors3 f_ref;
+  Matrices3 cov_ref;
+  Tracker::getPoints3AndCovariances(ref_stereoFrame,
+                                    stereoCam,
+                                    ref_ids,
+                                    stereoPtCov,
+                                    boost::none,
+                                    &f_ref,
+                                    &cov_ref);
+  // Current vectors and covariances, rotated to the reference frame.
+  Vectors3 R_f_cur;
+  Matrices3 cov_R_cur;
+  Tracker::getPoints3AndCovariances(cur_stereoFrame,
+                                    stereoCam,
+                                    cur_ids,
+                                    stereoPtCov,
+                                    camLrectlkf_R_camLrectkf.matrix(),
+                                    &R_f_cur,
+                                    &cov_R_cur);
 
   // Relative translation suggested by each match and covariances
   // (DOUBLE FOR PRECISE COV COMPUTATION).
@@ -460,21 +670,10 @@ Tracker::geometricOutlierRejectionStereoGivenRotation(
   Matrices3f cov_relTranf;
   cov_relTranf.reserve(nrMatches);
 
-  for (const KeypointMatch& it : matches_ref_cur) {
-    // Get reference vector and covariance:
-    std::tie(f_ref_i, cov_ref_i) = Tracker::getPoint3AndCovariance(
-        ref_stereoFrame, stereoCam, it.first, stereoPtCov);
-    // Get current vectors and covariance:
-    std::tie(R_f_cur_i, cov_R_cur_i) =
-        Tracker::getPoint3AndCovariance(cur_stereoFrame,
-                                        stereoCam,
-                                        it.second,
-                                        stereoPtCov,
-                                        camLrectlkf_R_camLrectkf.matrix());
-
+  for (size_t i = 0u; i < nrMatches; ++i) {
     // Populate relative translation estimates and their covariances.
-    Vector3 v = f_ref_i - R_f_cur_i;
-    Matrix3 M = cov_R_cur_i + cov_ref_i;
+    Vector3 v = f_ref[i] - R_f_cur[i];
+    Matrix3 M = cov_R_cur[i] + cov_ref[i];
 
     relTran.push_back(v);
     cov_relTran.push_back(M);
@@ -491,16 +690,6 @@ Tracker::geometricOutlierRejectionStereoGivenRotation(
   //============================================================================
   auto time_voting_tic = utils::Timer::tic();
 
-  std::vector<std::vector<int>> coherentSet;
-  // (THIS MUST BE RESIZE - fixed size) number of other translations
-  // consistent with current one.
-  coherentSet.resize(nrMatches);
-  for (size_t i = 0; i < nrMatches; i++) coherentSet.at(i).reserve(nrMatches);
-
-  size_t maxCoherentSetSize = 0;
-  size_t maxCoherentSetId = 0;
-  // double timeMahalanobis = 0, timeAllocate = 0, timePushBack = 0,
-  // timeMaxSet = 0;
   float threshold = static_cast<float>(
       tracker_params_
           .ransac_threshold_stereo_);  // residual should be distributed
@@ -509,59 +698,12 @@ Tracker::geometricOutlierRejectionStereoGivenRotation(
   // considering a tail probability of 0.1, we get this value (x =
   // chi2inv(0.9,3) = 6.2514
 
-  Vector3f v;
-  Matrix3f O;  // allocate just once
-  Vector3f relTran_i;
-  Matrix3f cov_relTran_i;
-  float dinv, innovationMahalanobisNorm;  // define just once
-  for (size_t i = 0; i < nrMatches; i++) {
-    relTran_i = relTranf.at(i);
-    cov_relTran_i = cov_relTranf.at(i);
-    coherentSet.at(i).push_back(i);  // vector is coherent with itself for sure
-    for (size_t j = i + 1; j < nrMatches;
-         j++) {  // look at the other vectors (quadratic complexity)
-      // timeBefore = UtilsOpenCV::GetTimeInSeconds();
-      v = relTran_i - relTranf.at(j);          // relTranMismatch_ij
-      O = cov_relTran_i + cov_relTranf.at(j);  // cov_relTran_j
-      // timeAllocate += UtilsOpenCV::GetTimeInSeconds() - timeBefore;
-
-      // see testTracker for different implementations and timing for the
-      // mahalanobis distance
-      // timeBefore = UtilsOpenCV::GetTimeInSeconds();
-      dinv = 1 / (O(0, 0) * (O(1, 1) * O(2, 2) - O(1, 2) * O(2, 1)) -
-                  O(1, 0) * (O(0, 1) * O(2, 2) - O(0, 2) * O(2, 1)) +
-                  O(2, 0) * (O(0, 1) * O(1, 2) - O(1, 1) * O(0, 2)));
-      innovationMahalanobisNorm =
-          dinv * v(0) * (v(0) * (O(1, 1) * O(2, 2) - O(1, 2) * O(2, 1)) -
-                         v(1) * (O(0, 1) * O(2, 2) - O(0, 2) * O(2, 1)) +
-                         v(2) * (O(0, 1) * O(1, 2) - O(1, 1) * O(0, 2))) +
-          dinv * v(1) * (O(0, 0) * (v(1) * O(2, 2) - O(1, 2) * v(2)) -
-                         O(1, 0) * (v(0) * O(2, 2) - O(0, 2) * v(2)) +
-                         O(2, 0) * (v(0) * O(1, 2) - v(1) * O(0, 2))) +
-          dinv * v(2) * (O(0, 0) * (O(1, 1) * v(2) - v(1) * O(2, 1)) -
-                         O(1, 0) * (O(0, 1) * v(2) - v(0) * O(2, 1)) +
-                         O(2, 0) * (O(0, 1) * v(1) - O(1, 1) * v(0)));
-      // timeMahalanobis += UtilsOpenCV::GetTimeInSeconds() - timeBefore;
-
-      // timeBefore = UtilsOpenCV::GetTimeInSeconds();
-      if (innovationMahalanobisNorm < threshold) {
-        coherentSet.at(i).push_back(j);
-        coherentSet.at(j).push_back(i);  // norm is symmetric
-      }
-      // timePushBack += UtilsOpenCV::GetTimeInSeconds() - timeBefore;
-    }
-    // timeBefore = UtilsOpenCV::GetTimeInSeconds();
-    if (coherentSet.at(i).size() > maxCoherentSetSize) {
-      maxCoherentSetSize = coherentSet.at(i).size();
-      maxCoherentSetId = i;
-    }
-    // timeMaxSet += UtilsOpenCV::GetTimeInSeconds() - timeBefore;
-  }
-  // std::cout << "timeMahalanobis: " << timeMahalanobis << std::endl
-  //<< "timeAllocate: " << timeAllocate << std::endl
-  //<< "timePushBack: " << timePushBack << std::endl
-  //<< "timeMaxSet: " << timeMaxSet << std::endl
-  //<< " relTran.size(): " << relTran.size() << std::endl;
+  // Inliers are max coherent set, sorted.
+  std::vector<int> inliers;
+  const size_t maxCoherentSetSize =
+      translation_voting_.vote(relTranf, cov_relTranf, threshold, &inliers);
+  VLOG(10) << "Translation voting: " << translation_voting_.getNrTestedPairs()
+           << " Mahalanobis norms for " << nrMatches << " hypotheses.";
 
   double time_voting_p = utils::Timer::toc(time_voting_tic).count();
 
@@ -577,14 +719,6 @@ Tracker::geometricOutlierRejectionStereoGivenRotation(
         gtsam::Matrix3::Zero());
   }
 
-  // Inliers are max coherent set.
-  std::vector<int> inliers = coherentSet.at(maxCoherentSetId);
-
-  // Sort inliers.
-  std::sort(inliers.begin(), inliers.end());
-  // UtilsOpenCV::PrintVector<int>(inliers,"inliers");
-  // std::cout << "maxCoherentSetId: " << maxCoherentSetId << std::endl;
-
   VLOG(5) << "RANSAC (STEREO): #iter = " << 1 << '\n'
            << " #inliers = " << inliers.size()
            << "\n #outliers = " << inliers.size() - matches_ref_cur.size()
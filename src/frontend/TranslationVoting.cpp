@@ -0,0 +1,304 @@
+/* ----------------------------------------------------------------------------
+ * Copyright 2017, Massachusetts Institute of Technology,
+ * Cambridge, MA 02139
+ * All Rights Reserved
+ * Authors: Luca Carlone, et al. (see THANKS for the full author list)
+ * See LICENSE for the license information
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @file   TranslationVoting.cpp
+ * @brief  Voting of relative translation hypotheses for 1-point stereo RANSAC.
+ * @author Antoni Rosinol
+ */
+
+#include "kimera-vio/frontend/TranslationVoting.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <glog/logging.h>
+
+namespace VIO {
+
+namespace {
+//! Hypotheses whose covariance bound is above this quantile are not put in the
+//! grid, they are tested against all other hypotheses.
+constexpr float kGridQuantile = 0.9f;
+//! Relative margin on the cell size, to absorb the rounding errors of the
+//! float Mahalanobis norm.
+constexpr float kCellMargin = 1e-2f;
+//! Cell coordinates are kept small enough not to overflow int32_t.
+constexpr float kMaxCellCoordinate = static_cast<float>(1 << 20);
+}  // namespace
+
+/* -------------------------------------------------------------------------- */
+size_t TranslationVoting::vote(const Vectors3f& translations,
+                               const Matrices3f& covariances,
+                               const float& threshold,
+                               std::vector<int>* inliers) {
+  CHECK_NOTNULL(inliers);
+  CHECK_EQ(translations.size(), covariances.size());
+  inliers->clear();
+  nr_tested_pairs_ = 0u;
+  threshold_ = threshold;
+  const size_t n = translations.size();
+  if (n == 0u) return 0u;
+
+  buildGrid(translations, covariances);
+
+  // Every hypothesis is coherent with itself.
+  coherent_set_sizes_.assign(n, 1u);
+  coherent_.resize(n);
+
+  // Hypotheses in the grid can only be coherent with hypotheses in the grid
+  // that are in a neighbouring cell. Each pair is tested once: from the
+  // hypothesis first in sorted order if both are in the same cell, otherwise
+  // from the one whose cell has the other in the positive half of its
+  // neighbourhood.
+  for (size_t i = 0u; i < nr_in_grid_; ++i) {
+    const size_t end =
+        bucket_start_[getBucket(cx_[i], cy_[i], cz_[i]) + 1u];
+    if (testBatch(i, i + 1u, end, true, cx_[i], cy_[i], cz_[i]) > 0u) {
+      countBatch(i, i + 1u, end);
+    }
+    for (int32_t dx = 0; dx <= 1; ++dx) {
+      for (int32_t dy = -dx; dy <= 1; ++dy) {
+        for (int32_t dz = (dx == 0 && dy == 0) ? 1 : -1; dz <= 1; ++dz) {
+          const int32_t cx = cx_[i] + dx;
+          const int32_t cy = cy_[i] + dy;
+          const int32_t cz = cz_[i] + dz;
+          const size_t bucket = getBucket(cx, cy, cz);
+          const size_t begin = bucket_start_[bucket];
+          const size_t end = bucket_start_[bucket + 1u];
+          // Different cells may share a bucket: only count the given cell.
+          if (testBatch(i, begin, end, true, cx, cy, cz) > 0u) {
+            countBatch(i, begin, end);
+          }
+        }
+      }
+    }
+  }
+
+  // Hypotheses out of the grid are tested against all the others.
+  for (size_t i = nr_in_grid_; i < n; ++i) {
+    if (testBatch(i, 0u, nr_in_grid_, false, 0, 0, 0) > 0u) {
+      countBatch(i, 0u, nr_in_grid_);
+    }
+    if (testBatch(i, i + 1u, n, false, 0, 0, 0) > 0u) {
+      countBatch(i, i + 1u, n);
+    }
+  }
+
+  // Ties keep the first hypothesis.
+  size_t best = 0u;
+  for (size_t i = 1u; i < n; ++i) {
+    if (coherent_set_sizes_[i] > coherent_set_sizes_[best]) best = i;
+  }
+
+  // Recover the coherent set of the best hypothesis with a linear pass.
+  const size_t best_sorted =
+      std::find(idx_.begin(), idx_.end(), static_cast<int>(best)) -
+      idx_.begin();
+  DCHECK_LT(best_sorted, n);
+  testBatch(best_sorted, 0u, n, false, 0, 0, 0);
+  inliers->reserve(coherent_set_sizes_[best]);
+  inliers->push_back(best);
+  for (size_t k = 0u; k < n; ++k) {
+    if (coherent_[k] && k != best_sorted) inliers->push_back(idx_[k]);
+  }
+  std::sort(inliers->begin(), inliers->end());
+  return inliers->size();
+}
+
+/* -------------------------------------------------------------------------- */
+void TranslationVoting::buildGrid(const Vectors3f& translations,
+                                  const Matrices3f& covariances) {
+  const size_t n = translations.size();
+
+  // Since (C_i + C_j)^-1 >= I / trace(C_i + C_j), hypotheses i and j can only
+  // be coherent if |t_i - t_j|^2 < bounds_[i] + bounds_[j].
+  bounds_.resize(n);
+  for (size_t i = 0u; i < n; ++i) {
+    const Matrix3f& cov = covariances[i];
+    const float bound = threshold_ * (cov(0, 0) + cov(1, 1) + cov(2, 2));
+    // Invalid covariances are kept out of the grid.
+    bounds_[i] = bound >= 0.0f ? bound : std::numeric_limits<float>::infinity();
+  }
+  sorted_bounds_.assign(bounds_.begin(), bounds_.end());
+  const size_t quantile_idx = static_cast<size_t>(kGridQuantile * (n - 1u));
+  std::nth_element(sorted_bounds_.begin(),
+                   sorted_bounds_.begin() + quantile_idx,
+                   sorted_bounds_.end());
+  const float max_bound = sorted_bounds_[quantile_idx];
+
+  // Two hypotheses with bounds below max_bound can only be coherent if they
+  // are closer than the cell size, hence in neighbouring cells.
+  const float cell_size = std::sqrt(2.0f * max_bound * (1.0f + kCellMargin));
+  const bool use_grid = std::isfinite(cell_size) && cell_size > 0.0f;
+
+  size_t nr_in_grid = 0u;
+  cells_.resize(3u * n);
+  in_grid_.resize(n);
+  for (size_t i = 0u; i < n; ++i) {
+    in_grid_[i] = 0u;
+    if (!use_grid || !(bounds_[i] <= max_bound)) continue;
+    const float fx = std::floor(translations[i](0) / cell_size);
+    const float fy = std::floor(translations[i](1) / cell_size);
+    const float fz = std::floor(translations[i](2) / cell_size);
+    // Also rejects NaNs.
+    if (!(std::abs(fx) < kMaxCellCoordinate &&
+          std::abs(fy) < kMaxCellCoordinate &&
+          std::abs(fz) < kMaxCellCoordinate)) {
+      continue;
+    }
+    cells_[3u * i] = static_cast<int32_t>(fx);
+    cells_[3u * i + 1u] = static_cast<int32_t>(fy);
+    cells_[3u * i + 2u] = static_cast<int32_t>(fz);
+    in_grid_[i] = 1u;
+    ++nr_in_grid;
+  }
+  nr_in_grid_ = nr_in_grid;
+
+  // Keep the load factor of the hash table below 0.5.
+  nr_buckets_ = 1u;
+  while (nr_buckets_ < 2u * nr_in_grid_) nr_buckets_ <<= 1u;
+
+  // Counting sort by bucket, the hypotheses out of the grid go to an extra
+  // last bucket. After sorting, bucket b is [bucket_start_[b],
+  // bucket_start_[b + 1]).
+  buckets_.resize(n);
+  bucket_start_.assign(nr_buckets_ + 2u, 0u);
+  for (size_t i = 0u; i < n; ++i) {
+    buckets_[i] = in_grid_[i] ? getBucket(cells_[3u * i],
+                                          cells_[3u * i + 1u],
+                                          cells_[3u * i + 2u])
+                              : nr_buckets_;
+    ++bucket_start_[buckets_[i] + 1u];
+  }
+  for (size_t b = 1u; b < bucket_start_.size(); ++b) {
+    bucket_start_[b] += bucket_start_[b - 1u];
+  }
+  // Shift by one bucket, so that incrementing while placing leaves the bucket
+  // starts in place.
+  for (size_t b = bucket_start_.size() - 1u; b > 0u; --b) {
+    bucket_start_[b] = bucket_start_[b - 1u];
+  }
+
+  tx_.resize(n);
+  ty_.resize(n);
+  tz_.resize(n);
+  for (std::vector<float>& cov : cov_) cov.resize(n);
+  cx_.resize(n);
+  cy_.resize(n);
+  cz_.resize(n);
+  idx_.resize(n);
+  for (size_t i = 0u; i < n; ++i) {
+    const size_t k = bucket_start_[buckets_[i] + 1u]++;
+    tx_[k] = translations[i](0);
+    ty_[k] = translations[i](1);
+    tz_[k] = translations[i](2);
+    for (size_t r = 0u; r < 3u; ++r) {
+      for (size_t c = 0u; c < 3u; ++c) {
+        cov_[3u * r + c][k] = covariances[i](r, c);
+      }
+    }
+    cx_[k] = cells_[3u * i];
+    cy_[k] = cells_[3u * i + 1u];
+    cz_[k] = cells_[3u * i + 2u];
+    idx_[k] = i;
+  }
+  DCHECK_EQ(bucket_start_[nr_buckets_], nr_in_grid_);
+  DCHECK_EQ(bucket_start_[nr_buckets_ + 1u], n);
+}
+
+/* -------------------------------------------------------------------------- */
+size_t TranslationVoting::testBatch(const size_t& i,
+                                    const size_t& begin,
+                                    const size_t& end,
+                                    const bool& check_cell,
+                                    const int32_t& cx,
+                                    const int32_t& cy,
+                                    const int32_t& cz) {
+  DCHECK_LE(begin, end);
+  DCHECK_LE(end - begin, coherent_.size());
+  nr_tested_pairs_ += end - begin;
+
+  const float t0 = tx_[i], t1 = ty_[i], t2 = tz_[i];
+  const float c00 = cov_[0][i], c01 = cov_[1][i], c02 = cov_[2][i];
+  const float c10 = cov_[3][i], c11 = cov_[4][i], c12 = cov_[5][i];
+  const float c20 = cov_[6][i], c21 = cov_[7][i], c22 = cov_[8][i];
+  const float threshold = threshold_;
+  // Local copies, as the stores below could alias the references.
+  const size_t first = begin, last = end;
+  const bool any_cell = !check_cell;
+  const int32_t qx = cx, qy = cy, qz = cz;
+
+  // Plain pointers and branchless masks, so that the loop vectorizes. The
+  // mask is stored as int32_t: float loads cannot alias it, which keeps the
+  // run-time alias checks few.
+  const float* tx = tx_.data();
+  const float* ty = ty_.data();
+  const float* tz = tz_.data();
+  const float* o00 = cov_[0].data();
+  const float* o01 = cov_[1].data();
+  const float* o02 = cov_[2].data();
+  const float* o10 = cov_[3].data();
+  const float* o11 = cov_[4].data();
+  const float* o12 = cov_[5].data();
+  const float* o20 = cov_[6].data();
+  const float* o21 = cov_[7].data();
+  const float* o22 = cov_[8].data();
+  const int32_t* cell_x = cx_.data();
+  const int32_t* cell_y = cy_.data();
+  const int32_t* cell_z = cz_.data();
+  int32_t* coherent = coherent_.data();
+
+  size_t nr_coherent = 0u;
+  for (size_t k = first; k < last; ++k) {
+    const float v0 = t0 - tx[k];
+    const float v1 = t1 - ty[k];
+    const float v2 = t2 - tz[k];
+    const float O00 = c00 + o00[k], O01 = c01 + o01[k], O02 = c02 + o02[k];
+    const float O10 = c10 + o10[k], O11 = c11 + o11[k], O12 = c12 + o12[k];
+    const float O20 = c20 + o20[k], O21 = c21 + o21[k], O22 = c22 + o22[k];
+    // Closed-form Mahalanobis norm, see testTracker for the timing of other
+    // implementations.
+    const float dinv = 1 / (O00 * (O11 * O22 - O12 * O21) -
+                            O10 * (O01 * O22 - O02 * O21) +
+                            O20 * (O01 * O12 - O11 * O02));
+    const float innovation_mahalanobis_norm =
+        dinv * v0 * (v0 * (O11 * O22 - O12 * O21) -
+                     v1 * (O01 * O22 - O02 * O21) +
+                     v2 * (O01 * O12 - O11 * O02)) +
+        dinv * v1 * (O00 * (v1 * O22 - O12 * v2) -
+                     O10 * (v0 * O22 - O02 * v2) +
+                     O20 * (v0 * O12 - v1 * O02)) +
+        dinv * v2 * (O00 * (O11 * v2 - v1 * O21) -
+                     O10 * (O01 * v2 - v0 * O21) +
+                     O20 * (O01 * v1 - O11 * v0));
+    const bool in_cell =
+        any_cell | ((cell_x[k] == qx) & (cell_y[k] == qy) & (cell_z[k] == qz));
+    const int32_t is_coherent =
+        (innovation_mahalanobis_norm < threshold) & in_cell;
+    coherent[k - first] = is_coherent;
+    nr_coherent += is_coherent;
+  }
+  return nr_coherent;
+}
+
+/* -------------------------------------------------------------------------- */
+void TranslationVoting::countBatch(const size_t& i,
+                                   const size_t& begin,
+                                   const size_t& end) {
+  size_t& coherent_set_size_i = coherent_set_sizes_[idx_[i]];
+  for (size_t k = begin; k < end; ++k) {
+    if (coherent_[k - begin]) {
+      ++coherent_set_size_i;
+      ++coherent_set_sizes_[idx_[k]];
+    }
+  }
+}
+
+}  // namespace VIO
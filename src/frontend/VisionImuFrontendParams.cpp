@@ -40,6 +40,14 @@ void FrontendParams::print() const {
                         klt_eps_,
                         "maxFeatureAge_: ",
                         maxFeatureAge_,
+                        "klt_error_pruning_factor_: ",
+                        klt_error_pruning_factor_,
+                        "klt_error_pruning_min_error_: ",
+                        klt_error_pruning_min_error_,
+                        "klt_fb_threshold_: ",
+                        klt_fb_threshold_,
+                        "klt_fb_max_tracks_: ",
+                        klt_fb_max_tracks_,
                         "Optical Flow Predictor Type",
                         VIO::to_underlying(optical_flow_predictor_type_),
                         // RANSAC params
@@ -92,6 +100,12 @@ bool FrontendParams::parseYAML(const std::string& filepath) {
   yaml_parser.getYamlParam("klt_max_level", &klt_max_level_);
   yaml_parser.getYamlParam("klt_eps", &klt_eps_);
   yaml_parser.getYamlParam("maxFeatureAge", &maxFeatureAge_);
+  yaml_parser.getYamlParam("klt_error_pruning_factor",
+                           &klt_error_pruning_factor_);
+  yaml_parser.getYamlParam("klt_error_pruning_min_error",
+                           &klt_error_pruning_min_error_);
+  yaml_parser.getYamlParam("klt_fb_threshold", &klt_fb_threshold_);
+  yaml_parser.getYamlParam("klt_fb_max_tracks", &klt_fb_max_tracks_);
 
   yaml_parser.getYamlParam("useRANSAC", &useRANSAC_);
   yaml_parser.getYamlParam("minNrMonoInliers", &minNrMonoInliers_);
@@ -145,6 +159,12 @@ bool FrontendParams::equals(const FrontendParams& tp2, double tol) const {
          (klt_max_level_ == tp2.klt_max_level_) &&
          (fabs(klt_eps_ - tp2.klt_eps_) <= tol) &&
          (maxFeatureAge_ == tp2.maxFeatureAge_) &&
+         (fabs(klt_error_pruning_factor_ - tp2.klt_error_pruning_factor_) <=
+          tol) &&
+         (fabs(klt_error_pruning_min_error_ -
+               tp2.klt_error_pruning_min_error_) <= tol) &&
+         (fabs(klt_fb_threshold_ - tp2.klt_fb_threshold_) <= tol) &&
+         (klt_fb_max_tracks_ == tp2.klt_fb_max_tracks_) &&
          // stereo matching
          stereo_matching_params_.equals(tp2.stereo_matching_params_, tol) &&
          // RANSAC parameters
@@ -15,12 +15,21 @@
 
 #include "kimera-vio/imu-frontend/ImuFrontend.h"
 
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 
+#include <gtsam/config.h>
+
 #include "kimera-vio/common/vio_types.h"
 #include "kimera-vio/imu-frontend/ImuFrontend-definitions.h"
 #include "kimera-vio/utils/UtilsNumerical.h"
 
+DEFINE_bool(imu_correct_in_flight_pim_bias,
+            true,
+            "Correct the preintegration in progress to first order when the "
+            "Backend publishes a new IMU bias, instead of waiting for the next "
+            "keyframe to reset it.");
+
 namespace VIO {
 
 /* -------------------------------------------------------------------------- */
@@ -34,7 +43,7 @@ void ImuData::print() const {
 }
 
 ImuFrontend::ImuFrontend(const ImuParams& imu_params, const ImuBias& imu_bias)
-    : imu_params_(imu_params) {
+    : imu_params_(imu_params), latest_imu_bias_version_(0u) {
   CHECK_GT(imu_params.acc_noise_density_, 0.0);
   CHECK_GT(imu_params.acc_random_walk_, 0.0);
   CHECK_GT(imu_params.gyro_noise_density_, 0.0);
@@ -63,10 +72,9 @@ void ImuFrontend::initializeImuFrontend(const ImuBias& imu_bias) {
     }
   }
   CHECK(pim_);
-  {
-    std::lock_guard<std::mutex> lock(imu_bias_mutex_);
-    latest_imu_bias_ = imu_bias;
-  }
+  std::atomic_store(&latest_imu_bias_,
+                    std::make_shared<const ImuBias>(imu_bias));
+  pim_bias_version_ = latest_imu_bias_version_.load(std::memory_order_acquire);
   if (VLOG_IS_ON(10)) {
     LOG(ERROR) << "IMU PREINTEGRATION PARAMS GIVEN TO IMU Frontend.";
     imu_params_.print();
@@ -88,6 +96,7 @@ ImuFrontend::PimPtr ImuFrontend::preintegrateImuMeasurements(
   CHECK(pim_) << "Pim not initialized.";
   CHECK(imu_stamps.cols() >= 2) << "No Imu data found.";
   CHECK(imu_accgyr.cols() >= 2) << "No Imu data found.";
+  if (FLAGS_imu_correct_in_flight_pim_bias) correctPimWithLatestBias();
   // TODO why are we not using the last measurement??
   // Just because we do not have a future imu_stamp??
   // This can be a feature instead of a bug, in the sense that the user can then
@@ -133,9 +142,9 @@ gtsam::Rot3 ImuFrontend::preintegrateGyroMeasurements(
     const ImuAccGyrS& imu_accgyr) {
   CHECK(imu_stamps.cols() >= 2) << "No Imu data found.";
   CHECK(imu_accgyr.cols() >= 2) << "No Imu data found.";
-  std::lock_guard<std::mutex> lock(imu_bias_mutex_);
-  gtsam::PreintegratedAhrsMeasurements pim_rot(latest_imu_bias_.gyroscope(),
-                                              gtsam::Matrix3::Identity());
+  gtsam::PreintegratedAhrsMeasurements pim_rot(
+      std::atomic_load(&latest_imu_bias_)->gyroscope(),
+      gtsam::Matrix3::Identity());
   for (int i = 0; i < imu_stamps.cols() - 1; ++i) {
     const gtsam::Vector3& measured_omega = imu_accgyr.block<3, 1>(3, i);
     const double& delta_t =
@@ -150,6 +159,55 @@ gtsam::Rot3 ImuFrontend::preintegrateGyroMeasurements(
   return pim_rot.deltaRij();
 }
 
+/* -------------------------------------------------------------------------- */
+// gtsam only sets biasHat_ and the preintegrated deltas when resetting the
+// whole integration. This struct is never instantiated: its member pointers
+// let us move the linearization point of a pim in progress without
+// re-integrating its measurements.
+struct PimBiasAccessor : public gtsam::PreintegrationType {
+  static void setBiasHat(const ImuBias& bias_hat,
+                         gtsam::PreintegrationType* pim) {
+    CHECK_NOTNULL(pim);
+    pim->*(&PimBiasAccessor::biasHat_) = bias_hat;
+  }
+
+  static void setPreintegrated(const gtsam::Vector9& xi,
+                               gtsam::PreintegrationType* pim) {
+    CHECK_NOTNULL(pim);
+#ifdef GTSAM_TANGENT_PREINTEGRATION
+    pim->*(&PimBiasAccessor::preintegrated_) = xi;
+#else
+    pim->*(&PimBiasAccessor::deltaXij_) =
+        gtsam::NavState(gtsam::Rot3::Expmap(xi.segment<3>(0)),
+                        gtsam::Point3(xi.segment<3>(3)),
+                        gtsam::Vector3(xi.segment<3>(6)));
+#endif
+  }
+};
+
+void ImuFrontend::correctPimWithLatestBias() {
+  const uint64_t version =
+      latest_imu_bias_version_.load(std::memory_order_acquire);
+  if (version == pim_bias_version_) return;
+  pim_bias_version_ = version;
+  const std::shared_ptr<const ImuBias> imu_bias =
+      std::atomic_load(&latest_imu_bias_);
+  if (pim_->deltaTij() == 0.0) {
+    // Nothing integrated yet, no need to correct anything.
+    pim_->resetIntegrationAndSetBias(*imu_bias);
+    return;
+  }
+
+  // biasCorrectedDelta is the first-order correction of the preintegrated
+  // deltas to the given bias. Making it the new linearization point keeps the
+  // bias Jacobians and covariance, which only depend weakly on the bias.
+  const gtsam::Vector9 corrected_delta = pim_->biasCorrectedDelta(*imu_bias);
+  PimBiasAccessor::setPreintegrated(corrected_delta, pim_.get());
+  PimBiasAccessor::setBiasHat(*imu_bias, pim_.get());
+  VLOG(10) << "Corrected in-flight preintegration of " << pim_->deltaTij()
+           << "s to the latest imu bias.";
+}
+
 /* -------------------------------------------------------------------------- */
 gtsam::PreintegrationBase::Params ImuFrontend::convertVioImuParamsToGtsam(
     const ImuParams& imu_params) {
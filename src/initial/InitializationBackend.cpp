@@ -48,14 +48,13 @@ bool InitializationBackend::bundleAdjustmentAndGravityAlignment(
     gtsam::Vector3* gyro_bias,
     gtsam::Vector3* g_iter_b0,
     gtsam::NavState* init_navstate) {
+  CHECK_NOTNULL(gyro_bias);
+  CHECK_NOTNULL(g_iter_b0);
+  CHECK_NOTNULL(init_navstate);
   // Logging
   VLOG(10) << "N frames for initial alignment: " << output_frontend.size();
   // Create inputs for Backend
   std::vector<BackendInput::UniquePtr> inputs_backend;
-
-  // Create inputs for online gravity alignment
-  std::vector<ImuFrontend::PimPtr> pims;
-  std::vector<double> delta_t_camera;
   // Iterate and fill Backend input vector
   while (!output_frontend.empty()) {
     // Create input for Backend
@@ -68,20 +67,39 @@ bool InitializationBackend::bundleAdjustmentAndGravityAlignment(
         init_input_payload.pim_,
         init_input_payload.imu_acc_gyrs_,
         init_input_payload.relative_pose_body_stereo_));
-    pims.push_back(init_input_payload.pim_);
-    // Bookkeeping for timestamps
-    Timestamp timestamp_kf =
-        init_input_payload.stereo_frame_lkf_.timestamp_;
-    delta_t_camera.push_back(
-        UtilsNumerical::NsecToSec(timestamp_kf - timestamp_lkf_));
-    timestamp_lkf_ = timestamp_kf;
-
     // Check that all frames are keyframes (required)
     CHECK(init_input_payload.is_keyframe_);
     // Pop from queue
     output_frontend.pop();
   }
 
+  InitializationAlignmentResult result;
+  bundleAdjustmentAndGravityAlignment(inputs_backend, &result);
+  *gyro_bias = result.gyro_bias_;
+  *g_iter_b0 = result.g_iter_b0_;
+  *init_navstate = result.init_navstate_;
+  return result.is_success_;
+}
+
+/* ------------------------------------------------------------------------ */
+bool InitializationBackend::bundleAdjustmentAndGravityAlignment(
+    const std::vector<BackendInput::UniquePtr>& inputs_backend,
+    InitializationAlignmentResult* result) {
+  CHECK_NOTNULL(result);
+  CHECK(!inputs_backend.empty());
+  // Create inputs for online gravity alignment
+  std::vector<ImuFrontend::PimPtr> pims;
+  std::vector<double> delta_t_camera;
+  for (const BackendInput::UniquePtr& input_backend : inputs_backend) {
+    CHECK(input_backend);
+    pims.push_back(input_backend->pim_);
+    // Bookkeeping for timestamps
+    const Timestamp& timestamp_kf = input_backend->timestamp_;
+    delta_t_camera.push_back(
+        UtilsNumerical::NsecToSec(timestamp_kf - timestamp_lkf_));
+    timestamp_lkf_ = timestamp_kf;
+  }
+
   // TODO(Sandro): Bundle-Adjustment is not super robust and accurate!!!
   // Run initial Bundle Adjustment and retrieve body poses
   // wrt. to initial body frame (b0_T_bk, for k in 0:N).
@@ -105,12 +123,31 @@ bool InitializationBackend::bundleAdjustmentAndGravityAlignment(
   OnlineGravityAlignment initial_alignment(
       estimated_poses, delta_t_camera, pims, imu_params_.n_gravity_);
   auto tic_oga = utils::Timer::tic();
-  bool is_success = initial_alignment.alignVisualInertialEstimates(
-      gyro_bias, g_iter_b0, init_navstate, true);
+  result->is_success_ =
+      initial_alignment.alignVisualInertialEstimates(&result->gyro_bias_,
+                                                     &result->g_iter_b0_,
+                                                     &result->init_navstate_,
+                                                     true);
   auto alignment_duration =
       utils::Timer::toc<std::chrono::nanoseconds>(tic_oga).count() * 1e-9;
   LOG(WARNING) << "Current alignment duration: (" << alignment_duration
                << " s).";
+  if (!result->is_success_) return false;
+
+  // Propagate the aligned state to the last keyframe: poses come from the
+  // bundle adjustment, velocities from the bias-corrected preintegration
+  // between consecutive keyframes (pims[k - 1] goes from k - 1 to k).
+  CHECK_EQ(estimated_poses.size(), pims.size() + 1u);
+  const gtsam::Pose3& w_Pose_b0 = result->init_navstate_.pose();
+  const ImuBias imu_bias(gtsam::Vector3::Zero(), result->gyro_bias_);
+  gtsam::Velocity3 w_vel_bk = result->init_navstate_.velocity();
+  for (size_t k = 1u; k < estimated_poses.size(); ++k) {
+    const gtsam::NavState navstate_km1(
+        w_Pose_b0.compose(estimated_poses.at(k - 1u)), w_vel_bk);
+    w_vel_bk = pims.at(k - 1u)->predict(navstate_km1, imu_bias).velocity();
+  }
+  result->latest_navstate_ =
+      gtsam::NavState(w_Pose_b0.compose(estimated_poses.back()), w_vel_bk);
 
   // TODO(Sandro): Check initialization against GT
   // Compute performance and Log output if requested
@@ -142,7 +179,7 @@ bool InitializationBackend::bundleAdjustmentAndGravityAlignment(
   } */
   ////////////////// (Remove)
 
-  return is_success;
+  return true;
 }
 
 /* -------------------------------------------------------------------------- */
@@ -180,8 +217,7 @@ InitializationBackend::addInitialVisualStatesAndOptimize(
 
   // Add all landmarks to factor graph
   LandmarkIds landmarks_all_keyframes;
-  BOOST_FOREACH (auto keyTrack_j, feature_tracks_)
-    landmarks_all_keyframes.push_back(keyTrack_j.first);
+  feature_tracks_.getLandmarkIds(&landmarks_all_keyframes);
 
   addLandmarksToGraph(landmarks_all_keyframes);
 
@@ -257,8 +293,10 @@ void InitializationBackend::addInitialVisualState(
 
   // extract relevant information from stereo frame
   LandmarkIds landmarks_kf;
-  addStereoMeasurementsToFeatureTracks(
-      curr_kf_id_, smartStereoMeasurements_kf, &landmarks_kf);
+  addStereoMeasurementsToFeatureTracks(curr_kf_id_,
+                                       timestamp_kf_nsec,
+                                       smartStereoMeasurements_kf,
+                                       &landmarks_kf);
 
   // Add zero velocity update if no-motion detected
   TrackingStatus kfTrackingStatus_mono =
@@ -20,12 +20,18 @@
  * @author Luca Carlone
  */
 
+#include <algorithm>
 #include <memory>
 #include <unordered_map>
 
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 
+#include <Eigen/Cholesky>
+#include <Eigen/StdVector>
+
+#include <opencv2/core/utility.hpp>
+
 #include <gtsam/base/Matrix.h>
 #include <gtsam/inference/Symbol.h>
 #include <gtsam/linear/JacobianFactor.h>
@@ -64,9 +70,200 @@ DEFINE_double(gravity_tolerance_refinement,
 DEFINE_double(camera_pim_delta_difference,
               5e-3,
               "Maximum tolerable difference in time interval.");
+DEFINE_double(alignment_min_pivot_ratio,
+              1e-10,
+              "Minimum pivot of the alignment normal equations, relative to"
+              " their largest diagonal entry, below which they are"
+              " considered rank deficient.");
 
 namespace VIO {
 
+namespace {
+
+/* -------------------------------------------------------------------------- */
+// Checks that a factorized block of normal equations is positive definite
+// and not close to rank deficient (e.g. gravity is not observable if the
+// body barely accelerates or rotates).
+// [in] ldlt, factorization of the block.
+// [in] scale, largest diagonal entry of the normal equations, so that
+// pivots are compared across blocks and not only within one block.
+template <typename Ldlt>
+bool isWellConditioned(const Ldlt &ldlt, const double &scale) {
+  if (ldlt.info() != Eigen::Success) return false;
+  return ldlt.vectorD().minCoeff() >
+         FLAGS_alignment_min_pivot_ratio * std::max(scale, 1e-12);
+}
+
+/* -------------------------------------------------------------------------- */
+// Normal equations contribution of a single frame to the linear alignment.
+// Unknowns of a frame are [V_k, V_kp1, g], with g of dimension kGravityDim
+// (3 for the linear alignment, 2 for the refinement in the tangent space).
+template <int kGravityDim>
+struct AlignmentFrameBlock {
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  static constexpr int kDim = 6 + kGravityDim;
+  Eigen::Matrix<double, kDim, kDim> H;
+  Eigen::Matrix<double, kDim, 1> r;
+};
+
+/* -------------------------------------------------------------------------- */
+// Normal equations of the linear alignment, stored by blocks. Consecutive
+// frames only share a velocity, so H is block tridiagonal in the velocities
+// [V_0, ..., V_N], bordered by the gravity unknowns:
+//       | D_0  U_0              B_0 |
+//   H = | U_0' D_1  U_1         B_1 |
+//       |      ...  ...         ... |
+//       | B_0' B_1' ...         G   |
+// Buffers are kept across calls, so that iterative callers do not
+// reallocate.
+template <int kGravityDim>
+struct AlignmentNormalEquations {
+  typedef Eigen::Matrix<double, 3, kGravityDim> BorderBlock;
+  typedef Eigen::Matrix<double, kGravityDim, kGravityDim> GravityBlock;
+  typedef Eigen::Matrix<double, kGravityDim, 1> GravityVector;
+
+  std::vector<AlignmentFrameBlock<kGravityDim>,
+              Eigen::aligned_allocator<AlignmentFrameBlock<kGravityDim>>>
+      frames;
+  std::vector<gtsam::Matrix3, Eigen::aligned_allocator<gtsam::Matrix3>> D;
+  std::vector<gtsam::Matrix3, Eigen::aligned_allocator<gtsam::Matrix3>> U;
+  std::vector<BorderBlock, Eigen::aligned_allocator<BorderBlock>> B;
+  std::vector<gtsam::Vector3, Eigen::aligned_allocator<gtsam::Vector3>> r_v;
+  std::vector<Eigen::LDLT<gtsam::Matrix3>,
+              Eigen::aligned_allocator<Eigen::LDLT<gtsam::Matrix3>>>
+      D_ldlt;
+  GravityBlock G;
+  GravityVector r_g;
+};
+
+/* -------------------------------------------------------------------------- */
+// Solves the linear alignment for [V_0, ..., V_N, g] in the least squares
+// sense, with gravity parametrized as g = g0 + T * x, where x has dimension
+// kGravityDim (T = I and g0 = 0 for the plain linear alignment).
+// Per-frame blocks are computed in parallel, then the velocities are
+// eliminated one block at a time (block tridiagonal LDLT, O(N) with 3x3
+// factorizations), leaving a kGravityDim system for x; velocities are
+// recovered by back-substitution.
+// [in] set of visual inertial frames for alignment.
+// [in] tangent basis T for gravity.
+// [in] gravity offset g0.
+// [in/out] preallocated normal equations.
+// [out] velocities [V_0, ..., V_N].
+// [out] gravity unknowns x.
+// Returns false if the normal equations are rank deficient.
+template <int kGravityDim>
+bool solveAlignmentNormalEquations(
+    const VisualInertialFrames &vi_frames,
+    const Eigen::Matrix<double, 3, kGravityDim> &T,
+    const gtsam::Vector3 &g0,
+    AlignmentNormalEquations<kGravityDim> *normal_equations,
+    std::vector<gtsam::Vector3, Eigen::aligned_allocator<gtsam::Vector3>>
+        *velocities,
+    Eigen::Matrix<double, kGravityDim, 1> *x) {
+  CHECK_NOTNULL(normal_equations);
+  CHECK_NOTNULL(velocities);
+  CHECK_NOTNULL(x);
+  const int n_frames = static_cast<int>(vi_frames.size());
+  CHECK_GT(n_frames, 0);
+  const int n_velocities = n_frames + 1;
+
+  AlignmentNormalEquations<kGravityDim> &ne = *normal_equations;
+  ne.frames.resize(n_frames);
+  ne.D.assign(n_velocities, gtsam::Matrix3::Zero());
+  ne.U.assign(n_frames, gtsam::Matrix3::Zero());
+  ne.B.assign(n_velocities,
+              AlignmentNormalEquations<kGravityDim>::BorderBlock::Zero());
+  ne.r_v.assign(n_velocities, gtsam::Vector3::Zero());
+  ne.D_ldlt.resize(n_velocities);
+  ne.G.setZero();
+  ne.r_g.setZero();
+
+  // Per-frame blocks, independent from each other.
+  cv::parallel_for_(cv::Range(0, n_frames), [&](const cv::Range &range) {
+    for (int i = range.start; i < range.end; ++i) {
+      const VisualInertialFrame &frame_i = vi_frames[i];
+      Eigen::Matrix<double, 6, 6 + kGravityDim> A;
+      A.setZero();
+      Eigen::Matrix<double, 6, 1> b;
+      // Position constraint: [A11, 0, A13 * T].
+      A.template block<3, 3>(0, 0) = frame_i.A11();
+      A.template block<3, kGravityDim>(0, 6) = frame_i.A13() * T;
+      b.template head<3>() = frame_i.b1() - frame_i.A13() * g0;
+      // Velocity constraint: [A21, A22, A23 * T].
+      A.template block<3, 3>(3, 0) = frame_i.A21();
+      A.template block<3, 3>(3, 3) = frame_i.A22();
+      A.template block<3, kGravityDim>(3, 6) = frame_i.A23() * T;
+      b.template tail<3>() = frame_i.b2() - frame_i.A23() * g0;
+      ne.frames[i].H.noalias() = A.transpose() * A;
+      ne.frames[i].r.noalias() = A.transpose() * b;
+    }
+  });
+
+  // Scatter: consecutive frames share a velocity, so this is sequential.
+  for (int i = 0; i < n_frames; ++i) {
+    const AlignmentFrameBlock<kGravityDim> &block = ne.frames[i];
+    ne.D[i] += block.H.template block<3, 3>(0, 0);
+    ne.D[i + 1] += block.H.template block<3, 3>(3, 3);
+    ne.U[i] += block.H.template block<3, 3>(0, 3);
+    ne.B[i] += block.H.template block<3, kGravityDim>(0, 6);
+    ne.B[i + 1] += block.H.template block<3, kGravityDim>(3, 6);
+    ne.G += block.H.template block<kGravityDim, kGravityDim>(6, 6);
+    ne.r_v[i] += block.r.template head<3>();
+    ne.r_v[i + 1] += block.r.template segment<3>(3);
+    ne.r_g += block.r.template tail<kGravityDim>();
+  }
+  double scale = ne.G.diagonal().maxCoeff();
+  for (int k = 0; k < n_velocities; ++k) {
+    scale = std::max(scale, ne.D[k].diagonal().maxCoeff());
+  }
+
+  // Forward elimination of the velocities, the border and right-hand side
+  // are updated in place.
+  for (int k = 0; k < n_velocities; ++k) {
+    ne.D_ldlt[k].compute(ne.D[k]);
+    if (!isWellConditioned(ne.D_ldlt[k], scale)) {
+      LOG(ERROR) << "Alignment normal equations are rank deficient at "
+                    "velocity "
+                 << k << ", pivots: " << ne.D_ldlt[k].vectorD().transpose();
+      return false;
+    }
+    const typename AlignmentNormalEquations<kGravityDim>::BorderBlock
+        Dinv_B = ne.D_ldlt[k].solve(ne.B[k]);
+    const gtsam::Vector3 Dinv_r = ne.D_ldlt[k].solve(ne.r_v[k]);
+    ne.G.noalias() -= ne.B[k].transpose() * Dinv_B;
+    ne.r_g.noalias() -= ne.B[k].transpose() * Dinv_r;
+    if (k + 1 < n_velocities) {
+      const gtsam::Matrix3 Dinv_U = ne.D_ldlt[k].solve(ne.U[k]);
+      ne.D[k + 1].noalias() -= ne.U[k].transpose() * Dinv_U;
+      ne.B[k + 1].noalias() -= ne.U[k].transpose() * Dinv_B;
+      ne.r_v[k + 1].noalias() -= ne.U[k].transpose() * Dinv_r;
+    }
+  }
+
+  // Reduced system for the gravity unknowns.
+  const Eigen::LDLT<
+      typename AlignmentNormalEquations<kGravityDim>::GravityBlock>
+      G_ldlt(ne.G);
+  if (!isWellConditioned(G_ldlt, scale)) {
+    LOG(ERROR) << "Gravity is not observable from the alignment frames, "
+                  "pivots: "
+               << G_ldlt.vectorD().transpose();
+    return false;
+  }
+  *x = G_ldlt.solve(ne.r_g);
+
+  // Back-substitution of the velocities.
+  velocities->resize(n_velocities);
+  for (int k = n_velocities - 1; k >= 0; --k) {
+    gtsam::Vector3 rhs = ne.r_v[k] - ne.B[k] * (*x);
+    if (k + 1 < n_velocities) rhs.noalias() -= ne.U[k] * (*velocities)[k + 1];
+    (*velocities)[k] = ne.D_ldlt[k].solve(rhs);
+  }
+  return true;
+}
+
+}  // namespace
+
 /* -------------------------------------------------------------------------- */
 void VisualInertialFrame::updateDeltaState(const gtsam::NavState &delta_state) {
   bk_alpha_bkp1_ = gtsam::Vector3(delta_state.pose().translation());
@@ -229,7 +426,7 @@ bool OnlineGravityAlignment::estimateBiasAndUpdateStates(
     estimateGyroscopeBiasAHRS(*vi_frames, ahrs_pims, gyro_bias);
     LOG(INFO) << "AHRS Bias Estimator used.";
   } else {
-    estimateGyroscopeBias(*vi_frames, gyro_bias);
+    if (!estimateGyroscopeBias(*vi_frames, gyro_bias)) return false;
     LOG(INFO) << "Linear Bias Estimator used.";
   }
   // Update delta states with corrected bias
@@ -248,45 +445,58 @@ bool OnlineGravityAlignment::estimateBiasAndUpdateStates(
 // and the estimated rotation between frames from Bundle-Adjustment.
 // [in] frames containing pim constraints and body poses.
 // [out] new estimated value for gyroscope bias.
+// Returns false, leaving the bias untouched, if the rotations do not
+// constrain the bias.
 // Unit tested.
-void OnlineGravityAlignment::estimateGyroscopeBias(
+bool OnlineGravityAlignment::estimateGyroscopeBias(
     const VisualInertialFrames &vi_frames,
     gtsam::Vector3 *gyro_bias) {
   CHECK_NOTNULL(gyro_bias);
-  // Create Gaussian Graph with unit noise
-  gtsam::GaussianFactorGraph gaussian_graph;
-  auto noise = gtsam::noiseModel::Unit::Create(3);
-
-  // Loop through all initialization frame
-  for (int i = 0; i < vi_frames.size(); i++) {
-    auto frame_i = std::next(vi_frames.begin(), i);
-
-    // Compute rotation error between pre-integrated and visual estimates
-    gtsam::Rot3 bkp1_error_bkp1(frame_i->bkGammaBkp1().transpose() *
-                                frame_i->bkRbkp1());
-    // Compute rotation error in canonical coordinates (dR_bkp1)
-    gtsam::Vector3 dR = gtsam::Rot3::Logmap(bkp1_error_bkp1);
-    // Get rotation Jacobian wrt. gyro_bias (dR_bkp1 = J * dbg_bkp1)
-    gtsam::Matrix3 dbg_J_dR = frame_i->dbgJacobianDr();
-
-    // Insert Jacobian Factor in Gaussian Graph
-    gaussian_graph.add(gtsam::Symbol('d', 0), dbg_J_dR, dR, noise);
+  const int n_frames = static_cast<int>(vi_frames.size());
+  CHECK_GT(n_frames, 0);
+
+  // Per-frame normal equations J^T * J and J^T * dR, in parallel.
+  std::vector<gtsam::Matrix3> H_frames(n_frames);
+  std::vector<gtsam::Vector3> r_frames(n_frames);
+  cv::parallel_for_(cv::Range(0, n_frames), [&](const cv::Range &range) {
+    for (int i = range.start; i < range.end; ++i) {
+      const VisualInertialFrame &frame_i = vi_frames[i];
+      // Compute rotation error between pre-integrated and visual estimates
+      gtsam::Rot3 bkp1_error_bkp1(frame_i.bkGammaBkp1().transpose() *
+                                  frame_i.bkRbkp1());
+      // Compute rotation error in canonical coordinates (dR_bkp1)
+      const gtsam::Vector3 dR = gtsam::Rot3::Logmap(bkp1_error_bkp1);
+      // Get rotation Jacobian wrt. gyro_bias (dR_bkp1 = J * dbg_bkp1)
+      const gtsam::Matrix3 dbg_J_dR = frame_i.dbgJacobianDr();
+      H_frames[i].noalias() = dbg_J_dR.transpose() * dbg_J_dR;
+      r_frames[i].noalias() = dbg_J_dR.transpose() * dR;
+    }
+  });
+
+  // Accumulate and solve the 3x3 normal equations.
+  gtsam::Matrix3 H = gtsam::Matrix3::Zero();
+  gtsam::Vector3 r = gtsam::Vector3::Zero();
+  for (int i = 0; i < n_frames; ++i) {
+    H += H_frames[i];
+    r += r_frames[i];
   }
-  // Optimize Gaussian Graph and get solution
-  gtsam::VectorValues solution = gaussian_graph.optimize();
-  gtsam::Vector3 delta_bg = solution.at(gtsam::Symbol('d', 0));
+  VLOG(5) << "Gyro bias normal equations:\n" << H << "\nrhs:\n" << r;
+  const Eigen::LDLT<gtsam::Matrix3> ldlt(H);
+  if (!isWellConditioned(ldlt, H.diagonal().maxCoeff())) {
+    LOG(ERROR) << "Gyro bias normal equations are rank deficient, pivots: "
+               << ldlt.vectorD().transpose();
+    return false;
+  }
+  const gtsam::Vector3 delta_bg = ldlt.solve(r);
 
   // Adapt gyroscope bias
   *gyro_bias += delta_bg;
 
   // Logging of solution
-  if (VLOG_IS_ON(5)) {
-    gaussian_graph.print("\nGaussian Factor graph:\n");
-  }
   VLOG(5) << "Gyro bias estimation:\n" << delta_bg;
 
   // TODO(Sandro): Implement check on quality of estimate
-  return;
+  return true;
 }
 
 /* -------------------------------------------------------------------------- */
@@ -402,17 +612,23 @@ void OnlineGravityAlignment::updateDeltaStates(
   CHECK_NOTNULL(vi_frames);
   CHECK_EQ(vi_frames->size(), pims.size());
 
-  // Repropagate measurements with first order approximation
-  for (int i = 0; i < vi_frames->size(); i++) {
-    // Update pre-integration with first-order approximation
-    gtsam::Vector9 correct_preintegrated = pims.at(i)->biasCorrectedDelta(
-        gtsam::imuBias::ConstantBias(Vector3::Zero(), gyro_bias));
-    // Retract delta state
-    const gtsam::NavState bk_delta_state_bkp1 =
-        gtsam::NavState().retract(correct_preintegrated);
-    // Update value for delta_state in frames
-    vi_frames->at(i).updateDeltaState(bk_delta_state_bkp1);
-  }
+  // Repropagate measurements with first order approximation: this only uses
+  // the bias Jacobians of each pim, no raw IMU data is re-integrated.
+  const gtsam::imuBias::ConstantBias bias(Vector3::Zero(), gyro_bias);
+  cv::parallel_for_(
+      cv::Range(0, static_cast<int>(vi_frames->size())),
+      [&](const cv::Range &range) {
+        for (int i = range.start; i < range.end; ++i) {
+          // Update pre-integration with first-order approximation
+          const gtsam::Vector9 correct_preintegrated =
+              pims[i]->biasCorrectedDelta(bias);
+          // Retract delta state
+          const gtsam::NavState bk_delta_state_bkp1 =
+              gtsam::NavState().retract(correct_preintegrated);
+          // Update value for delta_state in frames
+          (*vi_frames)[i].updateDeltaState(bk_delta_state_bkp1);
+        }
+      });
 }
 
 /* -------------------------------------------------------------------------- */
@@ -431,49 +647,32 @@ bool OnlineGravityAlignment::alignEstimatesLinearly(
   CHECK_NOTNULL(g_iter);
   CHECK_NOTNULL(init_vel);
 
-  // Create Gaussian Graph with unit noise
-  gtsam::GaussianFactorGraph gaussian_graph;
-  auto noise = gtsam::noiseModel::Unit::Create(3);
-
-  // Loop through all frames
-  for (int i = 0; i < vi_frames.size(); i++) {
-    auto frame_i = std::next(vi_frames.begin(), i);
-
-    // Add binary factor for position constraint
-    gaussian_graph.add(gtsam::Symbol('V', i),
-                       frame_i->A11(),
-                       gtsam::Symbol('g', 0),
-                       frame_i->A13(),
-                       frame_i->b1(),
-                       noise);
-
-    // Add ternary factor for velocity constraint
-    gaussian_graph.add(gtsam::Symbol('V', i),
-                       frame_i->A21(),
-                       gtsam::Symbol('V', i + 1),
-                       frame_i->A22(),
-                       gtsam::Symbol('g', 0),
-                       frame_i->A23(),
-                       frame_i->b2(),
-                       noise);
+  // Solve normal equations for [V_0, ..., V_N, g]
+  AlignmentNormalEquations<3> normal_equations;
+  std::vector<gtsam::Vector3, Eigen::aligned_allocator<gtsam::Vector3>>
+      velocities;
+  gtsam::Vector3 g_b0;
+  if (!solveAlignmentNormalEquations<3>(vi_frames,
+                                        gtsam::Matrix3::Identity(),
+                                        gtsam::Vector3::Zero(),
+                                        &normal_equations,
+                                        &velocities,
+                                        &g_b0)) {
+    return false;
   }
 
-  // Optimize Gaussian Graph and get solution
-  gtsam::VectorValues solution = gaussian_graph.optimize();
-  gtsam::Vector3 g_b0 = solution.at(gtsam::Symbol('g', 0));
-
   // Logging of solution
-  if (VLOG_IS_ON(5)) {
-    gaussian_graph.print("\nGaussian Factor graph:\n");
-  }
+  VLOG(5) << "Linear alignment solution:\n"
+          << "initial velocity: " << velocities.front().transpose() << '\n'
+          << "gravity: " << g_b0.transpose();
 
   // Refine gravity alignment if necessary
   // TODO(Sandro): Load tolerance in yaml file
   if (abs(g_b0.norm() - g_world.norm()) > FLAGS_gravity_tolerance_linear) {
-    refineGravity(vi_frames, g_world, &g_b0, init_vel);
+    if (!refineGravity(vi_frames, g_world, &g_b0, init_vel)) return false;
   } else {
-    // Retrieve initial velocity from graph optimization
-    *init_vel = solution.at(gtsam::Symbol('V', 0));
+    // Retrieve initial velocity from linear solve
+    *init_vel = velocities.front();
   }
 
   // We want the gravity vector and not the measured acceleration
@@ -527,9 +726,10 @@ gtsam::Matrix OnlineGravityAlignment::createTangentBasis(
 // Refines gravity alignment by imposing norm of gravity vector iteratively.
 // [in] set of visual inertial frames for alignment.
 // [in] global gravity value for alignment.
-// [out] gravity vector expressed in initial body frame.
+// [in/out] gravity vector expressed in initial body frame.
 // [out] initial velocity estimate in initial body frame.
-void OnlineGravityAlignment::refineGravity(
+// Returns false if the normal equations are rank deficient.
+bool OnlineGravityAlignment::refineGravity(
     const VisualInertialFrames &vi_frames,
     const gtsam::Vector3 &g_world,
     gtsam::Vector3 *g_iter,
@@ -542,53 +742,33 @@ void OnlineGravityAlignment::refineGravity(
   // Create tangent basis to g (g = g0 + txty*dxdy)
   gtsam::Matrix txty = createTangentBasis(g0);
 
+  // Buffers are allocated once and reused across iterations.
+  AlignmentNormalEquations<2> normal_equations;
+  std::vector<gtsam::Vector3, Eigen::aligned_allocator<gtsam::Vector3>>
+      velocities;
+  gtsam::Vector2 dxdy;
+
   // Multiple iterations till convergence
   for (int l = 0; l < FLAGS_num_iterations_gravity_refinement; l++) {
-    // Create Gaussian Graph with unit noise
-    gtsam::GaussianFactorGraph gaussian_graph;
-    auto noise = gtsam::noiseModel::Unit::Create(3);
-
-    // Loop through all frames
-    for (int i = 0; i < vi_frames.size(); i++) {
-      auto frame_i = std::next(vi_frames.begin(), i);
-
-      // Apply tangent basis to g (g = g0 + txty*dxdy)
-      gtsam::Matrix A_13_tangent = frame_i->A13() * txty;
-      gtsam::Vector3 b_1_tangent = frame_i->b1() - frame_i->A13() * g0;
-
-      // Add binary factor for position constraint
-      gaussian_graph.add(gtsam::Symbol('V', i),
-                         frame_i->A11(),
-                         gtsam::Symbol('d', 0),
-                         A_13_tangent,
-                         b_1_tangent,
-                         noise);
-
-      // Apply tangent basis to g (g = g0 + txty*dxdy)
-      gtsam::Matrix A_23_tangent = frame_i->A23() * txty;
-      gtsam::Vector3 b_2_tangent = frame_i->b2() - frame_i->A23() * g0;
-
-      // Add ternary factor for velocity constraint
-      gaussian_graph.add(gtsam::Symbol('V', i),
-                         frame_i->A21(),
-                         gtsam::Symbol('V', i + 1),
-                         frame_i->A22(),
-                         gtsam::Symbol('d', 0),
-                         A_23_tangent,
-                         b_2_tangent,
-                         noise);
+    // Solve for [V_0, ..., V_N, dxdy], with g = g0 + txty*dxdy
+    if (!solveAlignmentNormalEquations<2>(vi_frames,
+                                          Eigen::Matrix<double, 3, 2>(txty),
+                                          g0,
+                                          &normal_equations,
+                                          &velocities,
+                                          &dxdy)) {
+      LOG(ERROR) << "Gravity refinement failed at iteration " << l;
+      return false;
     }
 
-    // Optimize Gaussian Graph and get solution
-    gtsam::VectorValues solution = gaussian_graph.optimize();
-    auto dxdy = solution.at(gtsam::Symbol('d', 0));
-
-    // Retrieve velocity from graph optimization
-    *init_vel = solution.at(gtsam::Symbol('V', 0));
+    // Retrieve velocity from linear solve
+    *init_vel = velocities.front();
 
     // Compute new g estimate
     g0 = (g0 + txty * dxdy).normalized() * g_world.norm();
   }
+  *g_iter = g0;
+  return true;
 }
 
 /* -------------------------------------------------------------------------- */
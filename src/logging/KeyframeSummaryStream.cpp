@@ -0,0 +1,205 @@
+/* ----------------------------------------------------------------------------
+ * Copyright 2017, Massachusetts Institute of Technology,
+ * Cambridge, MA 02139
+ * All Rights Reserved
+ * Authors: Luca Carlone, et al. (see THANKS for the full author list)
+ * See LICENSE for the license information
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @file   KeyframeSummaryStream.cpp
+ * @brief  Compact binary summary of each keyframe for external readers.
+ * @author Antoni Rosinol
+ */
+
+#include "kimera-vio/logging/KeyframeSummaryStream.h"
+
+#include <chrono>
+#include <cstring>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+DECLARE_string(output_path);
+
+namespace VIO {
+
+constexpr uint32_t KeyframeSummary::kMagic;
+constexpr uint16_t KeyframeSummary::kVersion;
+constexpr uint8_t KeyframeSummary::kHasCovariance;
+constexpr uint8_t KeyframeSummary::kHasTrackingStatus;
+constexpr size_t KeyframeSummary::kNrFrontendTimes;
+constexpr size_t KeyframeSummary::kNrBackendTimes;
+constexpr size_t KeyframeSummary::kNrCovarianceEntries;
+
+/* -------------------------------------------------------------------------- */
+KeyframeSummaryStream::KeyframeSummaryStream(const std::string& filename,
+                                             const size_t& ring_capacity)
+    : ofstream_(),
+      frontend_summaries_(ring_capacity),
+      summaries_(ring_capacity),
+      writer_thread_() {
+  CHECK(!filename.empty());
+  const std::string output_file = FLAGS_output_path + '/' + filename;
+  LOG(INFO) << "Opening keyframe summary stream: " << output_file;
+  ofstream_.open(output_file.c_str(),
+                 std::ios_base::out | std::ios_base::binary);
+  CHECK(ofstream_.is_open()) << "Cannot open file: " << output_file;
+  writer_thread_ = std::thread(&KeyframeSummaryStream::spinWriter, this);
+}
+
+/* -------------------------------------------------------------------------- */
+KeyframeSummaryStream::~KeyframeSummaryStream() {
+  shutdown_ = true;
+  if (writer_thread_.joinable()) writer_thread_.join();
+  // The pipeline threads are done by now, write what is left.
+  writeSummaries();
+  LOG_IF(WARNING, nr_dropped_ > 0u)
+      << "Dropped " << nr_dropped_ << " keyframe summaries.";
+  ofstream_.close();
+}
+
+/* -------------------------------------------------------------------------- */
+void KeyframeSummaryStream::addFrontendOutput(
+    const Timestamp& timestamp_kf,
+    const TrackerStatusSummary& tracker_status,
+    const DebugTrackerInfo& tracker_info) {
+  FrontendSummary frontend_summary;
+  frontend_summary.timestamp_ = timestamp_kf;
+  frontend_summary.tracking_status_mono_ =
+      tracker_status.kfTrackingStatus_mono_;
+  frontend_summary.tracking_status_stereo_ =
+      tracker_status.kfTrackingStatus_stereo_;
+  frontend_summary.frontend_times_[0] = tracker_info.featureDetectionTime_;
+  frontend_summary.frontend_times_[1] = tracker_info.featureTrackingTime_;
+  frontend_summary.frontend_times_[2] = tracker_info.monoRansacTime_;
+  frontend_summary.frontend_times_[3] = tracker_info.stereoRansacTime_;
+  // If the Backend lags behind, its record will just miss the status.
+  LOG_IF(WARNING, !frontend_summaries_.push(frontend_summary))
+      << "Keyframe summary stream: dropping Frontend output.";
+}
+
+/* -------------------------------------------------------------------------- */
+void KeyframeSummaryStream::addBackendOutput(
+    const BackendOutput& backend_output) {
+  // Frontend keyframes come in the same order as the Backend outputs, skip
+  // the ones the Backend did not output (e.g. before initialization).
+  const Timestamp& timestamp_kf = backend_output.timestamp_;
+  const FrontendSummary* frontend_summary = frontend_summaries_.peek();
+  while (frontend_summary && frontend_summary->timestamp_ < timestamp_kf) {
+    frontend_summaries_.pop();
+    frontend_summary = frontend_summaries_.peek();
+  }
+
+  KeyframeSummary summary;
+  fillSummary(backend_output, &summary);
+  summary.sequence_ = sequence_++;
+  if (frontend_summary && frontend_summary->timestamp_ == timestamp_kf) {
+    summary.tracking_status_mono_ =
+        static_cast<uint8_t>(frontend_summary->tracking_status_mono_);
+    summary.tracking_status_stereo_ =
+        static_cast<uint8_t>(frontend_summary->tracking_status_stereo_);
+    summary.flags_ |= KeyframeSummary::kHasTrackingStatus;
+    std::memcpy(summary.frontend_times_,
+                frontend_summary->frontend_times_,
+                sizeof(summary.frontend_times_));
+    frontend_summaries_.pop();
+  }
+
+  if (!summaries_.push(summary)) {
+    ++nr_dropped_;
+    VLOG(1) << "Keyframe summary stream: dropping summary for keyframe "
+            << summary.kf_id_;
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+void KeyframeSummaryStream::fillSummary(const BackendOutput& backend_output,
+                                        KeyframeSummary* summary) {
+  CHECK_NOTNULL(summary);
+  std::memset(summary, 0, sizeof(KeyframeSummary));
+  summary->magic_ = KeyframeSummary::kMagic;
+  summary->version_ = KeyframeSummary::kVersion;
+  summary->size_ = static_cast<uint16_t>(sizeof(KeyframeSummary));
+
+  const VioNavStateTimestamped& W_State_Blkf = backend_output.W_State_Blkf_;
+  summary->timestamp_ = W_State_Blkf.timestamp_;
+  summary->kf_id_ = backend_output.cur_kf_id_;
+  const gtsam::Point3& W_t_B = W_State_Blkf.pose_.translation();
+  const gtsam::Quaternion W_q_B = W_State_Blkf.pose_.rotation().toQuaternion();
+  const gtsam::Vector3& gyro_bias = W_State_Blkf.imu_bias_.gyroscope();
+  const gtsam::Vector3& acc_bias = W_State_Blkf.imu_bias_.accelerometer();
+  summary->W_t_B_[0] = W_t_B.x();
+  summary->W_t_B_[1] = W_t_B.y();
+  summary->W_t_B_[2] = W_t_B.z();
+  for (size_t i = 0u; i < 3u; ++i) {
+    summary->W_v_B_[i] = W_State_Blkf.velocity_(i);
+    summary->gyro_bias_[i] = gyro_bias(i);
+    summary->acc_bias_[i] = acc_bias(i);
+  }
+  summary->W_q_B_[0] = W_q_B.w();
+  summary->W_q_B_[1] = W_q_B.x();
+  summary->W_q_B_[2] = W_q_B.y();
+  summary->W_q_B_[3] = W_q_B.z();
+  summary->landmark_count_ = backend_output.landmark_count_;
+
+  const DebugVioInfo& debug_info = backend_output.debug_info_;
+  summary->backend_times_[0] = debug_info.factorsAndSlotsTime_;
+  summary->backend_times_[1] = debug_info.preUpdateTime_;
+  summary->backend_times_[2] = debug_info.updateTime_;
+  summary->backend_times_[3] = debug_info.updateSlotTime_;
+  summary->backend_times_[4] = debug_info.extraIterationsTime_;
+  summary->nr_extra_iterations_ =
+      static_cast<uint32_t>(debug_info.numExtraIterations_);
+
+  // The covariance is in pose, velocity, bias order, and all zeros unless
+  // the Backend computes it.
+  const gtsam::Matrix& state_covariance = backend_output.state_covariance_lkf_;
+  if (state_covariance.rows() >= 6 && state_covariance.cols() >= 6 &&
+      !state_covariance.topLeftCorner<6, 6>().isZero()) {
+    size_t idx = 0u;
+    for (int row = 0; row < 6; ++row) {
+      for (int col = row; col < 6; ++col) {
+        summary->pose_covariance_[idx++] = state_covariance(row, col);
+      }
+    }
+    summary->flags_ |= KeyframeSummary::kHasCovariance;
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+bool KeyframeSummaryStream::isValid(const KeyframeSummary& summary) {
+  return summary.magic_ == KeyframeSummary::kMagic &&
+         summary.version_ == KeyframeSummary::kVersion &&
+         summary.size_ == sizeof(KeyframeSummary);
+}
+
+/* -------------------------------------------------------------------------- */
+void KeyframeSummaryStream::spinWriter() {
+  // Poll rather than wait on a condition variable, so that the Backend
+  // never takes a lock. Keyframes come at a few Hz, the latency is moot.
+  while (!shutdown_) {
+    if (writeSummaries() == 0u) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+size_t KeyframeSummaryStream::writeSummaries() {
+  size_t nr_written_summaries = 0u;
+  KeyframeSummary summary;
+  while (summaries_.pop(&summary)) {
+    ofstream_.write(reinterpret_cast<const char*>(&summary),
+                    sizeof(KeyframeSummary));
+    ++nr_written_summaries;
+  }
+  // Flush whole records only, so readers never see a partial one for long.
+  if (nr_written_summaries > 0u) {
+    ofstream_.flush();
+    LOG_IF(ERROR, !ofstream_.good()) << "Keyframe summary stream: bad file.";
+  }
+  return nr_written_summaries;
+}
+
+}  // namespace VIO
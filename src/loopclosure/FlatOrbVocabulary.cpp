@@ -0,0 +1,220 @@
+/* ----------------------------------------------------------------------------
+ * Copyright 2017, Massachusetts Institute of Technology,
+ * Cambridge, MA 02139
+ * All Rights Reserved
+ * Authors: Luca Carlone, et al. (see THANKS for the full author list)
+ * See LICENSE for the license information
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @file   FlatOrbVocabulary.cpp
+ * @brief  Contiguous copy of a DBoW2 ORB vocabulary tree for fast BoW
+ * transforms.
+ * @author Marcus Abate
+ */
+
+#include "kimera-vio/loopclosure/FlatOrbVocabulary.h"
+
+#include <cstring>
+#include <queue>
+
+#include <glog/logging.h>
+
+#include <opencv2/core/utility.hpp>
+
+namespace VIO {
+
+/* -------------------------------------------------------------------------- */
+// DBoW2 has no getters for the node tree nor the scoring object, which are
+// protected. This struct is never instantiated, it only names them through
+// member pointers of a derived class.
+struct FlatOrbVocabulary::VocabularyAccessor : public OrbVocabulary {
+  static void flatten(const OrbVocabulary& vocabulary,
+                      FlatOrbVocabulary* flat) {
+    CHECK_NOTNULL(flat);
+    const std::vector<Node>& tree = vocabulary.*(&VocabularyAccessor::m_nodes);
+    const DBoW2::GeneralScoring* scoring =
+        vocabulary.*(&VocabularyAccessor::m_scoring_object);
+    CHECK_NOTNULL(scoring);
+
+    flat->must_normalize_ = scoring->mustNormalize(flat->norm_);
+    flat->weighting_ = vocabulary.getWeightingType();
+    flat->depth_levels_ = vocabulary.getDepthLevels();
+    flat->nr_words_ = vocabulary.size();
+    flat->nodes_.clear();
+    flat->descriptors_.clear();
+    if (tree.empty()) return;
+
+    flat->nodes_.reserve(tree.size());
+    flat->descriptors_.reserve(tree.size() * kDescriptorWords);
+
+    // Breadth-first traversal: the children of every node are appended
+    // together, so they end up adjacent in nodes_ and descriptors_.
+    std::queue<std::pair<DBoW2::NodeId, uint32_t>> to_visit;
+    appendNode(tree[0], flat);
+    to_visit.emplace(0u, 0u);
+    while (!to_visit.empty()) {
+      const Node& node = tree[to_visit.front().first];
+      const uint32_t flat_idx = to_visit.front().second;
+      to_visit.pop();
+      flat->nodes_[flat_idx].first_child_ = flat->nodes_.size();
+      flat->nodes_[flat_idx].nr_children_ = node.children.size();
+      for (const DBoW2::NodeId& child_id : node.children) {
+        to_visit.emplace(child_id, flat->nodes_.size());
+        appendNode(tree[child_id], flat);
+      }
+    }
+    CHECK_EQ(flat->nodes_.size(), tree.size());
+  }
+
+  static void appendNode(const Node& node, FlatOrbVocabulary* flat) {
+    FlatNode flat_node;
+    flat_node.node_id_ = node.id;
+    flat_node.word_id_ = node.word_id;
+    flat_node.weight_ = node.weight;
+    flat->nodes_.push_back(flat_node);
+
+    uint64_t packed[kDescriptorWords] = {0u, 0u, 0u, 0u};
+    // The root has no descriptor.
+    if (!node.descriptor.empty()) {
+      CHECK_EQ(node.descriptor.total() * node.descriptor.elemSize(),
+               sizeof(packed));
+      CHECK(node.descriptor.isContinuous());
+      std::memcpy(packed, node.descriptor.data, sizeof(packed));
+    }
+    flat->descriptors_.insert(
+        flat->descriptors_.end(), packed, packed + kDescriptorWords);
+  }
+};
+
+/* -------------------------------------------------------------------------- */
+FlatOrbVocabulary::FlatOrbVocabulary(const OrbVocabulary& vocabulary) {
+  VocabularyAccessor::flatten(vocabulary, this);
+}
+
+/* -------------------------------------------------------------------------- */
+void FlatOrbVocabulary::transform(const OrbDescriptorVec& features,
+                                  DBoW2::BowVector* bow_vec) const {
+  CHECK_NOTNULL(bow_vec);
+  bow_vec->clear();
+  if (empty()) return;
+
+  std::vector<uint32_t> leaves, level_nodes;
+  transformBatch(features, depth_levels_, &leaves, &level_nodes);
+  accumulateWeights(leaves, level_nodes, bow_vec, nullptr);
+}
+
+/* -------------------------------------------------------------------------- */
+void FlatOrbVocabulary::transform(const OrbDescriptorVec& features,
+                                  DBoW2::BowVector* bow_vec,
+                                  DBoW2::FeatureVector* feat_vec,
+                                  const int& levels_up) const {
+  CHECK_NOTNULL(bow_vec);
+  CHECK_NOTNULL(feat_vec);
+  bow_vec->clear();
+  feat_vec->clear();
+  if (empty()) return;
+
+  std::vector<uint32_t> leaves, level_nodes;
+  transformBatch(features, depth_levels_ - levels_up, &leaves, &level_nodes);
+  accumulateWeights(leaves, level_nodes, bow_vec, feat_vec);
+}
+
+/* -------------------------------------------------------------------------- */
+void FlatOrbVocabulary::transformBatch(
+    const OrbDescriptorVec& features,
+    const int& nid_level,
+    std::vector<uint32_t>* leaves,
+    std::vector<uint32_t>* level_nodes) const {
+  CHECK_NOTNULL(leaves);
+  CHECK_NOTNULL(level_nodes);
+  const size_t n_features = features.size();
+
+  // Pack all descriptors contiguously once, so the descent only touches
+  // plain uint64_t arrays.
+  std::vector<uint64_t> packed(n_features * kDescriptorWords);
+  for (size_t i = 0u; i < n_features; ++i) {
+    const cv::Mat& feature = features[i];
+    DCHECK_EQ(feature.total() * feature.elemSize(),
+              kDescriptorWords * sizeof(uint64_t));
+    DCHECK(feature.isContinuous());
+    std::memcpy(&packed[i * kDescriptorWords],
+                feature.data,
+                kDescriptorWords * sizeof(uint64_t));
+  }
+
+  leaves->resize(n_features);
+  level_nodes->resize(n_features);
+  cv::parallel_for_(cv::Range(0, n_features), [&](const cv::Range& range) {
+    for (int i = range.start; i < range.end; ++i) {
+      (*leaves)[i] = findLeaf(
+          &packed[i * kDescriptorWords], nid_level, &(*level_nodes)[i]);
+    }
+  });
+}
+
+/* -------------------------------------------------------------------------- */
+uint32_t FlatOrbVocabulary::findLeaf(const uint64_t* descriptor,
+                                     const int& nid_level,
+                                     uint32_t* level_node) const {
+  DCHECK(descriptor);
+  DCHECK(level_node);
+  uint32_t node_idx = 0u;
+  *level_node = 0u;
+  int current_level = 0;
+  while (nodes_[node_idx].nr_children_ > 0u) {
+    ++current_level;
+    const FlatNode& parent = nodes_[node_idx];
+    const uint64_t* child_descriptor =
+        &descriptors_[parent.first_child_ * kDescriptorWords];
+    // Ties keep the first child, as in DBoW2.
+    node_idx = parent.first_child_;
+    uint32_t best_distance = hammingDistance(descriptor, child_descriptor);
+    for (uint32_t c = 1u; c < parent.nr_children_; ++c) {
+      child_descriptor += kDescriptorWords;
+      const uint32_t distance = hammingDistance(descriptor, child_descriptor);
+      if (distance < best_distance) {
+        best_distance = distance;
+        node_idx = parent.first_child_ + c;
+      }
+    }
+    if (current_level == nid_level) *level_node = node_idx;
+  }
+  // Leaves above nid_level are their own level node.
+  if (current_level < nid_level) *level_node = node_idx;
+  return node_idx;
+}
+
+/* -------------------------------------------------------------------------- */
+void FlatOrbVocabulary::accumulateWeights(
+    const std::vector<uint32_t>& leaves,
+    const std::vector<uint32_t>& level_nodes,
+    DBoW2::BowVector* bow_vec,
+    DBoW2::FeatureVector* feat_vec) const {
+  CHECK_NOTNULL(bow_vec);
+  CHECK_EQ(leaves.size(), level_nodes.size());
+  // Sequential, in feature order, so that the accumulated weights are
+  // bit-exact with DBoW2.
+  const bool accumulate =
+      weighting_ == DBoW2::TF || weighting_ == DBoW2::TF_IDF;
+  for (size_t i = 0u; i < leaves.size(); ++i) {
+    const FlatNode& leaf = nodes_[leaves[i]];
+    if (leaf.weight_ <= 0.0) continue;
+    if (accumulate) {
+      bow_vec->addWeight(leaf.word_id_, leaf.weight_);
+    } else {
+      bow_vec->addIfNotExist(leaf.word_id_, leaf.weight_);
+    }
+    if (feat_vec) {
+      feat_vec->addFeature(nodes_[level_nodes[i]].node_id_, i);
+    }
+  }
+
+  if (accumulate && !bow_vec->empty() && !must_normalize_) {
+    const double nd = bow_vec->size();
+    for (auto& word : *bow_vec) word.second /= nd;
+  }
+  if (must_normalize_) bow_vec->normalize(norm_);
+}
+
+}  // namespace VIO
@@ -60,13 +60,18 @@ LoopClosureDetector::LoopClosureDetector(
       orb_feature_detector_(),
       orb_feature_matcher_(),
       db_BoW_(nullptr),
+      flat_vocab_(nullptr),
       db_frames_(),
+      db_frames_pgo_keys_(),
       timestamp_map_(),
       lcd_tp_wrapper_(nullptr),
       latest_bowvec_(),
+      last_lcd_W_Pose_Blkf_(),
+      last_lcd_thumbnail_(),
       B_Pose_camLrect_(),
       stereo_camera_(stereo_camera),
       stereo_matcher_(nullptr),
+      stereo_pose_refiner_(nullptr),
       pgo_(nullptr),
       W_Pose_Blkf_estimates_(),
       logger_(nullptr) {
@@ -90,6 +95,11 @@ LoopClosureDetector::LoopClosureDetector(
   // Sparse stereo reconstruction members
   stereo_matcher_ = 
       VIO::make_unique<StereoMatcher>(stereo_camera_, stereo_matching_params);
+  stereo_pose_refiner_ = VIO::make_unique<StereoPoseRefiner>(
+      *stereo_camera_->getStereoCalib(),
+      lcd_params_.refine_pose_huber_threshold_,
+      lcd_params_.refine_pose_outlier_threshold_,
+      lcd_params_.refine_pose_landmark_distance_threshold_);
 
   // Initialize the ORB feature detector object:
   orb_feature_detector_ = cv::ORB::create(lcd_params_.nfeatures_,
@@ -123,6 +133,7 @@ LoopClosureDetector::LoopClosureDetector(
 
   // Initialize db_BoW_:
   db_BoW_ = VIO::make_unique<OrbDatabase>(vocab);
+  flat_vocab_ = VIO::make_unique<FlatOrbVocabulary>(vocab);
 
   // Initialize pgo_:
   // TODO(marcus): parametrize the verbosity of PGO params
@@ -175,34 +186,59 @@ LcdOutput::UniquePtr LoopClosureDetector::spinOnce(const LcdInput& input) {
     StereoFrontendOutput::Ptr stereo_frontend_output =
         VIO::safeCast<FrontendOutputPacketBase, StereoFrontendOutput>(
             input.frontend_output_);
-    // Try to find a loop and update the PGO with the result if available.
-    if (detectLoop(stereo_frontend_output->stereo_frame_lkf_, &loop_result)) {
-      LoopClosureFactor lc_factor(loop_result.match_id_,
-                                  loop_result.query_id_,
-                                  loop_result.relative_pose_,
-                                  shared_noise_model_);
+    const StereoFrame& stereo_frame_lkf =
+        stereo_frontend_output->stereo_frame_lkf_;
+    const cv::Mat& left_img = stereo_frame_lkf.left_frame_.img_;
+    if (!isNovelKeyframe(input.W_Pose_Blkf_, left_img)) {
+      // Only the odometry goes to the PGO, the frame is not added to the
+      // LCD database.
+      loop_result.status_ = LCDStatus::REDUNDANT_KEYFRAME;
+      VLOG(2) << "LoopClosureDetector: Skipping redundant keyframe "
+              << input.cur_kf_id_;
+    } else {
+      // Try to find a loop and update the PGO with the result if available.
+      const bool is_loop = detectLoop(stereo_frame_lkf, &loop_result);
+      db_frames_pgo_keys_.push_back(input.cur_kf_id_);
+      last_lcd_W_Pose_Blkf_ = input.W_Pose_Blkf_;
+      if (lcd_params_.min_keyframe_image_difference_ > 0.0) {
+        last_lcd_thumbnail_ = computeThumbnail(left_img);
+      }
 
-      utils::StatsCollector stat_pgo_timing(
-          "PGO Update/Optimization Timing [ms]");
-      auto tic = utils::Timer::tic();
+      if (is_loop) {
+        // Loop results are given in LCD database ids, the PGO uses keyframe
+        // ids.
+        loop_result.match_id_ = db_frames_pgo_keys_.at(loop_result.match_id_);
+        loop_result.query_id_ = db_frames_pgo_keys_.at(loop_result.query_id_);
+        // Use the uncertainty of the refined pose when there is one.
+        LoopClosureFactor lc_factor(loop_result.match_id_,
+                                    loop_result.query_id_,
+                                    loop_result.relative_pose_,
+                                    loop_result.relative_pose_noise_
+                                        ? loop_result.relative_pose_noise_
+                                        : shared_noise_model_);
 
-      addLoopClosureFactorAndOptimize(lc_factor);
+        utils::StatsCollector stat_pgo_timing(
+            "PGO Update/Optimization Timing [ms]");
+        auto tic = utils::Timer::tic();
 
-      auto update_duration = utils::Timer::toc(tic).count();
-      stat_pgo_timing.AddSample(update_duration);
+        addLoopClosureFactorAndOptimize(lc_factor);
 
-      VLOG(1) << "LoopClosureDetector: LOOP CLOSURE detected from keyframe "
-              << loop_result.match_id_ << " to keyframe "
-              << loop_result.query_id_;
-    } else {
-      VLOG(2) << "LoopClosureDetector: No loop closure detected. Reason: "
-              << LoopResult::asString(loop_result.status_);
-    }
+        auto update_duration = utils::Timer::toc(tic).count();
+        stat_pgo_timing.AddSample(update_duration);
 
-    // Timestamps for PGO and for LCD should match now.
-    CHECK_EQ(db_frames_.back().timestamp_,
-             timestamp_map_.at(db_frames_.back().id_));
-    CHECK_EQ(timestamp_map_.size(), db_frames_.size());
+        VLOG(1) << "LoopClosureDetector: LOOP CLOSURE detected from keyframe "
+                << loop_result.match_id_ << " to keyframe "
+                << loop_result.query_id_;
+      } else {
+        VLOG(2) << "LoopClosureDetector: No loop closure detected. Reason: "
+                << LoopResult::asString(loop_result.status_);
+      }
+
+      // Timestamps for PGO and for LCD should match now.
+      CHECK_EQ(db_frames_.size(), db_frames_pgo_keys_.size());
+      CHECK_EQ(db_frames_.back().timestamp_,
+               timestamp_map_.at(db_frames_pgo_keys_.back()));
+    }
     CHECK_EQ(timestamp_map_.size(), W_Pose_Blkf_estimates_.size());
   } else {
     LOG(ERROR) << "LoopClosureDetector: Not using StereoFrontend! Change frontend.";
@@ -250,6 +286,56 @@ LcdOutput::UniquePtr LoopClosureDetector::spinOnce(const LcdInput& input) {
   return output_payload;
 }
 
+/* ------------------------------------------------------------------------ */
+bool LoopClosureDetector::isNovelKeyframe(const gtsam::Pose3& W_Pose_Blkf,
+                                          const cv::Mat& img) const {
+  if (!lcd_params_.skip_redundant_keyframes_ ||
+      db_frames_pgo_keys_.empty()) {
+    return true;
+  }
+
+  const gtsam::Pose3& last_Pose_cur =
+      last_lcd_W_Pose_Blkf_.between(W_Pose_Blkf);
+  if (last_Pose_cur.translation().norm() >=
+          lcd_params_.min_keyframe_translation_ ||
+      gtsam::Rot3::Logmap(last_Pose_cur.rotation()).norm() >=
+          lcd_params_.min_keyframe_rotation_) {
+    return true;
+  }
+
+  // The pose barely changed, but the scene might have (e.g. drift while
+  // hovering): compare low-resolution images as a last resort.
+  if (lcd_params_.min_keyframe_image_difference_ > 0.0 &&
+      !last_lcd_thumbnail_.empty()) {
+    const cv::Mat thumbnail = computeThumbnail(img);
+    const double image_difference =
+        cv::norm(thumbnail, last_lcd_thumbnail_, cv::NORM_L1) /
+        (255.0 * thumbnail.total());
+    return image_difference >= lcd_params_.min_keyframe_image_difference_;
+  }
+
+  return false;
+}
+
+/* ------------------------------------------------------------------------ */
+cv::Mat LoopClosureDetector::computeThumbnail(const cv::Mat& img) {
+  CHECK(!img.empty());
+  cv::Mat gray;
+  if (img.channels() > 1) {
+    cv::cvtColor(img, gray, cv::COLOR_BGR2GRAY);
+  } else {
+    gray = img;
+  }
+  cv::Mat thumbnail;
+  cv::resize(gray,
+             thumbnail,
+             cv::Size(kThumbnailWidth, kThumbnailHeight),
+             0.0,
+             0.0,
+             cv::INTER_AREA);
+  return thumbnail;
+}
+
 /* ------------------------------------------------------------------------ */
 FrameId LoopClosureDetector::processAndAddFrame(
     const StereoFrame& stereo_frame) {
@@ -269,30 +355,97 @@ FrameId LoopClosureDetector::processAndAddFrame(
     descriptors_mat.row(i).copyTo(descriptors_vec[i].row(0));
   }
 
-  // Fill StereoFrame with ORB keypoints and perform stereo matching.
-  StereoFrame cp_stereo_frame(stereo_frame);
-  rewriteStereoFrameFeatures(keypoints, &cp_stereo_frame);
-
-  // Build and store LCDFrame object.
-  db_frames_.push_back(LCDFrame(cp_stereo_frame.timestamp_,
+  // Build and store LCDFrame object. Stereo matching of the ORB keypoints is
+  // only needed for geometric verification and pose recovery, so it is
+  // deferred until the frame is part of a loop candidate.
+  db_frames_.push_back(LCDFrame(stereo_frame.timestamp_,
                                 db_frames_.size(),
-                                cp_stereo_frame.id_,
+                                stereo_frame.id_,
                                 keypoints,
-                                cp_stereo_frame.keypoints_3d_,
+                                std::vector<gtsam::Vector3>(),
                                 descriptors_vec,
                                 descriptors_mat,
-                                cp_stereo_frame.left_frame_.versors_,
-                                cp_stereo_frame.left_keypoints_rectified_,
-                                cp_stereo_frame.right_keypoints_rectified_));
+                                BearingVectors(),
+                                StatusKeypointsCV(),
+                                StatusKeypointsCV()));
+  // Keep only what the stereo reconstruction needs: the rectified images.
+  // The raw images and VIO features of the keyframe are not kept.
+  LCDFrame& lcd_frame = db_frames_.back();
+  if (stereo_frame.isRectified()) {
+    lcd_frame.left_img_rectified_ = stereo_frame.getLeftImgRectified();
+    lcd_frame.right_img_rectified_ = stereo_frame.getRightImgRectified();
+  } else {
+    StereoFrame cp_stereo_frame(stereo_frame);
+    stereo_camera_->undistortRectifyStereoFrame(&cp_stereo_frame);
+    lcd_frame.left_img_rectified_ = cp_stereo_frame.getLeftImgRectified();
+    lcd_frame.right_img_rectified_ = cp_stereo_frame.getRightImgRectified();
+  }
 
   CHECK(!db_frames_.empty());
   return db_frames_.back().id_;
 }
 
+/* ------------------------------------------------------------------------ */
+void LoopClosureDetector::reconstructStereoFrame(const FrameId& frame_id) {
+  CHECK_LT(frame_id, db_frames_.size());
+  LCDFrame& lcd_frame = db_frames_[frame_id];
+  if (lcd_frame.isStereoReconstructed()) return;
+  CHECK(!lcd_frame.right_img_rectified_.empty());
+
+  // Versors and rectified left keypoints of the ORB keypoints.
+  const CameraParams& left_cam_params = stereo_camera_->getLeftCamParams();
+  KeypointsCV left_keypoints;
+  left_keypoints.reserve(lcd_frame.keypoints_.size());
+  lcd_frame.versors_.clear();
+  lcd_frame.versors_.reserve(lcd_frame.keypoints_.size());
+  for (const cv::KeyPoint& keypoint : lcd_frame.keypoints_) {
+    left_keypoints.push_back(keypoint.pt);
+    lcd_frame.versors_.push_back(
+        UndistorterRectifier::UndistortKeypointAndGetVersor(keypoint.pt,
+                                                            left_cam_params));
+  }
+  stereo_camera_->undistortRectifyLeftKeypoints(
+      left_keypoints, &lcd_frame.left_keypoints_rectified_);
+
+  // Match them in the right image and get their depth.
+  stereo_matcher_->sparseStereoReconstruction(
+      lcd_frame.left_img_rectified_,
+      lcd_frame.right_img_rectified_,
+      lcd_frame.left_keypoints_rectified_,
+      &lcd_frame.right_keypoints_rectified_);
+  Depths keypoints_depth;
+  stereo_matcher_->getDepthFromRectifiedMatches(
+      lcd_frame.left_keypoints_rectified_,
+      lcd_frame.right_keypoints_rectified_,
+      &keypoints_depth);
+
+  // 3D keypoints in the frame of the left camera.
+  lcd_frame.keypoints_3d_.clear();
+  lcd_frame.keypoints_3d_.reserve(lcd_frame.right_keypoints_rectified_.size());
+  for (size_t i = 0; i < lcd_frame.right_keypoints_rectified_.size(); i++) {
+    if (lcd_frame.right_keypoints_rectified_[i].first ==
+        KeypointStatus::VALID) {
+      // NOTE: versors are already in the rectified frame.
+      const gtsam::Vector3& versor = lcd_frame.versors_[i];
+      CHECK_GE(versor(2), 1e-3)
+          << "reconstructStereoFrame: found point with nonpositive depth!";
+      // keypoints_depth is not the norm of the vector, it is the z component.
+      lcd_frame.keypoints_3d_.push_back(versor * keypoints_depth[i] /
+                                        versor(2));
+    } else {
+      lcd_frame.keypoints_3d_.push_back(gtsam::Vector3::Zero());
+    }
+  }
+
+  lcd_frame.left_img_rectified_.release();
+  lcd_frame.right_img_rectified_.release();
+}
+
 /* ------------------------------------------------------------------------ */
 bool LoopClosureDetector::detectLoop(const StereoFrame& stereo_frame,
                                      LoopResult* result) {
   CHECK_NOTNULL(result);
+  result->relative_pose_noise_ = nullptr;
 
   FrameId frame_id = processAndAddFrame(stereo_frame);
   result->query_id_ = frame_id;
@@ -300,8 +453,8 @@ bool LoopClosureDetector::detectLoop(const StereoFrame& stereo_frame,
   // Create BOW representation of descriptors.
   DBoW2::BowVector bow_vec;
   DCHECK(db_BoW_);
-  db_BoW_->getVocabulary()->transform(db_frames_[frame_id].descriptors_vec_,
-                                      bow_vec);
+  DCHECK(flat_vocab_);
+  flat_vocab_->transform(db_frames_[frame_id].descriptors_vec_, &bow_vec);
 
   int max_possible_match_id = frame_id - lcd_params_.recent_frames_window_;
   if (max_possible_match_id < 0) max_possible_match_id = 0;
@@ -384,18 +537,22 @@ bool LoopClosureDetector::detectLoop(const StereoFrame& stereo_frame,
               result->status_ = LCDStatus::FAILED_GEOM_VERIFICATION;
             } else {
               gtsam::Pose3 bodyMatch_T_bodyQuery_stereo;
+              gtsam::SharedNoiseModel bodyMatch_noise_bodyQuery_stereo;
               bool pass_3d_pose_compute =
                   recoverPose(result->query_id_,
                               result->match_id_,
                               camMatch_T_camQuery_mono,
                               &bodyMatch_T_bodyQuery_stereo,
                               &i_query,
-                              &i_match);
+                              &i_match,
+                              &bodyMatch_noise_bodyQuery_stereo);
 
               if (!pass_3d_pose_compute) {
                 result->status_ = LCDStatus::FAILED_POSE_RECOVERY;
               } else {
                 result->relative_pose_ = bodyMatch_T_bodyQuery_stereo;
+                result->relative_pose_noise_ =
+                    bodyMatch_noise_bodyQuery_stereo;
                 result->status_ = LCDStatus::LOOP_DETECTED;
               }
             }
@@ -425,6 +582,8 @@ bool LoopClosureDetector::geometricVerificationCheck(
   CHECK_NOTNULL(camMatch_T_camQuery_mono);
   switch (lcd_params_.geom_check_) {
     case GeomVerifOption::NISTER: {
+      reconstructStereoFrame(query_id);
+      reconstructStereoFrame(match_id);
       return geometricVerificationNister(query_id,
                                          match_id,
                                          camMatch_T_camQuery_mono,
@@ -450,10 +609,16 @@ bool LoopClosureDetector::recoverPose(
     const gtsam::Pose3& camMatch_T_camQuery_mono,
     gtsam::Pose3* bodyMatch_T_bodyQuery_stereo,
     std::vector<FrameId>* inlier_id_in_query_frame,
-    std::vector<FrameId>* inlier_id_in_match_frame) {
+    std::vector<FrameId>* inlier_id_in_match_frame,
+    gtsam::SharedNoiseModel* bodyMatch_noise_bodyQuery_stereo) {
   CHECK_NOTNULL(bodyMatch_T_bodyQuery_stereo);
+  if (bodyMatch_noise_bodyQuery_stereo) {
+    *bodyMatch_noise_bodyQuery_stereo = nullptr;
+  }
   CHECK_NOTNULL(inlier_id_in_query_frame);
   CHECK_NOTNULL(inlier_id_in_match_frame);
+  reconstructStereoFrame(query_id);
+  reconstructStereoFrame(match_id);
 
   bool passed_pose_recovery = false;
   gtsam::Pose3 camMatch_T_camQuery_stereo;
@@ -481,12 +646,14 @@ bool LoopClosureDetector::recoverPose(
                         static_cast<int>(lcd_params_.pose_recovery_option_));
     }
   }
+  gtsam::Matrix6 camMatch_info_camQuery = gtsam::Matrix6::Zero();
   if (lcd_params_.refine_pose_) {
     camMatch_T_camQuery_stereo = refinePoses(query_id,
                                              match_id,
                                              camMatch_T_camQuery_stereo,
                                              *inlier_id_in_query_frame,
-                                             *inlier_id_in_match_frame);
+                                             *inlier_id_in_match_frame,
+                                             &camMatch_info_camQuery);
   }
 
   transformCameraPoseToBodyPose(camMatch_T_camQuery_stereo,
@@ -494,8 +661,24 @@ bool LoopClosureDetector::recoverPose(
 
   // Use the rotation obtained from 5pt method if needed.
   // TODO(marcus): check that the rotations are close to each other!
-  if (lcd_params_.use_mono_rot_ &&
-      lcd_params_.pose_recovery_option_ != PoseRecoveryOption::GIVEN_ROT) {
+  const bool use_mono_rot =
+      lcd_params_.use_mono_rot_ &&
+      lcd_params_.pose_recovery_option_ != PoseRecoveryOption::GIVEN_ROT;
+  // The information of the refinement does not hold for the mono rotation.
+  if (bodyMatch_noise_bodyQuery_stereo && !use_mono_rot &&
+      !camMatch_info_camQuery.isZero()) {
+    // bodyMatch_T_bodyQuery = B_Pose_camLrect * camMatch_T_camQuery *
+    // B_Pose_camLrect^-1, so a tangent vector of the camera pose maps to
+    // Ad(B_Pose_camLrect) times it in the body pose.
+    const gtsam::Matrix6 Ad_camLrect_Pose_B =
+        B_Pose_camLrect_.inverse().AdjointMap();
+    const gtsam::Matrix6 bodyMatch_info_bodyQuery =
+        Ad_camLrect_Pose_B.transpose() * camMatch_info_camQuery *
+        Ad_camLrect_Pose_B;
+    *bodyMatch_noise_bodyQuery_stereo =
+        gtsam::noiseModel::Gaussian::Information(bodyMatch_info_bodyQuery);
+  }
+  if (use_mono_rot) {
     gtsam::Pose3 bodyMatch_T_bodyQuery_mono;
     transformCameraPoseToBodyPose(camMatch_T_camQuery_mono,
                                   &bodyMatch_T_bodyQuery_mono);
@@ -517,86 +700,49 @@ gtsam::Pose3 LoopClosureDetector::refinePoses(
     const FrameId match_id,
     const gtsam::Pose3& camMatch_T_camQuery_stereo,
     const std::vector<FrameId>& inlier_id_in_query_frame,
-    const std::vector<FrameId>& inlier_id_in_match_frame) {
-  gtsam::NonlinearFactorGraph nfg;
-  gtsam::Values values;
-
-  // TODO camMatch_T_camQuery rename to camMatch_T_camQuery
-  gtsam::Key key_match = gtsam::Symbol('x', match_id);
-  gtsam::Key key_query = gtsam::Symbol('x', query_id);
-  values.insert(key_match, gtsam::Pose3::identity());
-  values.insert(key_query, camMatch_T_camQuery_stereo);
-
-  gtsam::SharedNoiseModel noise = gtsam::noiseModel::Unit::Create(6);
-  nfg.add(gtsam::PriorFactor<gtsam::Pose3>(key_match, gtsam::Pose3::identity(), noise));
-
-  gtsam::SharedNoiseModel noise_stereo = gtsam::noiseModel::Unit::Create(3);
-
-  gtsam::SmartStereoProjectionParams smart_factors_params;
-  smart_factors_params =
-      SmartFactorParams(gtsam::HESSIAN,             // JACOBIAN_SVD
-                        gtsam::ZERO_ON_DEGENERACY,  // IGNORE_DEGENERACY
-                        false,                      // ThrowCherality = false
-                        true);                      // verboseCherality = true
-  smart_factors_params.setRankTolerance(1);
-  smart_factors_params.setLandmarkDistanceThreshold(10);
-  smart_factors_params.setRetriangulationThreshold(0.001);
-  smart_factors_params.setDynamicOutlierRejectionThreshold(3);
-
+    const std::vector<FrameId>& inlier_id_in_match_frame,
+    gtsam::Matrix6* camMatch_info_camQuery) {
+  CHECK_EQ(inlier_id_in_query_frame.size(), inlier_id_in_match_frame.size());
+  CHECK(stereo_pose_refiner_);
+  if (camMatch_info_camQuery) camMatch_info_camQuery->setZero();
+  const LCDFrame& query_frame = db_frames_.at(query_id);
+  const LCDFrame& match_frame = db_frames_.at(match_id);
+
+  stereo_pose_refiner_->clear();
   for (size_t i = 0; i < inlier_id_in_query_frame.size(); i++) {
-    KeypointCV undistorted_rectified_left_query_keypoint =
-        (db_frames_[query_id]
-             .left_keypoints_rectified_.at(inlier_id_in_query_frame[i]).second);
-    KeypointCV undistorted_rectified_right_query_keypoint =
-        (db_frames_[query_id]
-             .right_keypoints_rectified_.at(inlier_id_in_query_frame[i]).second);
-
-    gtsam::StereoPoint2 sp_query_i(undistorted_rectified_left_query_keypoint.x,
-                                   undistorted_rectified_right_query_keypoint.x,
-                                   undistorted_rectified_left_query_keypoint.y);
-
-    SmartStereoFactor stereo_factor_i(noise_stereo, smart_factors_params);
-
-    stereo_factor_i.add(sp_query_i, key_query, stereo_camera_->getStereoCalib());
-
-    KeypointCV undistorted_rectified_left_match_keypoint =
-        (db_frames_[match_id]
-             .left_keypoints_rectified_.at(inlier_id_in_match_frame[i]).second);
-    KeypointCV undistorted_rectified_right_match_keypoint =
-        (db_frames_[match_id]
-             .right_keypoints_rectified_.at(inlier_id_in_match_frame[i]).second);
-
-    gtsam::StereoPoint2 sp_match_i(undistorted_rectified_left_match_keypoint.x,
-                                   undistorted_rectified_right_match_keypoint.x,
-                                   undistorted_rectified_left_match_keypoint.y);
-
-    stereo_factor_i.add(sp_match_i, key_match, stereo_camera_->getStereoCalib());
-
-    nfg.add(stereo_factor_i);
+    const StatusKeypointCV& right_query_keypoint =
+        query_frame.right_keypoints_rectified_.at(inlier_id_in_query_frame[i]);
+    const StatusKeypointCV& right_match_keypoint =
+        match_frame.right_keypoints_rectified_.at(inlier_id_in_match_frame[i]);
+    // Without a right keypoint there is no stereo measurement to refine with.
+    if (right_query_keypoint.first != KeypointStatus::VALID ||
+        right_match_keypoint.first != KeypointStatus::VALID) {
+      continue;
+    }
+    const KeypointCV& left_query_keypoint =
+        query_frame.left_keypoints_rectified_.at(inlier_id_in_query_frame[i])
+            .second;
+    const KeypointCV& left_match_keypoint =
+        match_frame.left_keypoints_rectified_.at(inlier_id_in_match_frame[i])
+            .second;
+
+    stereo_pose_refiner_->addCorrespondence(
+        gtsam::StereoPoint2(left_query_keypoint.x,
+                            right_query_keypoint.second.x,
+                            left_query_keypoint.y),
+        gtsam::StereoPoint2(left_match_keypoint.x,
+                            right_match_keypoint.second.x,
+                            left_match_keypoint.y));
   }
 
-  gtsam::LevenbergMarquardtParams params;
-  params.setVerbosityLM("ERROR");
-  try {
-    values = gtsam::LevenbergMarquardtOptimizer(nfg, values, params).optimize();
-  } catch (const gtsam::CheiralityException& e) {
-    LOG(ERROR) << e.what();
-  } catch (const gtsam::StereoCheiralityException& e) {
-    LOG(ERROR) << e.what();
-  } catch (const gtsam::OutOfRangeThreadsafe& e) {
-    LOG(ERROR) << e.what();
-  } catch (const std::out_of_range& e) {
-    LOG(ERROR) << e.what();
-  } catch (const std::exception& e) {
-    // Catch anything thrown within try block that derives from
-    // std::exception.
-    LOG(ERROR) << e.what();
-  } catch (...) {
-    // Catch the rest of exceptions.
-    LOG(ERROR) << "Unrecognized exception.";
+  gtsam::Pose3 camMatch_T_camQuery_refined;
+  if (!stereo_pose_refiner_->refine(camMatch_T_camQuery_stereo,
+                                    &camMatch_T_camQuery_refined,
+                                    camMatch_info_camQuery)) {
+    VLOG(10) << "LoopClosureDetector: pose refinement failed with "
+             << stereo_pose_refiner_->getNrInliers() << " inliers.";
   }
-
-  return values.at<gtsam::Pose3>(key_query);
+  return camMatch_T_camQuery_refined;
 }
 
 /* ------------------------------------------------------------------------ */
@@ -629,11 +775,13 @@ const gtsam::NonlinearFactorGraph LoopClosureDetector::getPGOnfg() const {
 /* ------------------------------------------------------------------------ */
 void LoopClosureDetector::setDatabase(const OrbDatabase& db) {
   db_BoW_ = VIO::make_unique<OrbDatabase>(db);
+  flat_vocab_ = VIO::make_unique<FlatOrbVocabulary>(*db_BoW_->getVocabulary());
 }
 
 /* ------------------------------------------------------------------------ */
 void LoopClosureDetector::setVocabulary(const OrbVocabulary& voc) {
   db_BoW_->setVocabulary(voc);
+  flat_vocab_ = VIO::make_unique<FlatOrbVocabulary>(voc);
 }
 
 /* ------------------------------------------------------------------------ */
@@ -49,6 +49,9 @@ LoopClosureDetectorParams::LoopClosureDetectorParams(
     double ransac_inlier_threshold_stereo,
     bool use_mono_rot,
     bool refine_pose,
+    double refine_pose_huber_threshold,
+    double refine_pose_outlier_threshold,
+    double refine_pose_landmark_distance_threshold,
     double lowe_ratio,
 #if CV_VERSION_MAJOR == 3
     int matcher_type,
@@ -74,7 +77,12 @@ LoopClosureDetectorParams::LoopClosureDetectorParams(
     double betweenTranslationPrecision,
 
     double pgo_rot_threshold,
-    double pgo_trans_threshold)
+    double pgo_trans_threshold,
+
+    bool skip_redundant_keyframes,
+    double min_keyframe_translation,
+    double min_keyframe_rotation,
+    double min_keyframe_image_difference)
     : PipelineParams("Loop Closure Parameters"),
       image_width_(image_width),
       image_height_(image_height),
@@ -108,6 +116,10 @@ LoopClosureDetectorParams::LoopClosureDetectorParams(
       ransac_inlier_threshold_stereo_(ransac_inlier_threshold_stereo),
       use_mono_rot_(use_mono_rot),
       refine_pose_(refine_pose),
+      refine_pose_huber_threshold_(refine_pose_huber_threshold),
+      refine_pose_outlier_threshold_(refine_pose_outlier_threshold),
+      refine_pose_landmark_distance_threshold_(
+          refine_pose_landmark_distance_threshold),
 
       lowe_ratio_(lowe_ratio),
       matcher_type_(matcher_type),
@@ -126,7 +138,12 @@ LoopClosureDetectorParams::LoopClosureDetectorParams(
       betweenTranslationPrecision_(betweenTranslationPrecision),
 
       pgo_rot_threshold_(pgo_rot_threshold),
-      pgo_trans_threshold_(pgo_trans_threshold) {
+      pgo_trans_threshold_(pgo_trans_threshold),
+
+      skip_redundant_keyframes_(skip_redundant_keyframes),
+      min_keyframe_translation_(min_keyframe_translation),
+      min_keyframe_rotation_(min_keyframe_rotation),
+      min_keyframe_image_difference_(min_keyframe_image_difference) {
   // Trivial sanity checks:
   CHECK(alpha_ > 0);
   CHECK(nfeatures_ >= 100);  // TODO(marcus): add more checks, change this one
@@ -197,6 +214,12 @@ bool LoopClosureDetectorParams::parseYAML(const std::string& filepath) {
                            &ransac_inlier_threshold_stereo_);
   yaml_parser.getYamlParam("use_mono_rot", &use_mono_rot_);
   yaml_parser.getYamlParam("refine_pose", &refine_pose_);
+  yaml_parser.getYamlParam("refine_pose_huber_threshold",
+                           &refine_pose_huber_threshold_);
+  yaml_parser.getYamlParam("refine_pose_outlier_threshold",
+                           &refine_pose_outlier_threshold_);
+  yaml_parser.getYamlParam("refine_pose_landmark_distance_threshold",
+                           &refine_pose_landmark_distance_threshold_);
   yaml_parser.getYamlParam("lowe_ratio", &lowe_ratio_);
   yaml_parser.getYamlParam("matcher_type", &matcher_type_);
   yaml_parser.getYamlParam("nfeatures", &nfeatures_);
@@ -228,6 +251,14 @@ bool LoopClosureDetectorParams::parseYAML(const std::string& filepath) {
   yaml_parser.getYamlParam("pgo_rot_threshold", &pgo_rot_threshold_);
   yaml_parser.getYamlParam("pgo_trans_threshold", &pgo_trans_threshold_);
 
+  yaml_parser.getYamlParam("skip_redundant_keyframes",
+                           &skip_redundant_keyframes_);
+  yaml_parser.getYamlParam("min_keyframe_translation",
+                           &min_keyframe_translation_);
+  yaml_parser.getYamlParam("min_keyframe_rotation", &min_keyframe_rotation_);
+  yaml_parser.getYamlParam("min_keyframe_image_difference",
+                           &min_keyframe_image_difference_);
+
   return true;
 }
 
@@ -301,6 +332,12 @@ void LoopClosureDetectorParams::print() const {
                         use_mono_rot_,
                         "refine_pose_:",
                         refine_pose_,
+                        "refine_pose_huber_threshold_: ",
+                        refine_pose_huber_threshold_,
+                        "refine_pose_outlier_threshold_: ",
+                        refine_pose_outlier_threshold_,
+                        "refine_pose_landmark_distance_threshold_: ",
+                        refine_pose_landmark_distance_threshold_,
                         "lowe_ratio_: ",
                         lowe_ratio_,
                         "matcher_type_:",
@@ -333,7 +370,16 @@ void LoopClosureDetectorParams::print() const {
                         "pgo_rot_threshold_: ",
                         pgo_rot_threshold_,
                         "pgo_trans_threshold_: ",
-                        pgo_trans_threshold_);
+                        pgo_trans_threshold_,
+
+                        "skip_redundant_keyframes_: ",
+                        skip_redundant_keyframes_,
+                        "min_keyframe_translation_: ",
+                        min_keyframe_translation_,
+                        "min_keyframe_rotation_: ",
+                        min_keyframe_rotation_,
+                        "min_keyframe_image_difference_: ",
+                        min_keyframe_image_difference_);
   LOG(INFO) << out.str();
 }
 }  // namespace VIO
@@ -0,0 +1,308 @@
+/* ----------------------------------------------------------------------------
+ * Copyright 2017, Massachusetts Institute of Technology,
+ * Cambridge, MA 02139
+ * All Rights Reserved
+ * Authors: Luca Carlone, et al. (see THANKS for the full author list)
+ * See LICENSE for the license information
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @file   StereoPoseRefiner.cpp
+ * @brief  Refinement of the relative pose between two stereo frames.
+ * @author Marcus Abate
+ */
+
+#include "kimera-vio/loopclosure/StereoPoseRefiner.h"
+
+#include <algorithm>
+#include <limits>
+
+#include <glog/logging.h>
+
+#include <Eigen/Cholesky>
+#include <Eigen/LU>
+
+namespace VIO {
+
+namespace {
+// Same defaults as gtsam::LevenbergMarquardtParams.
+constexpr size_t kMaxIterations = 100u;
+constexpr double kInitialLambda = 1e-5;
+constexpr double kMinLambda = 1e-10;
+constexpr double kMaxLambda = 1e5;
+constexpr double kLambdaFactor = 10.0;
+constexpr double kRelativeErrorTolerance = 1e-5;
+constexpr double kAbsoluteErrorTolerance = 1e-5;
+}  // namespace
+
+constexpr size_t StereoPoseRefiner::kMinNrInliers;
+
+/* -------------------------------------------------------------------------- */
+StereoPoseRefiner::StereoPoseRefiner(
+    const gtsam::Cal3_S2Stereo& stereo_calib,
+    const double& huber_threshold,
+    const double& outlier_threshold,
+    const double& landmark_distance_threshold)
+    : fx_(stereo_calib.fx()),
+      fy_(stereo_calib.fy()),
+      cx_(stereo_calib.px()),
+      cy_(stereo_calib.py()),
+      baseline_(stereo_calib.baseline()),
+      huber_threshold_(huber_threshold),
+      outlier_threshold_(outlier_threshold),
+      landmark_distance_threshold_(landmark_distance_threshold),
+      measurements_(),
+      H_pp_(gtsam::Matrix6::Zero()),
+      g_p_(gtsam::Vector6::Zero()) {
+  CHECK_GT(fx_, 0.0);
+  CHECK_GT(fy_, 0.0);
+  CHECK_GT(baseline_, 0.0);
+  CHECK_GT(huber_threshold_, 0.0);
+  CHECK_GT(outlier_threshold_, 0.0);
+  CHECK_GT(landmark_distance_threshold_, 0.0);
+}
+
+/* -------------------------------------------------------------------------- */
+void StereoPoseRefiner::addCorrespondence(const gtsam::StereoPoint2& z_query,
+                                          const gtsam::StereoPoint2& z_match) {
+  measurements_.emplace_back();
+  Measurement& measurement = measurements_.back();
+  measurement.z_query_ << z_query.uL(), z_query.uR(), z_query.v();
+  measurement.z_match_ << z_match.uL(), z_match.uR(), z_match.v();
+}
+
+/* -------------------------------------------------------------------------- */
+bool StereoPoseRefiner::refine(const gtsam::Pose3& camMatch_T_camQuery_initial,
+                               gtsam::Pose3* camMatch_T_camQuery,
+                               gtsam::Matrix6* information) {
+  CHECK_NOTNULL(camMatch_T_camQuery);
+  *camMatch_T_camQuery = camMatch_T_camQuery_initial;
+
+  // Initialize the landmarks at the midpoint of their back-projections in
+  // both frames. Landmarks that cannot be back-projected are put behind the
+  // match camera so that they are never inliers.
+  const gtsam::Matrix3 R = camMatch_T_camQuery_initial.rotation().matrix();
+  const gtsam::Vector3 t = camMatch_T_camQuery_initial.translation();
+  for (Measurement& measurement : measurements_) {
+    gtsam::Vector3 landmark_match, landmark_query;
+    if (!backprojectStereo(measurement.z_match_, &landmark_match) ||
+        !backprojectStereo(measurement.z_query_, &landmark_query)) {
+      measurement.landmark_ = -gtsam::Vector3::UnitZ();
+      continue;
+    }
+    measurement.landmark_ = 0.5 * (landmark_match + R * landmark_query + t);
+  }
+
+  gtsam::Pose3 pose = camMatch_T_camQuery_initial;
+  double cost = linearize(pose);
+  if (nr_inliers_ < kMinNrInliers) {
+    VLOG(2) << "StereoPoseRefiner: not enough inliers: " << nr_inliers_;
+    return false;
+  }
+
+  double lambda = kInitialLambda;
+  gtsam::Vector6 delta;
+  for (size_t iter = 0u; iter < kMaxIterations; ++iter) {
+    // Increase the damping until the step decreases the cost.
+    bool step_accepted = false;
+    gtsam::Pose3 new_pose;
+    double new_cost = cost;
+    while (lambda <= kMaxLambda) {
+      solve(lambda, &delta);
+      new_pose = pose.retract(delta);
+      new_cost = evaluate(new_pose);
+      if (new_cost < cost) {
+        step_accepted = true;
+        break;
+      }
+      lambda *= kLambdaFactor;
+    }
+    if (!step_accepted) break;
+
+    pose = new_pose;
+    for (Measurement& measurement : measurements_) {
+      if (measurement.inlier_) {
+        measurement.landmark_ = measurement.landmark_candidate_;
+      }
+    }
+    lambda = std::max(lambda / kLambdaFactor, kMinLambda);
+    const bool converged = cost - new_cost < kAbsoluteErrorTolerance ||
+                           cost - new_cost < kRelativeErrorTolerance * cost;
+
+    // The set of inliers may change at the new linearization point.
+    cost = linearize(pose);
+    if (nr_inliers_ < kMinNrInliers) {
+      VLOG(2) << "StereoPoseRefiner: not enough inliers: " << nr_inliers_;
+      return false;
+    }
+    if (converged) break;
+  }
+
+  *camMatch_T_camQuery = pose;
+  if (information) {
+    // The last linearization is at the refined pose.
+    *information = marginalInformation();
+    if (information->llt().info() != Eigen::Success) {
+      VLOG(2) << "StereoPoseRefiner: information is not positive definite.";
+      information->setZero();
+    }
+  }
+  return true;
+}
+
+/* -------------------------------------------------------------------------- */
+bool StereoPoseRefiner::projectStereo(const gtsam::Vector3& point,
+                                      gtsam::Vector3* z,
+                                      gtsam::Matrix3* H_point) const {
+  DCHECK(z);
+  if (!(point.z() > 0.0)) return false;
+  const double d = 1.0 / point.z();
+  const double x = point.x();
+  const double y = point.y();
+  *z << cx_ + fx_ * x * d, cx_ + fx_ * (x - baseline_) * d, cy_ + fy_ * y * d;
+  if (H_point) {
+    const double d2 = d * d;
+    *H_point << fx_ * d, 0.0, -fx_ * x * d2,       //
+        fx_ * d, 0.0, -fx_ * (x - baseline_) * d2,  //
+        0.0, fy_ * d, -fy_ * y * d2;
+  }
+  return true;
+}
+
+/* -------------------------------------------------------------------------- */
+bool StereoPoseRefiner::backprojectStereo(const gtsam::Vector3& z,
+                                          gtsam::Vector3* point) const {
+  DCHECK(point);
+  const double disparity = z(0) - z(1);
+  if (!(disparity > 0.0)) return false;
+  const double depth = fx_ * baseline_ / disparity;
+  *point << (z(0) - cx_) * depth / fx_, (z(2) - cy_) * depth / fy_, depth;
+  return true;
+}
+
+/* -------------------------------------------------------------------------- */
+double StereoPoseRefiner::linearize(const gtsam::Pose3& camMatch_T_camQuery) {
+  const gtsam::Matrix3 R = camMatch_T_camQuery.rotation().matrix();
+  const gtsam::Vector3 t = camMatch_T_camQuery.translation();
+  H_pp_.setZero();
+  g_p_.setZero();
+  nr_inliers_ = 0u;
+  double cost = 0.0;
+
+  gtsam::Vector3 z_match, z_query;
+  gtsam::Matrix3 D_match, D_query;
+  Matrix36 H_pose;
+  for (Measurement& measurement : measurements_) {
+    measurement.inlier_ = false;
+    // Checked at every linearization, as the landmarks move in the steps.
+    if (measurement.landmark_.norm() > landmark_distance_threshold_) continue;
+    // Landmark in the query camera frame, as Pose3::transformTo.
+    const gtsam::Vector3 q = R.transpose() * (measurement.landmark_ - t);
+    if (!projectStereo(measurement.landmark_, &z_match, &D_match) ||
+        !projectStereo(q, &z_query, &D_query)) {
+      continue;
+    }
+    const gtsam::Vector3 r_match = z_match - measurement.z_match_;
+    const gtsam::Vector3 r_query = z_query - measurement.z_query_;
+    const double e_match = r_match.norm();
+    const double e_query = r_query.norm();
+    if (e_match > outlier_threshold_ || e_query > outlier_threshold_) continue;
+    measurement.inlier_ = true;
+    ++nr_inliers_;
+    cost += huberCost(e_match) + huberCost(e_query);
+
+    // Jacobians of the query residual wrt the pose (rotation first, as the
+    // Pose3 retraction) and wrt the landmark.
+    H_pose.leftCols<3>() = gtsam::skewSymmetric(q);
+    H_pose.rightCols<3>() = -gtsam::Matrix3::Identity();
+    const Matrix36 J_query_pose = D_query * H_pose;
+    const gtsam::Matrix3 J_query_landmark = D_query * R.transpose();
+    const gtsam::Matrix3& J_match_landmark = D_match;
+
+    const double w_match = huberWeight(e_match);
+    const double w_query = huberWeight(e_query);
+    measurement.H_ll_ =
+        w_match * J_match_landmark.transpose() * J_match_landmark +
+        w_query * J_query_landmark.transpose() * J_query_landmark;
+    measurement.H_lp_ = w_query * J_query_landmark.transpose() * J_query_pose;
+    measurement.g_l_ = -(w_match * J_match_landmark.transpose() * r_match +
+                         w_query * J_query_landmark.transpose() * r_query);
+    H_pp_ += w_query * J_query_pose.transpose() * J_query_pose;
+    g_p_ -= w_query * J_query_pose.transpose() * r_query;
+  }
+  return cost;
+}
+
+/* -------------------------------------------------------------------------- */
+void StereoPoseRefiner::solve(const double& lambda, gtsam::Vector6* delta) {
+  CHECK_NOTNULL(delta);
+  // Marquardt damping of the full system, then elimination of the landmarks.
+  gtsam::Matrix6 H = H_pp_;
+  H.diagonal() += lambda * H_pp_.diagonal();
+  gtsam::Vector6 g = g_p_;
+  for (Measurement& measurement : measurements_) {
+    if (!measurement.inlier_) continue;
+    gtsam::Matrix3 H_ll = measurement.H_ll_;
+    H_ll.diagonal() += lambda * measurement.H_ll_.diagonal();
+    measurement.H_ll_inv_ = H_ll.inverse();
+    const Eigen::Matrix<double, 6, 3> H_pl_H_ll_inv =
+        measurement.H_lp_.transpose() * measurement.H_ll_inv_;
+    H -= H_pl_H_ll_inv * measurement.H_lp_;
+    g -= H_pl_H_ll_inv * measurement.g_l_;
+  }
+  *delta = H.ldlt().solve(g);
+
+  for (Measurement& measurement : measurements_) {
+    if (!measurement.inlier_) continue;
+    measurement.landmark_candidate_ =
+        measurement.landmark_ +
+        measurement.H_ll_inv_ *
+            (measurement.g_l_ - measurement.H_lp_ * (*delta));
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+double StereoPoseRefiner::evaluate(
+    const gtsam::Pose3& camMatch_T_camQuery) const {
+  const gtsam::Matrix3 R = camMatch_T_camQuery.rotation().matrix();
+  const gtsam::Vector3 t = camMatch_T_camQuery.translation();
+  double cost = 0.0;
+  gtsam::Vector3 z_match, z_query;
+  for (const Measurement& measurement : measurements_) {
+    if (!measurement.inlier_) continue;
+    const gtsam::Vector3& landmark = measurement.landmark_candidate_;
+    if (!projectStereo(landmark, &z_match, nullptr) ||
+        !projectStereo(R.transpose() * (landmark - t), &z_query, nullptr)) {
+      return std::numeric_limits<double>::infinity();
+    }
+    cost += huberCost((z_match - measurement.z_match_).norm()) +
+            huberCost((z_query - measurement.z_query_).norm());
+  }
+  return cost;
+}
+
+/* -------------------------------------------------------------------------- */
+gtsam::Matrix6 StereoPoseRefiner::marginalInformation() const {
+  gtsam::Matrix6 information = H_pp_;
+  for (const Measurement& measurement : measurements_) {
+    if (!measurement.inlier_) continue;
+    information -= measurement.H_lp_.transpose() *
+                   measurement.H_ll_.inverse() * measurement.H_lp_;
+  }
+  // Remove the round-off asymmetry before it is factorized.
+  return 0.5 * (information + information.transpose());
+}
+
+/* -------------------------------------------------------------------------- */
+double StereoPoseRefiner::huberCost(const double& error_norm) const {
+  return error_norm <= huber_threshold_
+             ? 0.5 * error_norm * error_norm
+             : huber_threshold_ * (error_norm - 0.5 * huber_threshold_);
+}
+
+/* -------------------------------------------------------------------------- */
+double StereoPoseRefiner::huberWeight(const double& error_norm) const {
+  return error_norm <= huber_threshold_ ? 1.0 : huber_threshold_ / error_norm;
+}
+
+}  // namespace VIO
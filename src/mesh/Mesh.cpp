@@ -14,6 +14,8 @@
 
 #include "kimera-vio/mesh/Mesh.h"
 
+#include <algorithm>
+
 #include <glog/logging.h>
 
 #include <opencv2/core/core.hpp>
@@ -167,7 +169,8 @@ void Mesh<VertexPositionType>::addPolygonToMesh(const Polygon& polygon) {
     // Update adjacency matrix
     if (!triangle_maybe_already_in_mesh) {
       // There are new vertices!
-      // TODO(Toni): this assumes that we never remove vertices!!
+      // Vertex ids are kept compact (see garbageCollectVertices), so new
+      // vertices always come after the existing rows/cols.
       // Add a new col/row for each new vtx
       // Check vtx_ids are ordered
       VertexIds sorted_vtx_ids = vtx_ids;
@@ -213,8 +216,8 @@ Mesh<VertexPositionType>::updateMeshDataStructures(
     const VertexPositionType& lmk_position,
     const VertexColorRGB& vertex_color,
     const VertexNormal& vertex_normal,
-    std::map<VertexId, LandmarkId>* vertex_to_lmk_id_map,
-    std::map<LandmarkId, VertexId>* lmk_id_to_vertex_id_map,
+    VertexToLmkIdMap* vertex_to_lmk_id_map,
+    LmkIdToVertexMap* lmk_id_to_vertex_id_map,
     cv::Mat* vertices_mesh,
     VertexNormals* vertices_mesh_normal,
     cv::Mat* vertices_mesh_color) const {
@@ -225,23 +228,25 @@ Mesh<VertexPositionType>::updateMeshDataStructures(
   CHECK_NOTNULL(vertices_mesh_color);
   DCHECK(!normals_computed_) << "Normals should be invalidated before...";
 
-  const auto& lmk_id_to_vertex_map_end = lmk_id_to_vertex_id_map->end();
-  const auto& vertex_it = lmk_id_to_vertex_id_map->find(lmk_id);
+  // Check whether this landmark is already in the set of vertices of the
+  // mesh, and book a new vertex id for it otherwise.
+  const auto& inserted = lmk_id_to_vertex_id_map->emplace(
+      lmk_id, static_cast<VertexId>(vertices_mesh->rows));
+  const auto& vertex_it = inserted.first;
 
   VertexId row_id_vertex;
-  // Check whether this landmark is already in the set of vertices of the
-  // mesh.
-  if (vertex_it == lmk_id_to_vertex_map_end) {
+  if (inserted.second) {
     // New landmark, create a new entrance in the set of vertices.
     // Store 3D points in map_points_3d.
     vertices_mesh->push_back(lmk_position);
     vertices_mesh_normal->push_back(vertex_normal);
     vertices_mesh_color->push_back(vertex_color);
     row_id_vertex = vertices_mesh->rows - 1;
+    CHECK_EQ(row_id_vertex, vertex_it->second);
     // Book-keeping.
-    // Store the row in the vertices structure of this new landmark id.
-    (*lmk_id_to_vertex_id_map)[lmk_id] = row_id_vertex;
-    (*vertex_to_lmk_id_map)[row_id_vertex] = lmk_id;
+    // Store the lmk id of the new row in the vertices structure.
+    CHECK_EQ(vertex_to_lmk_id_map->size(), row_id_vertex);
+    vertex_to_lmk_id_map->push_back(lmk_id);
   } else {
     // Update old landmark with new position.
     // But don't update the color information... Or should we?
@@ -277,11 +282,10 @@ bool Mesh<VertexPositionType>::getPolygon(const size_t& polygon_idx,
   for (size_t j = 0; j < polygon_dimension_; j++) {
     const int32_t& row_id_pt_j =
         polygons_mesh_.at<int32_t>(idx_in_polygon_mesh + j + 1);
-    CHECK(vertex_to_lmk_id_map_.find(row_id_pt_j) !=
-           vertex_to_lmk_id_map_.end());
+    CHECK_LT(row_id_pt_j, vertex_to_lmk_id_map_.size());
     CHECK_LT(row_id_pt_j, vertices_mesh_.rows);
     polygon->at(j) = Vertex<VertexPositionType>(
-        vertex_to_lmk_id_map_.at(row_id_pt_j),
+        vertex_to_lmk_id_map_[row_id_pt_j],
         vertices_mesh_.at<VertexPositionType>(row_id_pt_j),
         vertices_mesh_color_.at<VertexColorRGB>(row_id_pt_j),
         has_normals? vertices_mesh_normal_.at(row_id_pt_j) : VertexNormal());
@@ -315,7 +319,7 @@ bool Mesh<VertexPosition>::getVertex(const LandmarkId& lmk_id,
     if (vertex_id != nullptr) *vertex_id = vtx_id;
     if (vertex != nullptr)
       *vertex = Vertex<VertexPosition>(
-          vertex_to_lmk_id_map_.at(vtx_id),
+          vertex_to_lmk_id_map_[vtx_id],
           vertices_mesh_.at<VertexPosition>(vtx_id),
           vertices_mesh_color_.at<VertexColorRGB>(vtx_id),
           vertices_mesh_normal_.at(vtx_id));
@@ -444,15 +448,11 @@ bool Mesh<VertexPositionType>::setVertexPosition(
 // Get a list of all lmk ids in the mesh.
 template <typename VertexPositionType>
 LandmarkIds Mesh<VertexPositionType>::getLandmarkIds() const {
-  LandmarkIds lmk_ids(lmk_id_to_vertex_map_.size());
-  size_t i = 0;
-  for (LmkIdToVertexMap::const_iterator it = lmk_id_to_vertex_map_.begin();
-       it != lmk_id_to_vertex_map_.end();
-       ++it) {
-    lmk_ids[i] = it->first;
-    i++;
-  }
-  CHECK_EQ(i, lmk_id_to_vertex_map_.size());
+  // Sorted, as they are not stored in order.
+  LandmarkIds lmk_ids(vertex_to_lmk_id_map_.begin(),
+                      vertex_to_lmk_id_map_.end());
+  CHECK_EQ(lmk_ids.size(), lmk_id_to_vertex_map_.size());
+  std::sort(lmk_ids.begin(), lmk_ids.end());
   return lmk_ids;
 }
 
@@ -495,6 +495,159 @@ void Mesh<VertexPositionType>::clearMesh() {
   lmk_id_to_vertex_map_.clear();
 }
 
+/* -------------------------------------------------------------------------- */
+template <typename VertexPositionType>
+size_t Mesh<VertexPositionType>::removePolygons(
+    const std::vector<bool>& keep_polygon) {
+  CHECK_EQ(polygon_dimension_, 3) << "This doesn't work with non-triangles";
+  const size_t n_polygons = getNumberOfPolygons();
+  CHECK_EQ(keep_polygon.size(), n_polygons);
+  if (n_polygons == 0u) return 0u;
+  CHECK(polygons_mesh_.isContinuous());
+
+  // Shift the kept polygons down, dropping the hash and edges of the others.
+  const size_t stride = polygon_dimension_ + 1u;
+  int32_t* polygons = polygons_mesh_.ptr<int32_t>();
+  size_t n_kept = 0u;
+  for (size_t i = 0u; i < n_polygons; i++) {
+    int32_t* polygon = polygons + i * stride;
+    if (keep_polygon[i]) {
+      if (n_kept != i) {
+        std::copy(polygon, polygon + stride, polygons + n_kept * stride);
+      }
+      n_kept++;
+    } else {
+      face_hashes_.erase(getTriangleHash(polygon + 1u));
+      setTriangleEdges(polygon + 1u, 0u);
+    }
+  }
+  const size_t n_removed = n_polygons - n_kept;
+  if (n_removed == 0u) return 0u;
+  polygons_mesh_.resize(n_kept * stride);
+  normals_computed_ = false;
+
+  // Edges shared between a removed and a kept polygon were cleared above.
+  for (size_t i = 0u; i < n_kept; i++) {
+    setTriangleEdges(polygons + i * stride + 1u, 1u);
+  }
+  return n_removed;
+}
+
+/* -------------------------------------------------------------------------- */
+template <typename VertexPositionType>
+size_t Mesh<VertexPositionType>::garbageCollectVertices() {
+  CHECK_EQ(polygon_dimension_, 3) << "This doesn't work with non-triangles";
+  const int n_vertices = vertices_mesh_.rows;
+  CHECK_EQ(vertices_mesh_color_.rows, n_vertices);
+  const size_t n_polygons = getNumberOfPolygons();
+  const size_t stride = polygon_dimension_ + 1u;
+  CHECK(n_polygons == 0u || polygons_mesh_.isContinuous());
+  int32_t* polygons = n_polygons > 0u ? polygons_mesh_.ptr<int32_t>() : nullptr;
+
+  // Mark the vertices referenced by at least one polygon.
+  std::vector<int32_t> new_vtx_ids(n_vertices, -1);
+  for (size_t i = 0u; i < n_polygons; i++) {
+    for (size_t j = 1u; j < stride; j++) {
+      const int32_t& vtx_id = polygons[i * stride + j];
+      DCHECK_LT(vtx_id, n_vertices);
+      new_vtx_ids[vtx_id] = 0;
+    }
+  }
+
+  // Assign compact ids to the live vertices, preserving their order.
+  int32_t n_live = 0;
+  for (int32_t& new_vtx_id : new_vtx_ids) {
+    if (new_vtx_id == 0) new_vtx_id = n_live++;
+  }
+  const size_t n_removed = n_vertices - n_live;
+  if (n_removed == 0u) return 0u;
+
+  // Copy the live vertices into storage sized to them, releasing the rest.
+  const bool has_normals = vertices_mesh_normal_.size() == n_vertices;
+  cv::Mat vertices_mesh(n_live, 1, vertices_mesh_.type());
+  cv::Mat vertices_mesh_color(n_live, 1, vertices_mesh_color_.type());
+  VertexNormals vertices_mesh_normal(has_normals ? n_live : 0);
+  for (int32_t vtx_id = 0; vtx_id < n_vertices; vtx_id++) {
+    const int32_t& new_vtx_id = new_vtx_ids[vtx_id];
+    if (new_vtx_id < 0) continue;
+    vertices_mesh.at<VertexPositionType>(new_vtx_id) =
+        vertices_mesh_.at<VertexPositionType>(vtx_id);
+    vertices_mesh_color.at<VertexColorRGB>(new_vtx_id) =
+        vertices_mesh_color_.at<VertexColorRGB>(vtx_id);
+    if (has_normals) {
+      vertices_mesh_normal[new_vtx_id] = vertices_mesh_normal_[vtx_id];
+    }
+  }
+  vertices_mesh_ = vertices_mesh;
+  vertices_mesh_color_ = vertices_mesh_color;
+  vertices_mesh_normal_.swap(vertices_mesh_normal);
+
+  // Remap the polygons, and rebuild the face hashes and adjacency on the new
+  // vertex ids. The adjacency matrix is never smaller than 1x1.
+  const int adjacency_size = std::max(n_live, 1);
+  adjacency_matrix_ =
+      cv::Mat(adjacency_size, adjacency_size, CV_8UC1, cv::Scalar(0u));
+  face_hashes_.clear();
+  for (size_t i = 0u; i < n_polygons; i++) {
+    int32_t* polygon = polygons + i * stride + 1u;
+    for (size_t j = 0u; j < polygon_dimension_; j++) {
+      polygon[j] = new_vtx_ids[polygon[j]];
+    }
+    face_hashes_[getTriangleHash(polygon)] = true;
+    setTriangleEdges(polygon, 1u);
+  }
+
+  // Remap the lmk id maps. New ids never exceed old ones, so the lmk ids of
+  // the live vertices can be moved down in place.
+  CHECK_EQ(vertex_to_lmk_id_map_.size(), n_vertices);
+  for (int32_t vtx_id = 0; vtx_id < n_vertices; vtx_id++) {
+    const int32_t& new_vtx_id = new_vtx_ids[vtx_id];
+    if (new_vtx_id < 0) continue;
+    vertex_to_lmk_id_map_[new_vtx_id] = vertex_to_lmk_id_map_[vtx_id];
+  }
+  vertex_to_lmk_id_map_.resize(n_live);
+  vertex_to_lmk_id_map_.shrink_to_fit();
+  for (auto it = lmk_id_to_vertex_map_.begin();
+       it != lmk_id_to_vertex_map_.end();) {
+    const int32_t& new_vtx_id = new_vtx_ids[it->second];
+    if (new_vtx_id < 0) {
+      it = lmk_id_to_vertex_map_.erase(it);
+    } else {
+      it->second = new_vtx_id;
+      ++it;
+    }
+  }
+  CHECK_EQ(vertex_to_lmk_id_map_.size(), lmk_id_to_vertex_map_.size());
+  CHECK_EQ(vertex_to_lmk_id_map_.size(), n_live);
+
+  VLOG(10) << "Garbage collected " << n_removed << " mesh vertices, "
+           << n_live << " left.";
+  return n_removed;
+}
+
+/* -------------------------------------------------------------------------- */
+template <typename VertexPositionType>
+size_t Mesh<VertexPositionType>::getTriangleHash(const int32_t* vtx_ids) {
+  DCHECK(vtx_ids);
+  VertexIds sorted_vtx_ids(vtx_ids, vtx_ids + 3u);
+  std::sort(sorted_vtx_ids.begin(), sorted_vtx_ids.end());
+  return UtilsNumerical::hashTriplet(
+      sorted_vtx_ids[0], sorted_vtx_ids[1], sorted_vtx_ids[2]);
+}
+
+/* -------------------------------------------------------------------------- */
+template <typename VertexPositionType>
+void Mesh<VertexPositionType>::setTriangleEdges(const int32_t* vtx_ids,
+                                                const uint8_t& value) {
+  DCHECK(vtx_ids);
+  adjacency_matrix_.at<uint8_t>(vtx_ids[0], vtx_ids[1]) = value;
+  adjacency_matrix_.at<uint8_t>(vtx_ids[1], vtx_ids[0]) = value;
+  adjacency_matrix_.at<uint8_t>(vtx_ids[0], vtx_ids[2]) = value;
+  adjacency_matrix_.at<uint8_t>(vtx_ids[2], vtx_ids[0]) = value;
+  adjacency_matrix_.at<uint8_t>(vtx_ids[1], vtx_ids[2]) = value;
+  adjacency_matrix_.at<uint8_t>(vtx_ids[2], vtx_ids[1]) = value;
+}
+
 // explicit instantiations
 template class Mesh<Vertex2D>;
 template class Mesh<Vertex3D>;
@@ -85,11 +85,10 @@ void MeshOptimization::draw3dMesh(const std::string& id,
                                   const Mesh3D& mesh_3d,
                                   bool display_as_wireframe,
                                   const double& opacity) {
-  cv::Mat vertices_mesh;
-  cv::Mat polygons_mesh;
-  mesh_3d.getVerticesMeshToMat(&vertices_mesh);
-  mesh_3d.getPolygonsMeshToMat(&polygons_mesh);
-  cv::Mat colors_mesh = mesh_3d.getColorsMesh().t();  // Note the transpose.
+  const cv::Mat& vertices_mesh = mesh_3d.getVerticesMeshView();
+  const cv::Mat& polygons_mesh = mesh_3d.getPolygonsMeshView();
+  // Note the transpose.
+  cv::Mat colors_mesh = mesh_3d.getColorsMeshView().t();
   if (colors_mesh.empty()) {
     colors_mesh = cv::Mat(1u,
                           mesh_3d.getNumberOfUniqueVertices(),
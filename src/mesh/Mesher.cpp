@@ -29,6 +29,7 @@
 
 #include "kimera-vio/utils/Statistics.h"
 #include "kimera-vio/utils/Timer.h"
+#include "kimera-vio/utils/UtilsNumerical.h"
 
 // General functionality for the mesher.
 DEFINE_bool(add_extra_lmks_from_stereo,
@@ -39,6 +40,12 @@ DEFINE_bool(reduce_mesh_to_time_horizon,
             true,
             "Reduce mesh vertices to the "
             "landmarks available in current optimization's time horizon.");
+DEFINE_int32(mesh_vertex_gc_period,
+             5,
+             "Compact the storage of the 3D mesh by dropping the vertices "
+             "that are no longer used by any polygon every this many mesh "
+             "updates, 0 disables it. The output mesh never has such "
+             "vertices.");
 DEFINE_bool(compute_per_vertex_normals,
             false,
             "Compute per-vertex normals,"
@@ -224,10 +231,16 @@ MesherOutput::UniquePtr Mesher::spinOnce(const MesherInput& input) {
     LOG_FIRST_N(WARNING, 1) << "Mesh serialization enabled.";
     serializeMeshes();
   }
-  // TODO(Toni): remove these calls, since all info is in mesh_3d_...
-  getVerticesMesh(&(mesher_output_payload->vertices_mesh_));
-  getPolygonsMesh(&(mesher_output_payload->polygons_mesh_));
   mesher_output_payload->mesh_3d_ = mesh_3d_;
+  // Vertices of removed polygons only leave mesh_3d_ every
+  // FLAGS_mesh_vertex_gc_period updates, but never reach the output.
+  mesher_output_payload->mesh_3d_.garbageCollectVertices();
+  // TODO(Toni): remove these, since all info is in mesh_3d_...
+  // The payload owns a copy of the mesh already, share its buffers.
+  mesher_output_payload->vertices_mesh_ =
+      mesher_output_payload->mesh_3d_.getVerticesMeshView();
+  mesher_output_payload->polygons_mesh_ =
+      mesher_output_payload->mesh_3d_.getPolygonsMeshView();
   return mesher_output_payload;
 }
 
@@ -522,9 +535,9 @@ void Mesher::updatePolygonMeshToTimeHorizon(
          "cannot trim 3D mesh to time horizon.";
   const auto& end = points_with_id_map.end();
 
-  // Loop over each face in the mesh.
+  // Loop over each face in the mesh, updating it in place.
   Mesh3D::Polygon polygon;
-  Mesh3D mesh_output;
+  std::vector<bool> keep_polygon(mesh_3d_.getNumberOfPolygons(), false);
   for (size_t i = 0; i < mesh_3d_.getNumberOfPolygons(); i++) {
     CHECK(mesh_3d_.getPolygon(i, &polygon)) << "Could not retrieve polygon.";
     bool save_polygon = true;
@@ -534,7 +547,7 @@ void Mesher::updatePolygonMeshToTimeHorizon(
         // Vertex of current polygon is not in points_with_id_map
         if (reduce_mesh_to_time_horizon) {
           // We want to reduce the mesh to time horizon.
-          // Delete the polygon by not adding it to the new mesh.
+          // Delete the polygon by not keeping it in the mesh.
           save_polygon = false;
           break;
         } else {
@@ -549,24 +562,31 @@ void Mesher::updatePolygonMeshToTimeHorizon(
         vertex.setVertexPosition(Vertex3D(point_with_id_it->second.x(),
                                           point_with_id_it->second.y(),
                                           point_with_id_it->second.z()));
+        mesh_3d_.setVertexPosition(vertex.getLmkId(),
+                                   vertex.getVertexPosition());
       }
     }
 
     if (save_polygon) {
       // Refilter polygons, as the updated vertices might make it unvalid.
-      if (!isBadTriangle(
-              polygon,
-              leftCameraPose,
-              min_ratio_largest_smallest_side,
-              -1.0,  // elongation test is invalid, no per-frame concept
-              max_triangle_side)) {
-        // Finally add the polygon to the mesh.
-        mesh_output.addPolygonToMesh(polygon);
-      }
+      keep_polygon[i] = !isBadTriangle(
+          polygon,
+          leftCameraPose,
+          min_ratio_largest_smallest_side,
+          -1.0,  // elongation test is invalid, no per-frame concept
+          max_triangle_side);
     }
   }
-
-  mesh_3d_ = mesh_output;
+  mesh_3d_.removePolygons(keep_polygon);
+
+  // Vertices of removed polygons stay in the mesh until they are collected,
+  // the output mesh is collected on every update instead.
+  if (FLAGS_mesh_vertex_gc_period > 0 &&
+      ++nr_updates_since_vertex_gc_ >=
+          static_cast<size_t>(FLAGS_mesh_vertex_gc_period)) {
+    mesh_3d_.garbageCollectVertices();
+    nr_updates_since_vertex_gc_ = 0u;
+  }
   VLOG(10) << "Finished updatePolygonMeshToTimeHorizon.";
 }
 
@@ -831,9 +851,11 @@ void Mesher::segmentPlanesInMesh(
 
   // Cluster new lmk ids for seed planes.
   // Loop over the mesh only once.
+  // The histograms for new planes are updated incrementally: only the votes of
+  // polygons that changed bins since the last call are added/removed.
+  histogram_votes_stamp_++;
   Mesh3D::Polygon polygon;
-  cv::Mat z_components(1, 0, CV_32F);
-  cv::Mat walls(0, 0, CV_32FC2);
+  size_t nr_wall_polygons = 0u;
   for (size_t i = 0; i < mesh_3d_.getNumberOfPolygons(); i++) {
     CHECK(mesh_3d_.getPolygon(i, &polygon)) << "Could not retrieve polygon.";
     CHECK_EQ(polygon.size(), mesh_polygon_dim);
@@ -844,6 +866,7 @@ void Mesher::segmentPlanesInMesh(
     // Calculate normal of the triangle in the mesh.
     // The normals are in the world frame of reference.
     cv::Point3f triangle_normal;
+    PolygonHistogramVotes polygon_votes;
     if (calculateNormal(p1, p2, p3, &triangle_normal)) {
       ////////////////////////// Update seed planes ////////////////////////////
       // Update seed_planes lmk_ids field with ids of vertices of polygon if the
@@ -870,12 +893,10 @@ void Mesher::segmentPlanesInMesh(
               vertical, triangle_normal, normal_tolerance_horizontal_surface)) {
         // We have a triangle with a normal aligned with gravity, which is not
         // already clustered in a plane.
-        // Store z components to build histogram.
-        // TODO instead of storing z_components, use the accumulate flag in
-        // calcHist and add them straight.
-        z_components.push_back(p1.z);
-        z_components.push_back(p2.z);
-        z_components.push_back(p3.z);
+        // Vote with its z components in the histogram.
+        polygon_votes.z_bins_[0] = z_hist_.getBinIndex(&p1.z);
+        polygon_votes.z_bins_[1] = z_hist_.getBinIndex(&p2.z);
+        polygon_votes.z_bins_[2] = z_hist_.getBinIndex(&p3.z);
       } else if ((FLAGS_only_use_non_clustered_points ? !is_polygon_on_a_plane
                                                       : true) &&
                  isNormalPerpendicularToAxis(
@@ -899,20 +920,76 @@ void Mesher::segmentPlanesInMesh(
           VLOG(10) << "New normalized theta: " << theta
                    << " and distance: " << distance;
         }
-        walls.push_back(cv::Point2f(theta, distance));
+        const float wall[2] = {static_cast<float>(theta),
+                               static_cast<float>(distance)};
+        polygon_votes.wall_bin_ = hist_2d_.getBinIndex(wall);
+        nr_wall_polygons++;
         // WARNING should we instead be using projected triangle normal
         // on equator, and taking average of three distances...
         // NORMALIZE if a theta is positive and distance negative, it is the
         // same as if theta is 180 deg from it and distance positive...
       }
     }
+
+    if (polygon_votes.hasVotes()) {
+      // Key the votes by the lmk ids of the polygon, which are stable across
+      // calls, unlike its index in the mesh.
+      PolygonLmkIds lmk_ids = {{polygon.at(0).getLmkId(),
+                                polygon.at(1).getLmkId(),
+                                polygon.at(2).getLmkId()}};
+      std::sort(lmk_ids.begin(), lmk_ids.end());
+      PolygonHistogramVotes& previous_votes =
+          polygon_histogram_votes_[lmk_ids];
+      updatePolygonHistogramVotes(polygon_votes, &previous_votes);
+      previous_votes.stamp_ = histogram_votes_stamp_;
+    }
   }
 
-  VLOG(10) << "Number of polygons potentially on a wall: " << walls.rows;
+  // Remove the votes of polygons that left the mesh or stopped voting.
+  for (auto it = polygon_histogram_votes_.begin();
+       it != polygon_histogram_votes_.end();) {
+    if (it->second.stamp_ != histogram_votes_stamp_) {
+      updatePolygonHistogramVotes(PolygonHistogramVotes(), &it->second);
+      it = polygon_histogram_votes_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  VLOG(10) << "Number of polygons potentially on a wall: " << nr_wall_polygons;
 
   // Segment new planes.
   // Currently using lmks that were used by the seed_planes...
-  segmentNewPlanes(new_planes, z_components, walls);
+  segmentNewPlanes(new_planes);
+}
+
+/* -------------------------------------------------------------------------- */
+size_t Mesher::PolygonLmkIdsHash::operator()(
+    const PolygonLmkIds& lmk_ids) const {
+  return UtilsNumerical::hashTripletOrderAgnostic(
+      lmk_ids[0], lmk_ids[1], lmk_ids[2]);
+}
+
+/* -------------------------------------------------------------------------- */
+void Mesher::updatePolygonHistogramVotes(const PolygonHistogramVotes& new_votes,
+                                         PolygonHistogramVotes* votes) {
+  CHECK_NOTNULL(votes);
+  if (votes->z_bins_ != new_votes.z_bins_) {
+    for (const int& bin : votes->z_bins_) {
+      if (bin >= 0) z_hist_.addVotesToBin(bin, -1.0f);
+    }
+    for (const int& bin : new_votes.z_bins_) {
+      if (bin >= 0) z_hist_.addVotesToBin(bin, 1.0f);
+    }
+    votes->z_bins_ = new_votes.z_bins_;
+  }
+  if (votes->wall_bin_ != new_votes.wall_bin_) {
+    if (votes->wall_bin_ >= 0) hist_2d_.addVotesToBin(votes->wall_bin_, -1.0f);
+    if (new_votes.wall_bin_ >= 0) {
+      hist_2d_.addVotesToBin(new_votes.wall_bin_, 1.0f);
+    }
+    votes->wall_bin_ = new_votes.wall_bin_;
+  }
 }
 
 /* -------------------------------------------------------------------------- */
@@ -1025,61 +1102,52 @@ bool Mesher::updatePlanesLmkIdsFromPolygon(
 
 /* -------------------------------------------------------------------------- */
 // Segment new planes in the mesh.
-// Currently segments horizontal planes using z_components, which is
-// expected to be a cv::Mat z_components (1, 0, CV_32F);
-// And walls perpendicular to the ground, using a cv::Mat which is expected to
-// be a cv::Mat walls (0, 0, CV_32FC2), with first channel being theta (yaw
-// angle of the wall) and the second channel the distance of it.
-// points_with_id_vio is only used if we are using stereo points...
-void Mesher::segmentNewPlanes(std::vector<Plane>* new_segmented_planes,
-                              const cv::Mat& z_components,
-                              const cv::Mat& walls) {
+// Currently segments horizontal planes using the z histogram, and walls
+// perpendicular to the ground using the 2D histogram of theta (yaw angle of the
+// wall) and distance, as voted in segmentPlanesInMesh.
+void Mesher::segmentNewPlanes(std::vector<Plane>* new_segmented_planes) {
   CHECK_NOTNULL(new_segmented_planes);
   new_segmented_planes->clear();
 
   // Segment horizontal planes.
   static size_t plane_id = 0;
   static const Plane::Normal vertical(0, 0, 1);
-  segmentHorizontalPlanes(
-      new_segmented_planes, &plane_id, vertical, z_components);
+  segmentHorizontalPlanes(new_segmented_planes, &plane_id, vertical);
 
   // Segment vertical planes.
-  segmentWalls(new_segmented_planes, &plane_id, walls);
+  segmentWalls(new_segmented_planes, &plane_id);
 }
 
 /* -------------------------------------------------------------------------- */
 // Segment wall planes.
 // plane_id, starting id for new planes, it gets increased every time we add a
 // new plane.
-void Mesher::segmentWalls(std::vector<Plane>* wall_planes,
-                          size_t* plane_id,
-                          const cv::Mat& walls) {
+void Mesher::segmentWalls(std::vector<Plane>* wall_planes, size_t* plane_id) {
   CHECK_NOTNULL(wall_planes);
   CHECK_NOTNULL(plane_id);
   ////////////////////////////// 2D Histogram //////////////////////////////////
-  VLOG(10) << "Starting to calculate 2D histogram...";
-  hist_2d_.calculateHistogram(walls, FLAGS_log_histogram_2D);
-  VLOG(10) << "Finished to calculate 2D histogram.";
-
-  /// Added by me
-  // cv::GaussianBlur(histImg, histImg, cv::Size(9, 9), 0);
-  ///
-  VLOG(10) << "Starting get local maximum for 2D histogram...";
-  std::vector<Histogram::PeakInfo2D> peaks2;
-  static const cv::Size kernel_size_2d(FLAGS_hist_2d_gaussian_kernel_size,
-                                       FLAGS_hist_2d_gaussian_kernel_size);
-  hist_2d_.getLocalMaximum2D(&peaks2,
-                             kernel_size_2d,
-                             FLAGS_hist_2d_nr_of_local_max,
-                             FLAGS_hist_2d_min_support,
-                             FLAGS_hist_2d_min_dist_btw_local_max,
-                             FLAGS_visualize_histogram_2D,
-                             FLAGS_log_histogram_2D);
-  VLOG(10) << "Finished get local maximum for 2D histogram.";
-
-  VLOG(0) << "# of peaks in 2D histogram = " << peaks2.size();
+  // The 2D histogram is kept up to date by segmentPlanesInMesh, only look for
+  // its peaks again if it changed.
+  if (hist_2d_peaks_version_ != hist_2d_.getVersion()) {
+    if (FLAGS_log_histogram_2D) hist_2d_.logHistogram();
+    VLOG(10) << "Starting get local maximum for 2D histogram...";
+    hist_2d_peaks_.clear();
+    static const cv::Size kernel_size_2d(FLAGS_hist_2d_gaussian_kernel_size,
+                                         FLAGS_hist_2d_gaussian_kernel_size);
+    hist_2d_.getLocalMaximum2D(&hist_2d_peaks_,
+                               kernel_size_2d,
+                               FLAGS_hist_2d_nr_of_local_max,
+                               FLAGS_hist_2d_min_support,
+                               FLAGS_hist_2d_min_dist_btw_local_max,
+                               FLAGS_visualize_histogram_2D,
+                               FLAGS_log_histogram_2D);
+    hist_2d_peaks_version_ = hist_2d_.getVersion();
+    VLOG(10) << "Finished get local maximum for 2D histogram.";
+  }
+
+  VLOG(0) << "# of peaks in 2D histogram = " << hist_2d_peaks_.size();
   size_t i = 0;
-  for (const Histogram::PeakInfo2D& peak : peaks2) {
+  for (const Histogram::PeakInfo2D& peak : hist_2d_peaks_) {
     double plane_theta = peak.x_value_;
     double plane_distance = peak.y_value_;
     cv::Point3f plane_normal(std::cos(plane_theta), std::sin(plane_theta), 0);
@@ -1119,25 +1187,28 @@ void Mesher::segmentWalls(std::vector<Plane>* wall_planes,
 // new plane.
 void Mesher::segmentHorizontalPlanes(std::vector<Plane>* horizontal_planes,
                                      size_t* plane_id,
-                                     const Plane::Normal& normal,
-                                     const cv::Mat& z_components) {
+                                     const Plane::Normal& normal) {
   CHECK_NOTNULL(horizontal_planes);
   CHECK_NOTNULL(plane_id);
   ////////////////////////////// 1D Histogram //////////////////////////////////
-  VLOG(10) << "Starting calculate 1D histogram.";
-  z_hist_.calculateHistogram(z_components, FLAGS_log_histogram_1D);
-  VLOG(10) << "Finished calculate 1D histogram.";
-
-  VLOG(10) << "Starting get local maximum for 1D.";
-  static const cv::Size kernel_size(1, FLAGS_z_histogram_gaussian_kernel_size);
-  std::vector<Histogram::PeakInfo> peaks =
-      z_hist_.getLocalMaximum1D(kernel_size,
-                                FLAGS_z_histogram_window_size,
-                                FLAGS_z_histogram_peak_per,
-                                FLAGS_z_histogram_min_support,
-                                FLAGS_visualize_histogram_1D,
-                                FLAGS_log_histogram_1D);
-  VLOG(10) << "Finished get local maximum for 1D.";
+  // The z histogram is kept up to date by segmentPlanesInMesh, only look for
+  // its peaks again if it changed.
+  if (z_hist_peaks_version_ != z_hist_.getVersion()) {
+    if (FLAGS_log_histogram_1D) z_hist_.logHistogram();
+    VLOG(10) << "Starting get local maximum for 1D.";
+    static const cv::Size kernel_size(1,
+                                      FLAGS_z_histogram_gaussian_kernel_size);
+    z_hist_peaks_ = z_hist_.getLocalMaximum1D(kernel_size,
+                                              FLAGS_z_histogram_window_size,
+                                              FLAGS_z_histogram_peak_per,
+                                              FLAGS_z_histogram_min_support,
+                                              FLAGS_visualize_histogram_1D,
+                                              FLAGS_log_histogram_1D);
+    z_hist_peaks_version_ = z_hist_.getVersion();
+    VLOG(10) << "Finished get local maximum for 1D.";
+  }
+  // Filtered below, so work on a copy.
+  std::vector<Histogram::PeakInfo> peaks = z_hist_peaks_;
 
   LOG(WARNING) << "# of peaks in 1D histogram = " << peaks.size();
   size_t i = 0;
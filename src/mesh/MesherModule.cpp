@@ -20,7 +20,9 @@ MesherModule::MesherModule(bool parallel_run, Mesher::UniquePtr mesher)
     : MIMOPipelineModule<MesherInput, MesherOutput>("Mesher", parallel_run),
       frontend_payload_queue_("mesher_frontend"),
       backend_payload_queue_("mesher_backend"),
-      mesher_(std::move(mesher)) {}
+      mesher_(std::move(mesher)) {
+  latchWorkingOnPop(&backend_payload_queue_);
+}
 
 MesherModule::InputUniquePtr MesherModule::getInputPacket() {
   MesherBackendInput backend_payload = nullptr;
@@ -119,6 +119,10 @@ MonoImuPipeline::MonoImuPipeline(const VioParams& params,
                 std::cref(*CHECK_NOTNULL(vio_frontend_module_.get())),
                 std::placeholders::_1));
 
+  LOG_IF(WARNING, FLAGS_log_keyframe_summary)
+      << "MonoImuPipeline: the keyframe summary stream is only written by "
+         "the stereo pipeline.";
+
   // TOOD(marcus): enable use of mesher for mono pipeline
   // if (static_cast<VisualizationType>(FLAGS_viz_type) ==
   //     VisualizationType::kMesh2dTo3dSparse) {
@@ -16,6 +16,10 @@
 #include "kimera-vio/pipeline/Pipeline.h"
 
 DEFINE_bool(log_output, false, "Log output to CSV files.");
+DEFINE_bool(log_keyframe_summary,
+            false,
+            "Stream a binary summary of each keyframe to the file "
+            "keyframe_summary.bin in the output path. Stereo pipeline only.");
 DEFINE_bool(extract_planes_from_the_scene,
             false,
             "Whether to use structural regularities in the scene,"
@@ -65,6 +69,7 @@ Pipeline::Pipeline(const VioParams& params)
       frontend_input_queue_("frontend_input_queue"),
       backend_input_queue_("backend_input_queue"),
       display_input_queue_("display_input_queue"),
+      keyframe_summary_stream_(nullptr),
       frontend_thread_(nullptr),
       backend_thread_(nullptr),
       mesher_thread_(nullptr),
@@ -150,7 +155,7 @@ bool Pipeline::shutdownWhenFinished(const int& sleep_time_ms,
   CHECK(vio_frontend_module_);
   CHECK(vio_backend_module_);
 
-  while (!hasFinished()) {
+  while (!drain(sleep_time_ms)) {
     // Note that the values in the log below might be different than the
     // evaluation above since they are separately evaluated at different times.
     VLOG(5) << printStatus();
@@ -158,9 +163,6 @@ bool Pipeline::shutdownWhenFinished(const int& sleep_time_ms,
     // Print all statistics
     LOG_IF(INFO, print_stats) << utils::Statistics::Print();
 
-    // Time to sleep between queries to the queues [in milliseconds].
-    std::this_thread::sleep_for(std::chrono::milliseconds(sleep_time_ms));
-
     if (!parallel_run_) {
       // Don't break, otw we will shutdown the pipeline.
       return false;
@@ -173,6 +175,32 @@ bool Pipeline::shutdownWhenFinished(const int& sleep_time_ms,
   return true;
 }
 
+/* -------------------------------------------------------------------------- */
+bool Pipeline::drain(const int& timeout_ms) {
+  CHECK(data_provider_module_);
+  CHECK(vio_frontend_module_);
+  CHECK(vio_backend_module_);
+
+  // Nobody else would make progress while we wait in sequential mode.
+  if (!parallel_run_) return hasFinished();
+
+  // Modules change state outside of the lock, but they lock it before
+  // notifying, so no notification is lost between the check and the wait.
+  const auto has_finished = [this] { return hasFinished(); };
+  std::unique_lock<std::mutex> lock(drain_mutex_);
+  if (timeout_ms < 0) {
+    drain_cv_.wait(lock, has_finished);
+    return true;
+  }
+  return drain_cv_.wait_for(
+      lock, std::chrono::milliseconds(timeout_ms), has_finished);
+}
+
+void Pipeline::notifyDrain() {
+  { std::lock_guard<std::mutex> lock(drain_mutex_); }
+  drain_cv_.notify_all();
+}
+
 void Pipeline::spinSequential() {
   // Spin once each pipeline module.
   CHECK(data_provider_module_);
@@ -198,9 +226,10 @@ bool Pipeline::hasFinished() const {
   CHECK(vio_frontend_module_);
   CHECK(vio_backend_module_);
 
-  // This is a very rough way of knowing if we have finished...
-  // Since threads might be in the middle of processing data while we
-  // query if the queues are empty.
+  // Modules are checked upstream first: a module pushes its output before
+  // becoming idle, and is flagged as working as soon as it pops an input (see
+  // PipelineModuleBase::latchWorkingOnPop), so a payload in flight is always
+  // seen either in a queue or in a working module.
   return !(                 // Negate everything (too lazy to negate everything)
       !shutdown_ &&         // Loop while not explicitly shutdown.
       is_backend_ok_ &&     // Loop while Backend is fine.
@@ -224,6 +253,7 @@ void Pipeline::shutdown() {
                               "shutdown.";
   LOG(INFO) << "Shutting down VIO pipeline.";
   shutdown_ = true;
+  notifyDrain();
 
   // First: call registered shutdown callbacks, these are typically to signal
   // data providers that they should now die.
@@ -273,6 +303,23 @@ void Pipeline::spinOnce(FrontendInputPacketBase::UniquePtr input) {
 
 void Pipeline::launchThreads() {
   if (parallel_run_) {
+    // Modules signal when they become idle, so drain() can check if the
+    // pipeline has finished.
+    const PipelineModuleBase::OnIdleCallback on_idle_cb =
+        std::bind(&Pipeline::notifyDrain, this);
+    CHECK(data_provider_module_);
+    data_provider_module_->registerOnIdleCallback(on_idle_cb);
+    CHECK(vio_frontend_module_);
+    vio_frontend_module_->registerOnIdleCallback(on_idle_cb);
+    CHECK(vio_backend_module_);
+    vio_backend_module_->registerOnIdleCallback(on_idle_cb);
+    if (mesher_module_) mesher_module_->registerOnIdleCallback(on_idle_cb);
+    if (lcd_module_) lcd_module_->registerOnIdleCallback(on_idle_cb);
+    if (visualizer_module_) {
+      visualizer_module_->registerOnIdleCallback(on_idle_cb);
+    }
+    if (display_module_) display_module_->registerOnIdleCallback(on_idle_cb);
+
     frontend_thread_ = VIO::make_unique<std::thread>(
         &VisionImuFrontendModule::spin, CHECK_NOTNULL(vio_frontend_module_.get()));
 
@@ -67,6 +67,30 @@ StereoImuPipeline::StereoImuPipeline(const VioParams& params,
           stereo_camera_,
           FLAGS_visualize ? &display_input_queue_ : nullptr,
           FLAGS_log_output));
+
+  if (FLAGS_log_keyframe_summary) {
+    keyframe_summary_stream_ =
+        VIO::make_unique<KeyframeSummaryStream>("keyframe_summary.bin");
+    // Registered before the callback that pushes keyframes to the Backend,
+    // so that the Frontend summary of a keyframe is always in the stream
+    // before the Backend output that looks it up.
+    auto& keyframe_summary_stream = keyframe_summary_stream_;
+    vio_frontend_module_->registerOutputCallback(
+        [&keyframe_summary_stream](
+            const FrontendOutputPacketBase::Ptr& output) {
+          StereoFrontendOutput::Ptr converted_output =
+              VIO::safeCast<FrontendOutputPacketBase, StereoFrontendOutput>(
+                  output);
+          if (converted_output && converted_output->is_keyframe_) {
+            CHECK_NOTNULL(keyframe_summary_stream.get())
+                ->addFrontendOutput(
+                    converted_output->stereo_frame_lkf_.timestamp_,
+                    converted_output->status_stereo_measurements_->first,
+                    converted_output->getTrackerInfo());
+          }
+        });
+  }
+
   auto& backend_input_queue = backend_input_queue_;  //! for the lambda below
   vio_frontend_module_->registerOutputCallback([&backend_input_queue](
       const FrontendOutputPacketBase::Ptr& output) {
@@ -117,6 +141,15 @@ StereoImuPipeline::StereoImuPipeline(const VioParams& params,
                 std::cref(*CHECK_NOTNULL(vio_frontend_module_.get())),
                 std::placeholders::_1));
 
+  if (keyframe_summary_stream_) {
+    auto& keyframe_summary_stream = keyframe_summary_stream_;
+    vio_backend_module_->registerOutputCallback(
+        [&keyframe_summary_stream](const BackendOutput::Ptr& output) {
+          CHECK_NOTNULL(keyframe_summary_stream.get())
+              ->addBackendOutput(*CHECK_NOTNULL(output.get()));
+        });
+  }
+
   if (static_cast<VisualizationType>(FLAGS_viz_type) ==
       VisualizationType::kMesh2dTo3dSparse) {
     mesher_module_ = VIO::make_unique<MesherModule>(
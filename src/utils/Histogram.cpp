@@ -150,13 +150,53 @@ void Histogram::calculateHistogram(const cv::Mat& input, bool log_histogram) {
   } else {
     LOG(FATAL) << "The histogram is not meant for dim: " << dims_;
   }
+  version_++;
 
-  if (log_histogram) {
-    cv::FileStorage file("histogram_" + std::to_string(dims_) + ".yaml",
-                         cv::FileStorage::WRITE);
-    file << "Histogram";
-    file << histogram_;
+  if (log_histogram) logHistogram();
+}
+
+/* -------------------------------------------------------------------------- */
+int Histogram::getBinIndex(const float* sample) const {
+  CHECK_NOTNULL(sample);
+  CHECK(uniform_) << "Only uniform histograms can be updated incrementally.";
+  int bin_idx = 0;
+  for (int dim = 0; dim < dims_; dim++) {
+    // Same arithmetic as cv::calcHist for uniform float histograms, so that
+    // samples land in the same bins.
+    const double scale =
+        hist_size_[dim] / ((double)ranges_[dim][1] - ranges_[dim][0]);
+    const double offset = -scale * ranges_[dim][0];
+    const int idx = cvFloor(sample[dim] * scale + offset);
+    if (idx < 0 || idx >= hist_size_[dim]) return -1;
+    bin_idx = bin_idx * hist_size_[dim] + idx;
   }
+  return bin_idx;
+}
+
+/* -------------------------------------------------------------------------- */
+void Histogram::addVotesToBin(const int& bin_idx, const float& votes) {
+  if (histogram_.empty()) clearHistogram();
+  CHECK_GE(bin_idx, 0);
+  CHECK_LT(bin_idx, histogram_.total());
+  histogram_.ptr<float>()[bin_idx] += votes;
+  version_++;
+}
+
+/* -------------------------------------------------------------------------- */
+void Histogram::clearHistogram() {
+  CHECK_GT(dims_, 0);
+  // Same layout as the output of cv::calcHist.
+  histogram_.create(dims_, hist_size_, CV_32F);
+  histogram_.setTo(0.0f);
+  version_++;
+}
+
+/* -------------------------------------------------------------------------- */
+void Histogram::logHistogram() const {
+  cv::FileStorage file("histogram_" + std::to_string(dims_) + ".yaml",
+                       cv::FileStorage::WRITE);
+  file << "Histogram";
+  file << histogram_;
 }
 
 /* -------------------------------------------------------------------------- */
@@ -23,6 +23,7 @@
 #include <opengv/point_cloud/methods.hpp>
 
 #include <opencv2/core/eigen.hpp>
+#include <opencv2/core/hal/intrin.hpp>
 
 #include <gtsam/base/Matrix.h>
 #include <gtsam/base/Vector.h>
@@ -781,18 +782,18 @@ double UtilsOpenCV::MaxAbsValue(gtsam::Matrix M) {
 // compute image gradients (TODO: untested: taken from
 // http://www.coldvision.io/2016/03/18/image-gradient-sobel-operator-opencv-3-x-cuda/)
 cv::Mat UtilsOpenCV::ImageLaplacian(const cv::Mat& img) {
-  // duplicate image to preserve const input
-  cv::Mat input = img.clone();
-
-  // blur the input image to remove the noise
-  cv::GaussianBlur(input, input, cv::Size(3, 3), 0, 0, cv::BORDER_DEFAULT);
+  // blur the input image to remove the noise, into a new image to preserve
+  // the const input
+  cv::Mat input_blurred;
+  cv::GaussianBlur(
+      img, input_blurred, cv::Size(3, 3), 0, 0, cv::BORDER_DEFAULT);
 
   // convert it to grayscale (CV_8UC3 -> CV_8UC1)
   cv::Mat input_gray;
-  if (input.channels() > 1)
-    cv::cvtColor(input, input_gray, cv::COLOR_RGB2GRAY);
+  if (input_blurred.channels() > 1)
+    cv::cvtColor(input_blurred, input_gray, cv::COLOR_RGB2GRAY);
   else
-    input_gray = input.clone();
+    input_gray = input_blurred;
 
   // compute the gradients on both directions x and y
   cv::Mat grad_x, grad_y;
@@ -852,126 +853,88 @@ UtilsOpenCV::FindHighIntensityInTriangle(const cv::Mat img,
   if (intensityThreshold < 0) {  // check is disabled
     return keypointsWithIntensities;
   }
-
-  static constexpr bool isDebug = false;
+  CHECK_EQ(img.type(), CV_8UC1);
+  // Intensities are integers: intensity > threshold iff
+  // intensity > floor(threshold).
+  if (intensityThreshold >= 255.0f) return keypointsWithIntensities;
+  const uint8_t threshold = static_cast<uint8_t>(intensityThreshold);
 
   // parse input vertices
-  int x0 = std::round(px_vertices[0]);
-  int y0 = std::round(px_vertices[1]);
-  int x1 = std::round(px_vertices[2]);
-  int y1 = std::round(px_vertices[3]);
-  int x2 = std::round(px_vertices[4]);
-  int y2 = std::round(px_vertices[5]);
+  const int x[3] = {static_cast<int>(std::round(px_vertices[0])),
+                    static_cast<int>(std::round(px_vertices[2])),
+                    static_cast<int>(std::round(px_vertices[4]))};
+  const int y[3] = {static_cast<int>(std::round(px_vertices[1])),
+                    static_cast<int>(std::round(px_vertices[3])),
+                    static_cast<int>(std::round(px_vertices[5]))};
 
   // get bounding box
-  int topLeft_x = std::min(x0, std::min(x1, x2));
-  int topLeft_y = std::min(y0, std::min(y1, y2));
-  int botRight_x = std::max(x0, std::max(x1, x2));
-  int botRight_y = std::max(y0, std::max(y1, y2));
-
-  double min, max;  // for debug
-  cv::Mat imgCopy;  // for debug
-  if (isDebug) {
-    std::vector<cv::Point> pts(3);
-    cv::minMaxLoc(img, &min, &max);
-    imgCopy = img.clone();
-    cv::cvtColor(imgCopy, imgCopy, cv::COLOR_GRAY2BGR);
-    pts[0] = cv::Point(x0, y0);
-    pts[1] = cv::Point(x1, y1);
-    pts[2] = cv::Point(x2, y2);
-    cv::rectangle(imgCopy,
-                  cv::Point(topLeft_x, topLeft_y),
-                  cv::Point(botRight_x, botRight_y),
-                  cv::Scalar(0, 255, 0));
-    cv::line(imgCopy, pts[0], pts[1], cv::Scalar(0, 255, 0), 1, CV_AA, 0);
-    cv::line(imgCopy, pts[1], pts[2], cv::Scalar(0, 255, 0), 1, CV_AA, 0);
-    cv::line(imgCopy, pts[2], pts[0], cv::Scalar(0, 255, 0), 1, CV_AA, 0);
-  }
-
-  for (int r = topLeft_y; r < botRight_y; r++) {
+  const int topLeft_x = std::min(x[0], std::min(x[1], x[2]));
+  const int topLeft_y = std::min(y[0], std::min(y[1], y[2]));
+  const int botRight_x = std::max(x[0], std::max(x[1], x[2]));
+  const int botRight_y = std::max(y[0], std::max(y[1], y[2]));
+
+  // Edges 01, 12 and 20, as (start, end) vertex indices. Horizontal edges are
+  // skipped, the other edges intersect row r at
+  // lambda * x_start + (1 - lambda) * x_end, with
+  // lambda = (r - y_end) / (y_start - y_end).
+  static constexpr int kEdges[3][2] = {{0, 1}, {1, 2}, {2, 0}};
+  int dy[3];
+  for (int e = 0; e < 3; ++e) dy[e] = y[kEdges[e][0]] - y[kEdges[e][1]];
+
+  static constexpr int margin = 4;
+  const int first_row = std::max(topLeft_y, 0);
+  const int last_row = std::min(botRight_y, img.rows);
+  for (int r = first_row; r < last_row; r++) {
     // find smallest col inside triangle:
     int min_x = botRight_x;  // initialized to largest
     int max_x = topLeft_x;   // initialized to smallest
-    int margin = 4;
-
-    // check triangle 01:
-    if (y0 != y1) {  // in this case segment is horizontal and we can skip it
-      double lambda01 = double(r - y1) / double(y0 - y1);
-      if (lambda01 >= 0 && lambda01 <= 1) {  // intersection belongs to segment
-        int x =
-            std::round((lambda01) * double(x0) + (1 - lambda01) * double(x1));
-        min_x = std::min(min_x, x);  // try to expand segment to the left
-        max_x = std::max(max_x, x);  // try to expand segment to the right
-      }
-    }
-
-    // check triangle 12:
-    if (y1 != y2) {  // in this case segment is horizontal and we can skip it
-      double lambda12 = double(r - y2) / double(y1 - y2);
-      if (lambda12 >= 0 && lambda12 <= 1) {  // intersection belongs to segment
-        int x =
-            std::round((lambda12) * double(x1) + (1 - lambda12) * double(x2));
-        min_x = std::min(min_x, x);  // try to expand segment to the left
-        max_x = std::max(max_x, x);  // try to expand segment to the right
-      }
-    }
-
-    // check triangle 20:
-    if (y2 != y0) {  // in this case segment is horizontal and we can skip it
-      double lambda20 = double(r - y0) / double(y2 - y0);
-      if (lambda20 >= 0 && lambda20 <= 1) {  // intersection belongs to segment
-        int x =
-            std::round((lambda20) * double(x2) + (1 - lambda20) * double(x0));
-        min_x = std::min(min_x, x);  // try to expand segment to the left
-        max_x = std::max(max_x, x);  // try to expand segment to the right
+    for (int e = 0; e < 3; ++e) {
+      if (dy[e] == 0) continue;  // horizontal segment, skip it
+      const int start = kEdges[e][0];
+      const int end = kEdges[e][1];
+      const double lambda = double(r - y[end]) / double(dy[e]);
+      if (lambda >= 0 && lambda <= 1) {  // intersection belongs to segment
+        const int x_r = std::round(lambda * double(x[start]) +
+                                   (1 - lambda) * double(x[end]));
+        min_x = std::min(min_x, x_r);  // try to expand segment to the left
+        max_x = std::max(max_x, x_r);  // try to expand segment to the right
       }
     }
 
     // sanity check
-    CHECK(min_x >= topLeft_x && max_x <= botRight_x)
+    DCHECK(min_x >= topLeft_x && max_x <= botRight_x)
         << min_x << " " << topLeft_x << " " << max_x << " " << botRight_x
         << '\n'
         << "FindHighIntensityInTriangle: inconsistent extrema.";
 
-    for (int c = min_x + margin; c < max_x - margin; c++) {
-      float intensity_rc = float(img.at<uint8_t>(r, c));
-
-      if (isDebug) {
-        LOG(INFO) << "intensity_rc (r,c): " << intensity_rc << " (" << r << ","
-                  << c << ")";
-        LOG(INFO) << "min: " << min << " max " << max;
-        cv::circle(imgCopy,
-                   cv::Point(c, r),
-                   1,
-                   cv::Scalar(255, 0, 0),
-                   CV_FILLED,
-                   CV_AA,
-                   0);
+    const int first_col = std::max(min_x + margin, 0);
+    const int last_col = std::min(max_x - margin, img.cols);
+    const uint8_t* row = img.ptr<uint8_t>(r);
+    int c = first_col;
+#if CV_SIMD128
+    // Skip 16 pixels at a time when none of them is above the threshold,
+    // which is most of the image for gradient and edge images.
+    const cv::v_uint8x16 v_threshold = cv::v_setall_u8(threshold);
+    for (; c + 16 <= last_col; c += 16) {
+      if (!cv::v_check_any(cv::v_load(row + c) > v_threshold)) continue;
+      for (int k = c; k < c + 16; ++k) {
+        if (row[k] > threshold) {
+          keypointsWithIntensities.push_back(
+              std::make_pair(KeypointCV(k, r), double(row[k])));
+        }
       }
-
-      if (intensity_rc > intensityThreshold) {
+    }
+#endif
+    for (; c < last_col; c++) {
+      if (row[c] > threshold) {
         keypointsWithIntensities.push_back(
-            std::make_pair(cv::Point(c, r), intensity_rc));
-        if (isDebug) {
-          cv::circle(imgCopy,
-                     cv::Point(c, r),
-                     1,
-                     cv::Scalar(0, 0, 255),
-                     CV_FILLED,
-                     CV_AA,
-                     0);
-        }
+            std::make_pair(KeypointCV(c, r), double(row[c])));
       }
     }
   }
 
-  if (isDebug) {
-    cv::imshow("imgCopy", imgCopy);
-    cv::waitKey(1);
-  }
-
   return keypointsWithIntensities;
-}  // namespace VIO
+}
 
 /* ------------------------------------------------------------------------ */
 // Returns a OpenCV file storage in a safely manner, warning about potential
@@ -15,6 +15,7 @@
 #include "kimera-vio/visualizer/OpenCvVisualizer3D.h"
 
 #include <algorithm>      // for min
+#include <cmath>          // for abs
 #include <memory>         // for shared_ptr<>
 #include <string>         // for string
 #include <unordered_map>  // for unordered_map<>
@@ -85,6 +86,19 @@ DEFINE_int32(displayed_trajectory_length,
              50,
              "Set length of plotted trajectory."
              "If -1 then all the trajectory is plotted.");
+DEFINE_double(factor_graph_viz_update_tolerance,
+              0.005,
+              "Factor graph widgets are re-created when their geometry (in "
+              "meters, or rotation matrix entries) changes by more than this.");
+DEFINE_int32(trajectory_segment_length,
+             32,
+             "Number of poses per trajectory widget. Only the last segment is "
+             "re-rendered when a pose is added.");
+DEFINE_int32(max_trajectory_poses,
+             4096,
+             "Maximum number of trajectory poses kept for display, older poses "
+             "are decimated beyond this. If -1 the trajectory is not "
+             "decimated.");
 
 namespace VIO {
 
@@ -424,22 +438,25 @@ void OpenCvVisualizer3D::visualizeFactorGraph(
   CHECK_NOTNULL(widgets_map);
   // Assert consistency between state and factor_graph
 
-  // First, recolor all previous poses as inactive (white color) by re-drawing
-  // them, the active ones will be colored later.
-  for (const std::pair<std::string, cv::Affine3d>& widget_id_pose_pair :
-       widget_id_to_pose_map_) {
-    const auto& widget_id = widget_id_pose_pair.first;
-    (*widgets_map)[widget_id] = VIO::make_unique<cv::viz::WCameraPosition>(
-        K_, inactive_frustum_scale_, cv::viz::Color::white());
-    (*widgets_map)[widget_id]->setPose(widget_id_pose_pair.second);
-  }
-  widget_id_to_pose_map_.clear();
+  // Widgets are only re-created when their geometry or appearance changed
+  // since they were displayed, see needsFactorGraphWidgetUpdate.
+  factor_graph_widgets_drawn_.clear();
+  // Active poses of the previous iteration, to recolor the ones that are not
+  // active anymore.
+  std::map<std::string, cv::Affine3d> prev_widget_id_to_pose_map;
+  prev_widget_id_to_pose_map.swap(widget_id_to_pose_map_);
 
-  for (const std::string& line_id : widget_ids_to_remove_in_next_iter_) {
-    // Remove lmk to pose lines
-    removeWidget(line_id);
+  // Step 2 draws the poses with a linear container factor in their own color.
+  static constexpr bool draw_linear_container_factors = true;
+  gtsam::KeySet keys_with_linear_container_factor;
+  if (draw_linear_container_factors) {
+    for (const auto& factor : factor_graph) {
+      if (boost::dynamic_pointer_cast<gtsam::LinearContainerFactor>(factor)) {
+        keys_with_linear_container_factor.insert(factor->begin(),
+                                                 factor->end());
+      }
+    }
   }
-  widget_ids_to_remove_in_next_iter_.clear();
 
   // Step 1: visualize variables
   // Loop over the state
@@ -479,7 +496,8 @@ void OpenCvVisualizer3D::visualizeFactorGraph(
       // Left Cam
       const gtsam::Pose3& world_pose_camLrect =
           imu_pose.compose(body_pose_camLrect);
-      if (draw_left_cam) {
+      if (draw_left_cam &&
+          keys_with_linear_container_factor.count(key_value.key) == 0u) {
         drawLeftCam(world_pose_camLrect, variable_index, widgets_map);
       }
 
@@ -519,7 +537,6 @@ void OpenCvVisualizer3D::visualizeFactorGraph(
   static constexpr bool draw_pose_priors = true;
   static constexpr bool draw_plane_priors = false;
   static constexpr bool draw_point_plane_factors = false;
-  static constexpr bool draw_linear_container_factors = true;
   static constexpr bool draw_preintegrated_imu_factors = true;
   static constexpr bool draw_imu_constant_bias_factors = true;
   static constexpr bool draw_between_factors = true;
@@ -606,6 +623,82 @@ void OpenCvVisualizer3D::visualizeFactorGraph(
       }
     }
   }
+
+  // Step 3: recolor the poses that are not active anymore as inactive (white
+  // color), they are kept in the window.
+  for (const std::pair<std::string, cv::Affine3d>& widget_id_pose_pair :
+       prev_widget_id_to_pose_map) {
+    const auto& widget_id = widget_id_pose_pair.first;
+    if (widget_id_to_pose_map_.count(widget_id) > 0u) continue;
+    (*widgets_map)[widget_id] = VIO::make_unique<cv::viz::WCameraPosition>(
+        K_, inactive_frustum_scale_, cv::viz::Color::white());
+    (*widgets_map)[widget_id]->setPose(widget_id_pose_pair.second);
+  }
+
+  // Step 4: forget the widgets that were not drawn in this iteration, and
+  // remove the ones that should not outlive their factor.
+  for (auto it = factor_graph_widgets_.begin();
+       it != factor_graph_widgets_.end();) {
+    if (factor_graph_widgets_drawn_.count(it->first) > 0u) {
+      ++it;
+      continue;
+    }
+    if (it->second.remove_when_stale_) removeWidget(it->first);
+    it = factor_graph_widgets_.erase(it);
+  }
+  VLOG(10) << "Factor graph visualization: " << factor_graph_widgets_.size()
+           << " widgets displayed.";
+}
+
+void OpenCvVisualizer3D::appendToSignature(const cv::Affine3d& pose,
+                                           WidgetSignature* signature) {
+  CHECK_NOTNULL(signature);
+  std::vector<double>& geometry = signature->geometry_;
+  const cv::Matx33d& rotation = pose.rotation();
+  geometry.insert(geometry.end(), rotation.val, rotation.val + 9);
+  const cv::Vec3d& translation = pose.translation();
+  geometry.insert(geometry.end(), translation.val, translation.val + 3);
+}
+
+void OpenCvVisualizer3D::appendToSignature(const cv::Point3d& point,
+                                           WidgetSignature* signature) {
+  CHECK_NOTNULL(signature);
+  signature->geometry_.push_back(point.x);
+  signature->geometry_.push_back(point.y);
+  signature->geometry_.push_back(point.z);
+}
+
+void OpenCvVisualizer3D::appendToSignature(const cv::viz::Color& color,
+                                           const WidgetStyle& style,
+                                           const double& line_width,
+                                           WidgetSignature* signature) {
+  CHECK_NOTNULL(signature);
+  std::vector<double>& appearance = signature->appearance_;
+  appearance.insert(appearance.end(), color.val, color.val + 3);
+  appearance.push_back(static_cast<double>(style));
+  appearance.push_back(line_width);
+}
+
+bool OpenCvVisualizer3D::needsFactorGraphWidgetUpdate(
+    const std::string& widget_id,
+    const WidgetSignature& signature,
+    const bool& remove_when_stale) {
+  factor_graph_widgets_drawn_.insert(widget_id);
+  FactorGraphWidget& widget = factor_graph_widgets_[widget_id];
+  widget.remove_when_stale_ = remove_when_stale;
+  const std::vector<double>& displayed_geometry = widget.signature_.geometry_;
+  const std::vector<double>& geometry = signature.geometry_;
+  // Any change of appearance shows, unlike small changes of geometry.
+  bool needs_update = widget.signature_.appearance_ != signature.appearance_ ||
+                      displayed_geometry.size() != geometry.size();
+  for (size_t i = 0u; !needs_update && i < geometry.size(); ++i) {
+    needs_update = std::abs(displayed_geometry[i] - geometry[i]) >
+                   FLAGS_factor_graph_viz_update_tolerance;
+  }
+  // Keep the signature of the displayed widget otherwise, so that small
+  // changes accumulate until the widget is re-created.
+  if (needs_update) widget.signature_ = signature;
+  return needs_update;
 }
 
 void OpenCvVisualizer3D::drawImuPose(const gtsam::Pose3& imu_pose,
@@ -613,10 +706,20 @@ void OpenCvVisualizer3D::drawImuPose(const gtsam::Pose3& imu_pose,
                                      WidgetsMap* widgets_map) {
   CHECK_NOTNULL(widgets_map);
   // Visualize IMU pose as a coordinate frame
-  (*widgets_map)["IMU pose " + std::to_string(variable_index)] =
-      VIO::make_unique<cv::viz::WCoordinateSystem>(0.1);
-  (*widgets_map)["IMU pose " + std::to_string(variable_index)]->setPose(
-      UtilsOpenCV::gtsamPose3ToCvAffine3d(imu_pose));
+  const std::string imu_pose_id = "IMU pose " + std::to_string(variable_index);
+  const cv::Affine3d& imu_pose_cv =
+      UtilsOpenCV::gtsamPose3ToCvAffine3d(imu_pose);
+  WidgetSignature signature;
+  appendToSignature(imu_pose_cv, &signature);
+  static constexpr double kImuPoseScale = 0.1;
+  appendToSignature(cv::viz::Color::black(),
+                    WidgetStyle::kCoordinateSystem,
+                    kImuPoseScale,
+                    &signature);
+  if (!needsFactorGraphWidgetUpdate(imu_pose_id, signature, false)) return;
+  (*widgets_map)[imu_pose_id] =
+      VIO::make_unique<cv::viz::WCoordinateSystem>(kImuPoseScale);
+  (*widgets_map)[imu_pose_id]->setPose(imu_pose_cv);
 }
 
 void OpenCvVisualizer3D::drawLeftCam(const gtsam::Pose3& world_pose_camLrect,
@@ -624,12 +727,19 @@ void OpenCvVisualizer3D::drawLeftCam(const gtsam::Pose3& world_pose_camLrect,
                                      WidgetsMap* widgets_map) {
   CHECK_NOTNULL(widgets_map);
   std::string left_cam_id = "Left CAM pose " + std::to_string(variable_index);
-  (*widgets_map)[left_cam_id] = VIO::make_unique<cv::viz::WCameraPosition>(
-      K_, left_cam_active_frustum_scale_, left_cam_active_frustum_color_);
   const cv::Affine3d& left_cam_pose =
       UtilsOpenCV::gtsamPose3ToCvAffine3d(world_pose_camLrect);
-  (*widgets_map)[left_cam_id]->setPose(left_cam_pose);
   widget_id_to_pose_map_[left_cam_id] = left_cam_pose;
+  WidgetSignature signature;
+  appendToSignature(left_cam_pose, &signature);
+  appendToSignature(left_cam_active_frustum_color_,
+                    WidgetStyle::kFrustum,
+                    left_cam_active_frustum_scale_,
+                    &signature);
+  if (!needsFactorGraphWidgetUpdate(left_cam_id, signature, false)) return;
+  (*widgets_map)[left_cam_id] = VIO::make_unique<cv::viz::WCameraPosition>(
+      K_, left_cam_active_frustum_scale_, left_cam_active_frustum_color_);
+  (*widgets_map)[left_cam_id]->setPose(left_cam_pose);
 }
 
 void OpenCvVisualizer3D::drawRightCam(const gtsam::Pose3& world_pose_camRrect,
@@ -637,13 +747,19 @@ void OpenCvVisualizer3D::drawRightCam(const gtsam::Pose3& world_pose_camRrect,
                                       WidgetsMap* widgets_map) {
   CHECK_NOTNULL(widgets_map);
   std::string right_cam_id = "Right CAM pose " + std::to_string(variable_index);
-  (*widgets_map)[right_cam_id] = VIO::make_unique<cv::viz::WCameraPosition>(
-      K_, right_cam_active_frustum_scale_, right_cam_active_frustum_color_);
   const cv::Affine3d& right_cam_pose =
       UtilsOpenCV::gtsamPose3ToCvAffine3d(world_pose_camRrect);
-  (*widgets_map)[right_cam_id]->setPose(
-      UtilsOpenCV::gtsamPose3ToCvAffine3d(world_pose_camRrect));
   widget_id_to_pose_map_[right_cam_id] = right_cam_pose;
+  WidgetSignature signature;
+  appendToSignature(right_cam_pose, &signature);
+  appendToSignature(right_cam_active_frustum_color_,
+                    WidgetStyle::kFrustum,
+                    right_cam_active_frustum_scale_,
+                    &signature);
+  if (!needsFactorGraphWidgetUpdate(right_cam_id, signature, false)) return;
+  (*widgets_map)[right_cam_id] = VIO::make_unique<cv::viz::WCameraPosition>(
+      K_, right_cam_active_frustum_scale_, right_cam_active_frustum_color_);
+  (*widgets_map)[right_cam_id]->setPose(right_cam_pose);
 }
 
 void OpenCvVisualizer3D::drawImuToLeftCamArrow(
@@ -660,6 +776,16 @@ void OpenCvVisualizer3D::drawImuToLeftCamArrow(
       left_cam_position.x(), left_cam_position.y(), left_cam_position.z());
   std::string imu_to_left_cam_id =
       "IMU to Left CAM " + std::to_string(variable_index);
+  WidgetSignature signature;
+  appendToSignature(arrow_start, &signature);
+  appendToSignature(arrow_end, &signature);
+  appendToSignature(imu_to_left_cam_vector_color_,
+                    WidgetStyle::kArrow,
+                    imu_to_left_cam_vector_scale_,
+                    &signature);
+  if (!needsFactorGraphWidgetUpdate(imu_to_left_cam_id, signature, false)) {
+    return;
+  }
   (*widgets_map)[imu_to_left_cam_id] =
       VIO::make_unique<cv::viz::WArrow>(arrow_start,
                                         arrow_end,
@@ -682,9 +808,18 @@ void OpenCvVisualizer3D::drawVelocityArrow(const gtsam::Vector3& imu_velocity,
   cv::Point3d arrow_end(end.x(), end.y(), end.z());
 
   // Display the velocity as an arrow centered at the IMU widget.
-  (*widgets_map)["IMU vel " + std::to_string(variable_index)] =
-      VIO::make_unique<cv::viz::WArrow>(
-          arrow_start, arrow_end, 0.001, velocity_vector_color_);
+  const std::string imu_vel_id = "IMU vel " + std::to_string(variable_index);
+  WidgetSignature signature;
+  appendToSignature(arrow_start, &signature);
+  static constexpr double kVelocityArrowThickness = 0.001;
+  appendToSignature(arrow_end, &signature);
+  appendToSignature(velocity_vector_color_,
+                    WidgetStyle::kArrow,
+                    kVelocityArrowThickness,
+                    &signature);
+  if (!needsFactorGraphWidgetUpdate(imu_vel_id, signature, false)) return;
+  (*widgets_map)[imu_vel_id] = VIO::make_unique<cv::viz::WArrow>(
+      arrow_start, arrow_end, kVelocityArrowThickness, velocity_vector_color_);
 }
 
 void OpenCvVisualizer3D::drawSmartStereoFactor(
@@ -726,9 +861,17 @@ void OpenCvVisualizer3D::drawSmartStereoFactor(
       cv::Mat out(1, 1, CV_8UC3);
       cv::applyColorMap(in, out, cv::COLORMAP_PARULA);
       cv::viz::Color arrow_color(out.at<cv::Vec3b>(0, 0));
+      static constexpr double kLmkArrowThickness = 0.0005;
+      WidgetSignature signature;
+      appendToSignature(arrow_start, &signature);
+      appendToSignature(arrow_end, &signature);
+      appendToSignature(
+          arrow_color, WidgetStyle::kArrow, kLmkArrowThickness, &signature);
+      if (!needsFactorGraphWidgetUpdate(cam_to_lmk_line_id, signature, true)) {
+        continue;
+      }
       (*widgets_map)[cam_to_lmk_line_id] = VIO::make_unique<cv::viz::WArrow>(
-          arrow_start, arrow_end, 0.0005, arrow_color);
-      widget_ids_to_remove_in_next_iter_.push_back(cam_to_lmk_line_id);
+          arrow_start, arrow_end, kLmkArrowThickness, arrow_color);
     }
     // 1. Plot Landmark
     // Check that we have not added this lmk already...
@@ -772,17 +915,25 @@ void OpenCvVisualizer3D::drawLinearContainerFactor(
       CHECK(getEstimateOfKey(state, key, &imu_pose));
       std::string left_cam_id =
           "Left CAM pose " + std::to_string(symbol.index());
-      (*widgets_map)[left_cam_id] = VIO::make_unique<cv::viz::WCameraPosition>(
-          K_,
-          cam_with_linear_prior_frustum_scale_,
-          cam_with_linear_prior_frustum_color_);
       const gtsam::Pose3& world_pose_camLrect =
           imu_pose.compose(body_pose_camLrect);
       const cv::Affine3d& left_cam_with_prior_pose =
           UtilsOpenCV::gtsamPose3ToCvAffine3d(world_pose_camLrect);
-      (*widgets_map)[left_cam_id]->setPose(
-          UtilsOpenCV::gtsamPose3ToCvAffine3d(world_pose_camLrect));
       widget_id_to_pose_map_[left_cam_id] = left_cam_with_prior_pose;
+      WidgetSignature signature;
+      appendToSignature(left_cam_with_prior_pose, &signature);
+      appendToSignature(cam_with_linear_prior_frustum_color_,
+                        WidgetStyle::kFrustum,
+                        cam_with_linear_prior_frustum_scale_,
+                        &signature);
+      if (!needsFactorGraphWidgetUpdate(left_cam_id, signature, false)) {
+        continue;
+      }
+      (*widgets_map)[left_cam_id] = VIO::make_unique<cv::viz::WCameraPosition>(
+          K_,
+          cam_with_linear_prior_frustum_scale_,
+          cam_with_linear_prior_frustum_color_);
+      (*widgets_map)[left_cam_id]->setPose(left_cam_with_prior_pose);
       // PERHAPS COLOR AGAIN THE LMK TO POSE RAYS IN RED, as in
       // the factor that connects all together!
     } else if (symbol.chr() == kLandmarkSymbolChar) {
@@ -816,13 +967,21 @@ void OpenCvVisualizer3D::drawVelocityPrior(
             : "Generic Velocity Prior";
     std::string velocity_prior_text_id =
         info + ", id: " + std::to_string(velocity_symbol.index());
+    static constexpr double kTextSize = 0.04;
+    WidgetSignature text_signature;
+    appendToSignature(text_position, &text_signature);
+    text_signature.geometry_.push_back(velocity_symbol.index());
+    appendToSignature(
+        velocity_prior_color_, WidgetStyle::kText, kTextSize, &text_signature);
     // By keeping id the same, we overwrite the text, otw too much clutter
-    (*widgets_map)["Velocity Prior"] =
-        VIO::make_unique<cv::viz::WText3D>(velocity_prior_text_id,
-                                           text_position,
-                                           0.04,
-                                           false,
-                                           velocity_prior_color_);
+    if (needsFactorGraphWidgetUpdate("Velocity Prior", text_signature, false)) {
+      (*widgets_map)["Velocity Prior"] =
+          VIO::make_unique<cv::viz::WText3D>(velocity_prior_text_id,
+                                             text_position,
+                                             kTextSize,
+                                             false,
+                                             velocity_prior_color_);
+    }
 
     // Print a red cube around the IMU pose with the velocity prior.
     static constexpr double half_cube_side = 0.02;
@@ -834,11 +993,19 @@ void OpenCvVisualizer3D::drawVelocityPrior(
                           imu_pose.z() + half_cube_side);
     std::string velocity_prior_cube_id =
         "Point prior " + std::to_string(velocity_symbol.index());
-    (*widgets_map)[velocity_prior_cube_id] = VIO::make_unique<cv::viz::WCube>(
-        min_point, max_point, true, velocity_prior_color_);
-
-    // Potentially remove this info on each iteration.
-    // widget_ids_to_remove_in_next_iter_.push_back(velocity_prior_id);
+    WidgetSignature cube_signature;
+    appendToSignature(min_point, &cube_signature);
+    appendToSignature(velocity_prior_color_,
+                      WidgetStyle::kWireframeCube,
+                      half_cube_side,
+                      &cube_signature);
+    // Potentially remove this info once the prior is gone, by setting
+    // remove_when_stale to true.
+    if (needsFactorGraphWidgetUpdate(
+            velocity_prior_cube_id, cube_signature, false)) {
+      (*widgets_map)[velocity_prior_cube_id] = VIO::make_unique<cv::viz::WCube>(
+          min_point, max_point, true, velocity_prior_color_);
+    }
   } else {
     LOG(WARNING) << "Prior on gtsam::Vector3 or gtsam::Point3 unrecognized...";
   }
@@ -858,15 +1025,23 @@ void OpenCvVisualizer3D::drawPosePrior(
   CHECK(getEstimateOfKey(state, pose_key, &imu_pose));
   std::string left_cam_id =
       "Left CAM pose prior " + std::to_string(pose_symbol.index());
+  const gtsam::Pose3& world_pose_camLrect =
+      imu_pose.compose(body_pose_camLrect);
+  const cv::Affine3d& left_cam_pose =
+      UtilsOpenCV::gtsamPose3ToCvAffine3d(world_pose_camLrect);
+  WidgetSignature signature;
+  appendToSignature(left_cam_pose, &signature);
+  appendToSignature(cam_with_pose_prior_frustum_color_,
+                    WidgetStyle::kFrustum,
+                    cam_with_pose_prior_frustum_scale_,
+                    &signature);
+  // Let's keep the prior in the visualization window for now
+  if (!needsFactorGraphWidgetUpdate(left_cam_id, signature, false)) return;
   (*widgets_map)[left_cam_id] = VIO::make_unique<cv::viz::WCameraPosition>(
       K_,
       cam_with_pose_prior_frustum_scale_,
       cam_with_pose_prior_frustum_color_);
-  const gtsam::Pose3& world_pose_camLrect =
-      imu_pose.compose(body_pose_camLrect);
-  (*widgets_map)[left_cam_id]->setPose(
-      UtilsOpenCV::gtsamPose3ToCvAffine3d(world_pose_camLrect));
-  // Let's keep the prior in the visualization window for now
+  (*widgets_map)[left_cam_id]->setPose(left_cam_pose);
   // const cv::Affine3d& left_cam_with_prior_pose =
   //     UtilsOpenCV::gtsamPose3ToCvAffine3d(world_pose_camLrect);
   // widget_id_to_pose_map_[left_cam_id] = left_cam_with_prior_pose;
@@ -899,35 +1074,71 @@ void OpenCvVisualizer3D::drawBtwFactor(
 
   static constexpr double kCylinderRadius = 0.005;
   static constexpr double kSphereRadius = 0.02;
+  WidgetSignature edge_signature;
+  appendToSignature(start_point, &edge_signature);
+  appendToSignature(end_point, &edge_signature);
+  WidgetSignature sphere_signature;
+  appendToSignature(mid_point, &sphere_signature);
   // Do we have a no-motion prior?
   if (btw_factor.measured().equals(gtsam::Pose3::identity())) {
+    appendToSignature(no_motion_prior_color_,
+                      WidgetStyle::kCylinder,
+                      kCylinderRadius,
+                      &edge_signature);
+    appendToSignature(no_motion_prior_color_,
+                      WidgetStyle::kSphere,
+                      kSphereRadius,
+                      &sphere_signature);
     // Connect involved poses with a cylinder
     std::string no_motion_prior_id =
         "No Motion prior: " + std::to_string(pose_symbol_1.index());
-    (*widgets_map)[no_motion_prior_id + " (edge)"] =
-        VIO::make_unique<cv::viz::WCylinder>(start_point,
-                                             end_point,
-                                             kCylinderRadius,
-                                             20,
-                                             no_motion_prior_color_);
+    if (needsFactorGraphWidgetUpdate(
+            no_motion_prior_id + " (edge)", edge_signature, false)) {
+      (*widgets_map)[no_motion_prior_id + " (edge)"] =
+          VIO::make_unique<cv::viz::WCylinder>(start_point,
+                                               end_point,
+                                               kCylinderRadius,
+                                               20,
+                                               no_motion_prior_color_);
+    }
 
     // Add a sphere
-    (*widgets_map)[no_motion_prior_id + " (factor)"] =
-        VIO::make_unique<cv::viz::WSphere>(
-            mid_point, kSphereRadius, 10, no_motion_prior_color_);
+    if (needsFactorGraphWidgetUpdate(
+            no_motion_prior_id + " (factor)", sphere_signature, false)) {
+      (*widgets_map)[no_motion_prior_id + " (factor)"] =
+          VIO::make_unique<cv::viz::WSphere>(
+              mid_point, kSphereRadius, 10, no_motion_prior_color_);
+    }
 
     // Add text, since the cylinder is likely difficult to visualize
     std::string no_motion_prior_text_id =
         "No Motion Prior, id: " + std::to_string(pose_symbol_1.index());
     // By keeping id the same, we overwrite the text, otw too much clutter
     mid_point.z += 0.3;  //! move text upwards, otw clutters vel prior text
-    (*widgets_map)["No Motion Prior Text"] =
-        VIO::make_unique<cv::viz::WText3D>(no_motion_prior_text_id,
-                                           mid_point,
-                                           0.04,
-                                           false,
-                                           no_motion_prior_color_);
+    static constexpr double kTextSize = 0.04;
+    WidgetSignature text_signature;
+    appendToSignature(mid_point, &text_signature);
+    text_signature.geometry_.push_back(pose_symbol_1.index());
+    appendToSignature(
+        no_motion_prior_color_, WidgetStyle::kText, kTextSize, &text_signature);
+    if (needsFactorGraphWidgetUpdate(
+            "No Motion Prior Text", text_signature, false)) {
+      (*widgets_map)["No Motion Prior Text"] =
+          VIO::make_unique<cv::viz::WText3D>(no_motion_prior_text_id,
+                                             mid_point,
+                                             kTextSize,
+                                             false,
+                                             no_motion_prior_color_);
+    }
   } else {
+    appendToSignature(btw_factor_color_,
+                      WidgetStyle::kCylinder,
+                      kCylinderRadius,
+                      &edge_signature);
+    appendToSignature(btw_factor_color_,
+                      WidgetStyle::kSphere,
+                      kSphereRadius,
+                      &sphere_signature);
     // We have a regular btw factor
     std::string btw_factor_id = "Btw Factor: from " +
                                 std::to_string(pose_symbol_1.index()) + " to " +
@@ -935,15 +1146,19 @@ void OpenCvVisualizer3D::drawBtwFactor(
 
     // Add Edge
     std::string btw_factor_edge_id = btw_factor_id + " (edge)";
-    (*widgets_map)[btw_factor_edge_id] = VIO::make_unique<cv::viz::WCylinder>(
-        start_point, end_point, kCylinderRadius, 20, btw_factor_color_);
-    widget_ids_to_remove_in_next_iter_.push_back(btw_factor_edge_id);
+    if (needsFactorGraphWidgetUpdate(
+            btw_factor_edge_id, edge_signature, true)) {
+      (*widgets_map)[btw_factor_edge_id] = VIO::make_unique<cv::viz::WCylinder>(
+          start_point, end_point, kCylinderRadius, 20, btw_factor_color_);
+    }
 
     // Add Sphere
     std::string btw_factor_sphere_id = btw_factor_id + " (factor)";
-    (*widgets_map)[btw_factor_sphere_id] = VIO::make_unique<cv::viz::WSphere>(
-        mid_point, kSphereRadius, 10, btw_factor_color_);
-    widget_ids_to_remove_in_next_iter_.push_back(btw_factor_sphere_id);
+    if (needsFactorGraphWidgetUpdate(
+            btw_factor_sphere_id, sphere_signature, true)) {
+      (*widgets_map)[btw_factor_sphere_id] = VIO::make_unique<cv::viz::WSphere>(
+          mid_point, kSphereRadius, 10, btw_factor_color_);
+    }
 
     // TODO(Toni): try to color edge according to level of error
     // btw_factor.error(state);
@@ -951,28 +1166,46 @@ void OpenCvVisualizer3D::drawBtwFactor(
     // Visualize initial guess
     std::string btw_factor_pose_guess_id =
         "Btw factor pose guess" + std::to_string(pose_symbol_2.index());
-    (*widgets_map)[btw_factor_pose_guess_id] =
-        VIO::make_unique<cv::viz::WCameraPosition>(
-            K_,
-            btw_factor_pose_guess_active_frustum_scale_,
-            btw_factor_pose_guess_active_frustum_color_);
     const gtsam::Pose3& btw_factor_meas_world_pose_body =
         imu_pose_1.compose(btw_factor.measured());
     const cv::Affine3d& left_cam_pose = UtilsOpenCV::gtsamPose3ToCvAffine3d(
         btw_factor_meas_world_pose_body.compose(body_pose_camLrect));
-    (*widgets_map)[btw_factor_pose_guess_id]->setPose(left_cam_pose);
-    widget_ids_to_remove_in_next_iter_.push_back(btw_factor_pose_guess_id);
+    WidgetSignature guess_signature;
+    appendToSignature(left_cam_pose, &guess_signature);
+    appendToSignature(btw_factor_pose_guess_active_frustum_color_,
+                      WidgetStyle::kFrustum,
+                      btw_factor_pose_guess_active_frustum_scale_,
+                      &guess_signature);
+    if (needsFactorGraphWidgetUpdate(
+            btw_factor_pose_guess_id, guess_signature, true)) {
+      (*widgets_map)[btw_factor_pose_guess_id] =
+          VIO::make_unique<cv::viz::WCameraPosition>(
+              K_,
+              btw_factor_pose_guess_active_frustum_scale_,
+              btw_factor_pose_guess_active_frustum_color_);
+      (*widgets_map)[btw_factor_pose_guess_id]->setPose(left_cam_pose);
+    }
     // widget_id_to_pose_map_[btw_factor_imu_pose_guess_id] =
     // left_cam_pose;
 
     // Draw arrow to associate factor with initial guess
     std::string btw_factor_arrow_id = btw_factor_pose_guess_id + " (arrow)";
-    (*widgets_map)[btw_factor_arrow_id] = VIO::make_unique<cv::viz::WArrow>(
-        mid_point,
-        cv::Point3d(left_cam_pose.translation()),
-        btw_factor_to_guess_pose_vector_scale_,
-        btw_factor_to_guess_pose_vector_color_);
-    widget_ids_to_remove_in_next_iter_.push_back(btw_factor_arrow_id);
+    const cv::Point3d arrow_end(left_cam_pose.translation());
+    WidgetSignature arrow_signature;
+    appendToSignature(mid_point, &arrow_signature);
+    appendToSignature(arrow_end, &arrow_signature);
+    appendToSignature(btw_factor_to_guess_pose_vector_color_,
+                      WidgetStyle::kArrow,
+                      btw_factor_to_guess_pose_vector_scale_,
+                      &arrow_signature);
+    if (needsFactorGraphWidgetUpdate(
+            btw_factor_arrow_id, arrow_signature, true)) {
+      (*widgets_map)[btw_factor_arrow_id] = VIO::make_unique<cv::viz::WArrow>(
+          mid_point,
+          arrow_end,
+          btw_factor_to_guess_pose_vector_scale_,
+          btw_factor_to_guess_pose_vector_color_);
+    }
   }
 }
 
@@ -1010,21 +1243,45 @@ void OpenCvVisualizer3D::drawImuFactor(const gtsam::ImuFactor& imu_factor,
   // compare with the estimate from stereo RANSAC
   std::string imu_factor_pose_guess_id =
       "IMU factor pose guess" + std::to_string(pose_symbol_2.index());
-  (*widgets_map)[imu_factor_pose_guess_id] =
-      VIO::make_unique<cv::viz::WCameraPosition>(
-          K_, imu_factor_to_guess_pose_scale_, imu_factor_to_guess_pose_color_);
   const cv::Affine3d& left_cam_pose_guess = UtilsOpenCV::gtsamPose3ToCvAffine3d(
       meas_pose_2.compose(body_pose_camLrect));
-  (*widgets_map)[imu_factor_pose_guess_id]->setPose(left_cam_pose_guess);
-  widget_ids_to_remove_in_next_iter_.push_back(imu_factor_pose_guess_id);
+  WidgetSignature guess_signature;
+  appendToSignature(left_cam_pose_guess, &guess_signature);
+  appendToSignature(imu_factor_to_guess_pose_color_,
+                    WidgetStyle::kFrustum,
+                    imu_factor_to_guess_pose_scale_,
+                    &guess_signature);
+  if (needsFactorGraphWidgetUpdate(
+          imu_factor_pose_guess_id, guess_signature, true)) {
+    (*widgets_map)[imu_factor_pose_guess_id] =
+        VIO::make_unique<cv::viz::WCameraPosition>(
+            K_,
+            imu_factor_to_guess_pose_scale_,
+            imu_factor_to_guess_pose_color_);
+    (*widgets_map)[imu_factor_pose_guess_id]->setPose(left_cam_pose_guess);
+  }
 
   // Draw estimated IMU velocity as an arrow
   gtsam::Vector3 end = pose_2.translation() + meas_vel_2;
   cv::Point3d arrow_start(pose_2.x(), pose_2.y(), pose_2.z());
   cv::Point3d arrow_end(end.x(), end.y(), end.z());
-  (*widgets_map)["IMU vel guess " + std::to_string(vel_symbol_2.index())] =
-      VIO::make_unique<cv::viz::WArrow>(
-          arrow_start, arrow_end, 0.001, imu_factor_guess_velocity_color_);
+  const std::string imu_vel_guess_id =
+      "IMU vel guess " + std::to_string(vel_symbol_2.index());
+  WidgetSignature arrow_signature;
+  appendToSignature(arrow_start, &arrow_signature);
+  static constexpr double kVelocityArrowThickness = 0.001;
+  appendToSignature(arrow_end, &arrow_signature);
+  appendToSignature(imu_factor_guess_velocity_color_,
+                    WidgetStyle::kArrow,
+                    kVelocityArrowThickness,
+                    &arrow_signature);
+  if (needsFactorGraphWidgetUpdate(imu_vel_guess_id, arrow_signature, false)) {
+    (*widgets_map)[imu_vel_guess_id] =
+        VIO::make_unique<cv::viz::WArrow>(arrow_start,
+                                          arrow_end,
+                                          kVelocityArrowThickness,
+                                          imu_factor_guess_velocity_color_);
+  }
 }
 
 cv::Mat OpenCvVisualizer3D::visualizeMesh2D(
@@ -1497,14 +1754,17 @@ void OpenCvVisualizer3D::visualizeTrajectory3D(WidgetsMap* widgets_map) {
     return;
   }
 
-  // Create a Trajectory widget. (argument can be PATH, FRAMES, BOTH).
-  std::vector<cv::Affine3f> trajectory;
-  trajectory.reserve(trajectory_poses_3d_.size());
-  for (const auto& pose : trajectory_poses_3d_) {
-    trajectory.push_back(pose);
+  // Create a Trajectory widget per modified segment, the others are already
+  // displayed. (argument can be PATH, FRAMES, BOTH).
+  for (TrajectorySegment& segment : trajectory_segments_) {
+    if (!segment.dirty_) continue;
+    (*widgets_map)[trajectorySegmentWidgetId(segment.id_)] =
+        VIO::make_unique<cv::viz::WTrajectory>(segment.poses_,
+                                               cv::viz::WTrajectory::PATH,
+                                               1.0,
+                                               cv::viz::Color::red());
+    segment.dirty_ = false;
   }
-  (*widgets_map)["Trajectory"] = VIO::make_unique<cv::viz::WTrajectory>(
-      trajectory, cv::viz::WTrajectory::PATH, 1.0, cv::viz::Color::red());
 }
 
 void OpenCvVisualizer3D::visualizeTrajectoryWithFrustums(
@@ -1693,14 +1953,112 @@ void OpenCvVisualizer3D::removePlane(const PlaneId& plane_index,
 }
 
 void OpenCvVisualizer3D::addPoseToTrajectory(const cv::Affine3d& pose) {
+  CHECK_GE(FLAGS_trajectory_segment_length, 2);
+  const size_t segment_length = FLAGS_trajectory_segment_length;
   trajectory_poses_3d_.push_back(pose);
+  while (trajectory_poses_3d_.size() > segment_length) {
+    trajectory_poses_3d_.pop_front();
+  }
+
+  if (trajectory_segments_.empty() ||
+      trajectory_segments_.back().poses_.size() >= segment_length) {
+    // Start a new segment, from the last pose of the previous one.
+    TrajectorySegment segment;
+    segment.id_ = next_trajectory_segment_id_++;
+    segment.poses_.reserve(segment_length);
+    if (!trajectory_segments_.empty()) {
+      segment.poses_.push_back(trajectory_segments_.back().poses_.back());
+      ++nr_trajectory_poses_;
+    }
+    trajectory_segments_.push_back(segment);
+  }
+  TrajectorySegment& last_segment = trajectory_segments_.back();
+  last_segment.poses_.push_back(pose);
+  last_segment.dirty_ = true;
+  ++nr_trajectory_poses_;
+
+  // Drop whole segments as long as the remaining ones hold the displayed
+  // trajectory length.
   if (FLAGS_displayed_trajectory_length > 0) {
-    while (trajectory_poses_3d_.size() > FLAGS_displayed_trajectory_length) {
-      trajectory_poses_3d_.pop_front();
+    const size_t displayed_length = FLAGS_displayed_trajectory_length;
+    while (trajectory_segments_.size() > 1u &&
+           nr_trajectory_poses_ - trajectory_segments_.front().poses_.size() >=
+               displayed_length) {
+      popFrontTrajectorySegment();
+    }
+  }
+
+  if (FLAGS_max_trajectory_poses > 0) {
+    const size_t max_poses = FLAGS_max_trajectory_poses;
+    while (nr_trajectory_poses_ > max_poses &&
+           trajectory_segments_.size() > 1u) {
+      decimateTrajectory();
+    }
+  }
+}
+
+void OpenCvVisualizer3D::popFrontTrajectorySegment() {
+  CHECK(!trajectory_segments_.empty());
+  removeWidget(trajectorySegmentWidgetId(trajectory_segments_.front().id_));
+  nr_trajectory_poses_ -= trajectory_segments_.front().poses_.size();
+  trajectory_segments_.pop_front();
+}
+
+void OpenCvVisualizer3D::decimateTrajectory() {
+  // Never touch the last segment, which is still growing.
+  const size_t nr_closed_segments = trajectory_segments_.size() - 1u;
+  CHECK_GT(nr_closed_segments, 0u);
+  const size_t nr_segments_to_thin = std::max<size_t>(nr_closed_segments / 2u, 1u);
+
+  // Keep every other pose, and always the end points so that the segments
+  // stay connected.
+  bool decimated = false;
+  for (size_t i = 0u; i < nr_segments_to_thin; ++i) {
+    std::vector<cv::Affine3f>& poses = trajectory_segments_[i].poses_;
+    if (poses.size() <= 2u) continue;
+    const size_t prev_size = poses.size();
+    size_t kept = 1u;
+    for (size_t j = 2u; j + 1u < prev_size; j += 2u) poses[kept++] = poses[j];
+    poses[kept++] = poses.back();
+    poses.resize(kept);
+    nr_trajectory_poses_ -= prev_size - kept;
+    trajectory_segments_[i].dirty_ = true;
+    decimated = true;
+  }
+
+  if (!decimated) {
+    // The oldest segments are already as coarse as they can be.
+    popFrontTrajectorySegment();
+    return;
+  }
+
+  // Merge consecutive closed segments that fit into one widget.
+  const size_t segment_length = FLAGS_trajectory_segment_length;
+  size_t i = 0u;
+  while (i + 2u < trajectory_segments_.size()) {
+    TrajectorySegment& segment = trajectory_segments_[i];
+    const TrajectorySegment& next_segment = trajectory_segments_[i + 1u];
+    if (segment.poses_.size() + next_segment.poses_.size() - 1u >
+        segment_length) {
+      ++i;
+      continue;
     }
+    // Skip the boundary pose, which is already in segment.
+    segment.poses_.insert(segment.poses_.end(),
+                          next_segment.poses_.begin() + 1u,
+                          next_segment.poses_.end());
+    segment.dirty_ = true;
+    --nr_trajectory_poses_;
+    removeWidget(trajectorySegmentWidgetId(next_segment.id_));
+    trajectory_segments_.erase(trajectory_segments_.begin() + i + 1u);
   }
 }
 
+std::string OpenCvVisualizer3D::trajectorySegmentWidgetId(
+    const size_t& segment_id) {
+  return "Trajectory " + std::to_string(segment_id);
+}
+
 Mesh3DVizProperties OpenCvVisualizer3D::texturizeMesh3D(
     const Timestamp& image_timestamp,
     const cv::Mat& texture_image,
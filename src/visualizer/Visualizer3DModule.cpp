@@ -31,11 +31,13 @@ VisualizerModule::VisualizerModule(OutputQueue* output_queue,
       mesher_queue_(nullptr),
       lcd_queue_(nullptr),
       visualizer_(std::move(visualizer)) {
+  latchWorkingOnPop(&backend_queue_);
   if (visualizer_->visualization_type_ ==
       VisualizationType::kMesh2dTo3dSparse) {
     // Activate mesher queue if we are going to visualize the mesh.
     mesher_queue_ = VIO::make_unique<ThreadsafeQueue<VizMesherInput>>(
         "visualizer_mesher_queue");
+    latchWorkingOnPop(mesher_queue_.get());
   }
   if (use_lcd) {
     lcd_queue_ =
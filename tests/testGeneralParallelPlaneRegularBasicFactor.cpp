@@ -149,6 +149,12 @@ TEST(testGeneralParallelPlaneRegularFactor, Jacobians) {
   /// Verify the Jacobians are correct.
   EXPECT_TRUE(assert_equal(H1Expected, H1Actual, tol));
   EXPECT_TRUE(assert_equal(H2Expected, H2Actual, tol));
+
+  /// Same for the fixed-size Jacobians, which linearize() uses.
+  Matrix43 H1Fixed, H2Fixed;
+  factor.evaluateErrorFixed(plane_1, plane_2, H1Fixed, H2Fixed);
+  EXPECT_TRUE(assert_equal(H1Expected, Matrix(H1Fixed), tol));
+  EXPECT_TRUE(assert_equal(H2Expected, Matrix(H2Fixed), tol));
 }
 
 /**
@@ -150,6 +150,12 @@ TEST(testGeneralParallelPlaneRegularTangentSpaceFactor, Jacobians) {
   /// Verify the Jacobians are correct.
   ASSERT_TRUE(assert_equal(H1Expected, H1Actual, tol));
   ASSERT_TRUE(assert_equal(H2Expected, H2Actual, tol));
+
+  /// Same for the fixed-size Jacobians, which linearize() uses.
+  Matrix33 H1Fixed, H2Fixed;
+  factor.evaluateErrorFixed(plane_1, plane_2, H1Fixed, H2Fixed);
+  ASSERT_TRUE(assert_equal(H1Expected, Matrix(H1Fixed), tol));
+  ASSERT_TRUE(assert_equal(H2Expected, Matrix(H2Fixed), tol));
 }
 
 /**
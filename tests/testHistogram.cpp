@@ -0,0 +1,91 @@
+/* ----------------------------------------------------------------------------
+ * Copyright 2017, Massachusetts Institute of Technology,
+ * Cambridge, MA 02139
+ * All Rights Reserved
+ * Authors: Luca Carlone, et al. (see THANKS for the full author list)
+ * See LICENSE for the license information
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @file   testHistogram.cpp
+ * @brief  test Histogram
+ * @author Antoni Rosinol
+ */
+
+#include <array>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <opencv2/core.hpp>
+
+#include "kimera-vio/utils/Histogram.h"
+
+namespace VIO {
+
+/* ************************************************************************* */
+// Votes added one at a time must land in the same bins as with calcHist.
+TEST(Histogram, IncrementalVotes1D) {
+  std::vector<std::array<float, 2>> ranges = {{{-0.75f, 3.0f}}};
+  Histogram hist(1, {0}, cv::Mat(), 1, {512}, ranges, true, false);
+  Histogram incremental_hist(1, {0}, cv::Mat(), 1, {512}, ranges, true, false);
+
+  cv::RNG rng(7);
+  cv::Mat samples(1000, 1, CV_32F);
+  // Also out of range, and exactly on the bounds.
+  rng.fill(samples, cv::RNG::UNIFORM, -1.0f, 3.5f);
+  samples.at<float>(0) = -0.75f;
+  samples.at<float>(1) = 3.0f;
+  hist.calculateHistogram(samples);
+
+  const size_t version = incremental_hist.getVersion();
+  for (int i = 0; i < samples.rows; i++) {
+    const int bin = incremental_hist.getBinIndex(&samples.at<float>(i));
+    if (bin >= 0) incremental_hist.addVotesToBin(bin);
+  }
+  EXPECT_GT(incremental_hist.getVersion(), version);
+  EXPECT_EQ(incremental_hist.getBinIndex(&samples.at<float>(1)), -1);
+  ASSERT_EQ(incremental_hist.getHistogram().size,
+            hist.getHistogram().size);
+  EXPECT_EQ(cv::norm(incremental_hist.getHistogram(),
+                     hist.getHistogram(),
+                     cv::NORM_INF),
+            0.0);
+
+  // Removing all votes leaves an empty histogram.
+  for (int i = 0; i < samples.rows; i++) {
+    const int bin = incremental_hist.getBinIndex(&samples.at<float>(i));
+    if (bin >= 0) incremental_hist.addVotesToBin(bin, -1.0f);
+  }
+  EXPECT_EQ(cv::countNonZero(incremental_hist.getHistogram()), 0);
+}
+
+/* ************************************************************************* */
+TEST(Histogram, IncrementalVotes2D) {
+  std::vector<std::array<float, 2>> ranges = {{{0.0f, float(M_PI)}},
+                                              {{-6.0f, 6.0f}}};
+  Histogram hist(1, {0, 1}, cv::Mat(), 2, {40, 40}, ranges, true, false);
+  Histogram incremental_hist(
+      1, {0, 1}, cv::Mat(), 2, {40, 40}, ranges, true, false);
+
+  cv::RNG rng(11);
+  cv::Mat samples(500, 1, CV_32FC2);
+  rng.fill(samples, cv::RNG::UNIFORM, cv::Scalar(-0.5, -7.0),
+           cv::Scalar(3.5, 7.0));
+  hist.calculateHistogram(samples);
+
+  incremental_hist.clearHistogram();
+  for (int i = 0; i < samples.rows; i++) {
+    const cv::Vec2f& sample = samples.at<cv::Vec2f>(i);
+    const int bin = incremental_hist.getBinIndex(sample.val);
+    if (bin >= 0) incremental_hist.addVotesToBin(bin);
+  }
+  ASSERT_EQ(incremental_hist.getHistogram().size,
+            hist.getHistogram().size);
+  EXPECT_EQ(cv::norm(incremental_hist.getHistogram(),
+                     hist.getHistogram(),
+                     cv::NORM_INF),
+            0.0);
+}
+
+}  // namespace VIO
@@ -21,6 +21,8 @@
 #include "kimera-vio/imu-frontend/ImuFrontendParams.h"
 #include "kimera-vio/utils/ThreadsafeImuBuffer.h"
 
+DECLARE_bool(imu_correct_in_flight_pim_bias);
+
 namespace VIO {
 
 /* -------------------------------------------------------------------------- */
@@ -66,14 +68,98 @@ TEST(ImuFrontend, UpdateBias) {
   updated_imu_bias = imu_bias.compose(imu_bias);
   imu_frontend.updateBias(updated_imu_bias);
   EXPECT_TRUE(imu_frontend.getCurrentImuBias().equals(updated_imu_bias));
-  // Check that the updated bias does not reset pim!
+  // Check that, without in-flight correction, the updated bias does not
+  // reach the pim until the integration is reset!
+  FLAGS_imu_correct_in_flight_pim_bias = false;
   ImuStampS imu_timestamps(1, 2);
   imu_timestamps << 1.0, 2.0;
   ImuAccGyrS imu_measurements(6, 2);
+  imu_measurements.setZero();
   auto pim = imu_frontend.preintegrateImuMeasurements(imu_timestamps,
                                                       imu_measurements);
   EXPECT_TRUE(pim->biasHat().equals(imu_bias));
   EXPECT_TRUE(!pim->biasHat().equals(updated_imu_bias));
+  // With in-flight correction, the pim is moved to the updated bias without
+  // being reset.
+  FLAGS_imu_correct_in_flight_pim_bias = true;
+  pim = imu_frontend.preintegrateImuMeasurements(imu_timestamps,
+                                                 imu_measurements);
+  EXPECT_TRUE(pim->biasHat().equals(updated_imu_bias));
+  EXPECT_DOUBLE_EQ(pim->deltaTij(), 2.0e-9);
+}
+
+/* -------------------------------------------------------------------------- */
+TEST(ImuFrontend, CorrectInFlightPimBias) {
+  // Check that a bias published in the middle of the preintegration is
+  // applied retroactively to the measurements already integrated.
+  ImuParams imu_params;
+  imu_params.acc_random_walk_ = 1.0;
+  imu_params.acc_noise_density_ = 1.0;
+  imu_params.gyro_random_walk_ = 1.0;
+  imu_params.gyro_noise_density_ = 1.0;
+  imu_params.n_gravity_ << 0.0, 0.0, -9.81;
+  imu_params.imu_integration_sigma_ = 1.0;
+  imu_params.imu_preintegration_type_ =
+      ImuPreintegrationType::kPreintegratedImuMeasurements;
+  const ImuBias stale_bias(Vector3(0.1, -0.1, 0.05), Vector3(0.01, 0.02, -0.01));
+  const ImuBias new_bias(Vector3(0.12, -0.08, 0.05),
+                         Vector3(0.012, 0.017, -0.008));
+
+  // 200Hz measurements of a slow rotation, split in two batches.
+  static constexpr int kNrMeasurements = 21;
+  ImuStampS imu_timestamps(1, kNrMeasurements);
+  ImuAccGyrS imu_measurements(6, kNrMeasurements);
+  for (int i = 0; i < kNrMeasurements; ++i) {
+    imu_timestamps(i) = i * 5000000;
+    imu_measurements.col(i) << 0.3, -0.2, 9.81, 0.1, 0.2, -0.3;
+  }
+  const ImuStampS first_stamps = imu_timestamps.leftCols(11);
+  const ImuAccGyrS first_measurements = imu_measurements.leftCols(11);
+  const ImuStampS second_stamps = imu_timestamps.rightCols(11);
+  const ImuAccGyrS second_measurements = imu_measurements.rightCols(11);
+
+  // Reference: the whole interval integrated with the new bias.
+  ImuFrontend reference_frontend(imu_params, new_bias);
+  reference_frontend.preintegrateImuMeasurements(first_stamps,
+                                                 first_measurements);
+  const auto reference_pim = reference_frontend.preintegrateImuMeasurements(
+      second_stamps, second_measurements);
+
+  // The new bias arrives after the first batch has been integrated.
+  ImuFrontend imu_frontend(imu_params, stale_bias);
+  imu_frontend.preintegrateImuMeasurements(first_stamps, first_measurements);
+  imu_frontend.updateBias(new_bias);
+  const auto corrected_pim = imu_frontend.preintegrateImuMeasurements(
+      second_stamps, second_measurements);
+  EXPECT_TRUE(corrected_pim->biasHat().equals(new_bias));
+  EXPECT_DOUBLE_EQ(corrected_pim->deltaTij(), reference_pim->deltaTij());
+
+  // Same, without the in-flight correction.
+  FLAGS_imu_correct_in_flight_pim_bias = false;
+  ImuFrontend stale_frontend(imu_params, stale_bias);
+  stale_frontend.preintegrateImuMeasurements(first_stamps, first_measurements);
+  stale_frontend.updateBias(new_bias);
+  const auto stale_pim = stale_frontend.preintegrateImuMeasurements(
+      second_stamps, second_measurements);
+  FLAGS_imu_correct_in_flight_pim_bias = true;
+  EXPECT_TRUE(stale_pim->biasHat().equals(stale_bias));
+
+  // The corrected pim matches the reference up to second order terms, and is
+  // much closer to it than the stale one.
+  const double corrected_rot_error =
+      gtsam::Rot3::Logmap(reference_pim->deltaRij().between(
+                              corrected_pim->deltaRij()))
+          .norm();
+  const double stale_rot_error =
+      gtsam::Rot3::Logmap(
+          reference_pim->deltaRij().between(stale_pim->deltaRij()))
+          .norm();
+  EXPECT_LT(corrected_rot_error, 1e-5);
+  EXPECT_LT(corrected_rot_error, 0.05 * stale_rot_error);
+  EXPECT_LT((reference_pim->deltaVij() - corrected_pim->deltaVij()).norm(),
+            1e-5);
+  EXPECT_LT((reference_pim->deltaPij() - corrected_pim->deltaPij()).norm(),
+            1e-5);
 }
 
 /* -------------------------------------------------------------------------- */
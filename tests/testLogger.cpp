@@ -27,6 +27,7 @@
 
 #include "kimera-vio/backend/VioBackend-definitions.h"
 #include "kimera-vio/frontend/StereoVisionImuFrontend-definitions.h"
+#include "kimera-vio/logging/KeyframeSummaryStream.h"
 #include "kimera-vio/logging/Logger.h"
 
 DECLARE_string(test_data_path);
@@ -467,6 +468,108 @@ TEST_F(LoopClosureDetectorLoggerFixture, logOptimizedTraj) {
   EXPECT_LT(actual_qz - traj_pose.rotation().toQuaternion().z(), tol);
 }
 
+TEST_F(BackendLoggerFixture, keyframeSummaryStream) {
+  const gtsam::Pose3 W_Pose_Blkf(gtsam::Rot3::RzRyRx(0.1, -0.2, 0.3),
+                                 gtsam::Point3(1.0, 2.0, 3.0));
+  const gtsam::Vector3 W_Vel_Blkf(0.5, -0.5, 0.25);
+  const ImuBias imu_bias(gtsam::Vector3(0.1, 0.2, 0.3),
+                         gtsam::Vector3(0.01, 0.02, 0.03));
+  gtsam::Matrix state_covariance = gtsam::Matrix::Zero(15, 15);
+  state_covariance.topLeftCorner<6, 6>() =
+      gtsam::Vector6(1.0, 2.0, 3.0, 4.0, 5.0, 6.0).asDiagonal();
+  state_covariance(0, 5) = state_covariance(5, 0) = 0.5;
+  DebugVioInfo debug_info;
+  debug_info.resetTimes();
+  debug_info.updateTime_ = 0.02;
+  debug_info.numExtraIterations_ = 3u;
+  TrackerStatusSummary tracker_status;
+  tracker_status.kfTrackingStatus_mono_ = TrackingStatus::VALID;
+  tracker_status.kfTrackingStatus_stereo_ = TrackingStatus::FEW_MATCHES;
+  DebugTrackerInfo tracker_info;
+  tracker_info.featureTrackingTime_ = 0.004;
+
+  const std::string filename = "keyframe_summary.bin";
+  {
+    KeyframeSummaryStream stream(filename);
+    // The Backend never outputs the keyframe at 100, and the Frontend gives
+    // no status for the one at 250.
+    stream.addFrontendOutput(100, tracker_status, tracker_info);
+    stream.addFrontendOutput(200, tracker_status, tracker_info);
+    for (const Timestamp& timestamp : {200, 250}) {
+      stream.addBackendOutput(BackendOutput(timestamp,
+                                            gtsam::Values(),
+                                            gtsam::NonlinearFactorGraph(),
+                                            W_Pose_Blkf,
+                                            W_Vel_Blkf,
+                                            imu_bias,
+                                            timestamp == 200
+                                                ? state_covariance
+                                                : gtsam::Matrix(),
+                                            timestamp,
+                                            42,
+                                            debug_info,
+                                            PointsWithIdMap(),
+                                            LmkIdToLmkTypeMap()));
+    }
+    EXPECT_EQ(stream.getNrDroppedSummaries(), 0u);
+  }
+
+  std::ifstream summary_file(FLAGS_output_path + '/' + filename,
+                             std::ios_base::in | std::ios_base::binary);
+  ASSERT_TRUE(summary_file.is_open());
+  std::vector<KeyframeSummary> summaries;
+  KeyframeSummary summary;
+  while (summary_file.read(reinterpret_cast<char*>(&summary),
+                           sizeof(KeyframeSummary))) {
+    summaries.push_back(summary);
+  }
+  ASSERT_EQ(summaries.size(), 2u);
+
+  for (size_t i = 0u; i < summaries.size(); ++i) {
+    const KeyframeSummary& actual = summaries.at(i);
+    EXPECT_TRUE(KeyframeSummaryStream::isValid(actual));
+    EXPECT_EQ(actual.sequence_, i);
+    EXPECT_EQ(actual.landmark_count_, 42);
+    EXPECT_NEAR(actual.W_t_B_[0], 1.0, tol);
+    EXPECT_NEAR(actual.W_t_B_[1], 2.0, tol);
+    EXPECT_NEAR(actual.W_t_B_[2], 3.0, tol);
+    const gtsam::Quaternion W_q_B = W_Pose_Blkf.rotation().toQuaternion();
+    EXPECT_NEAR(actual.W_q_B_[0], W_q_B.w(), tol);
+    EXPECT_NEAR(actual.W_q_B_[1], W_q_B.x(), tol);
+    EXPECT_NEAR(actual.W_q_B_[2], W_q_B.y(), tol);
+    EXPECT_NEAR(actual.W_q_B_[3], W_q_B.z(), tol);
+    for (size_t j = 0u; j < 3u; ++j) {
+      EXPECT_NEAR(actual.W_v_B_[j], W_Vel_Blkf(j), tol);
+      EXPECT_NEAR(actual.gyro_bias_[j], imu_bias.gyroscope()(j), tol);
+      EXPECT_NEAR(actual.acc_bias_[j], imu_bias.accelerometer()(j), tol);
+    }
+    EXPECT_NEAR(actual.backend_times_[2], 0.02, tol);
+    EXPECT_EQ(actual.nr_extra_iterations_, 3u);
+  }
+
+  // First record: tracking status and covariance.
+  const KeyframeSummary& first = summaries.at(0);
+  EXPECT_EQ(first.timestamp_, 200);
+  EXPECT_EQ(first.kf_id_, 200u);
+  EXPECT_EQ(first.flags_, KeyframeSummary::kHasCovariance |
+                              KeyframeSummary::kHasTrackingStatus);
+  EXPECT_EQ(first.tracking_status_mono_,
+            static_cast<uint8_t>(TrackingStatus::VALID));
+  EXPECT_EQ(first.tracking_status_stereo_,
+            static_cast<uint8_t>(TrackingStatus::FEW_MATCHES));
+  EXPECT_NEAR(first.frontend_times_[1], 0.004, tol);
+  EXPECT_NEAR(first.pose_covariance_[0], 1.0, tol);   // (0, 0)
+  EXPECT_NEAR(first.pose_covariance_[5], 0.5, tol);   // (0, 5)
+  EXPECT_NEAR(first.pose_covariance_[6], 2.0, tol);   // (1, 1)
+  EXPECT_NEAR(first.pose_covariance_[20], 6.0, tol);  // (5, 5)
+
+  // Second record: neither.
+  const KeyframeSummary& second = summaries.at(1);
+  EXPECT_EQ(second.timestamp_, 250);
+  EXPECT_EQ(second.flags_, 0u);
+  EXPECT_EQ(second.pose_covariance_[0], 0.0);
+}
+
 TEST(testOpenFile, OpenFile) {
   std::ofstream outputFile;
   OpenFile("tmp.txt", &outputFile);
@@ -12,7 +12,9 @@
  * @author Marcus Abate, Luca Carlone
  */
 
+#include <algorithm>
 #include <memory>
+#include <random>
 #include <string>
 #include <utility>
 #include <vector>
@@ -21,6 +23,8 @@
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 
+#include <Eigen/Cholesky>
+
 #include "kimera-vio/frontend/CameraParams.h"
 #include "kimera-vio/frontend/Frame.h"
 #include "kimera-vio/frontend/StereoFrame.h"
@@ -28,7 +32,9 @@
 #include "kimera-vio/frontend/StereoMatcher.h"
 #include "kimera-vio/frontend/Tracker.h"
 #include "kimera-vio/frontend/feature-detector/FeatureDetector.h"
+#include "kimera-vio/loopclosure/FlatOrbVocabulary.h"
 #include "kimera-vio/loopclosure/LoopClosureDetector.h"
+#include "kimera-vio/loopclosure/StereoPoseRefiner.h"
 #include "kimera-vio/utils/UtilsOpenCV.h"
 
 DECLARE_string(test_data_path);
@@ -337,6 +343,112 @@ TEST_F(LCDFixture, processAndAddFrame) {
             lcd_detector_->getLCDParams().nfeatures_);
 }
 
+TEST_F(LCDFixture, deferredStereoReconstruction) {
+  /* Test that frames are only stereo-reconstructed when asked to */
+  CHECK(lcd_detector_);
+  FrameId id_0 = lcd_detector_->processAndAddFrame(*match1_stereo_frame_);
+  const LCDFrame& lcd_frame = lcd_detector_->getFrameDatabasePtr()->at(id_0);
+  EXPECT_FALSE(lcd_frame.isStereoReconstructed());
+  EXPECT_TRUE(lcd_frame.keypoints_3d_.empty());
+  EXPECT_TRUE(lcd_frame.versors_.empty());
+
+  // Same result as rewriting the features of the frame right away.
+  StereoFrame stereo_frame = *match1_stereo_frame_;
+  lcd_detector_->rewriteStereoFrameFeatures(lcd_frame.keypoints_,
+                                            &stereo_frame);
+
+  lcd_detector_->reconstructStereoFrame(id_0);
+  EXPECT_TRUE(lcd_frame.isStereoReconstructed());
+  ASSERT_EQ(lcd_frame.keypoints_3d_.size(), lcd_frame.keypoints_.size());
+  ASSERT_EQ(lcd_frame.versors_.size(), lcd_frame.keypoints_.size());
+  EXPECT_EQ(lcd_frame.keypoints_3d_, stereo_frame.keypoints_3d_);
+  EXPECT_EQ(lcd_frame.versors_, stereo_frame.left_frame_.versors_);
+  ASSERT_EQ(lcd_frame.right_keypoints_rectified_.size(),
+            stereo_frame.right_keypoints_rectified_.size());
+  for (size_t i = 0u; i < lcd_frame.right_keypoints_rectified_.size(); i++) {
+    EXPECT_EQ(lcd_frame.left_keypoints_rectified_[i],
+              stereo_frame.left_keypoints_rectified_[i]);
+    EXPECT_EQ(lcd_frame.right_keypoints_rectified_[i],
+              stereo_frame.right_keypoints_rectified_[i]);
+  }
+
+  // Reconstructing again is a no-op.
+  const std::vector<gtsam::Vector3> keypoints_3d = lcd_frame.keypoints_3d_;
+  lcd_detector_->reconstructStereoFrame(id_0);
+  EXPECT_EQ(lcd_frame.keypoints_3d_, keypoints_3d);
+}
+
+TEST_F(LCDFixture, deferredStereoFramesKeepRectifiedImages) {
+  /* Test that only the frames of a loop candidate are reconstructed */
+  CHECK(lcd_detector_);
+  lcd_detector_->processAndAddFrame(*match1_stereo_frame_);
+  lcd_detector_->processAndAddFrame(*query1_stereo_frame_);
+  lcd_detector_->processAndAddFrame(*query2_stereo_frame_);
+
+  // Deferred frames keep their rectified images, nothing else.
+  const std::vector<LCDFrame>& db_frames =
+      *lcd_detector_->getFrameDatabasePtr();
+  ASSERT_EQ(db_frames.size(), 3u);
+  for (const LCDFrame& lcd_frame : db_frames) {
+    EXPECT_FALSE(lcd_frame.isStereoReconstructed());
+    EXPECT_FALSE(lcd_frame.right_img_rectified_.empty());
+    EXPECT_EQ(lcd_frame.left_img_rectified_.size(),
+              lcd_frame.right_img_rectified_.size());
+    EXPECT_TRUE(lcd_frame.keypoints_3d_.empty());
+  }
+
+  // Geometric verification of a candidate only reconstructs its two frames,
+  // and releases their images.
+  std::vector<FrameId> i_query, i_match;
+  lcd_detector_->computeMatchedIndices(1, 0, &i_query, &i_match, true);
+  gtsam::Pose3 camMatch1_T_camQuery1_mono;
+  lcd_detector_->geometricVerificationCheck(
+      1, 0, &camMatch1_T_camQuery1_mono, &i_query, &i_match);
+  for (size_t i = 0u; i < 2u; i++) {
+    EXPECT_TRUE(db_frames[i].isStereoReconstructed());
+    EXPECT_TRUE(db_frames[i].right_img_rectified_.empty());
+    EXPECT_EQ(db_frames[i].keypoints_3d_.size(),
+              db_frames[i].keypoints_.size());
+  }
+  EXPECT_FALSE(db_frames[2].isStereoReconstructed());
+}
+
+TEST_F(LCDFixture, flatVocabularyTransform) {
+  /* Test that the flattened vocabulary gives the same BoW as DBoW2 */
+  CHECK(lcd_detector_);
+  const OrbVocabulary* vocab =
+      lcd_detector_->getBoWDatabase()->getVocabulary();
+  CHECK_NOTNULL(vocab);
+  FlatOrbVocabulary flat_vocab(*vocab);
+  EXPECT_EQ(flat_vocab.size(), vocab->size());
+
+  lcd_detector_->processAndAddFrame(*match1_stereo_frame_);
+  lcd_detector_->processAndAddFrame(*query1_stereo_frame_);
+
+  for (const LCDFrame& frame : *lcd_detector_->getFrameDatabasePtr()) {
+    ASSERT_GT(frame.descriptors_vec_.size(), 0u);
+
+    DBoW2::BowVector expected_bow_vec, actual_bow_vec;
+    vocab->transform(frame.descriptors_vec_, expected_bow_vec);
+    flat_vocab.transform(frame.descriptors_vec_, &actual_bow_vec);
+    EXPECT_EQ(expected_bow_vec, actual_bow_vec);
+
+    for (int levels_up : {0, 2}) {
+      DBoW2::FeatureVector expected_feat_vec, actual_feat_vec;
+      vocab->transform(frame.descriptors_vec_,
+                       expected_bow_vec,
+                       expected_feat_vec,
+                       levels_up);
+      flat_vocab.transform(frame.descriptors_vec_,
+                           &actual_bow_vec,
+                           &actual_feat_vec,
+                           levels_up);
+      EXPECT_EQ(expected_bow_vec, actual_bow_vec);
+      EXPECT_EQ(expected_feat_vec, actual_feat_vec);
+    }
+  }
+}
+
 TEST_F(LCDFixture, geometricVerificationCheck) {
   /* Test geometric verification using RANSAC Nister 5pt method */
   CHECK(lcd_detector_);
@@ -494,6 +606,92 @@ TEST_F(LCDFixture, recoverPoseGivenRot) {
   EXPECT_LT(error.second, tran_tol_stereo);
 }
 
+TEST_F(LCDFixture, stereoPoseRefiner) {
+  CHECK(stereo_camera_);
+  const gtsam::Cal3_S2Stereo::shared_ptr stereo_calib =
+      stereo_camera_->getStereoCalib();
+  const gtsam::StereoCamera match_camera(gtsam::Pose3(), stereo_calib);
+  const gtsam::Pose3 camMatch_T_camQuery(
+      gtsam::Rot3::Ypr(0.1, -0.05, 0.02), gtsam::Point3(0.3, -0.05, 0.2));
+  const gtsam::StereoCamera query_camera(camMatch_T_camQuery, stereo_calib);
+
+  // Noisy stereo projections of landmarks in front of both cameras, with a
+  // few gross outliers.
+  std::mt19937 generator(0);
+  std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+  std::normal_distribution<double> noise(0.0, 0.3);
+  const LoopClosureDetectorParams lcd_params;
+  StereoPoseRefiner refiner(*stereo_calib,
+                            lcd_params.refine_pose_huber_threshold_,
+                            lcd_params.refine_pose_outlier_threshold_,
+                            lcd_params.refine_pose_landmark_distance_threshold_);
+  for (size_t i = 0u; i < 100u; i++) {
+    const gtsam::Point3 landmark(
+        2.0 * uniform(generator), 1.5 * uniform(generator),
+        5.0 + 2.0 * uniform(generator));
+    const gtsam::StereoPoint2 z_query = query_camera.project(landmark);
+    const gtsam::StereoPoint2 z_match = match_camera.project(landmark);
+    const double outlier = i % 10u == 0u ? 20.0 : 0.0;
+    refiner.addCorrespondence(
+        gtsam::StereoPoint2(z_query.uL() + outlier + noise(generator),
+                            z_query.uR() + outlier + noise(generator),
+                            z_query.v() + noise(generator)),
+        gtsam::StereoPoint2(z_match.uL() + noise(generator),
+                            z_match.uR() + noise(generator),
+                            z_match.v() + noise(generator)));
+  }
+
+  const gtsam::Pose3 camMatch_T_camQuery_initial = camMatch_T_camQuery.compose(
+      gtsam::Pose3(gtsam::Rot3::Ypr(0.003, 0.0, -0.002),
+                   gtsam::Point3(0.01, 0.005, -0.01)));
+  gtsam::Pose3 camMatch_T_camQuery_refined;
+  gtsam::Matrix6 information;
+  EXPECT_TRUE(refiner.refine(camMatch_T_camQuery_initial,
+                             &camMatch_T_camQuery_refined,
+                             &information));
+  EXPECT_LE(refiner.getNrInliers(), 90u);
+  EXPECT_GE(refiner.getNrInliers(), 60u);
+
+  // The information is for unit pixel noise: the error of the refined pose
+  // scaled by the pixel noise must be consistent with it (chi2 with 6 dof at
+  // 99.9%).
+  EXPECT_TRUE(information.isApprox(information.transpose()));
+  EXPECT_EQ(information.llt().info(), Eigen::Success);
+  const gtsam::Vector6 refined_error_tangent =
+      camMatch_T_camQuery_refined.localCoordinates(camMatch_T_camQuery);
+  EXPECT_LT(refined_error_tangent.transpose() * information *
+                refined_error_tangent / (0.3 * 0.3),
+            22.46);
+
+  const std::pair<double, double> initial_error =
+      UtilsOpenCV::ComputeRotationAndTranslationErrors(
+          camMatch_T_camQuery, camMatch_T_camQuery_initial, false);
+  const std::pair<double, double> refined_error =
+      UtilsOpenCV::ComputeRotationAndTranslationErrors(
+          camMatch_T_camQuery, camMatch_T_camQuery_refined, false);
+  EXPECT_LT(refined_error.first, initial_error.first);
+  EXPECT_LT(refined_error.second, initial_error.second);
+
+  // Too few correspondences to refine the pose.
+  refiner.clear();
+  EXPECT_FALSE(refiner.refine(camMatch_T_camQuery_initial,
+                              &camMatch_T_camQuery_refined));
+  EXPECT_TRUE(camMatch_T_camQuery_refined.equals(camMatch_T_camQuery_initial));
+
+  // Landmarks further than the distance threshold are never inliers.
+  for (size_t i = 0u; i < 100u; i++) {
+    const gtsam::Point3 landmark(
+        2.0 * uniform(generator),
+        1.5 * uniform(generator),
+        lcd_params.refine_pose_landmark_distance_threshold_ + 2.0);
+    refiner.addCorrespondence(query_camera.project(landmark),
+                              match_camera.project(landmark));
+  }
+  EXPECT_FALSE(refiner.refine(camMatch_T_camQuery_initial,
+                              &camMatch_T_camQuery_refined));
+  EXPECT_EQ(refiner.getNrInliers(), 0u);
+}
+
 TEST_F(LCDFixture, detectLoop) {
   std::pair<double, double> error;
 
@@ -526,6 +724,8 @@ TEST_F(LCDFixture, detectLoop) {
   EXPECT_EQ(loop_result_3.isLoop(), true);
   EXPECT_EQ(loop_result_3.match_id_, 2);
   EXPECT_EQ(loop_result_3.query_id_, 3);
+  // The refined pose comes with its own noise for the PGO.
+  EXPECT_TRUE(loop_result_3.relative_pose_noise_ != nullptr);
 
   error = UtilsOpenCV::ComputeRotationAndTranslationErrors(
       match1_T_query1_, loop_result_3.relative_pose_, false);
@@ -669,4 +869,78 @@ TEST_F(LCDFixture, spinOnce) {
   EXPECT_EQ(output_2->states_.size(), 3);
 }
 
+TEST_F(LCDFixture, skipRedundantKeyframes) {
+  /* Test that redundant keyframes only add odometry to the PGO */
+  CHECK(lcd_detector_);
+  LoopClosureDetectorParams* params = lcd_detector_->getLCDParamsMutable();
+  params->skip_redundant_keyframes_ = true;
+  params->min_keyframe_translation_ = 0.5;
+  params->min_keyframe_rotation_ = 0.5;
+  params->min_keyframe_image_difference_ = 0.0;
+
+  // Nothing to compare against yet.
+  CHECK(match1_stereo_frame_);
+  EXPECT_TRUE(lcd_detector_->isNovelKeyframe(
+      gtsam::Pose3(), match1_stereo_frame_->left_frame_.img_));
+
+  auto make_input = [](const StereoFrame& stereo_frame,
+                       const Timestamp& timestamp,
+                       const FrameId& kf_id,
+                       const gtsam::Pose3& W_Pose_Blkf) {
+    StereoFrontendOutput::Ptr stereo_frontend_output =
+        std::make_shared<StereoFrontendOutput>(stereo_frame.isKeyframe(),
+                                               StatusStereoMeasurementsPtr(),
+                                               TrackingStatus(),
+                                               gtsam::Pose3::identity(),
+                                               gtsam::Pose3::identity(),
+                                               gtsam::Pose3::identity(),
+                                               stereo_frame,
+                                               ImuFrontend::PimPtr(),
+                                               ImuAccGyrS(),
+                                               cv::Mat(),
+                                               DebugTrackerInfo());
+    return VIO::make_unique<LcdInput>(
+        timestamp,
+        VIO::safeCast<StereoFrontendOutput, FrontendOutputPacketBase>(
+            stereo_frontend_output),
+        kf_id,
+        W_Pose_Blkf);
+  };
+
+  const gtsam::Pose3 W_Pose_B0;
+  const gtsam::Pose3 W_Pose_B1(gtsam::Rot3::Rz(0.1), gtsam::Point3(0.1, 0, 0));
+  const gtsam::Pose3 W_Pose_B2(gtsam::Rot3(), gtsam::Point3(1.0, 0, 0));
+
+  LcdOutput::Ptr output_0 = lcd_detector_->spinOnce(
+      *make_input(*match1_stereo_frame_, timestamp_match1_, 0, W_Pose_B0));
+  EXPECT_EQ(lcd_detector_->getFrameDatabasePtr()->size(), 1u);
+
+  EXPECT_FALSE(lcd_detector_->isNovelKeyframe(
+      W_Pose_B1, match2_stereo_frame_->left_frame_.img_));
+  LcdOutput::Ptr output_1 = lcd_detector_->spinOnce(
+      *make_input(*match2_stereo_frame_, timestamp_match2_, 1, W_Pose_B1));
+  EXPECT_EQ(lcd_detector_->getFrameDatabasePtr()->size(), 1u);
+  EXPECT_FALSE(output_1->is_loop_closure_);
+  EXPECT_EQ(output_1->states_.size(), 2u);
+
+  EXPECT_TRUE(lcd_detector_->isNovelKeyframe(
+      W_Pose_B2, query1_stereo_frame_->left_frame_.img_));
+  params->min_keyframe_image_difference_ = 0.01;
+  LcdOutput::Ptr output_2 = lcd_detector_->spinOnce(
+      *make_input(*query1_stereo_frame_, timestamp_query1_, 2, W_Pose_B2));
+  EXPECT_EQ(lcd_detector_->getFrameDatabasePtr()->size(), 2u);
+  EXPECT_EQ(output_2->states_.size(), 3u);
+  if (output_2->is_loop_closure_) {
+    // Ids are keyframe ids, not LCD database ids.
+    EXPECT_EQ(output_2->id_match_, 0u);
+    EXPECT_EQ(output_2->id_recent_, 2u);
+  }
+
+  // The image check keeps keyframes that did not move but look different.
+  EXPECT_FALSE(lcd_detector_->isNovelKeyframe(
+      W_Pose_B2, query1_stereo_frame_->left_frame_.img_));
+  EXPECT_TRUE(lcd_detector_->isNovelKeyframe(
+      W_Pose_B2, match1_stereo_frame_->left_frame_.img_));
+}
+
 }  // namespace VIO
@@ -107,6 +107,149 @@ TEST_F(MeshFixture, addPolygonNoDuplicates) {
   EXPECT_EQ(vertices_mesh.at<Vertex2D>(2, 0), Vertex2D(4.0, 7.0));
 }
 
+/**
+ * @brief Test that removing polygons and garbage collecting vertices compacts
+ * the vertex ids and keeps all internal datastructures coherent.
+ */
+TEST_F(MeshFixture, garbageCollectVertices) {
+  Mesh2D mesh_2d;
+  const std::vector<LandmarkIds> triangles = {
+      {1u, 2u, 3u}, {2u, 3u, 4u}, {3u, 4u, 5u}};
+  Mesh2D::Polygon polygon(3u);
+  for (const LandmarkIds& triangle : triangles) {
+    for (size_t i = 0u; i < 3u; i++) {
+      const LandmarkId& lmk_id = triangle[i];
+      polygon[i] = Mesh2D::VertexType(
+          lmk_id,
+          Vertex2D(static_cast<float>(lmk_id), 2.0f * lmk_id));
+    }
+    mesh_2d.addPolygonToMesh(polygon);
+  }
+  ASSERT_EQ(mesh_2d.getNumberOfPolygons(), 3u);
+  ASSERT_EQ(mesh_2d.getNumberOfUniqueVertices(), 5u);
+
+  // Nothing to collect while all vertices are referenced.
+  EXPECT_EQ(mesh_2d.garbageCollectVertices(), 0u);
+
+  // Removing the first polygon leaves lmk 1 unreferenced, but in the mesh.
+  EXPECT_EQ(mesh_2d.removePolygons({false, true, true}), 1u);
+  ASSERT_EQ(mesh_2d.getNumberOfPolygons(), 2u);
+  EXPECT_EQ(mesh_2d.getNumberOfUniqueVertices(), 5u);
+  Mesh2D::VertexId vtx_id = 0u;
+  EXPECT_TRUE(mesh_2d.getVtxIdForLmkId(1u, &vtx_id));
+  cv::Mat adjacency_matrix = mesh_2d.getAdjacencyMatrix();
+  EXPECT_EQ(adjacency_matrix.at<uint8_t>(0, 1), 0u);
+  EXPECT_EQ(adjacency_matrix.at<uint8_t>(0, 2), 0u);
+  // Shared with the second polygon.
+  EXPECT_EQ(adjacency_matrix.at<uint8_t>(1, 2), 1u);
+
+  EXPECT_EQ(mesh_2d.garbageCollectVertices(), 1u);
+  ASSERT_EQ(mesh_2d.getNumberOfUniqueVertices(), 4u);
+  EXPECT_FALSE(mesh_2d.getVtxIdForLmkId(1u, &vtx_id));
+
+  // Live vertices keep their relative order.
+  LandmarkId lmk_id = 0;
+  for (LandmarkId expected_lmk_id = 2; expected_lmk_id <= 5; expected_lmk_id++) {
+    ASSERT_TRUE(mesh_2d.getVtxIdForLmkId(expected_lmk_id, &vtx_id));
+    EXPECT_EQ(vtx_id, expected_lmk_id - 2u);
+    ASSERT_TRUE(mesh_2d.getLmkIdForVtxId(vtx_id, &lmk_id));
+    EXPECT_EQ(lmk_id, expected_lmk_id);
+  }
+
+  cv::Mat vertices_mesh;
+  mesh_2d.getVerticesMeshToMat(&vertices_mesh);
+  ASSERT_EQ(vertices_mesh.rows, 4u);
+  EXPECT_EQ(vertices_mesh.at<Vertex2D>(0, 0), Vertex2D(2.0, 4.0));
+  EXPECT_EQ(vertices_mesh.at<Vertex2D>(3, 0), Vertex2D(5.0, 10.0));
+  EXPECT_EQ(mesh_2d.getColorsMesh().rows, 4u);
+
+  cv::Mat polygons_mesh;
+  mesh_2d.getPolygonsMeshToMat(&polygons_mesh);
+  cv::Mat expected_polygons_mesh =
+      (cv::Mat_<int>(8u, 1u) << 3, 0, 1, 2, 3, 1, 2, 3);
+  EXPECT_EQ(cv::countNonZero(expected_polygons_mesh != polygons_mesh), 0);
+
+  adjacency_matrix = mesh_2d.getAdjacencyMatrix();
+  ASSERT_EQ(adjacency_matrix.rows, 4u);
+  ASSERT_EQ(adjacency_matrix.cols, 4u);
+  // clang-format off
+  cv::Mat expected_adjacency_matrix = (cv::Mat_<uint8_t>(4u, 4u) <<
+    0, 1, 1, 0,
+    1, 0, 1, 1,
+    1, 1, 0, 1,
+    0, 1, 1, 0);
+  // clang-format on
+  EXPECT_EQ(cv::countNonZero(expected_adjacency_matrix != adjacency_matrix),
+            0);
+
+  // The face hashes follow the new ids: no duplicates, and new vertices are
+  // appended after the compacted ones.
+  ASSERT_TRUE(mesh_2d.getPolygon(0u, &polygon));
+  mesh_2d.addPolygonToMesh(polygon);
+  EXPECT_EQ(mesh_2d.getNumberOfPolygons(), 2u);
+  polygon[0] = Mesh2D::VertexType(4u, Vertex2D(4.0, 8.0));
+  polygon[1] = Mesh2D::VertexType(5u, Vertex2D(5.0, 10.0));
+  polygon[2] = Mesh2D::VertexType(6u, Vertex2D(6.0, 12.0));
+  mesh_2d.addPolygonToMesh(polygon);
+  EXPECT_EQ(mesh_2d.getNumberOfPolygons(), 3u);
+  ASSERT_TRUE(mesh_2d.getVtxIdForLmkId(6u, &vtx_id));
+  EXPECT_EQ(vtx_id, 4u);
+  EXPECT_EQ(mesh_2d.getAdjacencyMatrix().rows, 5u);
+
+  // Removing all polygons collects all vertices.
+  EXPECT_EQ(mesh_2d.removePolygons({false, false, false}), 3u);
+  EXPECT_EQ(mesh_2d.garbageCollectVertices(), 5u);
+  EXPECT_EQ(mesh_2d.getNumberOfPolygons(), 0u);
+  EXPECT_EQ(mesh_2d.getNumberOfUniqueVertices(), 0u);
+  EXPECT_TRUE(mesh_2d.getLandmarkIds().empty());
+}
+
+/**
+ * @brief Test that the views expose the mesh storage without copying it, and
+ * that lmk ids are returned sorted regardless of insertion order.
+ */
+TEST_F(MeshFixture, meshViews) {
+  Mesh3D mesh_3d;
+  Mesh3D::Polygon polygon(3u);
+  polygon[0] = Mesh3D::VertexType(7, Vertex3D(0.0, 0.0, 1.0));
+  polygon[1] = Mesh3D::VertexType(3, Vertex3D(1.0, 0.0, 1.0));
+  polygon[2] = Mesh3D::VertexType(5, Vertex3D(0.0, 1.0, 1.0));
+  mesh_3d.addPolygonToMesh(polygon);
+
+  const cv::Mat& vertices_view = mesh_3d.getVerticesMeshView();
+  const cv::Mat& polygons_view = mesh_3d.getPolygonsMeshView();
+  cv::Mat vertices_mesh, polygons_mesh;
+  mesh_3d.getVerticesMeshToMat(&vertices_mesh);
+  mesh_3d.getPolygonsMeshToMat(&polygons_mesh);
+  EXPECT_EQ(vertices_view.data, mesh_3d.getVerticesMeshView().data);
+  EXPECT_NE(vertices_view.data, vertices_mesh.data);
+  EXPECT_NE(polygons_view.data, polygons_mesh.data);
+  ASSERT_EQ(vertices_view.rows, 3);
+  for (int i = 0; i < vertices_view.rows; i++) {
+    EXPECT_EQ(vertices_view.at<Vertex3D>(i), vertices_mesh.at<Vertex3D>(i));
+  }
+  EXPECT_EQ(cv::countNonZero(polygons_view != polygons_mesh), 0);
+  EXPECT_EQ(mesh_3d.getColorsMeshView().data,
+            mesh_3d.getColorsMesh(false).data);
+
+  LandmarkIds lmk_ids = mesh_3d.getLandmarkIds();
+  ASSERT_EQ(lmk_ids.size(), 3u);
+  EXPECT_EQ(lmk_ids[0], 3);
+  EXPECT_EQ(lmk_ids[1], 5);
+  EXPECT_EQ(lmk_ids[2], 7);
+
+  // Vertex ids follow insertion order.
+  Mesh3D::VertexId vtx_id = 0u;
+  LandmarkId lmk_id = -1;
+  ASSERT_TRUE(mesh_3d.getVtxIdForLmkId(7, &vtx_id));
+  EXPECT_EQ(vtx_id, 0u);
+  ASSERT_TRUE(mesh_3d.getLmkIdForVtxId(2u, &lmk_id));
+  EXPECT_EQ(lmk_id, 5);
+  EXPECT_FALSE(mesh_3d.getLmkIdForVtxId(3u, &lmk_id));
+  EXPECT_TRUE(mesh_3d.isLmkIdInMesh(3));
+  EXPECT_FALSE(mesh_3d.isLmkIdInMesh(4));
+}
+
 TEST_F(MeshFixture, addPolygonNominalMesh) {
   // Add polygon to the mesh and check that all internal datastructures
   // are correctly populated and coherent
@@ -133,6 +133,67 @@ class OnlineAlignmentFixture : public ::testing::Test {
     estimated_poses_[0] = gtsam::Pose3::identity();
   }
 
+  // Simulates a body spinning at a constant rate and accelerating smoothly,
+  // with IMU measurements at 200Hz and keyframes every 0.1s. The IMU sample
+  // at t_j is held until t_j+1, as the preintegration assumes.
+  // [in] nr of keyframe intervals.
+  // [in] constant gyroscope bias added to the IMU measurements.
+  // [in] world gravity.
+  void initializeSyntheticAlignmentData(const size_t& n_frames,
+                                        const gtsam::Vector3& gyro_bias,
+                                        const gtsam::Vector3& n_gravity) {
+    static constexpr size_t kImuSamplesPerFrame = 20u;
+    static constexpr Timestamp kImuPeriodNs = 5000000;  // 200Hz.
+    const gtsam::Rot3 W_R_B0 = gtsam::Rot3::RzRyRx(0.1, -0.2, 0.3);
+    const gtsam::Vector3 B_omega(0.3, -0.2, 0.5);
+    const gtsam::Vector3 W_v_B0(0.2, 0.1, -0.1);
+    // Acceleration a(t), velocity v(t) and position p(t) of the body.
+    auto W_acc = [](const double& t) {
+      return gtsam::Vector3(0.5 * cos(t), 0.3 * sin(2.0 * t), 0.2);
+    };
+    auto W_vel = [&W_v_B0](const double& t) {
+      return W_v_B0 + gtsam::Vector3(0.5 * sin(t),
+                                     0.15 * (1.0 - cos(2.0 * t)),
+                                     0.2 * t);
+    };
+    auto W_pos = [&W_v_B0](const double& t) {
+      return gtsam::Vector3(W_v_B0 * t) +
+             gtsam::Vector3(0.5 * (1.0 - cos(t)),
+                            0.15 * t - 0.075 * sin(2.0 * t),
+                            0.1 * t * t);
+    };
+    auto W_Pose_B = [&](const double& t) {
+      return gtsam::Pose3(W_R_B0 * gtsam::Rot3::Expmap(B_omega * t),
+                          W_pos(t));
+    };
+
+    estimated_poses_.clear();
+    pims_.clear();
+    delta_t_poses_.clear();
+    ahrs_pim_.clear();
+    init_navstate_ = VioNavState(W_Pose_B(0.0), W_vel(0.0), imu_bias_);
+
+    estimated_poses_.push_back(gtsam::Pose3::identity());
+    for (size_t k = 0u; k < n_frames; ++k) {
+      ImuStampS imu_stamps(1, kImuSamplesPerFrame + 1u);
+      ImuAccGyrS imu_accgyr(6, kImuSamplesPerFrame + 1u);
+      for (size_t j = 0u; j <= kImuSamplesPerFrame; ++j) {
+        imu_stamps(j) = (k * kImuSamplesPerFrame + j) * kImuPeriodNs;
+        const double t = UtilsNumerical::NsecToSec(imu_stamps(j));
+        imu_accgyr.block<3, 1>(0, j) =
+            W_Pose_B(t).rotation().unrotate(W_acc(t) - n_gravity);
+        imu_accgyr.block<3, 1>(3, j) = B_omega + gyro_bias;
+      }
+      ImuFrontend imu_frontend(imu_params_, imu_bias_);
+      pims_.push_back(
+          imu_frontend.preintegrateImuMeasurements(imu_stamps, imu_accgyr));
+      delta_t_poses_.push_back(
+          UtilsNumerical::NsecToSec(kImuSamplesPerFrame * kImuPeriodNs));
+      estimated_poses_.push_back(W_Pose_B(0.0).between(W_Pose_B(
+          UtilsNumerical::NsecToSec(imu_stamps(kImuSamplesPerFrame)))));
+    }
+  }
+
   void initializeImuParams(ImuParams* imu_params) const {
     CHECK_NOTNULL(imu_params);
     imu_params->acc_random_walk_ = 1.0;
@@ -151,6 +212,8 @@ class OnlineAlignmentFixture : public ::testing::Test {
   static constexpr double tol_OGA = 1e-3;
   static constexpr double tol_RD_gv = 25e-2;
   static constexpr double tol_RD_an = 4 / 180.0 * M_PI;
+  static constexpr double tol_SD = 1e-2;
+  static constexpr double tol_SD_gb = 1e-3;
 
   std::unique_ptr<EurocDataProvider> dataset_;
   AlignmentPoses estimated_poses_;
@@ -349,4 +412,48 @@ TEST_F(OnlineAlignmentFixture, DISABLED_GravityAlignmentRealData) {
   }
 }
 
+/* -------------------------------------------------------------------------- */
+TEST_F(OnlineAlignmentFixture, OnlineGravityAlignmentSyntheticData) {
+  const gtsam::Vector3 n_gravity(0.0, 0.0, -9.81);
+  const gtsam::Vector3 real_gyro_bias(0.01, -0.02, 0.015);
+  initializeSyntheticAlignmentData(30u, real_gyro_bias, n_gravity);
+
+  gtsam::Vector3 gyro_bias = gtsam::Vector3::Zero();
+  gtsam::Vector3 g_iter;
+  gtsam::NavState init_navstate;
+  OnlineGravityAlignment initial_alignment(
+      estimated_poses_, delta_t_poses_, pims_, n_gravity);
+  ASSERT_TRUE(initial_alignment.alignVisualInertialEstimates(
+      &gyro_bias, &g_iter, &init_navstate, true));
+
+  EXPECT_TRUE(gtsam::assert_equal(real_gyro_bias, gyro_bias, tol_SD_gb));
+
+  // Gravity is estimated in the initial body frame.
+  const gtsam::Vector3 real_body_grav(
+      init_navstate_.pose_.rotation().unrotate(n_gravity));
+  EXPECT_TRUE(gtsam::assert_equal(real_body_grav, g_iter, tol_SD));
+
+  // The initial yaw is not observable: compare the velocity along gravity
+  // and its norm.
+  const gtsam::Vector3& real_init_vel = init_navstate_.velocity_;
+  EXPECT_NEAR(real_init_vel.norm(), init_navstate.velocity().norm(), tol_SD);
+  EXPECT_NEAR(real_init_vel.z(), init_navstate.velocity().z(), tol_SD);
+}
+
+/* -------------------------------------------------------------------------- */
+TEST_F(OnlineAlignmentFixture, OnlineGravityAlignmentRankDeficient) {
+  const gtsam::Vector3 n_gravity(0.0, 0.0, -9.81);
+  // A single keyframe interval has 6 constraints for 9 unknowns: the
+  // velocities at both ends and gravity.
+  initializeSyntheticAlignmentData(1u, gtsam::Vector3::Zero(), n_gravity);
+
+  gtsam::Vector3 gyro_bias = gtsam::Vector3::Zero();
+  gtsam::Vector3 g_iter;
+  gtsam::NavState init_navstate;
+  OnlineGravityAlignment initial_alignment(
+      estimated_poses_, delta_t_poses_, pims_, n_gravity);
+  EXPECT_FALSE(initial_alignment.alignVisualInertialEstimates(
+      &gyro_bias, &g_iter, &init_navstate, false));
+}
+
 }  // Namespace VIO
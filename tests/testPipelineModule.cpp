@@ -0,0 +1,73 @@
+/* ----------------------------------------------------------------------------
+ * Copyright 2017, Massachusetts Institute of Technology,
+ * Cambridge, MA 02139
+ * All Rights Reserved
+ * Authors: Luca Carlone, et al. (see THANKS for the full author list)
+ * See LICENSE for the license information
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @file   testPipelineModule.cpp
+ * @brief  test PipelineModule
+ * @author Antoni Rosinol
+ */
+
+#include <memory>
+#include <thread>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include "kimera-vio/pipeline/PipelineModule.h"
+#include "kimera-vio/pipeline/PipelinePayload.h"
+#include "kimera-vio/utils/Macros.h"
+#include "kimera-vio/utils/ThreadsafeQueue.h"
+
+namespace VIO {
+
+struct DummyPayload : public PipelinePayload {
+  KIMERA_POINTER_TYPEDEFS(DummyPayload);
+  KIMERA_DELETE_COPY_CONSTRUCTORS(DummyPayload);
+  explicit DummyPayload(const Timestamp& timestamp)
+      : PipelinePayload(timestamp) {}
+  virtual ~DummyPayload() = default;
+};
+
+//! Forwards its input timestamp to the output.
+class DummyModule : public SISOPipelineModule<DummyPayload, DummyPayload> {
+ public:
+  using SISO = SISOPipelineModule<DummyPayload, DummyPayload>;
+
+  DummyModule(SISO::InputQueue* input_queue, SISO::OutputQueue* output_queue)
+      : SISO(input_queue, output_queue, "Dummy", true) {}
+  virtual ~DummyModule() = default;
+
+ protected:
+  OutputUniquePtr spinOnce(InputUniquePtr input) override {
+    return VIO::make_unique<DummyPayload>(input->timestamp_);
+  }
+};
+
+TEST(PipelineModule, isWorkingUntilOutputIsPushed) {
+  ThreadsafeQueue<DummyModule::InputUniquePtr> input_queue("test_input");
+  ThreadsafeQueue<DummyModule::OutputUniquePtr> output_queue("test_output");
+  DummyModule module(&input_queue, &output_queue);
+  std::thread spin_thread(&DummyModule::spin, &module);
+
+  // Enqueue and drain right away: the module must look busy from the push
+  // until its output is pushed, also while it pops the input.
+  for (Timestamp timestamp = 0; timestamp < 1000; ++timestamp) {
+    input_queue.push(VIO::make_unique<DummyPayload>(timestamp));
+    while (module.isWorking()) {
+    }
+    DummyModule::OutputUniquePtr output = nullptr;
+    ASSERT_TRUE(output_queue.pop(output));
+    ASSERT_TRUE(output);
+    EXPECT_EQ(output->timestamp_, timestamp);
+  }
+
+  module.shutdown();
+  spin_thread.join();
+}
+
+}  // namespace VIO
@@ -210,6 +210,43 @@ TEST(testPointPlaneFactor, JacobiansNegative) {
   ASSERT_TRUE(assert_equal(H2Expected, H2Actual, tol));
 }
 
+/**
+ * Test that the fixed-size Jacobians, which linearize() uses, equal numerical
+ * ones.
+ */
+TEST(testPointPlaneFactor, FixedSizeJacobians) {
+  Key pointKey(1);
+  Key planeKey(2);
+  noiseModel::Diagonal::shared_ptr regularityNoise =
+      noiseModel::Diagonal::Sigmas(Vector1::Constant(0.1));
+  PointPlaneFactor factor(pointKey, planeKey, regularityNoise);
+
+  // Set the linearization point
+  Point3 point(4.3, -3.2, 1.9);
+  OrientedPlane3 plane(Unit3(2.4, 1.2, 1.9), 2.3);
+
+  // Use the factor to calculate the Jacobians
+  Matrix13 H1Actual, H2Actual;
+  double error = factor.evaluateErrorFixed(point, plane, H1Actual, H2Actual);
+  ASSERT_TRUE(assert_equal(factor.evaluateError(point, plane),
+                           Vector1(error), tol));
+
+  // Calculate numerical derivatives
+  Matrix H1Expected = numericalDerivative21<Vector, Point3, OrientedPlane3>(
+      boost::bind(&PointPlaneFactor::evaluateError, &factor, _1, _2,
+                  boost::none, boost::none),
+      point, plane, delta_value);
+
+  Matrix H2Expected = numericalDerivative22<Vector, Point3, OrientedPlane3>(
+      boost::bind(&PointPlaneFactor::evaluateError, &factor, _1, _2,
+                  boost::none, boost::none),
+      point, plane, delta_value);
+
+  // Verify the Jacobians are correct
+  ASSERT_TRUE(assert_equal(H1Expected, Matrix(H1Actual), tol));
+  ASSERT_TRUE(assert_equal(H2Expected, Matrix(H2Actual), tol));
+}
+
 /**
  * Test that optimization works for plane parameters.
  * Three landmarks, with prior factors, and a plane constrained together
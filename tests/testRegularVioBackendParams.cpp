@@ -67,6 +67,9 @@ TEST(testRegularVioBackendParams, VioParseYAML) {
   EXPECT_DOUBLE_EQ(1.3, vp.noMotionRotationSigma_);
   EXPECT_DOUBLE_EQ(1.4, vp.constantVelSigma_);
   EXPECT_DOUBLE_EQ(0, vp.numOptimize_);
+  EXPECT_DOUBLE_EQ(0.01, vp.extraIterationsDeltaThreshold_);
+  EXPECT_DOUBLE_EQ(0.02, vp.extraIterationsErrorReductionThreshold_);
+  EXPECT_DOUBLE_EQ(30, vp.maxOptimizeTimeMs_);
   EXPECT_DOUBLE_EQ(2, vp.horizon_);
   EXPECT_DOUBLE_EQ(0.001, vp.wildfire_threshold_);
   EXPECT_DOUBLE_EQ(1, vp.useDogLeg_);
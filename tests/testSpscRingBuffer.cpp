@@ -0,0 +1,79 @@
+/* ----------------------------------------------------------------------------
+ * Copyright 2017, Massachusetts Institute of Technology,
+ * Cambridge, MA 02139
+ * All Rights Reserved
+ * Authors: Luca Carlone, et al. (see THANKS for the full author list)
+ * See LICENSE for the license information
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @file   testSpscRingBuffer.cpp
+ * @brief  test SpscRingBuffer
+ * @author Antoni Rosinol
+ */
+
+#include <thread>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include "kimera-vio/utils/SpscRingBuffer.h"
+
+namespace VIO {
+
+TEST(testSpscRingBuffer, capacityIsPowerOfTwo) {
+  EXPECT_EQ(SpscRingBuffer<int>(1u).capacity(), 1u);
+  EXPECT_EQ(SpscRingBuffer<int>(5u).capacity(), 8u);
+  EXPECT_EQ(SpscRingBuffer<int>(64u).capacity(), 64u);
+}
+
+TEST(testSpscRingBuffer, pushPopWrapsAround) {
+  SpscRingBuffer<int> ring(4u);
+  int value = -1;
+  EXPECT_TRUE(ring.empty());
+  EXPECT_FALSE(ring.pop(&value));
+  EXPECT_EQ(ring.peek(), nullptr);
+
+  // Go around the ring several times.
+  int next_pushed = 0;
+  int next_popped = 0;
+  for (size_t round = 0u; round < 5u; ++round) {
+    while (ring.push(next_pushed)) ++next_pushed;
+    EXPECT_EQ(ring.size(), 4u);
+    ASSERT_TRUE(ring.peek());
+    EXPECT_EQ(*ring.peek(), next_popped);
+    for (size_t i = 0u; i < 3u; ++i) {
+      ASSERT_TRUE(ring.pop(&value));
+      EXPECT_EQ(value, next_popped++);
+    }
+    EXPECT_EQ(ring.size(), 1u);
+  }
+  ring.pop();
+  EXPECT_TRUE(ring.empty());
+}
+
+TEST(testSpscRingBuffer, producerConsumerThreads) {
+  SpscRingBuffer<size_t> ring(16u);
+  static constexpr size_t kNrValues = 100000u;
+  std::thread producer([&ring]() {
+    for (size_t i = 0u; i < kNrValues; ++i) {
+      while (!ring.push(i)) std::this_thread::yield();
+    }
+  });
+
+  // All values arrive once and in order.
+  size_t expected_value = 0u;
+  size_t value = 0u;
+  while (expected_value < kNrValues) {
+    if (ring.pop(&value)) {
+      ASSERT_EQ(value, expected_value);
+      ++expected_value;
+    } else {
+      std::this_thread::yield();
+    }
+  }
+  producer.join();
+  EXPECT_TRUE(ring.empty());
+}
+
+}  // namespace VIO
@@ -17,7 +17,11 @@
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 
+#include <cmath>
+#include <limits>
+#include <map>
 #include <string>
+#include <tuple>
 
 #include "kimera-vio/dataprovider/EurocDataProvider.h"
 #include "kimera-vio/frontend/StereoCamera.h"
@@ -364,6 +368,81 @@ TEST_F(StereoCameraFixture, backProjectDisparityTo3DMaual) {
   // TODO(marcus): implement
 }
 
+TEST_F(StereoCameraFixture, backProjectDisparityToVoxelCloud) {
+  CHECK(stereo_camera_);
+  // Random disparities, with some missing values.
+  cv::Mat disp_img(480, 752, CV_32F);
+  cv::RNG rng(0);
+  rng.fill(disp_img, cv::RNG::UNIFORM, -4.0f, 64.0f);
+  disp_img.setTo(std::numeric_limits<float>::quiet_NaN(),
+                 disp_img < -2.0f);
+
+  DenseStereoParams params;
+  params.cloud_voxel_size_ = 0.1f;
+  params.cloud_min_depth_ = 0.5f;
+  params.cloud_max_depth_ = 4.0f;
+  const Timestamp timestamp = 1234;
+  DenseStereoCloud cloud;
+  stereo_camera_->backProjectDisparityToVoxelCloud(
+      disp_img, timestamp, params, &cloud);
+  ASSERT_EQ(cloud.points_.size(), cloud.weights_.size());
+  EXPECT_EQ(cloud.timestamp_, timestamp);
+  EXPECT_FLOAT_EQ(cloud.voxel_size_, params.cloud_voxel_size_);
+
+  // Voxelize the full resolution depth map.
+  cv::Mat depth_map;
+  stereo_camera_->backProjectDisparityTo3DManual(disp_img, &depth_map);
+  std::map<std::tuple<int, int, int>, size_t> expected_voxels;
+  size_t expected_nr_points = 0u;
+  cv::Point3d expected_mean(0.0, 0.0, 0.0);
+  for (int v = 0; v < depth_map.rows; ++v) {
+    for (int u = 0; u < depth_map.cols; ++u) {
+      const cv::Point3f& xyz = depth_map.at<cv::Point3f>(v, u);
+      if (!(xyz.z >= params.cloud_min_depth_ &&
+            xyz.z <= params.cloud_max_depth_)) {
+        continue;
+      }
+      ++expected_voxels[std::make_tuple(
+          static_cast<int>(std::floor(xyz.x / params.cloud_voxel_size_)),
+          static_cast<int>(std::floor(xyz.y / params.cloud_voxel_size_)),
+          static_cast<int>(std::floor(xyz.z / params.cloud_voxel_size_)))];
+      ++expected_nr_points;
+      expected_mean += cv::Point3d(xyz);
+    }
+  }
+  ASSERT_GT(expected_nr_points, 0u);
+  expected_mean *= 1.0 / expected_nr_points;
+
+  // Voxel boundaries are subject to rounding, so compare aggregates.
+  EXPECT_NEAR(cloud.points_.size(), expected_voxels.size(),
+              0.01 * expected_voxels.size());
+  size_t nr_points = 0u;
+  cv::Point3d mean(0.0, 0.0, 0.0);
+  for (size_t k = 0u; k < cloud.points_.size(); ++k) {
+    const cv::Point3f& point = cloud.points_[k];
+    EXPECT_GE(point.z, params.cloud_min_depth_);
+    EXPECT_LE(point.z, params.cloud_max_depth_);
+    EXPECT_GT(cloud.weights_[k], 0u);
+    nr_points += cloud.weights_[k];
+    mean += cloud.weights_[k] * cv::Point3d(point);
+  }
+  mean *= 1.0 / nr_points;
+  EXPECT_EQ(nr_points, expected_nr_points);
+  EXPECT_NEAR(mean.x, expected_mean.x, 1e-4);
+  EXPECT_NEAR(mean.y, expected_mean.y, 1e-4);
+  EXPECT_NEAR(mean.z, expected_mean.z, 1e-4);
+
+  // The output does not depend on the number of threads.
+  const int nr_threads = cv::getNumThreads();
+  cv::setNumThreads(1);
+  DenseStereoCloud sequential_cloud;
+  stereo_camera_->backProjectDisparityToVoxelCloud(
+      disp_img, timestamp, params, &sequential_cloud);
+  cv::setNumThreads(nr_threads);
+  EXPECT_EQ(sequential_cloud.points_, cloud.points_);
+  EXPECT_EQ(sequential_cloud.weights_, cloud.weights_);
+}
+
 TEST_F(StereoCameraFixture, unidstortRectifyStereoFrame) {
   CHECK(stereo_camera_);
   // TODO(marcus): implement
@@ -297,6 +297,25 @@ TEST_F(VioPipelineFixture, OfflineParallelSpinShutdownWhenFinished) {
   EXPECT_FALSE(handle.get());
 }
 
+TEST_F(VioPipelineFixture, OfflineParallelSpinDrain) {
+  buildOfflinePipeline(vio_params_);
+  ASSERT_TRUE(vio_params_.parallel_run_);
+  ASSERT_TRUE(dataset_parser_);
+  ASSERT_TRUE(vio_pipeline_);
+  // Nothing has been processed yet.
+  EXPECT_FALSE(vio_pipeline_->drain(0));
+  auto handle = std::async(std::launch::async,
+                           &VIO::DataProviderInterface::spin,
+                           dataset_parser_.get());
+  auto handle_pipeline =
+      std::async(std::launch::async, &VIO::StereoImuPipeline::spin, vio_pipeline_.get());
+  EXPECT_TRUE(vio_pipeline_->drain());
+  EXPECT_TRUE(vio_pipeline_->hasFinished());
+  vio_pipeline_->shutdown();
+  EXPECT_FALSE(handle_pipeline.get());
+  EXPECT_FALSE(handle.get());
+}
+
 // This tests that the VIO pipeline dies gracefully if the Backend breaks.
 TEST_F(VioPipelineFixture, OfflineSequentialSpinBackendFailureGracefulShutdown) {
   // Modify vio pipeline so that the Backend fails
@@ -208,6 +208,26 @@ TEST(testThreadsafeQueue, blocking_producer) {
   EXPECT_EQ(queue_size, 5u);
 }
 
+/* ************************************************************************* */
+TEST(testThreadsafeQueue, pop_latch) {
+  ThreadsafeQueue<std::string> q("test_queue");
+  std::atomic_bool latch(false);
+  q.setPopLatch(&latch);
+  std::string s;
+  EXPECT_FALSE(q.pop(s));
+  EXPECT_FALSE(latch);
+  q.push("Hello World!");
+  EXPECT_FALSE(latch);
+  EXPECT_TRUE(q.pop(s));
+  EXPECT_TRUE(latch);
+
+  latch = false;
+  q.setPopLatch(nullptr);
+  q.push("Hello World 2!");
+  EXPECT_TRUE(q.popBlocking(s));
+  EXPECT_FALSE(latch);
+}
+
 /* ************************************************************************* */
 TEST(testThreadsafeQueue, stress_test) {
   ThreadsafeQueue<std::string> q("test_queue");
@@ -31,6 +31,7 @@
 #include "kimera-vio/frontend/StereoMatcher.h"
 #include "kimera-vio/frontend/Tracker-definitions.h"
 #include "kimera-vio/frontend/Tracker.h"
+#include "kimera-vio/frontend/TranslationVoting.h"
 #include "kimera-vio/utils/Timer.h"
 
 DECLARE_string(test_data_path);
@@ -1079,6 +1080,75 @@ TEST_F(TestTracker, getPoint3AndCovariance) {
   // cout << "cov_ref_i_expected \n" << cov_ref_i_expected << endl;
 }
 
+/* ************************************************************************* */
+TEST_F(TestTracker, getPoints3AndCovariances) {
+  ClearStereoFrame(ref_stereo_frame.get());
+  VIO::StereoCamera ref_stereo_camera(ref_stereo_frame->left_frame_.cam_param_,
+                                      ref_stereo_frame->right_frame_.cam_param_);
+  gtsam::StereoCamera stereoCam =
+      gtsam::StereoCamera(gtsam::Pose3::identity(),
+                          ref_stereo_camera.getStereoCalib());
+  Matrix3 stereoPtCov = Matrix3::Identity();
+  stereoPtCov(0, 1) = stereoPtCov(1, 0) = 0.3;
+  stereoPtCov(2, 2) = 2.0;
+  const gtsam::Rot3 R = gtsam::Rot3::RzRyRx(0.1, -0.2, 0.3);
+
+  // Stereo points all over the image, at different disparities.
+  std::vector<size_t> point_ids;
+  for (size_t i = 0u; i < 20u; i++) {
+    const double xL = 20.0 + 30.0 * i;
+    const double v = 10.0 + 20.0 * i;
+    const double xR = xL - (1.0 + 3.0 * i);
+    ref_stereo_frame->left_keypoints_rectified_.push_back(
+        StatusKeypointCV(KeypointStatus::VALID, KeypointCV(xL, v)));
+    ref_stereo_frame->right_keypoints_rectified_.push_back(
+        StatusKeypointCV(KeypointStatus::VALID, KeypointCV(xR, v)));
+    ref_stereo_frame->keypoints_3d_.push_back(
+        stereoCam.backproject2(StereoPoint2(xL, xR, v)));
+    // Unordered and repeated ids.
+    point_ids.push_back((7u * i) % 20u);
+  }
+  point_ids.push_back(3u);
+
+  Vectors3 points;
+  Matrices3 covariances;
+  Tracker::getPoints3AndCovariances(*ref_stereo_frame,
+                                    stereoCam,
+                                    point_ids,
+                                    stereoPtCov,
+                                    R.matrix(),
+                                    &points,
+                                    &covariances);
+  ASSERT_EQ(point_ids.size(), points.size());
+  ASSERT_EQ(point_ids.size(), covariances.size());
+  for (size_t i = 0u; i < point_ids.size(); i++) {
+    const size_t& id = point_ids[i];
+    // Expected values from the gtsam back-projection Jacobian.
+    const StereoPoint2 stereo_point(
+        ref_stereo_frame->left_keypoints_rectified_[id].second.x,
+        ref_stereo_frame->right_keypoints_rectified_[id].second.x,
+        ref_stereo_frame->left_keypoints_rectified_[id].second.y);
+    Matrix3 J;
+    stereoCam.backproject2(stereo_point, boost::none, J);
+    J = R.matrix() * J;
+    const Vector3 expected_point =
+        R.matrix() * ref_stereo_frame->keypoints_3d_[id];
+    const Matrix3 expected_cov = J * stereoPtCov * J.transpose();
+    EXPECT_TRUE(assert_equal(expected_point, points[i], tol));
+    EXPECT_TRUE(assert_equal(expected_cov,
+                             covariances[i],
+                             tol * std::max(1.0, expected_cov.norm())));
+
+    // Same as the single point version.
+    Vector3 point;
+    Matrix3 cov;
+    tie(point, cov) = Tracker::getPoint3AndCovariance(
+        *ref_stereo_frame, stereoCam, id, stereoPtCov, R.matrix());
+    EXPECT_TRUE(assert_equal(point, points[i], tol));
+    EXPECT_TRUE(assert_equal(cov, covariances[i], tol));
+  }
+}
+
 /* ************************************************************************* */
 TEST_F(TestTracker, findOutliers) {
   // Normal case:
@@ -1377,6 +1447,118 @@ TEST_F(TestTracker, MahalanobisDistance) {
           << "time3 (manual): " << time3;
 }
 
+/* ************************************************************************* */
+// Quadratic voting over all pairs of hypotheses, as a reference for
+// TranslationVoting.
+static size_t bruteForceTranslationVoting(const Vectors3f& relTranf,
+                                          const Matrices3f& cov_relTranf,
+                                          const float& threshold,
+                                          std::vector<int>* inliers) {
+  const size_t nrMatches = relTranf.size();
+  std::vector<std::vector<int>> coherentSet(nrMatches);
+  size_t maxCoherentSetSize = 0;
+  size_t maxCoherentSetId = 0;
+  for (size_t i = 0; i < nrMatches; i++) {
+    coherentSet.at(i).push_back(i);
+    for (size_t j = i + 1; j < nrMatches; j++) {
+      Vector3f v = relTranf.at(i) - relTranf.at(j);
+      Matrix3f O = cov_relTranf.at(i) + cov_relTranf.at(j);
+      float dinv = 1 / (O(0, 0) * (O(1, 1) * O(2, 2) - O(1, 2) * O(2, 1)) -
+                        O(1, 0) * (O(0, 1) * O(2, 2) - O(0, 2) * O(2, 1)) +
+                        O(2, 0) * (O(0, 1) * O(1, 2) - O(1, 1) * O(0, 2)));
+      float innovationMahalanobisNorm =
+          dinv * v(0) * (v(0) * (O(1, 1) * O(2, 2) - O(1, 2) * O(2, 1)) -
+                         v(1) * (O(0, 1) * O(2, 2) - O(0, 2) * O(2, 1)) +
+                         v(2) * (O(0, 1) * O(1, 2) - O(1, 1) * O(0, 2))) +
+          dinv * v(1) * (O(0, 0) * (v(1) * O(2, 2) - O(1, 2) * v(2)) -
+                         O(1, 0) * (v(0) * O(2, 2) - O(0, 2) * v(2)) +
+                         O(2, 0) * (v(0) * O(1, 2) - v(1) * O(0, 2))) +
+          dinv * v(2) * (O(0, 0) * (O(1, 1) * v(2) - v(1) * O(2, 1)) -
+                         O(1, 0) * (O(0, 1) * v(2) - v(0) * O(2, 1)) +
+                         O(2, 0) * (O(0, 1) * v(1) - O(1, 1) * v(0)));
+      if (innovationMahalanobisNorm < threshold) {
+        coherentSet.at(i).push_back(j);
+        coherentSet.at(j).push_back(i);
+      }
+    }
+    if (coherentSet.at(i).size() > maxCoherentSetSize) {
+      maxCoherentSetSize = coherentSet.at(i).size();
+      maxCoherentSetId = i;
+    }
+  }
+  if (nrMatches > 0) {
+    *inliers = coherentSet.at(maxCoherentSetId);
+    std::sort(inliers->begin(), inliers->end());
+  } else {
+    inliers->clear();
+  }
+  return maxCoherentSetSize;
+}
+
+/* ************************************************************************* */
+TEST_F(TestTracker, TranslationVoting) {
+  const float threshold = 6.2514f;
+  std::mt19937 rng(3);
+  std::uniform_real_distribution<float> depth_dist(1.0f, 15.0f);
+  std::uniform_real_distribution<float> outlier_dist(-3.0f, 3.0f);
+  std::normal_distribution<float> normal_dist(0.0f, 1.0f);
+  const Vector3f true_translation(0.3f, -0.1f, 0.5f);
+
+  TranslationVoting translation_voting;
+  std::vector<int> inliers, expected_inliers;
+
+  // No hypotheses.
+  EXPECT_EQ(0u,
+            translation_voting.vote(
+                Vectors3f(), Matrices3f(), threshold, &inliers));
+  EXPECT_TRUE(inliers.empty());
+
+  double time_brute_force = 0.0, time_voting = 0.0;
+  for (const size_t& nr_hypotheses :
+       std::vector<size_t>{1u, 2u, 50u, 200u, 500u, 1000u}) {
+    // Stereo-like hypotheses: the covariance grows fast with the depth, and a
+    // fraction of them are outliers.
+    Vectors3f translations;
+    Matrices3f covariances;
+    for (size_t i = 0u; i < nr_hypotheses; i++) {
+      const float depth = depth_dist(rng);
+      Matrix3f A;
+      for (int k = 0; k < 9; k++) A(k / 3, k % 3) = normal_dist(rng);
+      A(2, 2) += 2.0f;
+      const float scale = 1e-3f * std::pow(depth / 5.0f, 2.0f);
+      Matrix3f cov = scale * scale * A * A.transpose();
+      cov += 1e-8f * Matrix3f::Identity();
+      Vector3f noise(normal_dist(rng), normal_dist(rng), normal_dist(rng));
+      Vector3f translation = true_translation + scale * A * noise;
+      if (i % 3 == 0) {
+        translation =
+            Vector3f(outlier_dist(rng), outlier_dist(rng), outlier_dist(rng));
+      }
+      translations.push_back(translation);
+      covariances.push_back(cov);
+    }
+
+    auto tic = VIO::utils::Timer::tic();
+    const size_t expected_size = bruteForceTranslationVoting(
+        translations, covariances, threshold, &expected_inliers);
+    time_brute_force += VIO::utils::Timer::toc(tic).count();
+
+    tic = VIO::utils::Timer::tic();
+    const size_t size = translation_voting.vote(
+        translations, covariances, threshold, &inliers);
+    time_voting += VIO::utils::Timer::toc(tic).count();
+
+    EXPECT_EQ(expected_size, size);
+    EXPECT_EQ(expected_inliers, inliers);
+    if (nr_hypotheses >= 200u) {
+      EXPECT_LT(translation_voting.getNrTestedPairs(),
+                nr_hypotheses * (nr_hypotheses - 1u) / 2u);
+    }
+  }
+  VLOG(1) << "Translation voting, brute force: " << time_brute_force << '\n'
+          << "Translation voting, grid: " << time_voting;
+}
+
 TEST_F(TestTracker, FeatureTrackingRotationalOpticalFlow) {
   // Load one Euroc image
 
@@ -1434,3 +1616,103 @@ TEST_F(TestTracker, FeatureTrackingNoOpticalFlowPredictionLargeRot) {
 
 TEST_F(TestTracker,
        FeatureTrackingRotationalOpticalFlowPredictionWithLargeRot) {}
+
+TEST_F(TestTracker, FeatureTrackingForwardBackwardCheck) {
+  // Current image: the reference one shifted by a few pixels, with its top
+  // left quarter replaced by noise, so that the tracks there drift.
+  const Frame& ref_left_frame = ref_stereo_frame->left_frame_;
+  ASSERT_FALSE(ref_left_frame.keypoints_.empty());
+  const KeypointCV shift(3.0f, 2.0f);
+  const cv::Mat shift_transform =
+      (cv::Mat_<double>(2, 3) << 1.0, 0.0, shift.x, 0.0, 1.0, shift.y);
+  cv::Mat cur_img;
+  cv::warpAffine(ref_left_frame.img_,
+                 cur_img,
+                 shift_transform,
+                 ref_left_frame.img_.size());
+  const cv::Rect occluded(0, 0, cur_img.cols / 2, cur_img.rows / 2);
+  cv::Mat occluded_img = cur_img(occluded);
+  cv::theRNG().state = 42u;
+  cv::randu(occluded_img, cv::Scalar(0), cv::Scalar(255));
+
+  // Tracks whose KLT window is fully in or out of the noise.
+  const int margin = tracker_params_.klt_win_size_ + 4;
+  const cv::Rect inside(occluded.x,
+                        occluded.y,
+                        occluded.width - margin,
+                        occluded.height - margin);
+  const cv::Rect outside(occluded.x,
+                         occluded.y,
+                         occluded.width + margin,
+                         occluded.height + margin);
+
+  // Returns the nr of tracks inside and outside the noise.
+  const auto track = [&](const FrontendParams& params,
+                         DebugTrackerInfo* debug_info) {
+    Frame ref_frame(ref_left_frame);
+    Frame cur_frame(ref_frame.id_ + 1u,
+                    ref_frame.timestamp_ + 1,
+                    ref_frame.cam_param_,
+                    cur_img);
+    Tracker tracker(params, stereo_camera_->getOriginalLeftCamera());
+    tracker.featureTracking(&ref_frame, &cur_frame, gtsam::Rot3());
+    *CHECK_NOTNULL(debug_info) = tracker.debug_info_;
+    std::pair<size_t, size_t> nr_tracks(0u, 0u);
+    for (size_t i = 0u; i < ref_frame.keypoints_.size(); ++i) {
+      if (ref_frame.landmarks_[i] == -1) continue;
+      const KeypointCV& px_ref = ref_frame.keypoints_[i];
+      if (inside.contains(px_ref)) ++nr_tracks.first;
+      if (!outside.contains(px_ref)) ++nr_tracks.second;
+    }
+    return nr_tracks;
+  };
+
+  FrontendParams params = tracker_params_;
+  params.klt_error_pruning_factor_ = 0.0;
+  params.klt_fb_threshold_ = 0.0;
+  DebugTrackerInfo debug_info;
+  const std::pair<size_t, size_t> nr_tracks_unchecked =
+      track(params, &debug_info);
+  EXPECT_EQ(debug_info.nrKltErrorPrunedFeatures_, 0u);
+  EXPECT_EQ(debug_info.nrKltFbRejectedFeatures_, 0u);
+  ASSERT_GT(nr_tracks_unchecked.first, 0u);
+  ASSERT_GT(nr_tracks_unchecked.second, 0u);
+
+  // A zero budget checks no track.
+  params.klt_fb_threshold_ = 0.5;
+  params.klt_fb_max_tracks_ = 0;
+  const std::pair<size_t, size_t> nr_tracks_no_budget =
+      track(params, &debug_info);
+  EXPECT_EQ(debug_info.nrKltFbRejectedFeatures_, 0u);
+  EXPECT_EQ(nr_tracks_no_budget, nr_tracks_unchecked);
+
+  // The forward-backward check alone rejects the drifted tracks.
+  params.klt_fb_max_tracks_ = -1;
+  const std::pair<size_t, size_t> nr_tracks_fb = track(params, &debug_info);
+  const size_t nr_fb_rejected_tracks = debug_info.nrKltFbRejectedFeatures_;
+  EXPECT_EQ(debug_info.nrKltErrorPrunedFeatures_, 0u);
+  EXPECT_GT(nr_fb_rejected_tracks, 0u);
+  EXPECT_LT(nr_tracks_fb.first, nr_tracks_unchecked.first);
+  EXPECT_GE(nr_tracks_fb.second, 0.9 * nr_tracks_unchecked.second);
+
+  // A budget of as many tracks as there are in the noise checks the ones
+  // with largest KLT error, which are in the noise: it leaves the tracks
+  // outside alone, and still finds most of the drifted tracks.
+  params.klt_fb_max_tracks_ = static_cast<int>(nr_tracks_unchecked.first);
+  const std::pair<size_t, size_t> nr_tracks_budget =
+      track(params, &debug_info);
+  EXPECT_EQ(nr_tracks_budget.second, nr_tracks_unchecked.second);
+  EXPECT_LE(debug_info.nrKltFbRejectedFeatures_, nr_fb_rejected_tracks);
+  EXPECT_GT(debug_info.nrKltFbRejectedFeatures_, nr_fb_rejected_tracks / 2u);
+
+  // The checks reject the drifted tracks, and keep the good ones.
+  params.klt_error_pruning_factor_ = 3.0;
+  params.klt_fb_max_tracks_ = -1;
+  const std::pair<size_t, size_t> nr_tracks_checked =
+      track(params, &debug_info);
+  EXPECT_GT(debug_info.nrKltErrorPrunedFeatures_ +
+                debug_info.nrKltFbRejectedFeatures_,
+            0u);
+  EXPECT_LT(nr_tracks_checked.first, nr_tracks_unchecked.first);
+  EXPECT_GE(nr_tracks_checked.second, 0.9 * nr_tracks_unchecked.second);
+}
@@ -598,3 +598,73 @@ TEST_F(UtilsOpenCVFixture, ImageLaplacian) {
   // cv::imshow("actual",actual);
   // cv::waitKey(100);
 }
+
+/* ************************************************************************* */
+TEST_F(UtilsOpenCVFixture, FindHighIntensityInTriangle) {
+  cv::Mat img(240, 320, CV_8UC1);
+  cv::RNG rng(12345);
+  rng.fill(img, cv::RNG::UNIFORM, 0, 256);
+  std::vector<cv::Vec6f> triangles;
+  for (size_t i = 0u; i < 50u; ++i) {
+    triangles.push_back(cv::Vec6f(rng.uniform(0.0f, 319.0f),
+                                  rng.uniform(0.0f, 239.0f),
+                                  rng.uniform(0.0f, 319.0f),
+                                  rng.uniform(0.0f, 239.0f),
+                                  rng.uniform(0.0f, 319.0f),
+                                  rng.uniform(0.0f, 239.0f)));
+  }
+  static constexpr float kThreshold = 200.5f;
+
+  // Brute force: pixels between the intersections of each row with the
+  // triangle edges, excluding a margin of 4 pixels on each side.
+  auto brute_force = [&img](const cv::Vec6f& t) {
+    std::vector<std::pair<KeypointCV, double>> expected;
+    const int x[3] = {static_cast<int>(std::round(t[0])),
+                      static_cast<int>(std::round(t[2])),
+                      static_cast<int>(std::round(t[4]))};
+    const int y[3] = {static_cast<int>(std::round(t[1])),
+                      static_cast<int>(std::round(t[3])),
+                      static_cast<int>(std::round(t[5]))};
+    const int min_y = std::min(y[0], std::min(y[1], y[2]));
+    const int max_y = std::max(y[0], std::max(y[1], y[2]));
+    for (int r = min_y; r < max_y; r++) {
+      int min_x = std::max(x[0], std::max(x[1], x[2]));
+      int max_x = std::min(x[0], std::min(x[1], x[2]));
+      for (int e = 0; e < 3; ++e) {
+        const int s = e, f = (e + 1) % 3;
+        if (y[s] == y[f]) continue;
+        const double lambda = double(r - y[f]) / double(y[s] - y[f]);
+        if (lambda < 0 || lambda > 1) continue;
+        const int x_r =
+            std::round(lambda * double(x[s]) + (1 - lambda) * double(x[f]));
+        min_x = std::min(min_x, x_r);
+        max_x = std::max(max_x, x_r);
+      }
+      for (int c = min_x + 4; c < max_x - 4; c++) {
+        const double intensity = img.at<uint8_t>(r, c);
+        if (intensity > kThreshold) {
+          expected.push_back(std::make_pair(KeypointCV(c, r), intensity));
+        }
+      }
+    }
+    return expected;
+  };
+
+  size_t nr_keypoints = 0u;
+  for (const cv::Vec6f& triangle : triangles) {
+    const std::vector<std::pair<KeypointCV, double>> actual =
+        UtilsOpenCV::FindHighIntensityInTriangle(img, triangle, kThreshold);
+    const auto expected = brute_force(triangle);
+    ASSERT_EQ(actual.size(), expected.size());
+    for (size_t j = 0u; j < expected.size(); ++j) {
+      EXPECT_EQ(actual[j].first, expected[j].first);
+      EXPECT_EQ(actual[j].second, expected[j].second);
+    }
+    nr_keypoints += expected.size();
+
+    // Disabled check.
+    EXPECT_TRUE(
+        UtilsOpenCV::FindHighIntensityInTriangle(img, triangle, -1.0f).empty());
+  }
+  EXPECT_GT(nr_keypoints, 0u);
+}
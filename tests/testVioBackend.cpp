@@ -27,6 +27,7 @@
 #include <gtsam/base/Vector.h>
 #include <gtsam/geometry/Pose3.h>
 #include <gtsam/navigation/ImuBias.h>
+#include <gtsam/slam/PriorFactor.h>
 
 #include "kimera-vio/backend/VioBackend.h"
 #include "kimera-vio/backend/VioBackendFactory.h"
@@ -360,4 +361,413 @@ TEST_F(BackendFixture, robotMovingWithConstantVelocity) {
   }
 }
 
+TEST_F(BackendFixture, extraIterationsStopEarly) {
+  // Synthetic scene, as in robotMovingWithConstantVelocity.
+  const double fov = M_PI / 3 * 2;
+  const double fx = 800.0 / 2 / tan(fov / 2);
+  const Cal3_S2 cam_params(fx, fx, 0.0, 400.0, 300.0);
+  const std::vector<Point3> pts = createScene();
+  StereoPoses poses;
+  createCameraPoses(&poses);
+
+  TrackerStatusSummary tracker_status_valid;
+  tracker_status_valid.kfTrackingStatus_mono_ = TrackingStatus::VALID;
+  tracker_status_valid.kfTrackingStatus_stereo_ = TrackingStatus::VALID;
+  std::vector<StatusStereoMeasurementsPtr> all_measurements;
+  for (const auto& pose : poses) {
+    gtsam::PinholeCamera<Cal3_S2> cam_left(pose.first, cam_params);
+    gtsam::PinholeCamera<Cal3_S2> cam_right(pose.second, cam_params);
+    StereoMeasurements measurement_frame;
+    for (size_t l_id = 0u; l_id < pts.size(); l_id++) {
+      const Point2 pt_left = cam_left.project2(pts[l_id]);
+      const Point2 pt_right = cam_right.project2(pts[l_id]);
+      measurement_frame.push_back(std::make_pair(
+          l_id, StereoPoint2(pt_left.x(), pt_right.x(), pt_left.y())));
+    }
+    all_measurements.push_back(std::make_shared<StatusStereoMeasurements>(
+        std::make_pair(tracker_status_valid, measurement_frame)));
+  }
+  StereoCalibPtr stereo_calibration =
+      boost::make_shared<gtsam::Cal3_S2Stereo>(cam_params.fx(),
+                                               cam_params.fy(),
+                                               cam_params.skew(),
+                                               cam_params.px(),
+                                               cam_params.py(),
+                                               baseline);
+
+  // Runs the backend over the scene, returns the debug info per keyframe.
+  auto run_backend = [&](const BackendParams& backend_params) {
+    VIO::utils::ThreadsafeImuBuffer imu_buf(-1);
+    createImuBuffer(&imu_buf);
+    ImuFrontend imu_frontend(imu_params_, imu_bias_);
+    VioBackend vio_backend(gtsam::Pose3(),
+                           stereo_calibration,
+                           backend_params,
+                           imu_params_,
+                           BackendOutputParams(false, 0, false),
+                           false);
+    vio_backend.registerImuBiasUpdateCallback(
+        std::bind(&ImuFrontend::updateBias,
+                  std::ref(imu_frontend),
+                  std::placeholders::_1));
+
+    std::vector<DebugVioInfo> debug_infos;
+    Timestamp timestamp_km1 =
+        t_start_ - before_start_imu_msgs_ * imu_time_step_;
+    for (FrameId k = 0u; k < num_keyframes_; k++) {
+      const Timestamp timestamp_k = k * keyframe_time_step_ + t_start_;
+      ImuStampS imu_stamps;
+      ImuAccGyrS imu_accgyr;
+      EXPECT_TRUE(imu_buf.getImuDataInterpolatedUpperBorder(
+                      timestamp_km1, timestamp_k, &imu_stamps, &imu_accgyr) ==
+                  utils::ThreadsafeImuBuffer::QueryResult::kDataAvailable);
+      timestamp_km1 = timestamp_k;
+      const auto& pim =
+          imu_frontend.preintegrateImuMeasurements(imu_stamps, imu_accgyr);
+      BackendOutput::Ptr backend_output = vio_backend.spinOnce(
+          BackendInput(timestamp_k,
+                       all_measurements[k],
+                       tracker_status_valid.kfTrackingStatus_stereo_,
+                       pim,
+                       imu_accgyr));
+      CHECK(backend_output);
+      imu_frontend.resetIntegrationWithCachedBias();
+      debug_infos.push_back(backend_output->debug_info_);
+    }
+    return debug_infos;
+  };
+
+  backend_params_.initial_ground_truth_state_ =
+      VioNavState(poses[0].first, velocity_x_, imu_bias_);
+  backend_params_.numOptimize_ = 3;
+
+  // Without stopping criteria, all the extra iterations are done.
+  for (const DebugVioInfo& debug_info : run_backend(backend_params_)) {
+    EXPECT_EQ(debug_info.numExtraIterations_, 2u);
+    EXPECT_EQ(debug_info.extraIterationsStopReason_,
+              ExtraIterationsStopReason::kMaxIterations);
+  }
+
+  // Any delta is below a huge threshold, so no extra iteration is done.
+  BackendParams delta_params = backend_params_;
+  delta_params.extraIterationsDeltaThreshold_ = 1e6;
+  for (const DebugVioInfo& debug_info : run_backend(delta_params)) {
+    EXPECT_EQ(debug_info.numExtraIterations_, 0u);
+    EXPECT_EQ(debug_info.extraIterationsStopReason_,
+              ExtraIterationsStopReason::kSmallDelta);
+  }
+
+  // A tiny time budget is used up by the first update already.
+  BackendParams deadline_params = backend_params_;
+  deadline_params.maxOptimizeTimeMs_ = 1e-6;
+  for (const DebugVioInfo& debug_info : run_backend(deadline_params)) {
+    EXPECT_EQ(debug_info.numExtraIterations_, 0u);
+    EXPECT_EQ(debug_info.extraIterationsStopReason_,
+              ExtraIterationsStopReason::kDeadline);
+  }
+}
+
+TEST_F(BackendFixture, featureTracksRecycling) {
+  FeatureTracks feature_tracks;
+  const gtsam::StereoPoint2 px(100.0, 90.0, 50.0);
+
+  // Lmk 0 is observed in every frame, lmk 1 only in frames 0 and 1, and a new
+  // lmk is created in every frame from frame 2 on. The time horizon spans the
+  // last 3 frames.
+  const FrameId horizon = 3u;
+  const size_t nr_frames = 100u;
+  LandmarkId new_lmk_id = 2;
+  for (FrameId frame_id = 0u; frame_id < nr_frames; ++frame_id) {
+    const FrameId oldest_frame_id =
+        frame_id + 1u < horizon ? 0u : frame_id + 1u - horizon;
+    EXPECT_EQ(feature_tracks.addObservation(0, frame_id, px, oldest_frame_id),
+              frame_id == 0u);
+    if (frame_id < 2u) {
+      feature_tracks.addObservation(1, frame_id, px, oldest_frame_id);
+    } else {
+      EXPECT_TRUE(feature_tracks.addObservation(
+          new_lmk_id++, frame_id, px, oldest_frame_id));
+    }
+    feature_tracks.recycleStaleTracks(oldest_frame_id);
+
+    // Only the observations in the time horizon are kept.
+    const FeatureTrack& feature_track = feature_tracks.at(0);
+    EXPECT_EQ(feature_track.obs_.front().first, oldest_frame_id);
+    EXPECT_EQ(feature_track.obs_.back().first, frame_id);
+    EXPECT_LE(feature_track.obs_.size(), horizon);
+    EXPECT_LE(feature_track.obs_.capacity(), FeatureTrack::kInitialCapacity);
+  }
+
+  // Tracks that left the time horizon were recycled, so the arena does not
+  // grow with the number of frames.
+  EXPECT_TRUE(feature_tracks.find(1) == nullptr);
+  EXPECT_TRUE(feature_tracks.find(new_lmk_id - 1) != nullptr);
+  EXPECT_LE(feature_tracks.size(), horizon + 1u);
+  EXPECT_LE(feature_tracks.capacity(), horizon + 2u);
+
+  // Tracks in the graph are only removed explicitly.
+  feature_tracks.at(new_lmk_id - 1).in_ba_graph_ = true;
+  feature_tracks.recycleStaleTracks(nr_frames + horizon);
+  EXPECT_EQ(feature_tracks.size(), 1u);
+  EXPECT_TRUE(feature_tracks.erase(new_lmk_id - 1));
+  EXPECT_FALSE(feature_tracks.erase(new_lmk_id - 1));
+  EXPECT_TRUE(feature_tracks.empty());
+
+  // A long track in the time horizon keeps all its observations.
+  for (FrameId frame_id = 0u; frame_id < nr_frames; ++frame_id) {
+    feature_tracks.addObservation(0, nr_frames + frame_id, px, 0u);
+  }
+  EXPECT_EQ(feature_tracks.at(0).obs_.size(), nr_frames);
+  EXPECT_EQ(feature_tracks.at(0).obs_.front().first, nr_frames);
+}
+
+#ifdef KIMERA_IN_PLACE_SMOOTHER_UPDATE
+// Two smoothers solve the same problem: one replaces the smart factors in
+// their slot by copies with the measurements of the last pose, the other one
+// removes them and adds the copies as new factors. Their estimates must
+// match, and be within pose_tol of the ground truth.
+static void testInPlaceSmartFactorUpdate(const gtsam::ISAM2Params& isam_params,
+                                         const double& pose_tol) {
+  const gtsam::Cal3_S2Stereo::shared_ptr stereo_calib =
+      boost::make_shared<gtsam::Cal3_S2Stereo>(
+          400.0, 400.0, 0.0, 320.0, 240.0, 0.1);
+  const gtsam::SharedNoiseModel smart_noise =
+      gtsam::noiseModel::Isotropic::Sigma(3, 1.0);
+  const gtsam::SharedNoiseModel tight_pose_noise =
+      gtsam::noiseModel::Isotropic::Sigma(6, 1e-4);
+  const gtsam::SharedNoiseModel loose_pose_noise =
+      gtsam::noiseModel::Isotropic::Sigma(6, 0.1);
+
+  const size_t nr_poses = 3u;
+  std::vector<gtsam::Pose3> poses;
+  for (size_t i = 0u; i < nr_poses; ++i) {
+    poses.push_back(gtsam::Pose3(gtsam::Rot3::Ypr(0.05 * i, 0.0, 0.0),
+                                 gtsam::Point3(0.2 * i, 0.0, 0.0)));
+  }
+  const gtsam::Pose3 pose_perturbation(gtsam::Rot3::Ypr(0.01, -0.01, 0.02),
+                                       gtsam::Point3(0.02, -0.03, 0.01));
+  std::vector<gtsam::Point3> points;
+  for (int i = -2; i <= 2; ++i) {
+    for (int j = -1; j <= 1; ++j) {
+      points.push_back(gtsam::Point3(0.5 * i, 0.4 * j, 4.0 + 0.3 * (i + j)));
+    }
+  }
+
+  InPlaceFixedLagSmoother in_place_smoother(100.0, isam_params);
+  InPlaceFixedLagSmoother replacing_smoother(100.0, isam_params);
+
+  // Poses 0 and 1, with smart factors observing the points from both.
+  gtsam::NonlinearFactorGraph new_factors;
+  gtsam::Values new_values;
+  gtsam::FixedLagSmoother::KeyTimestampMap timestamps;
+  for (size_t i = 0u; i < 2u; ++i) {
+    const gtsam::Symbol pose_symbol(kPoseSymbolChar, i);
+    new_factors.push_back(boost::make_shared<gtsam::PriorFactor<gtsam::Pose3>>(
+        pose_symbol, poses[i], i == 0u ? tight_pose_noise : loose_pose_noise));
+    new_values.insert(pose_symbol,
+                      i == 0u ? poses[i] : poses[i].compose(pose_perturbation));
+    timestamps[pose_symbol] = static_cast<double>(i);
+  }
+  std::vector<SmartStereoFactor::shared_ptr> in_place_factors;
+  std::vector<SmartStereoFactor::shared_ptr> replaced_factors;
+  for (const gtsam::Point3& point : points) {
+    SmartStereoFactor::shared_ptr factor =
+        boost::make_shared<SmartStereoFactor>(smart_noise, SmartFactorParams());
+    for (size_t i = 0u; i < 2u; ++i) {
+      factor->add(gtsam::StereoCamera(poses[i], stereo_calib).project(point),
+                  gtsam::Symbol(kPoseSymbolChar, i),
+                  stereo_calib);
+    }
+    in_place_factors.push_back(factor);
+    replaced_factors.push_back(boost::make_shared<SmartStereoFactor>(*factor));
+  }
+  gtsam::NonlinearFactorGraph in_place_new_factors = new_factors;
+  gtsam::NonlinearFactorGraph replacing_new_factors = new_factors;
+  for (size_t k = 0u; k < points.size(); ++k) {
+    in_place_new_factors.push_back(in_place_factors[k]);
+    replacing_new_factors.push_back(replaced_factors[k]);
+  }
+  in_place_smoother.update(in_place_new_factors, new_values, timestamps);
+  replacing_smoother.update(replacing_new_factors, new_values, timestamps);
+  const gtsam::FactorIndices in_place_slots =
+      in_place_smoother.getISAM2Result().newFactorsIndices;
+  const gtsam::FactorIndices replaced_slots =
+      replacing_smoother.getISAM2Result().newFactorsIndices;
+  ASSERT_EQ(in_place_slots.size(), 2u + points.size());
+  ASSERT_EQ(replaced_slots.size(), 2u + points.size());
+  const size_t nr_factors = in_place_smoother.getFactors().nrFactors();
+
+  // Pose 2, which observes all the points again.
+  const gtsam::Symbol pose_symbol_2(kPoseSymbolChar, 2u);
+  gtsam::NonlinearFactorGraph in_place_factors_2, replacing_factors_2;
+  in_place_factors_2.push_back(
+      boost::make_shared<gtsam::PriorFactor<gtsam::Pose3>>(
+          pose_symbol_2, poses[2], loose_pose_noise));
+  replacing_factors_2.push_back(in_place_factors_2.back());
+  gtsam::Values new_values_2;
+  new_values_2.insert(pose_symbol_2, poses[2].compose(pose_perturbation));
+  gtsam::FixedLagSmoother::KeyTimestampMap timestamps_2;
+  timestamps_2[pose_symbol_2] = 2.0;
+  ExtendedFactors extended_factors;
+  std::vector<SmartStereoFactor::shared_ptr> extended_in_place_factors;
+  gtsam::FactorIndices delete_slots;
+  for (size_t k = 0u; k < points.size(); ++k) {
+    const gtsam::StereoPoint2 measurement =
+        gtsam::StereoCamera(poses[2], stereo_calib).project(points[k]);
+    SmartStereoFactor::shared_ptr extended_factor =
+        boost::make_shared<SmartStereoFactor>(*in_place_factors[k]);
+    extended_factor->add(measurement, pose_symbol_2, stereo_calib);
+    extended_factors[in_place_slots[2u + k]] = extended_factor;
+    extended_in_place_factors.push_back(extended_factor);
+
+    SmartStereoFactor::shared_ptr new_factor =
+        boost::make_shared<SmartStereoFactor>(*replaced_factors[k]);
+    new_factor->add(measurement, pose_symbol_2, stereo_calib);
+    replacing_factors_2.push_back(new_factor);
+    delete_slots.push_back(replaced_slots[2u + k]);
+  }
+  in_place_smoother.update(in_place_factors_2,
+                           new_values_2,
+                           timestamps_2,
+                           gtsam::FactorIndices(),
+                           extended_factors);
+  replacing_smoother.update(
+      replacing_factors_2, new_values_2, timestamps_2, delete_slots);
+  for (size_t i = 0u; i < 3u; ++i) {
+    in_place_smoother.update();
+    replacing_smoother.update();
+  }
+
+  // Only the prior of pose 2 was added, the extended smart factors took the
+  // slot of the original ones, and these were left untouched.
+  EXPECT_EQ(in_place_smoother.getFactors().nrFactors(), nr_factors + 1u);
+  for (size_t k = 0u; k < points.size(); ++k) {
+    const gtsam::NonlinearFactor::shared_ptr& factor =
+        in_place_smoother.getFactors().at(in_place_slots[2u + k]);
+    EXPECT_EQ(factor.get(), extended_in_place_factors[k].get());
+    EXPECT_EQ(factor->keys().size(), nr_poses);
+    EXPECT_EQ(in_place_factors[k]->keys().size(), 2u);
+  }
+
+  const gtsam::Values in_place_estimate =
+      in_place_smoother.calculateEstimate();
+  const gtsam::Values replacing_estimate =
+      replacing_smoother.calculateEstimate();
+  for (size_t i = 0u; i < nr_poses; ++i) {
+    const gtsam::Symbol pose_symbol(kPoseSymbolChar, i);
+    EXPECT_TRUE(gtsam::assert_equal(
+        replacing_estimate.at<gtsam::Pose3>(pose_symbol),
+        in_place_estimate.at<gtsam::Pose3>(pose_symbol),
+        1e-5));
+    EXPECT_TRUE(gtsam::assert_equal(
+        poses[i], in_place_estimate.at<gtsam::Pose3>(pose_symbol), pose_tol));
+  }
+}
+
+TEST_F(BackendFixture, inPlaceSmartFactorUpdate) {
+  // Relinearize all variables at every update.
+  gtsam::ISAM2Params isam_params;
+  isam_params.relinearizeThreshold = 0.0;
+  isam_params.relinearizeSkip = 1;
+  testInPlaceSmartFactorUpdate(isam_params, 1e-3);
+}
+
+TEST_F(BackendFixture, inPlaceSmartFactorUpdateDefaultRelinearization) {
+  // The extended factors must be relinearized even when their variables are
+  // not, as with the default relinearizeThreshold and relinearizeSkip.
+  testInPlaceSmartFactorUpdate(gtsam::ISAM2Params(), 1e-2);
+}
+#endif
+
+TEST_F(BackendFixture, findSmartFactorsBehindCamera) {
+  const double fx = 400.0;
+  const double u0 = 320.0;
+  const double v0 = 240.0;
+  const double stereo_baseline = 0.1;
+  const gtsam::Cal3_S2Stereo::shared_ptr stereo_calib =
+      boost::make_shared<gtsam::Cal3_S2Stereo>(
+          fx, fx, 0.0, u0, v0, stereo_baseline);
+  // Projects without cheirality check, so that points behind the camera give
+  // a measurement too, with negative disparity.
+  auto project = [&](const gtsam::Pose3& pose, const gtsam::Point3& point) {
+    const gtsam::Point3 point_cam = pose.transformTo(point);
+    return gtsam::StereoPoint2(
+        fx * point_cam.x() / point_cam.z() + u0,
+        fx * (point_cam.x() - stereo_baseline) / point_cam.z() + u0,
+        fx * point_cam.y() / point_cam.z() + v0);
+  };
+
+  gtsam::Values estimate;
+  for (size_t i = 0u; i < 2u; ++i) {
+    estimate.insert(gtsam::Symbol(kPoseSymbolChar, i),
+                    gtsam::Pose3(gtsam::Rot3(), gtsam::Point3(0.3 * i, 0, 0)));
+  }
+  const gtsam::SharedNoiseModel smart_noise =
+      gtsam::noiseModel::Isotropic::Sigma(3, 1.0);
+  auto make_smart_factor = [&](const gtsam::Point3& point,
+                               const std::vector<Key>& keys) {
+    SmartStereoFactor::shared_ptr factor =
+        boost::make_shared<SmartStereoFactor>(smart_noise,
+                                              SmartFactorParams());
+    for (const Key& key : keys) {
+      factor->add(project(estimate.exists(key) ? estimate.at<gtsam::Pose3>(key)
+                                               : gtsam::Pose3(),
+                          point),
+                  key,
+                  stereo_calib);
+    }
+    return factor;
+  };
+
+  const std::vector<Key> keys = {gtsam::Symbol(kPoseSymbolChar, 0u),
+                                 gtsam::Symbol(kPoseSymbolChar, 1u)};
+  LandmarkIdSmartFactorMap smart_factors;
+  // In front of the cameras.
+  smart_factors[0] = make_smart_factor(gtsam::Point3(0.2, -0.1, 5.0), keys);
+  // Behind the cameras.
+  smart_factors[1] = make_smart_factor(gtsam::Point3(0.2, -0.1, -5.0), keys);
+  // Behind the cameras too, but observed from a pose not in the estimate.
+  smart_factors[2] = make_smart_factor(
+      gtsam::Point3(0.2, -0.1, -5.0),
+      {keys[0], gtsam::Symbol(kPoseSymbolChar, 2u)});
+
+  std::unordered_set<LandmarkId> lmks_behind_camera = {3};
+  VioBackend::findSmartFactorsBehindCamera(
+      estimate, smart_factors, &lmks_behind_camera);
+  EXPECT_EQ(lmks_behind_camera.size(), 1u);
+  EXPECT_EQ(lmks_behind_camera.count(1), 1u);
+
+  // The triangulation is cached at the screened poses.
+  EXPECT_TRUE(smart_factors[0]->point().valid());
+  EXPECT_TRUE(smart_factors[1]->point().behindCamera());
+}
+
+TEST(FactorSlot, isValidOnlyWhileSlotHoldsFactor) {
+  const gtsam::SharedNoiseModel noise =
+      gtsam::noiseModel::Isotropic::Sigma(3, 1.0);
+  gtsam::NonlinearFactorGraph graph;
+  graph.push_back(boost::make_shared<gtsam::PriorFactor<gtsam::Point3>>(
+      gtsam::Symbol('l', 0), gtsam::Point3(), noise));
+
+  FactorSlot factor_slot;
+  EXPECT_FALSE(factor_slot.isValid(graph));
+  factor_slot.slot_ = 0;
+  factor_slot.factor_ = graph.at(0);
+  EXPECT_TRUE(factor_slot.isValid(graph));
+
+  // The factor is removed, e.g. marginalized.
+  graph.remove(0);
+  EXPECT_FALSE(factor_slot.isValid(graph));
+
+  // Another factor reuses the slot.
+  graph.replace(0,
+                boost::make_shared<gtsam::PriorFactor<gtsam::Point3>>(
+                    gtsam::Symbol('l', 1), gtsam::Point3(), noise));
+  EXPECT_FALSE(factor_slot.isValid(graph));
+
+  // The slot is out of the graph.
+  factor_slot.slot_ = 1;
+  EXPECT_FALSE(factor_slot.isValid(graph));
+}
+
 }  // namespace VIO
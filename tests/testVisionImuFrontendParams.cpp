@@ -44,6 +44,10 @@ TEST(testVisionImuFrontendParams, TrackerParamParseYAML) {
   EXPECT_EQ(tp.klt_max_level_, 2);
   EXPECT_EQ(tp.klt_eps_, 0.001);
   EXPECT_EQ(tp.maxFeatureAge_, 10);
+  EXPECT_EQ(tp.klt_error_pruning_factor_, 2.5);
+  EXPECT_EQ(tp.klt_error_pruning_min_error_, 8.0);
+  EXPECT_EQ(tp.klt_fb_threshold_, 0.5);
+  EXPECT_EQ(tp.klt_fb_max_tracks_, 50);
 
   EXPECT_EQ(tp.stereo_matching_params_.equalize_image_, true);
   EXPECT_EQ(tp.stereo_matching_params_.nominal_baseline_, 110);